@@ -292,6 +292,26 @@ public: //access to data
 	//! Returns whether files should be automatically saved (after each process) or not
 	bool autoSaveMode() const;
 
+	//! Sets whether files should be saved asynchronously (write-behind) or not
+	/** In this mode, a snapshot of each exported entity is saved in the background
+		while the next commands are processed.
+		\param state whether the asynchronous mode is enabled or not
+		\param maxPendingMemory max. amount of memory used by the snapshots waiting to be saved (in bytes)
+	**/
+	void toggleAsyncSaveMode(bool state, size_t maxPendingMemory = DEFAULT_ASYNC_SAVE_MAX_MEMORY);
+	//! Returns whether files should be saved asynchronously (write-behind) or not
+	bool asyncSaveMode() const;
+	//! Returns the max. amount of memory used by the snapshots waiting to be saved (in bytes)
+	size_t asyncSaveMaxMemory() const;
+
+	//! Default max. amount of memory used by the snapshots waiting to be saved (in bytes)
+	static constexpr size_t DEFAULT_ASYNC_SAVE_MAX_MEMORY = (size_t(1) << 30);
+
+	//! Waits for all the pending (asynchronous) saves to be completed
+	/** \return false if at least one save failed (errors are reported in the console)
+	**/
+	virtual bool flushPendingSaves() { return true; }
+
 	//! Sets whether a timestamp should be automatically added to output files or not
 	void toggleAddTimestamp(bool state);
 	//! Returns whether a timestamp should be automatically added to output files or not
@@ -332,6 +352,12 @@ protected: //members
 	//! Whether files should be automatically saved (after each process) or not
 	bool m_autoSaveMode;
 
+	//! Whether files should be saved asynchronously (write-behind) or not
+	bool m_asyncSaveMode;
+
+	//! Max. amount of memory used by the snapshots waiting to be saved (in bytes)
+	size_t m_asyncSaveMaxMemory;
+
 	//! Whether a timestamp should be automatically added to output files or not
 	bool m_addTimestamp;
 
@@ -158,6 +158,8 @@ CL_ENTITY_TYPE CLMeshDesc::getCLEntityType() const
 ccCommandLineInterface::ccCommandLineInterface()
 	: m_silentMode(false)
 	, m_autoSaveMode(true)
+	, m_asyncSaveMode(false)
+	, m_asyncSaveMaxMemory(DEFAULT_ASYNC_SAVE_MAX_MEMORY)
 	, m_addTimestamp(true)
 	, m_precision(12)
 	, m_coordinatesShiftWasEnabled(false)
@@ -223,6 +225,22 @@ bool ccCommandLineInterface::autoSaveMode() const
 	return m_autoSaveMode;
 }
 
+void ccCommandLineInterface::toggleAsyncSaveMode(bool state, size_t maxPendingMemory/*=DEFAULT_ASYNC_SAVE_MAX_MEMORY*/)
+{
+	m_asyncSaveMode = state;
+	m_asyncSaveMaxMemory = maxPendingMemory;
+}
+
+bool ccCommandLineInterface::asyncSaveMode() const
+{
+	return m_asyncSaveMode;
+}
+
+size_t ccCommandLineInterface::asyncSaveMaxMemory() const
+{
+	return m_asyncSaveMaxMemory;
+}
+
 void ccCommandLineInterface::toggleAddTimestamp(bool state)
 {
 	m_addTimestamp = state;
@@ -22,8 +22,12 @@
 #include "ccSensor.h"
 #include "ccOctree.h"
 
+//Qt
+#include <QMutex>
+
 //system
 #include <unordered_set>
+#include <vector>
 
 class ccImage;
 class ccMesh;
@@ -387,6 +391,7 @@ public: //orthorectification tools
 		\param outputDir output directory for resulting images (is successful)
 		\param[out] orthoRectifiedImages resulting images (is successful)
 		\param[out] relativePos relative positions (relatively to first image)
+		\param maxMemory_MB memory budget for the images processed concurrently (in Mb)
 		\return true if successful
 	**/
 	static bool OrthoRectifyAsImages(std::vector<ccImage*> images,
@@ -394,7 +399,8 @@ public: //orthorectification tools
 									unsigned maxSize,
 									QDir* outputDir = nullptr,
 									std::vector<ccImage*>* orthoRectifiedImages = nullptr,
-									std::vector<std::pair<double,double> >* relativePos = nullptr);
+									std::vector<std::pair<double,double> >* relativePos = nullptr,
+									unsigned maxMemory_MB = 1024);
 
 	//! Computes ortho-rectification parameters for a given image
 	/** Requires at least 4 key points!
@@ -438,6 +444,8 @@ public: //misc
 
 	//! Undistorts an image based on the sensor distortion parameters
 	/** \warning Only works with the simple radial distortion model for now (see RadialDistortionParameters).
+		The remap table is computed once for a given image size (and the current parameters)
+		and the output pixels are resampled in parallel (bilinear interpolation).
 		\param image input image
 		\return undistorted image (or a null one if an error occurred)
 	**/
@@ -483,6 +491,24 @@ public: //helpers
 
 protected:
 
+	//! Undistortion remap table (for a given image size)
+	struct UndistortionMap
+	{
+		//! Image width
+		int width = 0;
+		//! Image height
+		int height = 0;
+		//! Parameters used to compute the table
+		std::vector<float> parameters;
+		//! Source position of each output pixel (row-major, negative if invalid)
+		std::vector<float> sourceX;
+		//! Source position of each output pixel (row-major, negative if invalid)
+		std::vector<float> sourceY;
+	};
+
+	//! Returns the undistortion remap table for a given image size (computed on the first call)
+	QSharedPointer<const UndistortionMap> getUndistortionMap(int width, int height) const;
+
 	//! Used internally for display
 	CCVector3 computeUpperLeftPoint() const;
 
@@ -514,6 +540,11 @@ protected:
 	ccGLMatrix m_projectionMatrix;
 	//! Whether the intrinsic matrix is valid or not
 	bool m_projectionMatrixIsValid;
+
+	//! Last undistortion remap table
+	mutable QSharedPointer<const UndistortionMap> m_undistortionMap;
+	//! Mutex for concurrent access to the undistortion remap table
+	mutable QMutex m_undistortionMapMutex;
 };
 
 class ccOctreeFrustumIntersector
@@ -0,0 +1,129 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_CHUNKED_ARRAY_HEADER
+#define CC_CHUNKED_ARRAY_HEADER
+
+//Local
+#include "ccChunk.h"
+
+//System
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! Chunked array (reallocation-free growth)
+/** The elements are stored in blocks of ccChunk::SIZE elements. Appending an element
+	never moves the existing ones (contrary to std::vector, there's no 'reallocate and copy'
+	step, nor any large contiguous allocation that may fail on fragmented memory).
+	Meant to be used as a temporary storage when the final number of elements is unknown
+	(e.g. when loading a file): the elements are then transferred once to the (contiguous)
+	destination array, see moveTo.
+**/
+template <class Type> class ccChunkedArray
+{
+public:
+
+	//! Default constructor
+	ccChunkedArray() : m_size(0) {}
+
+	//! Move constructor
+	ccChunkedArray(ccChunkedArray&& array) noexcept
+		: m_chunks(std::move(array.m_chunks))
+		, m_size(array.m_size)
+	{
+		array.m_size = 0;
+	}
+
+	//! Move assignment operator
+	ccChunkedArray& operator=(ccChunkedArray&& array) noexcept
+	{
+		if (this != &array)
+		{
+			m_chunks = std::move(array.m_chunks);
+			m_size = array.m_size;
+			array.m_size = 0;
+		}
+		return *this;
+	}
+
+	//! Returns the number of elements
+	inline size_t size() const { return m_size; }
+	//! Returns whether the array is empty
+	inline bool empty() const { return m_size == 0; }
+
+	//! Appends an element
+	/** Throws std::bad_alloc if a new chunk can't be allocated.
+	**/
+	inline void addElement(const Type& value)
+	{
+		const size_t chunkIndex = (m_size >> ccChunk::SIZE_POWER);
+		if (chunkIndex == m_chunks.size())
+		{
+			m_chunks.emplace_back(new Type[ccChunk::SIZE]);
+		}
+		m_chunks[chunkIndex][m_size & (ccChunk::SIZE - 1)] = value;
+		++m_size;
+	}
+
+	//! Returns an element
+	inline Type& operator[](size_t index) { assert(index < m_size); return m_chunks[index >> ccChunk::SIZE_POWER][index & (ccChunk::SIZE - 1)]; }
+	//! Returns an element (const version)
+	inline const Type& operator[](size_t index) const { assert(index < m_size); return m_chunks[index >> ccChunk::SIZE_POWER][index & (ccChunk::SIZE - 1)]; }
+
+	//! Clears the array (and releases the memory)
+	void clear()
+	{
+		m_chunks.clear();
+		m_chunks.shrink_to_fit();
+		m_size = 0;
+	}
+
+	//! Transfers the first elements (in order) to a destination
+	/** Each chunk is released as soon as its elements have been transferred (so as to limit
+		the memory peak). The array is cleared afterwards.
+		\param count number of elements to transfer (the others are discarded)
+		\param addElement function called on each element (e.g. to append it to a reserved std::vector)
+	**/
+	template <class Function> void moveTo(size_t count, Function addElement)
+	{
+		assert(count <= m_size);
+		count = std::min(count, m_size);
+		for (size_t chunkIndex = 0; chunkIndex < ccChunk::Count(count); ++chunkIndex)
+		{
+			const Type* chunk = m_chunks[chunkIndex].get();
+			size_t chunkSize = ccChunk::Size(chunkIndex, count);
+			for (size_t i = 0; i < chunkSize; ++i)
+			{
+				addElement(chunk[i]);
+			}
+			m_chunks[chunkIndex].reset();
+		}
+		clear();
+	}
+
+protected:
+
+	//! Chunks (of ccChunk::SIZE elements each)
+	std::vector< std::unique_ptr<Type[]> > m_chunks;
+	//! Number of elements
+	size_t m_size;
+};
+
+#endif //CC_CHUNKED_ARRAY_HEADER
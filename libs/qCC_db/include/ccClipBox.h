@@ -55,6 +55,7 @@ public:
 
 	//inherited from ccHObject
 	ccBBox getOwnBB(bool withGLFeatures = false) override;
+	bool isBBCacheable() const override { return false; } //the box is interactively modified
 
 	//inherited from ccInteractor
 	bool move2D(int x, int y, int dx, int dy, int screenWidth, int screenHeight) override;
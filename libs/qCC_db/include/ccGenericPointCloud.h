@@ -22,6 +22,7 @@
 #include "ccAdvancedTypes.h"
 #include "ccOctree.h"
 #include "ccShiftedObject.h"
+#include "ccVisibilityTable.h"
 
 //System
 #include <vector>
@@ -166,9 +167,9 @@ public:
 	***************************************************/
 
 	//! Array of "visibility" information for each point
-	/** See <CCConst.h>
+	/** See <CCConst.h> and ccVisibilityTable (one bit per point, with per-chunk summaries)
 	**/
-	using VisibilityTableType = std::vector<unsigned char>;
+	using VisibilityTableType = ccVisibilityTable;
 	
 	//! Returns associated visiblity array
 	virtual inline VisibilityTableType& getTheVisibilityArray() { return m_pointsVisibility; }
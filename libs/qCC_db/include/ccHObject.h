@@ -199,6 +199,15 @@ public: //children management
 	//! Returns index relatively to its parent or -1 if no parent
 	int getIndex() const;
 
+	//! Returns the current version of the entities hierarchy
+	/** This (global) counter is incremented each time a child is added to,
+		removed from or moved inside any entity. It can be used to safely
+		invalidate caches built over one or several hierarchies (e.g. the
+		DB tree ID index), as no entity can be deleted from a hierarchy
+		without its parent being modified.
+	**/
+	static unsigned GetHierarchyVersion();
+
 	//! Transfer a given child to another parent
 	void transferChild(ccHObject* child, ccHObject& newParent);
 	//! Transfer all children to another parent
@@ -236,6 +245,15 @@ public: //bounding-box
 	**/
 	virtual ccBBox getDisplayBB_recursive(bool relative, const ccGenericGLDisplay* display = nullptr);
 
+	//! Invalidates the cached bounding-boxes of this entity and of its ancestors
+	/** The recursive bounding-boxes (see getBB_recursive and getDisplayBB_recursive) are cached.
+		They are automatically invalidated when the geometry is updated (see notifyGeometryUpdate),
+		when a GL transformation is applied or changed, when the entity is enabled/disabled, or
+		when the hierarchy is modified. This method should only be called if an entity's own
+		bounding-box is modified in another way.
+	**/
+	void invalidateBBCache();
+
 	//! Returns best-fit bounding-box (if available)
 	/** \warning Only suitable for leaf objects (i.e. without children)
 		Therefore children bboxes are always ignored.
@@ -265,13 +283,27 @@ public: //bounding-box
 	//! Draws the entity (and its children) bounding-box
 	virtual void drawBB(CC_DRAW_CONTEXT& context, const ccColor::Rgb& col);
 
+	//! Returns whether the entity's own bounding-box can be cached or not
+	/** An entity's own bounding-box can be cached if it only changes along with a call to
+		notifyGeometryUpdate (on this entity, one of its children, or an entity it depends on
+		with the DP_NOTIFY_OTHER_ON_UPDATE flag) or a GL transformation. Otherwise, the recursive
+		bounding-boxes of this entity and of its ancestors are always recomputed.
+	**/
+	virtual bool isBBCacheable() const { return true; }
+
 public: //display
 
 	//Inherited from ccDrawableObject
 	void draw(CC_DRAW_CONTEXT& context) override;
+	void setDisplay(ccGenericGLDisplay* win) override;
+	void enableGLTransformation(bool state) override;
+
+	//Inherited from ccObject
+	void setEnabled(bool state) override;
 
 	//! Returns the absolute transformation (i.e. the actual displayed GL transforamtion) of an entity
-	/** \param[out] trans absolute transformation
+	/** The result is cached (until a GL transformation or the hierarchy is modified).
+		\param[out] trans absolute transformation
 		\return whether a GL transformation is actually enabled or not
 	**/
 	bool getAbsoluteGLTransformation(ccGLMatrix& trans) const;
@@ -396,7 +428,7 @@ public: //display
 protected:
 
 	//! Sets parent object
-	virtual inline void setParent(ccHObject* anObject) { m_parent = anObject; }
+	virtual void setParent(ccHObject* anObject);
 
 	//! Draws the entity only (not its children)
 	virtual void drawMeOnly(CC_DRAW_CONTEXT& context) { /*does nothing by default*/ }
@@ -460,6 +492,40 @@ protected:
 
 	//! Flag to safely handle dependencies when the object is being deleted
 	bool m_isDeleting;
+
+	//! Cached bounding-boxes (see getBB_recursive and getDisplayBB_recursive)
+	struct BBCache
+	{
+		//! Recursive bounding-boxes (indexed by 'withGLFeatures' and 'onlyEnabledChildren')
+		ccBBox recursiveBB[2][2];
+		//! Validity of the recursive bounding-boxes
+		bool recursiveBBIsValid[2][2] = { { false, false }, { false, false } };
+		//! Relative display bounding-box
+		ccBBox displayBB;
+		//! Display associated to the cached display bounding-box
+		const ccGenericGLDisplay* displayBBDisplay = nullptr;
+		//! Validity of the display bounding-box
+		bool displayBBIsValid = false;
+
+		//! Invalidates all the bounding-boxes
+		inline void invalidate() { recursiveBBIsValid[0][0] = recursiveBBIsValid[0][1] = recursiveBBIsValid[1][0] = recursiveBBIsValid[1][1] = displayBBIsValid = false; }
+	};
+
+	//! Bounding-boxes cache
+	BBCache m_bbCache;
+
+	//! Whether the bounding-boxes cache is currently being invalidated (to break dependency loops)
+	bool m_invalidatingBBCache;
+
+	//! Cached absolute GL transformation (see getAbsoluteGLTransformation)
+	mutable ccGLMatrix m_absoluteGLTrans;
+	//! Whether the cached absolute GL transformation is enabled
+	mutable bool m_absoluteGLTransEnabled;
+	//! Version of the cached absolute GL transformation (0 = invalid)
+	mutable unsigned m_absoluteGLTransVersion;
+
+	//! Last known index of this entity in its parent's children list (see getChildIndex)
+	mutable int m_childIndexHint;
 };
 
 /*** Helpers ***/
@@ -96,6 +96,7 @@ public:
 
 	//Inherited from ccHObject
 	ccBBox getOwnBB(bool withGLFeatures = false) override;
+	bool isBBCacheable() const override { return false; } //transformations can be added at any time
 
 protected:
 
@@ -61,6 +61,7 @@ public:
 
 	//Inherited from ccHObject
 	virtual ccBBox getOwnBB(bool withGLFeatures = false) override;
+	virtual bool isBBCacheable() const override { return false; } //depends on the associated cloud
 
 	//! Flag points with cell index (as a scalar field)
 	bool convertCellIndexToSF();
@@ -22,6 +22,9 @@
 #include "ccGenericPointCloud.h"
 
 //System
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 
 //! Compressed normal vectors handler
@@ -51,6 +54,90 @@ public:
 	//! Returns the compressed index corresponding to a normal vector (shortcut)
 	static inline CompressedNormType GetNormIndex(const CCVector3& N) { return GetNormIndex(N.u); }
 
+	//! Decodes a set of compressed normals (with the precomputed table)
+	/** Designed for bulk transfers (e.g. to VBOs).
+		\param codes compressed normals
+		\param count number of normals to decode
+		\param normals output buffer (count * 3 values)
+		\param step code increment (for decimation)
+	**/
+	static void DecodeNormals(const CompressedNormType* codes, size_t count, PointCoordinateType* normals, size_t step = 1);
+
+	/*** Octahedral encoding ***/
+
+	//! Octahedral compressed normal type (2 x 16 bits)
+	/** Contrary to the default compression scheme (see ccNormalCompressor), the
+		octahedral codes are decoded arithmetically (no precomputed table is required).
+	**/
+	using OctahedralNormType = uint32_t;
+
+	//! Encodes a normal with the octahedral scheme
+	/** \warning A null vector is encoded as (0,0,1).
+	**/
+	static inline OctahedralNormType EncodeOctahedral(const CCVector3& N)
+	{
+		//project the vector on the octahedron
+		PointCoordinateType l1 = std::abs(N.x) + std::abs(N.y) + std::abs(N.z);
+		PointCoordinateType invL1 = (l1 > 0 ? 1 / l1 : 0);
+		PointCoordinateType x = N.x * invL1;
+		PointCoordinateType y = N.y * invL1;
+		if (N.z < 0)
+		{
+			//fold the lower hemisphere
+			PointCoordinateType xf = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+			PointCoordinateType yf = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+			x = xf;
+			y = yf;
+		}
+		return static_cast<OctahedralNormType>(QuantizeOctahedral(x)) | (static_cast<OctahedralNormType>(QuantizeOctahedral(y)) << 16);
+	}
+
+	//! Decodes an octahedral compressed normal
+	static inline CCVector3 DecodeOctahedral(OctahedralNormType code)
+	{
+		PointCoordinateType x = static_cast<PointCoordinateType>(static_cast<int>(code & 0xFFFF) - 32768) / 32767;
+		PointCoordinateType y = static_cast<PointCoordinateType>(static_cast<int>(code >> 16) - 32768) / 32767;
+		PointCoordinateType z = 1 - std::abs(x) - std::abs(y);
+		//unfold the lower hemisphere
+		PointCoordinateType t = std::max<PointCoordinateType>(-z, 0);
+		x += (x >= 0 ? -t : t);
+		y += (y >= 0 ? -t : t);
+		PointCoordinateType invNorm = 1 / std::sqrt(x * x + y * y + z * z);
+		return CCVector3(x * invNorm, y * invNorm, z * invNorm);
+	}
+
+	//! Encodes a set of normals with the octahedral scheme
+	/** \param normals input normals (count * 3 values)
+		\param count number of normals
+		\param codes output codes (count values)
+	**/
+	static void EncodeOctahedral(const PointCoordinateType* normals, size_t count, OctahedralNormType* codes);
+
+	//! Decodes a set of octahedral compressed normals
+	/** The loop is branch-free so as to be vectorized by the compiler.
+		Designed for bulk transfers (e.g. to VBOs), as no lookup table is involved.
+		\param codes octahedral codes
+		\param count number of normals to decode
+		\param normals output buffer (count * 3 values)
+		\param step code increment (for decimation)
+	**/
+	static void DecodeOctahedral(const OctahedralNormType* codes, size_t count, PointCoordinateType* normals, size_t step = 1);
+
+	//! Converts an array of (default) compressed normals to octahedral codes
+	/** Can be used to convert the normals of existing entities (e.g. loaded from BIN files).
+		\param codes default compressed normals
+		\param octCodes output octahedral codes
+		\return success
+	**/
+	static bool ConvertToOctahedral(const NormsIndexesTableType& codes, std::vector<OctahedralNormType>& octCodes);
+
+	//! Converts octahedral codes to an array of (default) compressed normals
+	/** \param octCodes octahedral codes
+		\param codes output compressed normals array
+		\return success
+	**/
+	static bool ConvertFromOctahedral(const std::vector<OctahedralNormType>& octCodes, NormsIndexesTableType& codes);
+
 	//! 'Default' orientations
 	enum Orientation {
 
@@ -207,6 +294,13 @@ protected:
 	//! Inits internal structures
 	bool init();
 
+	//! Quantizes an octahedral coordinate (in [-1;1]) on 16 bits
+	static inline unsigned QuantizeOctahedral(PointCoordinateType v)
+	{
+		v = std::max<PointCoordinateType>(-1, std::min<PointCoordinateType>(v, 1));
+		return static_cast<unsigned>(static_cast<int>(std::lround(v * 32767)) + 32768);
+	}
+
 	//! Compressed normal vectors
 	std::vector<CCVector3> m_theNormalVectors;
 
@@ -29,6 +29,9 @@
 //Qt
 #include <QObject>
 
+//System
+#include <functional>
+
 class ccGenericPointCloud;
 class ccOctreeFrustumIntersector;
 class ccCameraSensor;
@@ -118,6 +121,88 @@ public: //HELPERS
 	static CCVector3 ComputeAverageNorm(CCCoreLib::ReferenceCloud* subset,
 										ccGenericPointCloud* sourceCloud);
 
+public: //NEIGHBOURHOOD QUERIES
+
+	//! Neighbourhood query context
+	/** One context is kept per thread (see GetThreadQueryContext) and reused for all the
+		cells successively processed by this thread, so that the search buffers are not
+		re-allocated for each cell.
+	**/
+	struct QCC_DB_LIB_API QueryContext
+	{
+		//! Search structure (the spherical version can be used for both kinds of searches)
+		CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+		//! Octree in which the neighbours are searched
+		const CCCoreLib::DgmOctree* octree = nullptr;
+
+		//! Spherical search around the current query point
+		/** \warning there may be more points at the end of nNSS.pointsInNeighbourhood than the returned count!
+		**/
+		inline unsigned findNeighborsInASphere(PointCoordinateType radius) { return octree->findNeighborsInASphereStartingFromCell(nNSS, radius, false); }
+		//! Nearest neighbours search around the current query point (see nNSS.minNumberOfNeighbors)
+		/** \warning the returned count may be higher than the requested number of neighbours!
+		**/
+		inline unsigned findNearestNeighbors() { return octree->findNearestNeighborsStartingFromCell(nNSS, false); }
+	};
+
+	//! Returns the (reusable) query context of the calling thread
+	static QueryContext& GetThreadQueryContext();
+
+	//! Releases the search buffers retained by the query contexts of all threads
+	/** Should be called once an executeFunctionForAllCellsAtLevel pass relying on the
+		query contexts is over, so that the pool threads don't keep their buffers.
+		\warning must not be called while a pass is still running
+	**/
+	static void ReleaseQueryContexts();
+
+	//! Prepares the calling thread query context for the points of a given cell
+	/** If the neighbours are searched in the cell's own octree, the points of the cell are
+		directly inserted in the neighbourhood. In any case, the cells gathered around the
+		first query points are shared by all the other points of the cell.
+		\param cell current octree cell
+		\param searchOctree octree in which the neighbours are searched (the cell's octree by default)
+		\param radius search radius (spherical searches only)
+		\param minNumberOfNeighbors minimum number of neighbours (nearest neighbours searches only)
+		\return the calling thread query context
+	**/
+	static QueryContext& PrepareCellQuery(	const CCCoreLib::DgmOctree::octreeCell& cell,
+											const CCCoreLib::DgmOctree* searchOctree = nullptr,
+											PointCoordinateType radius = 0,
+											unsigned minNumberOfNeighbors = 0);
+
+	//! Function called for each point of a cell by the batched queries
+	/** \param context query context (the query point is set and its neighbours have been searched)
+		\param indexInCell index of the query point in the cell
+		\param neighborCount number of valid neighbours (first elements of context.nNSS.pointsInNeighbourhood)
+		\return whether the process should continue or not
+	**/
+	using CellPointFunction = std::function<bool(QueryContext& context, unsigned indexInCell, unsigned neighborCount)>;
+
+	//! Searches the neighbours of all the points of a cell inside a sphere
+	/** \param cell current octree cell
+		\param radius search radius
+		\param func function called for each point of the cell
+		\param nProgress optional progress notification (one step per point)
+		\param searchOctree octree in which the neighbours are searched (the cell's octree by default)
+		\return false if the process was interrupted (by the function or the progress callback)
+	**/
+	static bool FindNeighborsInASphereForCellPoints(const CCCoreLib::DgmOctree::octreeCell& cell,
+													PointCoordinateType radius,
+													const CellPointFunction& func,
+													CCCoreLib::NormalizedProgress* nProgress = nullptr,
+													const CCCoreLib::DgmOctree* searchOctree = nullptr);
+
+	//! Searches the k nearest neighbours of all the points of a cell
+	/** See FindNeighborsInASphereForCellPoints.
+		\warning the neighbour count passed to the function may be higher than k (and the query
+		point itself is part of the neighbours if it belongs to the searched octree)
+	**/
+	static bool FindNearestNeighborsForCellPoints(	const CCCoreLib::DgmOctree::octreeCell& cell,
+													unsigned k,
+													const CellPointFunction& func,
+													CCCoreLib::NormalizedProgress* nProgress = nullptr,
+													const CCCoreLib::DgmOctree* searchOctree = nullptr);
+
 signals:
 
 	//! Signal sent when the octree organization is modified (cleared, etc.)
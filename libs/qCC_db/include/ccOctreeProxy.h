@@ -46,6 +46,7 @@ public:
 	//Inherited from ccHObject
 	virtual CC_CLASS_ENUM getClassID() const override { return CC_TYPES::POINT_OCTREE; }
 	virtual ccBBox getOwnBB(bool withGLFeatures = false) override;
+	virtual bool isBBCacheable() const override { return false; } //depends on the associated cloud
 
 protected:
 
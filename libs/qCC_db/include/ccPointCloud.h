@@ -163,10 +163,23 @@ public: //features deletion/clearing
 	//! Notify a modification of color / scalar field display parameters or contents
 	inline void colorsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_COLORS; }
 	//! Notify a modification of normals display parameters or contents
-	inline void normalsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_NORMALS; }
+	inline void normalsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_NORMALS; m_octahedralNormalsValid = false; }
 	//! Notify a modification of points display parameters or contents
 	inline void pointsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_POINTS; }
 
+	//! Notify a modification of the colors of a range of points
+	/** Only the VBO chunks overlapping the range will be updated. Can also be used after
+		having modified a few values of the displayed scalar field (as long as its display
+		range and color scale are left unchanged).
+		\param firstIndex index of the first modified point
+		\param lastIndex index of the last modified point (included)
+	**/
+	inline void colorsHaveChanged(unsigned firstIndex, unsigned lastIndex) { vboRangeHasChanged(vboSet::UPDATE_COLORS, firstIndex, lastIndex); }
+	//! Notify a modification of the normals of a range of points (see colorsHaveChanged)
+	inline void normalsHaveChanged(unsigned firstIndex, unsigned lastIndex) { vboRangeHasChanged(vboSet::UPDATE_NORMALS, firstIndex, lastIndex); m_octahedralNormalsValid = false; }
+	//! Notify a modification of the coordinates of a range of points (see colorsHaveChanged)
+	inline void pointsHaveChanged(unsigned firstIndex, unsigned lastIndex) { vboRangeHasChanged(vboSet::UPDATE_POINTS, firstIndex, lastIndex); }
+
 public: //features allocation/resize
 
 	//! Reserves memory to store the points coordinates
@@ -746,12 +759,31 @@ protected:
 	**/
 	void swapPoints(unsigned firstIndex, unsigned secondIndex) override;
 
+	//! Creates a new point cloud object from a subset of the points of this cloud
+	/** The output arrays are allocated once and each attribute (points, colors, normals,
+		waveforms, scalar fields and scan grid indexes) is copied with a parallel streaming pass.
+		\param count number of points in the subset
+		\param forEachPoint subset enumerator: called with a functor that must be applied to
+				each pair of (output index, input index). The pairs may be processed concurrently.
+		\param[out] warnings [optional] to determine if warnings (CTOR_ERRORS) occurred during the duplication process
+	**/
+	template <class SubsetFunction> ccPointCloud* createSubsetCloud(unsigned count, const SubsetFunction& forEachPoint, int* warnings) const;
+
 	//! Colors
 	RGBAColorsTableType* m_rgbaColors;
 
 	//! Normals (compressed)
 	NormsIndexesTableType* m_normals;
 
+	//! Normals (octahedral codes)
+	/** Table-free copy of the compressed normals, used to send them in bulk
+		to the graphic card (see getOctahedralNormals).
+	**/
+	std::vector<ccNormalVectors::OctahedralNormType> m_octahedralNormals;
+
+	//! Whether the octahedral codes are up to date with the compressed normals
+	bool m_octahedralNormalsValid;
+
 	//! Specifies whether current scalar field color scale should be displayed or not
 	bool m_sfColorScaleDisplayed;
 
@@ -776,6 +808,9 @@ protected: // VBO
 	//! Release VBOs
 	void releaseVBOs();
 
+	//! Flags a range of points for update in the VBOs
+	void vboRangeHasChanged(int updateFlags, unsigned firstIndex, unsigned lastIndex);
+
 	class VBO : public QGLBuffer
 	{
 	public:
@@ -808,6 +843,17 @@ protected: // VBO
 			UPDATE_ALL = UPDATE_POINTS | UPDATE_COLORS | UPDATE_NORMALS
 		};
 
+		//! Range of points to update inside a chunk
+		struct DirtyRange
+		{
+			//! Update flags (see UPDATE_FLAGS)
+			int updateFlags = 0;
+			//! Index of the first point to update (relatively to the chunk start)
+			unsigned firstIndex = 0;
+			//! Index of the last point to update (relatively to the chunk start, included)
+			unsigned lastIndex = 0;
+		};
+
 		vboSet()
 			: hasColors(false)
 			, colorIsSF(false)
@@ -815,6 +861,7 @@ protected: // VBO
 			, hasNormals(false)
 			, totalMemSizeBytes(0)
 			, updateFlags(0)
+			, hasDirtyRanges(false)
 			, state(NEW)
 		{}
 
@@ -826,6 +873,11 @@ protected: // VBO
 		int totalMemSizeBytes;
 		int updateFlags;
 
+		//! Per-chunk ranges of points to update (on top of the global update flags)
+		std::vector<DirtyRange> dirtyRanges;
+		//! Whether at least one chunk has a range of points to update
+		bool hasDirtyRanges;
+
 		//! Current state
 		STATES state;
 	};
@@ -839,6 +891,21 @@ protected: // VBO
 	void glChunkSFPointer    (const CC_DRAW_CONTEXT& context, size_t chunkIndex, unsigned decimStep, bool useVBOs);
 	void glChunkNormalPointer(const CC_DRAW_CONTEXT& context, size_t chunkIndex, unsigned decimStep, bool useVBOs);
 
+	//! Returns the octahedral codes of the normals (updated if necessary)
+	/** \return the codes (one per point) or nullptr if they couldn't be computed (not enough memory)
+	**/
+	const ccNormalVectors::OctahedralNormType* getOctahedralNormals();
+
+	//! Decodes (in bulk) a range of normals of a given chunk
+	/** Relies on the octahedral codes if possible (no lookup table), or on the compressed normals table otherwise.
+		\param chunkIndex chunk index
+		\param firstIndex index of the first normal (relatively to the chunk start)
+		\param count number of normals to decode
+		\param normals output buffer (count * 3 values)
+		\param decimStep normal increment (for decimation)
+	**/
+	void decodeChunkNormals(size_t chunkIndex, size_t firstIndex, size_t count, PointCoordinateType* normals, unsigned decimStep = 1);
+
 public: //Level of Detail (LOD)
 
 	//! Intializes the LOD structure
@@ -95,6 +95,7 @@ public:
 
 	//inherited methods (ccHObject)
 	virtual ccBBox getOwnBB(bool withGLFeatures = false) override;
+	virtual bool isBBCacheable() const override;
 	inline virtual void drawBB(CC_DRAW_CONTEXT& context, const ccColor::Rgb& col) override
 	{
 		//DGM: only for 3D polylines!
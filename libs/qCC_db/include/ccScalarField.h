@@ -192,6 +192,12 @@ public:
 	//! Returns associated histogram values (for display)
 	inline const Histogram& getHistogram() const { return m_histogram; }
 
+	//! Returns the values 'version'
+	/** Incremented each time the min and max values are (re)computed, i.e. each time
+		the values are (potentially) modified. Can be used to invalidate cached data.
+	**/
+	inline unsigned getValuesVersion() const { return m_valuesVersion; }
+
 	//! Returns whether the scalar field in its current configuration MAY have 'hidden' values or not
 	/** 'Hidden' values are typically NaN values or values outside of the 'displayed' intervale
 		while those values are not displayed in grey (see ccScalarField::showNaNValuesInGrey).
@@ -270,6 +276,9 @@ protected: //members
 	//! Associated histogram values (for display)
 	Histogram m_histogram;
 
+	//! Values 'version' (see getValuesVersion)
+	unsigned m_valuesVersion;
+
 	//! Modification flag
 	/** Any modification to the scalar field values or parameters
 		will turn this flag on.
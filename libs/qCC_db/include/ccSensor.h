@@ -46,6 +46,7 @@ public:
 	//inherited from ccHObject
 	CC_CLASS_ENUM getClassID() const override { return CC_TYPES::SENSOR; }
 	bool isSerializable() const override { return true; }
+	bool isBBCacheable() const override { return false; } //depends on the active index, the graphic scale, etc.
 
 	//! Returns the sensor type
 	/** Should be re-implemented by sub-classes
@@ -0,0 +1,236 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_VISIBILITY_TABLE_HEADER
+#define CC_VISIBILITY_TABLE_HEADER
+
+//Local
+#include "ccChunk.h"
+#include "qCC_db.h"
+
+//CCCoreLib
+#include <CCConst.h>
+
+//System
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+class QFile;
+
+//! Points visibility table (one bit per point)
+/** Drop-in replacement for the former 'one byte per point' table: the points are either
+	visible (CCCoreLib::POINT_VISIBLE) or not (any other value is read back as
+	CCCoreLib::POINT_HIDDEN).
+	A summary is also maintained for each chunk of points (see ccChunk): all visible,
+	all hidden or mixed. It is lazily updated (in parallel) after a modification.
+	Setting the visibility of distinct points from several threads is safe, but
+	the summaries must only be queried once all the modifications are done.
+**/
+class QCC_DB_LIB_API ccVisibilityTable
+{
+public:
+
+	//! Visibility summary of a chunk of points
+	enum ChunkState { ALL_VISIBLE, ALL_HIDDEN, MIXED };
+
+	//! Writable reference to the visibility of a single point (see operator[])
+	class Reference
+	{
+	public:
+
+		//! Returns the point visibility (CCCoreLib::POINT_VISIBLE or CCCoreLib::POINT_HIDDEN)
+		inline operator unsigned char() const { return m_table.getValue(m_index); }
+		//! Sets the point visibility
+		inline Reference& operator=(unsigned char value) { m_table.setValue(m_index, value); return *this; }
+		//! Copies the visibility of another point
+		inline Reference& operator=(const Reference& other) { return operator=(static_cast<unsigned char>(other)); }
+
+	protected:
+
+		friend class ccVisibilityTable;
+
+		Reference(ccVisibilityTable& table, size_t index) : m_table(table), m_index(index) {}
+
+		ccVisibilityTable& m_table;
+		size_t m_index;
+	};
+
+	//! Default constructor
+	ccVisibilityTable();
+
+	//! Copy constructor
+	ccVisibilityTable(const ccVisibilityTable& table);
+
+	//! Assignment operator
+	ccVisibilityTable& operator=(const ccVisibilityTable& table);
+
+	//! Returns the number of points
+	inline size_t size() const { return m_size; }
+	//! Returns whether the table is empty (i.e. not instantiated)
+	inline bool empty() const { return m_size == 0; }
+
+	//! Resizes the table
+	/** The new points are visible. Throws std::bad_alloc if there's not enough memory.
+	**/
+	void resize(size_t count);
+
+	//! Clears the table (and releases the memory)
+	void clear();
+
+	//! Returns the visibility of a point (CCCoreLib::POINT_VISIBLE or CCCoreLib::POINT_HIDDEN)
+	inline unsigned char getValue(size_t index) const { return isVisible(index) ? CCCoreLib::POINT_VISIBLE : CCCoreLib::POINT_HIDDEN; }
+	//! Sets the visibility of a point (any value other than CCCoreLib::POINT_VISIBLE hides it)
+	inline void setValue(size_t index, unsigned char value) { setVisible(index, value == CCCoreLib::POINT_VISIBLE); }
+
+	//! Returns the visibility of a point (const version)
+	inline unsigned char operator[](size_t index) const { return getValue(index); }
+	//! Returns a writable reference to the visibility of a point
+	inline Reference operator[](size_t index) { return Reference(*this, index); }
+	//! Returns the visibility of a point (const version)
+	inline unsigned char at(size_t index) const { assert(index < m_size); return getValue(index); }
+	//! Returns a writable reference to the visibility of a point
+	inline Reference at(size_t index) { assert(index < m_size); return Reference(*this, index); }
+
+	//! Returns whether a point is visible
+	inline bool isVisible(size_t index) const
+	{
+		assert(index < m_size);
+		return (m_hiddenBits[index >> 6].load(std::memory_order_relaxed) & (uint64_t(1) << (index & 63))) == 0;
+	}
+
+	//! Sets whether a point is visible
+	/** Thread-safe (as long as the summaries are not queried concurrently).
+	**/
+	inline void setVisible(size_t index, bool state)
+	{
+		assert(index < m_size);
+		const uint64_t mask = (uint64_t(1) << (index & 63));
+		if (state)
+			m_hiddenBits[index >> 6].fetch_and(~mask, std::memory_order_relaxed);
+		else
+			m_hiddenBits[index >> 6].fetch_or(mask, std::memory_order_relaxed);
+		invalidateSummaries();
+	}
+
+	//! Sets the visibility of all the points
+	void fill(unsigned char value);
+
+	//! Inverts the visibility of all the points
+	void invert();
+
+	//! Returns the number of visible points
+	size_t visibleCount() const;
+
+	//! Returns the number of chunks (see ccChunk)
+	inline size_t chunkCount() const { return ccChunk::Count(m_size); }
+
+	//! Returns the visibility summary of a chunk
+	ChunkState chunkState(size_t chunkIndex) const;
+
+	//! Returns the number of visible points in a chunk
+	unsigned chunkVisibleCount(size_t chunkIndex) const;
+
+	//! Calls a function on each visible point of a chunk (in increasing order)
+	/** \param chunkIndex chunk index
+		\param func function called with the (global) index of each visible point
+	**/
+	template <class Function> void forEachVisibleInChunk(size_t chunkIndex, Function func) const
+	{
+		const size_t firstIndex = ccChunk::StartPos(chunkIndex);
+		const size_t lastIndex = std::min(firstIndex + ccChunk::SIZE, m_size);
+		for (size_t w = (firstIndex >> 6); (w << 6) < lastIndex; ++w)
+		{
+			uint64_t visibleBits = ~m_hiddenBits[w].load(std::memory_order_relaxed);
+			if ((w << 6) + 64 > lastIndex)
+			{
+				//mask the bits after the end of the table
+				visibleBits &= ((uint64_t(1) << (lastIndex - (w << 6))) - 1);
+			}
+			while (visibleBits)
+			{
+				func((w << 6) + CountTrailingZeros(visibleBits));
+				visibleBits &= (visibleBits - 1);
+			}
+		}
+	}
+
+	//! Saves the table to a file
+	/** Same format as the former 'one byte per point' table.
+	**/
+	bool toFile(QFile& out) const;
+
+	//! Loads the table from a file
+	bool fromFile(QFile& in, short dataVersion);
+
+protected:
+
+	//! Returns the index of the lowest bit set (value must be non zero)
+	static inline unsigned CountTrailingZeros(uint64_t value)
+	{
+		assert(value != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+		unsigned long index = 0;
+		_BitScanForward64(&index, value);
+		return static_cast<unsigned>(index);
+#elif defined(__GNUC__)
+		return static_cast<unsigned>(__builtin_ctzll(value));
+#else
+		unsigned index = 0;
+		while ((value & 1) == 0)
+		{
+			value >>= 1;
+			++index;
+		}
+		return index;
+#endif
+	}
+
+	//! Flags the chunk summaries as outdated
+	inline void invalidateSummaries()
+	{
+		if (m_summariesValid.load(std::memory_order_relaxed))
+			m_summariesValid.store(false, std::memory_order_relaxed);
+	}
+
+	//! Updates the chunk summaries (if necessary)
+	void updateSummaries() const;
+
+	//! Allocates the bits (all visible)
+	void allocate(size_t count);
+
+	//! Number of points
+	size_t m_size;
+	//! Number of 64 bits words
+	size_t m_wordCount;
+	//! 'Hidden' bits (1 = hidden, 0 = visible)
+	std::unique_ptr<std::atomic<uint64_t>[]> m_hiddenBits;
+
+	//! Number of visible points per chunk
+	mutable std::vector<unsigned> m_chunkVisibleCounts;
+	//! Whether the chunk summaries are up to date
+	mutable std::atomic<bool> m_summariesValid;
+};
+
+#endif //CC_VISIBILITY_TABLE_HEADER
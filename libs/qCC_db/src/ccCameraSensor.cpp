@@ -15,6 +15,10 @@
 //#                                                                        #
 //##########################################################################
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 #include <cmath>
 
 #include "ccCameraSensor.h"
@@ -31,6 +35,10 @@
 //Qt
 #include <QDir>
 #include <QTextStream>
+#include <QThread>
+
+//System
+#include <atomic>
 
 ccCameraSensor::IntrinsicParameters::IntrinsicParameters()
 	: vertFocal_pix(1.0f)
@@ -971,6 +979,133 @@ bool ccCameraSensor::computeUncertainty(CCCoreLib::ReferenceCloud* points, std::
 	return true;
 }
 
+QSharedPointer<const ccCameraSensor::UndistortionMap> ccCameraSensor::getUndistortionMap(int width, int height) const
+{
+	if (!m_distortionParams || width <= 0 || height <= 0)
+	{
+		return {};
+	}
+
+	if (	m_distortionParams->getModel() != SIMPLE_RADIAL_DISTORTION
+		&&	m_distortionParams->getModel() != EXTENDED_RADIAL_DISTORTION)
+	{
+		//not handled
+		return {};
+	}
+
+	const RadialDistortionParameters* params = static_cast<RadialDistortionParameters*>(m_distortionParams.data());
+	float k1 = params->k1;
+	float k2 = params->k2;
+	float k3 = 0;
+	if (m_distortionParams->getModel() == EXTENDED_RADIAL_DISTORTION)
+	{
+		k3 = static_cast<ExtendedRadialDistortionParameters*>(m_distortionParams.data())->k3;
+	}
+
+	float xScale = width / static_cast<float>(m_intrinsicParams.arrayWidth);
+	float yScale = height / static_cast<float>(m_intrinsicParams.arrayHeight);
+	float rScale = sqrt(xScale * xScale + yScale * yScale);
+
+	float vertFocal_pix = getVertFocal_pix() * xScale;
+	float horizFocal_pix = getHorizFocal_pix() * yScale;
+	float vf2 = vertFocal_pix * vertFocal_pix;
+	float hf2 = horizFocal_pix * horizFocal_pix;
+	float cx = m_intrinsicParams.principal_point[0] * xScale;
+	float cy = m_intrinsicParams.principal_point[1] * yScale;
+	k1 *= rScale;
+	k2 *= rScale;
+	k3 *= rScale;
+
+	std::vector<float> parameters{ k1, k2, k3, vf2, hf2, cx, cy };
+
+	QMutexLocker locker(&m_undistortionMapMutex);
+
+	//the table is only computed once for a given image size (and set of parameters)
+	if (	m_undistortionMap
+		&&	m_undistortionMap->width == width
+		&&	m_undistortionMap->height == height
+		&&	m_undistortionMap->parameters == parameters)
+	{
+		return m_undistortionMap;
+	}
+
+	QSharedPointer<UndistortionMap> map(new UndistortionMap);
+	try
+	{
+		size_t pixelCount = static_cast<size_t>(width) * height;
+		map->sourceX.resize(pixelCount);
+		map->sourceY.resize(pixelCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return {};
+	}
+	map->width = width;
+	map->height = height;
+	map->parameters = parameters;
+
+	//The distortion model maps each (ideal) pixel p to p' = r(p).p
+	//with r(p) = 1.0 + k1 * ||p||^2 + k2 * ||p||^4 + k3 * ||p||^6
+	//For each output pixel p', we look for the source pixel p by inverting
+	//this relation (fixed-point iterations: p = p' / r(p))
+	static const int MaxIterationCount = 20;
+	static const float Epsilon = 1.0e-3f;
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, height, [&](int j)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int j = 0; j < height; ++j)
+#endif
+	{
+		float* sourceX = map->sourceX.data() + static_cast<size_t>(j) * width;
+		float* sourceY = map->sourceY.data() + static_cast<size_t>(j) * width;
+		float yd = j - cy;
+		for (int i = 0; i < width; ++i)
+		{
+			float xd = i - cx;
+			float x = xd;
+			float y = yd;
+			bool converged = false;
+			for (int it = 0; it < MaxIterationCount; ++it)
+			{
+				float p2 = x * x / hf2 + y * y / vf2; //p = pix/f
+				float rp = 1.0f + p2 * (k1 + p2 * (k2 + p2 * k3));
+				if (rp <= 0)
+				{
+					break;
+				}
+				float nx = xd / rp;
+				float ny = yd / rp;
+				converged = (std::abs(nx - x) < Epsilon && std::abs(ny - y) < Epsilon);
+				x = nx;
+				y = ny;
+				if (converged)
+				{
+					break;
+				}
+			}
+
+			float sx = x + cx;
+			float sy = y + cy;
+			if (!converged || sx < 0 || sy < 0 || sx > width - 1 || sy > height - 1)
+			{
+				sx = sy = -1.0f; //invalid
+			}
+			sourceX[i] = sx;
+			sourceY[i] = sy;
+		}
+	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
+
+	m_undistortionMap = map;
+	return m_undistortionMap;
+}
+
 //see http://opencv.willowgarage.com/documentation/cpp/camera_calibration_and_3d_reconstruction.html
 QImage ccCameraSensor::undistort(const QImage& image) const
 {
@@ -994,25 +1129,22 @@ QImage ccCameraSensor::undistort(const QImage& image) const
 	case EXTENDED_RADIAL_DISTORTION:
 		{
 			const RadialDistortionParameters* params = static_cast<RadialDistortionParameters*>(m_distortionParams.data());
-			float k1 = params->k1;
-			float k2 = params->k2;
-			if (k1 == 0 && k2 == 0)
+			if (params->k1 == 0 && params->k2 == 0)
 			{
 				ccLog::Warning("[ccCameraSensor::undistort] Invalid radial distortion coefficients!");
 				return QImage();
 			}
-			float k3 = 0;
-			if (m_distortionParams->getModel() == EXTENDED_RADIAL_DISTORTION)
-			{
-				k3 = static_cast<ExtendedRadialDistortionParameters*>(m_distortionParams.data())->k3;
-			}
 
 			int width = image.width();
 			int height = image.height();
 
-			float xScale = image.width() / static_cast<float>(m_intrinsicParams.arrayWidth);
-			float yScale = image.height() / static_cast<float>(m_intrinsicParams.arrayHeight);
-			float rScale = sqrt(xScale * xScale + yScale * yScale);
+			//get the remap table
+			QSharedPointer<const UndistortionMap> map = getUndistortionMap(width, height);
+			if (!map)
+			{
+				ccLog::Warning("[ccCameraSensor::undistort] Not enough memory!");
+				return QImage();
+			}
 
 			//try to reserve memory for new image
 			QImage newImage(QSize(width, height), image.format());
@@ -1021,55 +1153,89 @@ QImage ccCameraSensor::undistort(const QImage& image) const
 				ccLog::Warning("[ccCameraSensor::undistort] Not enough memory!");
 				return QImage();
 			}
+			newImage.setColorTable(image.colorTable());
 			newImage.fill(0);
 
-			float vertFocal_pix = getVertFocal_pix() * xScale;
-			float horizFocal_pix = getHorizFocal_pix() * yScale;
-			float vf2 = vertFocal_pix * vertFocal_pix;
-			float hf2 = horizFocal_pix * horizFocal_pix;
-			float cx = m_intrinsicParams.principal_point[0] * xScale;
-			float cy = m_intrinsicParams.principal_point[1] * yScale;
-			k1 *= rScale;
-			k2 *= rScale;
-			k3 *= rScale;
+			//bilinear interpolation is only possible if each byte is a color component
+			bool bilinear = false;
+			switch (image.format())
+			{
+			case QImage::Format_RGB32:
+			case QImage::Format_ARGB32:
+			case QImage::Format_ARGB32_Premultiplied:
+			case QImage::Format_RGB888:
+			case QImage::Format_RGBX8888:
+			case QImage::Format_RGBA8888:
+			case QImage::Format_RGBA8888_Premultiplied:
+			case QImage::Format_Grayscale8:
+			case QImage::Format_Alpha8:
+				bilinear = true;
+				break;
+			default:
+				//nearest neighbor
+				break;
+			}
 
 			assert((image.depth() % 8) == 0);
 			int depth = image.depth() / 8;
-			int bytesPerLine = image.bytesPerLine();
-			const uchar* iImageBits = image.bits();
+			int iBytesPerLine = image.bytesPerLine();
+			int oBytesPerLine = newImage.bytesPerLine();
+			const uchar* iImageBits = image.constBits();
 			uchar* oImageBits = newImage.bits();
 
-			//image undistortion
+			//image undistortion (row by row)
+#ifdef CC_CORE_LIB_USES_TBB
+			tbb::parallel_for(0, height, [&](int j)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+			for (int j = 0; j < height; ++j)
+#endif
 			{
-				for (int i = 0; i < width; ++i)
+				const float* sourceX = map->sourceX.data() + static_cast<size_t>(j) * width;
+				const float* sourceY = map->sourceY.data() + static_cast<size_t>(j) * width;
+				uchar* oPixel = oImageBits + static_cast<size_t>(j) * oBytesPerLine;
+				for (int i = 0; i < width; ++i, oPixel += depth)
 				{
-					float x = i - cx;
-					float x2 = x*x;
-					for (int j = 0; j < height; ++j)
+					if (sourceX[i] < 0)
 					{
-						float y = j - cy;
-						float y2 = y*y;
-
-						float p2 = x2 / hf2 + y2 / vf2; //p = pix/f
-						float rp = 1.0f + p2 * (k1 + p2 * (k2 + p2 * k3)); //r(p) = 1.0 + k1 * ||p||^2 + k2 * ||p||^4 + k3 * ||p||^6
-						float eqx = rp * x + cx;
-						float eqy = rp * y + cy;
-
-						int pixx = static_cast<int>(eqx);
-						int pixy = static_cast<int>(eqy);
-						if (	pixx >= 0
-							&&	pixx < width
-							&&	pixy >= 0
-							&&	pixy < height)
-						{
-							const uchar* iPixel = iImageBits + j * bytesPerLine + i * depth;
-							uchar* oPixel = oImageBits + pixy * bytesPerLine + pixx * depth;
-							memcpy(oPixel, iPixel, depth);
-							//newImage.setPixel(i, j, image.pixel(pixx, pixy));
-						}
+						//no source pixel
+						continue;
+					}
+
+					int x0 = static_cast<int>(sourceX[i]);
+					int y0 = static_cast<int>(sourceY[i]);
+
+					if (!bilinear)
+					{
+						memcpy(oPixel, iImageBits + static_cast<size_t>(y0) * iBytesPerLine + x0 * depth, depth);
+						continue;
+					}
+
+					int x1 = std::min(x0 + 1, width - 1);
+					int y1 = std::min(y0 + 1, height - 1);
+					//fixed-point weights (8 bits)
+					int wx = static_cast<int>((sourceX[i] - x0) * 256);
+					int wy = static_cast<int>((sourceY[i] - y0) * 256);
+
+					const uchar* row0 = iImageBits + static_cast<size_t>(y0) * iBytesPerLine;
+					const uchar* row1 = iImageBits + static_cast<size_t>(y1) * iBytesPerLine;
+					const uchar* p00 = row0 + x0 * depth;
+					const uchar* p01 = row0 + x1 * depth;
+					const uchar* p10 = row1 + x0 * depth;
+					const uchar* p11 = row1 + x1 * depth;
+					for (int c = 0; c < depth; ++c)
+					{
+						int top = p00[c] * (256 - wx) + p01[c] * wx;
+						int bottom = p10[c] * (256 - wx) + p11[c] * wx;
+						oPixel[c] = static_cast<uchar>((top * (256 - wy) + bottom * wy + 32768) >> 16);
 					}
 				}
 			}
+#ifdef CC_CORE_LIB_USES_TBB
+			);
+#endif
 
 			return newImage;
 		}
@@ -2008,14 +2174,32 @@ ccImage* ccCameraSensor::orthoRectifyAsImage(	const ccImage* image,
 	const QRgb blackValue = qRgb(0, 0, 0);
 	const QRgb blackAlphaZero = qRgba(0, 0, 0, 0);
 
-	for (unsigned i = 0; i < w; ++i)
+	//direct access to the source pixels
+	const QImage source = image->data().convertToFormat(QImage::Format_ARGB32);
+	if (source.isNull()) //not enough memory!
+		return nullptr;
+
+	//the output image is processed row by row
+	uchar* orthoBits = orthoImage.bits();
+	int orthoBytesPerLine = orthoImage.bytesPerLine();
+	int rowCount = static_cast<int>(h);
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, rowCount, [&](int row)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int row = 0; row < rowCount; ++row)
+#endif
 	{
-		double xip = minC[0] + static_cast<double>(i)*_pixelSize;
-		for (unsigned j = 0; j < h; ++j)
+		unsigned j = h - 1 - static_cast<unsigned>(row);
+		double yip = minC[1] + static_cast<double>(j)*_pixelSize;
+		QRgb* outRow = reinterpret_cast<QRgb*>(orthoBits + static_cast<size_t>(row) * orthoBytesPerLine);
+		for (unsigned i = 0; i < w; ++i)
 		{
 			QRgb rgb = blackValue; //output pixel is (transparent) black by default
 
-			double yip = minC[1] + static_cast<double>(j)*_pixelSize;
+			double xip = minC[0] + static_cast<double>(i)*_pixelSize;
 			double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
 			double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
 			double yi = p / q;
@@ -2032,14 +2216,17 @@ ccImage* ccCameraSensor::orthoRectifyAsImage(	const ccImage* image,
 
 				if (x >= 0 && x < width)
 				{
-					rgb = image->data().pixel(x, y);
+					rgb = reinterpret_cast<const QRgb*>(source.constScanLine(y))[x];
 				}
 			}
 
 			//pure black pixels are treated as transparent ones!
-			orthoImage.setPixel(i, h - 1 - j, rgb != blackValue ? rgb : blackAlphaZero);
+			outRow[i] = (rgb != blackValue ? rgb : blackAlphaZero);
 		}
 	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
 
 	//output pixel size (auto)
 	pixelSize = _pixelSize;
@@ -2052,7 +2239,8 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 											unsigned maxSize,
 											QDir* outputDir/*=0*/,
 											std::vector<ccImage*>* result/*=0*/,
-											std::vector<std::pair<double,double> >* relativePos/*=0*/)
+											std::vector<std::pair<double,double> >* relativePos/*=0*/,
+											unsigned maxMemory_MB/*=1024*/)
 {
 	size_t count = images.size();
 	if (count == 0)
@@ -2188,79 +2376,143 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 		}
 	}
 
-	//projet each image accordingly
+	//output size of each image
+	std::vector< std::pair<unsigned, unsigned> > orthoSizes(count);
+	size_t maxImageBytes = 1;
 	for (size_t k=0; k<count; ++k)
 	{
-		double* minC = &minCorners[2*k];
-		double* maxC = &maxCorners[2*k];
-		double dx = maxC[0]-minC[0];
-		double dy = maxC[1]-minC[1];
-
-		ccImage* image = images[k];
-		unsigned width = images[k]->getW();
-		unsigned height = images[k]->getH();
+		double dx = maxCorners[2*k] - minCorners[2*k];
+		double dy = maxCorners[2*k+1] - minCorners[2*k+1];
 		unsigned w = static_cast<unsigned>(ceil(dx / pixelSize));
 		unsigned h = static_cast<unsigned>(ceil(dy / pixelSize));
+		orthoSizes[k] = { w, h };
+
+		//output image + (converted) input image
+		size_t imageBytes = 4 * (static_cast<size_t>(w) * h + static_cast<size_t>(images[k]->getW()) * images[k]->getH());
+		maxImageBytes = std::max(maxImageBytes, imageBytes);
+	}
+
+	//the images are processed concurrently (as long as they fit in the memory budget)
+	size_t maxConcurrentImages = (static_cast<size_t>(maxMemory_MB) << 20) / maxImageBytes;
+	maxConcurrentImages = std::max<size_t>(1, std::min<size_t>(maxConcurrentImages, std::max(1, QThread::idealThreadCount())));
+
+	std::vector<QImage> orthoImages(count);
+	std::vector<QString> exportFilenames(count);
+	std::atomic<bool> notEnoughMemory(false);
 
-		QImage orthoImage(w,h,QImage::Format_ARGB32);
-		if (orthoImage.isNull()) //not enough memory!
+	//projet each image accordingly
+	for (size_t batchStart = 0; batchStart < count && !notEnoughMemory; batchStart += maxConcurrentImages)
+	{
+		int batchSize = static_cast<int>(std::min(maxConcurrentImages, count - batchStart));
+
+#ifdef CC_CORE_LIB_USES_TBB
+		tbb::parallel_for(0, batchSize, [&](int batchIndex)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+#endif
 		{
-			//clear mem.
-			if (result)
+			size_t k = batchStart + static_cast<size_t>(batchIndex);
+			const double* minC = &minCorners[2*k];
+
+			const ccImage* image = images[k];
+			int width = static_cast<int>(image->getW());
+			int height = static_cast<int>(image->getH());
+			unsigned w = orthoSizes[k].first;
+			unsigned h = orthoSizes[k].second;
+
+			QImage orthoImage(w,h,QImage::Format_ARGB32);
+			//direct access to the source pixels
+			const QImage source = image->data().convertToFormat(QImage::Format_ARGB32);
+			if (orthoImage.isNull() || source.isNull()) //not enough memory!
 			{
-				while (!result->empty())
-				{
-					delete result->back();
-					result->pop_back();
-				}
+				notEnoughMemory = true;
 			}
-			ccLog::Warning("[OrthoRectifyAsImages] Not enough memory!");
-			return false;
-		}
+			else
+			{
+				//ortho rectification parameters
+				const double& a0 = a[k*3  ];
+				const double& a1 = a[k*3+1];
+				const double& a2 = a[k*3+2];
+				const double& b0 = b[k*3  ];
+				const double& b1 = b[k*3+1];
+				const double& b2 = b[k*3+2];
+				//const double& c0 = c[k*3];
+				const double& c1 = c[k*3+1];
+				const double& c2 = c[k*3+2];
+
+				//row by row
+				for (unsigned row = 0; row < h; ++row)
+				{
+					unsigned j = h - 1 - row;
+					double yip = minC[1] + static_cast<double>(j)*pixelSize;
+					QRgb* outRow = reinterpret_cast<QRgb*>(orthoImage.scanLine(row));
+					for (unsigned i = 0; i < w; ++i)
+					{
+						double xip = minC[0] + static_cast<double>(i)*pixelSize;
+						double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
+						double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
+						double yi = p / q;
 
-		//ortho rectification parameters
-		const double& a0 = a[k*3  ];
-		const double& a1 = a[k*3+1];
-		const double& a2 = a[k*3+2];
-		const double& b0 = b[k*3  ];
-		const double& b1 = b[k*3+1];
-		const double& b2 = b[k*3+2];
-		//const double& c0 = c[k*3];
-		const double& c1 = c[k*3+1];
-		const double& c2 = c[k*3+2];
+						q = (c1*xip - a1)*(c2*yip - b2) - (c1*yip - b1)*(c2*xip - a2);
+						p = (a0 - xip)*(c2*yip - b2) - (b0 - yip)*(c2*xip - a2);
+						double  xi = p / q;
 
-		for (unsigned i=0; i<w; ++i)
-		{
-			double xip = minC[0] + static_cast<double>(i)*pixelSize;
-			for (unsigned j = 0; j < h; ++j)
-			{
-				double yip = minC[1] + static_cast<double>(j)*pixelSize;
-				double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
-				double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
-				double yi = p / q;
+						xi += 0.5 * width;
+						yi += 0.5 * height;
 
-				q = (c1*xip - a1)*(c2*yip - b2) - (c1*yip - b1)*(c2*xip - a2);
-				p = (a0 - xip)*(c2*yip - b2) - (b0 - yip)*(c2*xip - a2);
-				double  xi = p / q;
+						int x = static_cast<int>(xi);
+						int y = static_cast<int>(yi);
+						if (x >= 0 && x < width && y >= 0 && y < height)
+						{
+							QRgb rgb = reinterpret_cast<const QRgb*>(source.constScanLine(y))[x];
+							//pure black pixels are treated as transparent ones!
+							if (qRed(rgb) + qGreen(rgb) + qBlue(rgb) > 0)
+								outRow[i] = rgb;
+							else
+								outRow[i] = qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), 0);
+						}
+						else
+						{
+							outRow[i] = qRgba(255, 0, 255, 0);
+						}
+					}
+				}
 
-				xi += 0.5 * width;
-				yi += 0.5 * height;
+				if (outputDir)
+				{
+					//export image
+					exportFilenames[k] = QString("ortho_rectified_%1.png").arg(image->getName());
+					orthoImage.save(outputDir->absoluteFilePath(exportFilenames[k]));
+				}
 
-				int x = static_cast<int>(xi);
-				int y = static_cast<int>(yi);
-				if (x >= 0 && x < static_cast<int>(width) && y >= 0 && y < static_cast<int>(height))
+				if (result)
 				{
-					QRgb rgb = image->data().pixel(x, y);
-					//pure black pixels are treated as transparent ones!
-					if (qRed(rgb) + qGreen(rgb) + qBlue(rgb) > 0)
-						orthoImage.setPixel(i, h - 1 - j, rgb);
-					else
-						orthoImage.setPixel(i, h - 1 - j, qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), 0));
+					//we'll need it later
+					orthoImages[k] = orthoImage;
 				}
-				else
-					orthoImage.setPixel(i, h - 1 - j, qRgba(255, 0, 255, 0));
 			}
 		}
+#ifdef CC_CORE_LIB_USES_TBB
+		);
+#endif
+	}
+
+	if (notEnoughMemory)
+	{
+		ccLog::Warning("[OrthoRectifyAsImages] Not enough memory!");
+		return false;
+	}
+
+	//eventually output the results (in the input order)
+	for (size_t k=0; k<count; ++k)
+	{
+		double* minC = &minCorners[2*k];
+		double* maxC = &maxCorners[2*k];
+		unsigned w = orthoSizes[k].first;
+		unsigned h = orthoSizes[k].second;
 
 		//eventually compute relative pos
 		if (relativePos)
@@ -2272,10 +2524,6 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 
 		if (outputDir)
 		{
-			//export image
-			QString exportFilename = QString("ortho_rectified_%1.png").arg(image->getName());
-			orthoImage.save(outputDir->absoluteFilePath(exportFilename));
-
 			//export meta-data
 			QFile f(outputDir->absoluteFilePath("ortho_rectification_log.txt"));
 			if (f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) //always append
@@ -2285,7 +2533,7 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 				QTextStream stream(&f);
 				stream.setRealNumberNotation(QTextStream::FixedNotation);
 				stream.setRealNumberPrecision(6);
-				stream << "Image" << ' ' << exportFilename << ' ';
+				stream << "Image" << ' ' << exportFilenames[k] << ' ';
 				stream << "Local3DBBox" << ' ' << minC[0] << ' ' << minC[1] << ' ' << maxC[0] << ' ' << maxC[1] << ' ';
 				stream << "Local2DBBox" << ' ' << xShiftGlobal << ' ' << yShiftGlobal << ' ' << xShiftGlobal + static_cast<double>(w - 1) << ' ' << yShiftGlobal + static_cast<double>(h - 1) << endl;
 				f.close();
@@ -2293,7 +2541,10 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 		}
 
 		if (result)
-			result->push_back(new ccImage(orthoImage, image->getName()));
+		{
+			result->push_back(new ccImage(orthoImages[k], images[k]->getName()));
+			orthoImages[k] = QImage(); //release the shared data
+		}
 	}
 
 	return true;
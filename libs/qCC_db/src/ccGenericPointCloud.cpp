@@ -75,7 +75,7 @@ bool ccGenericPointCloud::resetVisibilityArray()
 		return false;
 	}
 
-	std::fill(m_pointsVisibility.begin(), m_pointsVisibility.end(), CCCoreLib::POINT_VISIBLE); //by default, all points are visible
+	m_pointsVisibility.fill(CCCoreLib::POINT_VISIBLE); //by default, all points are visible
 
 	return true;
 }
@@ -88,15 +88,12 @@ void ccGenericPointCloud::invertVisibilityArray()
 		return;
 	}
 
-	for (unsigned char& vis : m_pointsVisibility)
-	{
-		vis = (vis == CCCoreLib::POINT_HIDDEN ? CCCoreLib::POINT_VISIBLE : CCCoreLib::POINT_HIDDEN);
-	}
+	m_pointsVisibility.invert();
 }
 
 void ccGenericPointCloud::unallocateVisibilityArray()
 {
-	m_pointsVisibility.resize(0);
+	m_pointsVisibility.clear();
 }
 
 bool ccGenericPointCloud::isVisibilityTableInstantiated() const
@@ -203,7 +200,7 @@ bool ccGenericPointCloud::toFile_MeOnly(QFile& out) const
 		return WriteError();
 	if (hasVisibilityArray)
 	{
-		if (!ccSerializationHelper::GenericArrayToFile<unsigned char, 1, unsigned char>(m_pointsVisibility, out))
+		if (!m_pointsVisibility.toFile(out))
 			return false;
 	}
 
@@ -243,7 +240,7 @@ bool ccGenericPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flag
 		return ReadError();
 	if (hasVisibilityArray)
 	{
-		if (!ccSerializationHelper::GenericArrayFromFile<unsigned char, 1, unsigned char>(m_pointsVisibility, in, dataVersion))
+		if (!m_pointsVisibility.fromFile(in, dataVersion))
 		{
 			unallocateVisibilityArray();
 			return false;
@@ -469,17 +466,8 @@ CCCoreLib::ReferenceCloud* ccGenericPointCloud::getTheVisiblePoints(const Visibi
 		return nullptr;
 	}
 
-	//count the number of points to copy
-	unsigned pointCount = 0;
-	{
-		for (unsigned i = 0; i < count; ++i)
-		{
-			if (visTable->at(i) == CCCoreLib::POINT_VISIBLE)
-			{
-				++pointCount;
-			}
-		}
-	}
+	//count the number of points to copy (the per-chunk counts are computed in parallel)
+	unsigned pointCount = static_cast<unsigned>(visTable->visibleCount());
 
 	//we create an entity with the 'visible' vertices only
 	CCCoreLib::ReferenceCloud* rc = new CCCoreLib::ReferenceCloud(const_cast<ccGenericPointCloud*>(this));
@@ -488,11 +476,23 @@ CCCoreLib::ReferenceCloud* ccGenericPointCloud::getTheVisiblePoints(const Visibi
 	{
 		if (rc->reserve(pointCount))
 		{
-			for (unsigned i = 0; i < count; ++i)
+			//can't fail (see above)
+			size_t chunkCount = visTable->chunkCount();
+			for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
 			{
-				if (visTable->at(i) == CCCoreLib::POINT_VISIBLE)
+				switch (visTable->chunkState(chunkIndex))
 				{
-					rc->addPointIndex(i); //can't fail (see above)
+				case VisibilityTableType::ALL_HIDDEN:
+					break;
+				case VisibilityTableType::ALL_VISIBLE:
+				{
+					unsigned firstIndex = static_cast<unsigned>(ccChunk::StartPos(chunkIndex));
+					rc->addPointIndex(firstIndex, firstIndex + static_cast<unsigned>(ccChunk::Size(chunkIndex, count)));
+				}
+				break;
+				case VisibilityTableType::MIXED:
+					visTable->forEachVisibleInChunk(chunkIndex, [rc](size_t i) { rc->addPointIndex(static_cast<unsigned>(i)); });
+					break;
 				}
 			}
 		}
@@ -46,12 +46,46 @@
 //Qt
 #include <QIcon>
 
+//System
+#include <atomic>
+
+//! Version of the GL transformations (incremented each time a GL transformation or the hierarchy is modified)
+static std::atomic<unsigned> s_glTransVersion(1);
+
+//! Invalidates all the cached absolute GL transformations
+static void InvalidateAbsoluteGLTransformations()
+{
+	//0 is reserved for 'invalid'
+	if (++s_glTransVersion == 0)
+	{
+		++s_glTransVersion;
+	}
+}
+
+//! Version of the entities hierarchy (incremented each time a children list is modified)
+static std::atomic<unsigned> s_hierarchyVersion(1);
+
+//! Signals that (at least) one children list has been modified
+static void InvalidateHierarchy()
+{
+	++s_hierarchyVersion;
+}
+
+unsigned ccHObject::GetHierarchyVersion()
+{
+	return s_hierarchyVersion;
+}
+
 ccHObject::ccHObject(const QString& name, unsigned uniqueID/*=ccUniqueIDGenerator::InvalidUniqueID*/)
 	: ccObject(name, uniqueID)
 	, ccDrawableObject()
 	, m_parent(nullptr)
 	, m_selectionBehavior(SELECTION_AA_BBOX)
 	, m_isDeleting(false)
+	, m_invalidatingBBCache(false)
+	, m_absoluteGLTransEnabled(false)
+	, m_absoluteGLTransVersion(0)
+	, m_childIndexHint(-1)
 {
 	setVisible(false);
 	lockVisibility(true);
@@ -65,6 +99,10 @@ ccHObject::ccHObject(const ccHObject& object)
 	, m_parent(nullptr)
 	, m_selectionBehavior(object.m_selectionBehavior)
 	, m_isDeleting(false)
+	, m_invalidatingBBCache(false)
+	, m_absoluteGLTransEnabled(false)
+	, m_absoluteGLTransVersion(0)
+	, m_childIndexHint(-1)
 {
 	m_glTransHistory.toIdentity();
 }
@@ -108,6 +146,9 @@ void ccHObject::notifyGeometryUpdate()
 		m_currentDisplay->deprecate3DLayer();
 	}
 
+	//the cached bounding-boxes as well
+	invalidateBBCache();
+
 	//process dependencies
 	for (std::map<ccHObject*, int>::const_iterator it = m_dependencies.begin(); it != m_dependencies.end(); ++it)
 	{
@@ -316,6 +357,8 @@ void ccHObject::onDeletionOf(const ccHObject* obj)
 	{
 		//we can't swap children as we want to keep the order!
 		m_children.erase(m_children.begin() + pos);
+		InvalidateHierarchy();
+		invalidateBBCache();
 	}
 }
 
@@ -345,6 +388,7 @@ bool ccHObject::addChild(ccHObject* child, int dependencyFlags/*=DP_PARENT_OF_OT
 			m_children.push_back(child);
 		else
 			m_children.insert(m_children.begin() + insertIndex, child);
+		InvalidateHierarchy();
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -352,6 +396,8 @@ bool ccHObject::addChild(ccHObject* child, int dependencyFlags/*=DP_PARENT_OF_OT
 		return false;
 	}
 
+	invalidateBBCache();
+
 	//we want to be notified whenever this child is deleted!
 	child->addDependency(this, DP_NOTIFY_OTHER_ON_DELETE); //DGM: potentially redundant with calls to 'addDependency' but we can't miss that ;)
 
@@ -438,9 +484,23 @@ unsigned ccHObject::filterChildren(	Container& filteredChildren,
 
 int ccHObject::getChildIndex(const ccHObject* child) const
 {
+	if (!child)
+		return -1;
+
+	//fast path: the child is still at the same position
+	//(avoids a linear search when called repeatedly, e.g. by the DB tree)
+	int hint = child->m_childIndexHint;
+	if (hint >= 0 && static_cast<size_t>(hint) < m_children.size() && m_children[hint] == child)
+		return hint;
+
 	for (size_t i=0; i<m_children.size(); ++i)
+	{
 		if (m_children[i] == child)
+		{
+			child->m_childIndexHint = static_cast<int>(i);
 			return static_cast<int>(i);
+		}
+	}
 
 	return -1;
 }
@@ -481,6 +541,8 @@ void ccHObject::transferChildren(ccHObject& newParent, bool forceFatherDependent
 		assert(child->getParent() == &newParent || child->getParent() == nullptr);
 	}
 	m_children.clear();
+	InvalidateHierarchy();
+	invalidateBBCache();
 }
 
 void ccHObject::swapChildren(unsigned firstChildIndex, unsigned secondChildIndex)
@@ -489,6 +551,7 @@ void ccHObject::swapChildren(unsigned firstChildIndex, unsigned secondChildIndex
 	assert(secondChildIndex < m_children.size());
 
 	std::swap(m_children[firstChildIndex],m_children[secondChildIndex]);
+	InvalidateHierarchy();
 }
 
 int ccHObject::getIndex() const
@@ -511,22 +574,34 @@ bool ccHObject::isAncestorOf(const ccHObject *anObject) const
 
 bool ccHObject::getAbsoluteGLTransformation(ccGLMatrix& trans) const
 {
-	trans.toIdentity();
-	bool hasGLTrans = false;
-	
-	//recurse among ancestors to get the absolute GL transformation
-	const ccHObject* obj = this;
-	while (obj)
+	unsigned currentVersion = s_glTransVersion;
+	if (m_absoluteGLTransVersion != currentVersion)
 	{
-		if (obj->isGLTransEnabled())
+		//the parent's absolute transformation is (potentially) cached as well
+		ccGLMatrix parentTrans;
+		bool parentHasGLTrans = (m_parent ? m_parent->getAbsoluteGLTransformation(parentTrans) : false);
+
+		if (isGLTransEnabled())
+		{
+			//same composition order as the historical (non-cached) version
+			m_absoluteGLTrans = (parentHasGLTrans ? getGLTransformation() * parentTrans : getGLTransformation());
+			m_absoluteGLTransEnabled = true;
+		}
+		else
+		{
+			m_absoluteGLTrans = parentTrans;
+			m_absoluteGLTransEnabled = parentHasGLTrans;
+		}
+
+		if (!m_absoluteGLTransEnabled)
 		{
-			trans = trans * obj->getGLTransformation();
-			hasGLTrans = true;
+			m_absoluteGLTrans.toIdentity();
 		}
-		obj = obj->getParent();
+		m_absoluteGLTransVersion = currentVersion;
 	}
 
-	return hasGLTrans;
+	trans = m_absoluteGLTrans;
+	return m_absoluteGLTransEnabled;
 }
 
 ccBBox ccHObject::getOwnBB(bool withGLFeatures/*=false*/)
@@ -536,16 +611,32 @@ ccBBox ccHObject::getOwnBB(bool withGLFeatures/*=false*/)
 
 ccBBox ccHObject::getBB_recursive(bool withGLFeatures/*=false*/, bool onlyEnabledChildren/*=true*/)
 {
+	const int i = (withGLFeatures ? 1 : 0);
+	const int j = (onlyEnabledChildren ? 1 : 0);
+	if (m_bbCache.recursiveBBIsValid[i][j])
+	{
+		return m_bbCache.recursiveBB[i][j];
+	}
+
 	ccBBox box = getOwnBB(withGLFeatures);
+	//the result can only be cached if the whole sub-tree could be cached
+	bool cacheable = isBBCacheable();
 
 	for (auto child : m_children)
 	{
 		if (!onlyEnabledChildren || child->isEnabled())
 		{
 			box += child->getBB_recursive(withGLFeatures,onlyEnabledChildren);
+			cacheable &= child->m_bbCache.recursiveBBIsValid[i][j];
 		}
 	}
 
+	if (cacheable)
+	{
+		m_bbCache.recursiveBB[i][j] = box;
+		m_bbCache.recursiveBBIsValid[i][j] = true;
+	}
+
 	return box;
 }
 
@@ -553,19 +644,36 @@ ccBBox ccHObject::getDisplayBB_recursive(bool relative, const ccGenericGLDisplay
 {
 	ccBBox box;
 
-	if (!display || display == m_currentDisplay)
-		box = getOwnBB(true);
-
-	for (auto child : m_children)
+	if (m_bbCache.displayBBIsValid && m_bbCache.displayBBDisplay == display)
+	{
+		box = m_bbCache.displayBB;
+	}
+	else
 	{
-		if (child->isEnabled())
+		if (!display || display == m_currentDisplay)
+			box = getOwnBB(true);
+		//the result can only be cached if the whole sub-tree could be cached
+		bool cacheable = isBBCacheable();
+
+		for (auto child : m_children)
 		{
-			ccBBox childBox = child->getDisplayBB_recursive(true, display);
-			if (child->isGLTransEnabled())
+			if (child->isEnabled())
 			{
-				childBox = childBox * child->getGLTransformation();
+				ccBBox childBox = child->getDisplayBB_recursive(true, display);
+				if (child->isGLTransEnabled())
+				{
+					childBox = childBox * child->getGLTransformation();
+				}
+				box += childBox;
+				cacheable &= (child->m_bbCache.displayBBIsValid && child->m_bbCache.displayBBDisplay == display);
 			}
-			box += childBox;
+		}
+
+		if (cacheable)
+		{
+			m_bbCache.displayBB = box;
+			m_bbCache.displayBBDisplay = display;
+			m_bbCache.displayBBIsValid = true;
 		}
 	}
 
@@ -580,6 +688,76 @@ ccBBox ccHObject::getDisplayBB_recursive(bool relative, const ccGenericGLDisplay
 	return box;
 }
 
+void ccHObject::invalidateBBCache()
+{
+	if (m_invalidatingBBCache)
+	{
+		//dependency loop
+		return;
+	}
+	m_invalidatingBBCache = true;
+
+	//the recursive bounding-boxes of the ancestors depend on this entity
+	for (ccHObject* obj = this; obj && !obj->m_isDeleting; obj = obj->m_parent)
+	{
+		obj->m_bbCache.invalidate();
+	}
+
+	//as well as the ones of the entities that depend on its geometry (e.g. a mesh and its vertices)
+	for (std::map<ccHObject*, int>::const_iterator it = m_dependencies.begin(); it != m_dependencies.end(); ++it)
+	{
+		if ((it->second & DP_NOTIFY_OTHER_ON_UPDATE) == DP_NOTIFY_OTHER_ON_UPDATE && !it->first->m_isDeleting)
+		{
+			it->first->invalidateBBCache();
+		}
+	}
+
+	m_invalidatingBBCache = false;
+}
+
+void ccHObject::setParent(ccHObject* anObject)
+{
+	if (m_parent != anObject)
+	{
+		m_parent = anObject;
+		InvalidateAbsoluteGLTransformations();
+	}
+}
+
+void ccHObject::setDisplay(ccGenericGLDisplay* win)
+{
+	if (win != m_currentDisplay)
+	{
+		invalidateBBCache();
+	}
+
+	ccDrawableObject::setDisplay(win);
+}
+
+void ccHObject::enableGLTransformation(bool state)
+{
+	ccDrawableObject::enableGLTransformation(state);
+
+	//the GL transformation itself may have changed
+	InvalidateAbsoluteGLTransformations();
+	if (m_parent && !m_isDeleting)
+	{
+		m_parent->invalidateBBCache();
+	}
+}
+
+void ccHObject::setEnabled(bool state)
+{
+	if (state != isEnabled())
+	{
+		ccObject::setEnabled(state);
+		if (m_parent && !m_isDeleting)
+		{
+			m_parent->invalidateBBCache();
+		}
+	}
+}
+
 bool ccHObject::isDisplayed() const
 {
 	return (getDisplay() != nullptr) && isVisible() && isBranchEnabled();
@@ -782,6 +960,9 @@ void ccHObject::draw(CC_DRAW_CONTEXT& context)
 void ccHObject::applyGLTransformation(const ccGLMatrix& trans)
 {
 	m_glTransHistory = trans * m_glTransHistory;
+
+	//the geometry (and therefore the bounding-boxes) is modified
+	invalidateBBCache();
 }
 
 void ccHObject::applyGLTransformation_recursive(const ccGLMatrix* transInput/*=nullptr*/)
@@ -855,6 +1036,8 @@ void ccHObject::detachChild(ccHObject* child)
 	{
 		//we can't swap children as we want to keep the order!
 		m_children.erase(m_children.begin()+pos);
+		InvalidateHierarchy();
+		invalidateBBCache();
 	}
 }
 
@@ -872,6 +1055,8 @@ void ccHObject::detatchAllChildren()
 		}
 	}
 	m_children.clear();
+	InvalidateHierarchy();
+	invalidateBBCache();
 }
 
 void ccHObject::removeChild(ccHObject* child)
@@ -897,6 +1082,8 @@ void ccHObject::removeChild(int pos)
 	//(DGM: do this BEFORE deleting the object (otherwise
 	//the dependency mechanism can 'backfire' ;)
 	m_children.erase(m_children.begin() + pos);
+	InvalidateHierarchy();
+	invalidateBBCache();
 
 	//backup dependency flags
 	int flags = getDependencyFlagsWith(child);
@@ -921,6 +1108,15 @@ void ccHObject::removeChild(int pos)
 
 void ccHObject::removeAllChildren()
 {
+	if (!m_children.empty())
+	{
+		InvalidateHierarchy();
+		if (!m_isDeleting)
+		{
+			invalidateBBCache();
+		}
+	}
+
 	while (!m_children.empty())
 	{
 		ccHObject* child = m_children.back();
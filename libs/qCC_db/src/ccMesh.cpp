@@ -129,6 +129,7 @@ void ccMesh::setAssociatedCloud(ccGenericPointCloud* cloud)
 		m_associatedCloud->addDependency(this,DP_NOTIFY_OTHER_ON_DELETE | DP_NOTIFY_OTHER_ON_UPDATE);
 
 	m_bBox.setValidity(false);
+	invalidateBBCache();
 }
 
 void ccMesh::onUpdateOf(ccHObject* obj)
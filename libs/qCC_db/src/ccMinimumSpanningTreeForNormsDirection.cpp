@@ -15,6 +15,10 @@
 //#                                                                        #
 //##########################################################################
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 #include "ccMinimumSpanningTreeForNormsDirection.h"
 
 //CCCoreLib
@@ -22,374 +26,416 @@
 
 //local
 #include "ccLog.h"
+#include "ccNormalVectors.h"
 #include "ccOctree.h"
 #include "ccPointCloud.h"
 #include "ccProgressDialog.h"
-#include "ccScalarField.h"
 
 //system
-#include <map>
-#include <queue>
-#include <set>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
 #include <vector>
 
 namespace 
 {
-	//! Weighted graph edge
-	class Edge
-	{
-	public:
-		
-		//! Unique edge key type
-		using Key = std::pair<unsigned, unsigned>;
-		
-		//! Returns the unique key of an edge (no vertex order)
-		inline static Key ConstructKey(unsigned v1, unsigned v2)
-		{
-			return v1 > v2 ? std::make_pair(v2, v1) : std::make_pair(v1, v2);
-		}
-		
-		//! Default constructor
-		Edge(unsigned v1, unsigned v2, float weight)
-			: m_key(ConstructKey(v1, v2))
-			, m_weight(weight)
-		{
-			assert(m_weight >= 0);
-		}
-		
-		//! Strict weak ordering operator (required by std::priority_queue)
-		inline bool operator < (const Edge& other) const
-		{
-			return m_weight > other.m_weight;
-		}
-		
-		//! Returns first vertex (index)
-		const unsigned& v1() const { return m_key.first; }
-		//! Returns second vertex (index)
-		const unsigned& v2() const { return m_key.second; }
-		
-	protected:
-		
-		//! Unique key
-		Key m_key;
-		
-		//! Associated weight
-		float m_weight;
-	};
-	
-	//! Generic graph structure
-	class Graph
+	//! Compact k-nearest neighbors graph
+	/** As each vertex has at most k neighbors, the adjacency is stored as fixed-size
+		rows in a single array (unused slots are set to InvalidIndex). The graph is
+		not necessarily symmetric: an edge (v1,v2) may only appear in the row of v1.
+	**/
+	class KNNGraph
 	{
 	public:
-		
+
+		//! Invalid (unused) neighbor index
+		static constexpr unsigned InvalidIndex = std::numeric_limits<unsigned>::max();
+
 		//! Default constructor
-		Graph() = default;
-		
-		//! Set of indexes
-		using IndexSet = std::set<unsigned int>;
-		
-		//! Reserves memory for graph
-		/** Must be called before using the structure!
-		Clears the structure as well.
-	**/
-		bool reserve(unsigned vertexCount)
+		KNNGraph() = default;
+
+		//! Initializes the structure
+		bool init(unsigned vertexCount, unsigned k)
 		{
-			m_edges.clear();
-			
+			m_vertexCount = 0;
+			m_k = 0;
+
 			try
 			{
-				m_vertexNeighbors.resize(vertexCount, IndexSet());
+				m_neighbors.resize(static_cast<size_t>(vertexCount) * k, InvalidIndex);
 			}
 			catch (const std::bad_alloc&)
 			{
 				//not enough memory
 				return false;
 			}
-			
+
+			m_vertexCount = vertexCount;
+			m_k = k;
 			return true;
 		}
-		
+
 		//! Returns the number of vertices
-		unsigned vertexCount() const { return static_cast<unsigned>(m_vertexNeighbors.size()); } //the m_vertexNeighbors vector size shouldn't be bigger than a 32 bits integer (see 'reserve')
-		
-		//! Returns the number of edges
-		size_t edgeCount() const { return m_edges.size(); }
-		
-		//! Returns the weight associated to an edge (if it exists - returns -1 otherwise)
-		float weight(unsigned v1, unsigned v2) const
+		inline unsigned vertexCount() const { return m_vertexCount; }
+
+		//! Returns the (max) number of neighbors per vertex
+		inline unsigned k() const { return m_k; }
+
+		//! Returns the neighbors of a given vertex
+		inline unsigned* row(unsigned index) { return m_neighbors.data() + static_cast<size_t>(index) * m_k; }
+		//! Returns the neighbors of a given vertex (const version)
+		inline const unsigned* row(unsigned index) const { return m_neighbors.data() + static_cast<size_t>(index) * m_k; }
+
+	protected:
+
+		//! Neighbors (k per vertex)
+		std::vector<unsigned> m_neighbors;
+
+		//! Number of vertices
+		unsigned m_vertexCount = 0;
+
+		//! Max number of neighbors per vertex
+		unsigned m_k = 0;
+	};
+
+	//! Runs a function for each index in [0 ; count[ (in parallel if possible)
+	template <class Function> void ParallelFor(unsigned count, const Function& func)
+	{
+#ifdef CC_CORE_LIB_USES_TBB
+		tbb::parallel_for(0u, count, func);
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < static_cast<int>(count); ++i)
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			// try to find the corresponding edge (otherwise return -1)
-			std::map<Edge::Key, float>::const_iterator it = m_edges.find(Edge::ConstructKey(v1, v2));
-			
-			return (it == m_edges.end() ? -1 : it->second);
+			func(static_cast<unsigned>(i));
 		}
-		
-		//! Adds or updates the edge (v1,v2)
-		void addEdge(unsigned v1, unsigned v2, float weight = 0.0f)
+#endif
+	}
+
+	//! Atomically replaces a value by a smaller one
+	template <typename T> inline void AtomicMin(std::atomic<T>& a, T value)
+	{
+		T current = a.load(std::memory_order_relaxed);
+		while (value < current && !a.compare_exchange_weak(current, value, std::memory_order_relaxed))
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			m_edges.insert(std::make_pair(Edge::ConstructKey(v1, v2), weight));
-			m_vertexNeighbors[v1].insert(v2);
-			m_vertexNeighbors[v2].insert(v1);
 		}
-		
-		//! Returns the set of edges connected to a given vertex
-		inline const IndexSet& getVertexNeighbors(unsigned index) const
+	}
+
+	//! Returns the weight of an edge (based on the normals of its vertices)
+	inline float EdgeWeight(const CCVector3& N1, const CCVector3& N2)
+	{
+		//dot product
+		return std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
+
+		//distance
+		//return sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
+
+		//mutual dot product
+		//CCVector3 uAB = *P2 - *P1;
+		//uAB.normalize();
+		//return (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
+	}
+
+	//! Returns the bits of a (positive) weight
+	/** For positive floats, the order of the bits (as integers) is the same as the order of the values.
+	**/
+	inline uint32_t WeightBits(float weight)
+	{
+		assert(weight >= 0);
+		uint32_t bits;
+		memcpy(&bits, &weight, sizeof(float));
+		return bits;
+	}
+
+	//! Finds the root of a vertex in a union-find forest (with path halving)
+	inline unsigned FindRoot(std::vector<unsigned>& links, unsigned index)
+	{
+		while (links[index] != index)
 		{
-			return m_vertexNeighbors[index];
+			links[index] = links[links[index]];
+			index = links[index];
 		}
-		
-	protected:
-		
-		//! Graph edges
-		std::map<Edge::Key, float> m_edges;
-		
-		//! Set of neighbors for each vertex
-		std::vector<IndexSet> m_vertexNeighbors;
-	};
+		return index;
+	}
+
+	//! Finds the root of a vertex in a union-find forest (read-only version, safe to call concurrently)
+	inline unsigned FindRootConst(const std::vector<unsigned>& links, unsigned index)
+	{
+		while (links[index] != index)
+		{
+			index = links[index];
+		}
+		return index;
+	}
 }
 
-static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
-#ifdef WITH_GRAPH
-									const Graph& graph,
-#else
-									ccOctree::Shared& octree,
-									unsigned char level,
-									unsigned kNN,
-#endif
+//! Computes the Minimum Spanning Forest of the kNN graph (Borůvka's algorithm)
+/** At each round, the lightest edge leaving each component is determined in parallel
+	(ties are broken with the edge index so as to never create cycles) and then the
+	components are merged.
+	\param cloud point cloud (with normals)
+	\param graph kNN graph
+	\param mstEdges output edges
+	\param components output component (patch) index of each vertex (= smallest vertex index in the component)
+	\param progressCb progress notification (optional)
+	\return success
+**/
+static bool ComputeMSTWithBoruvka(	const ccPointCloud* cloud,
+									const KNNGraph& graph,
+									std::vector< std::pair<unsigned, unsigned> >& mstEdges,
+									std::vector<unsigned>& components,
 									ccProgressDialog* progressCb = nullptr)
 {
-	assert(cloud && cloud->hasNormals());
+	const unsigned vertexCount = graph.vertexCount();
+	const unsigned k = graph.k();
 
-//#define COLOR_PATCHES
-#ifdef COLOR_PATCHES
-	//Test: color patches
-	cloud->setColor(ccColor::white);
-	cloud->showColors(true);
-
-	//Test: arrival time
-	int sfIdx = cloud->getScalarFieldIndexByName("MST arrival time");
-	if (sfIdx < 0)
-		sfIdx = cloud->addScalarField("MST arrival time");
-	ccScalarField* sf = static_cast<ccScalarField*>(cloud->getScalarField(sfIdx));
-	sf->fill(NAN_VALUE);
-	cloud->setCurrentDisplayedScalarField(sfIdx);
-#endif
+	std::vector<unsigned> links;
+	std::vector< std::atomic<uint32_t> > minWeights;
+	std::vector< std::atomic<uint64_t> > bestEdges;
+	try
+	{
+		mstEdges.clear();
+		mstEdges.reserve(vertexCount != 0 ? vertexCount - 1 : 0);
+		components.resize(vertexCount);
+		links.resize(vertexCount);
+		minWeights = std::vector< std::atomic<uint32_t> >(vertexCount);
+		bestEdges = std::vector< std::atomic<uint64_t> >(vertexCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
 
-	//reset
-	std::priority_queue<Edge> priorityQueue;
-	std::vector<bool> visited;
-	unsigned visitedCount = 0;
-#ifdef WITH_GRAPH
-	unsigned vertexCount = graph.vertexCount();
-#else
-	unsigned vertexCount = cloud->size();
-#endif
+	const uint32_t noWeight = std::numeric_limits<uint32_t>::max();
+	const uint64_t noEdge = std::numeric_limits<uint64_t>::max();
 
-	//instantiate the 'visited' table
-	try
+	ParallelFor(vertexCount, [&](unsigned i)
 	{
-		visited.resize(vertexCount, false);
+		components[i] = i;
+	});
 
-		//progress notification
-		CCCoreLib::NormalizedProgress nProgress(progressCb, vertexCount);
-		if (progressCb)
-		{
-			progressCb->update(0);
-			progressCb->setMethodTitle(QObject::tr("Orient normals (MST)"));
-#ifdef WITH_GRAPH
-			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1\nEdges: %2").arg(vertexCount).arg(graph.edgeCount()));
-#else
-			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1").arg(vertexCount));
-#endif
-			progressCb->start();
-		}
+	if (progressCb)
+	{
+		progressCb->update(0);
+		progressCb->setMethodTitle(QObject::tr("Orient normals (MST)"));
+		progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1").arg(vertexCount));
+		progressCb->start();
+	}
 
-#ifndef WITH_GRAPH
-		CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-		nNSS.level = level;
-		nNSS.minNumberOfNeighbors = kNN + 1; //+1 because we'll get the query point itself!
-#endif
+	unsigned componentCount = vertexCount;
+	while (true)
+	{
+		//reset the per-component structures
+		ParallelFor(vertexCount, [&](unsigned i)
+		{
+			minWeights[i].store(noWeight, std::memory_order_relaxed);
+			bestEdges[i].store(noEdge, std::memory_order_relaxed);
+		});
 
-		//while unvisited vertices remain...
-		unsigned firstUnvisitedIndex = 0;
-		size_t patchCount = 0;
-		size_t inversionCount = 0;
-		while (visitedCount < vertexCount)
+		//look for the lightest weight leaving each component
+		//(as the graph is not symmetric, each edge updates both of its components)
+		ParallelFor(vertexCount, [&](unsigned v1)
 		{
-			//find the first not-yet-visited vertex
-			while (visited[firstUnvisitedIndex])
+			const unsigned* neighbors = graph.row(v1);
+			const unsigned c1 = components[v1];
+			for (unsigned j = 0; j < k && neighbors[j] != KNNGraph::InvalidIndex; ++j)
 			{
-				++firstUnvisitedIndex;
+				unsigned v2 = neighbors[j];
+				unsigned c2 = components[v2];
+				if (c1 != c2)
+				{
+					uint32_t weight = WeightBits(EdgeWeight(cloud->getPointNormal(v1), cloud->getPointNormal(v2)));
+					AtomicMin(minWeights[c1], weight);
+					AtomicMin(minWeights[c2], weight);
+				}
 			}
+		});
 
-			//set it as "visited"
+		//then the corresponding edge (with the smallest index in case of ties)
+		ParallelFor(vertexCount, [&](unsigned v1)
+		{
+			const unsigned* neighbors = graph.row(v1);
+			const unsigned c1 = components[v1];
+			for (unsigned j = 0; j < k && neighbors[j] != KNNGraph::InvalidIndex; ++j)
 			{
-				visited[firstUnvisitedIndex] = true;
-				++visitedCount;
-				//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-				const Graph::IndexSet& neighbors = graph.getVertexNeighbors(firstUnvisitedIndex);
-				for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+				unsigned v2 = neighbors[j];
+				unsigned c2 = components[v2];
+				if (c1 != c2)
 				{
-					priorityQueue.push(Edge(firstUnvisitedIndex, *it, graph.weight(firstUnvisitedIndex, *it)));
+					uint32_t weight = WeightBits(EdgeWeight(cloud->getPointNormal(v1), cloud->getPointNormal(v2)));
+					uint64_t edgeIndex = static_cast<uint64_t>(v1) * k + j;
+					if (weight == minWeights[c1].load(std::memory_order_relaxed))
+						AtomicMin(bestEdges[c1], edgeIndex);
+					if (weight == minWeights[c2].load(std::memory_order_relaxed))
+						AtomicMin(bestEdges[c2], edgeIndex);
 				}
-#else
-				const CCVector3* P = cloud->getPoint(firstUnvisitedIndex);
-				nNSS.queryPoint = *P;
-				octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-				octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-				nNSS.pointsInNeighbourhood.clear();
-				nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-				//look for neighbors in a sphere
-				unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-				neighborCount = std::min(neighborCount, kNN + 1);
-
-				//current point index
-				const CCVector3& N1 = cloud->getPointNormal(firstUnvisitedIndex);
-				for (unsigned j = 0; j < neighborCount; ++j)
-				{
-					//current neighbor index
-					unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-					if (	firstUnvisitedIndex != neighborIndex
-						&&	!visited[neighborIndex])
-					{
-						const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-						//dot product
-						float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
+			}
+		});
 
-						//distance
-						//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
+		//merge the components (the root of a component is always its smallest vertex index)
+		links = components;
+		size_t previousEdgeCount = mstEdges.size();
+		for (unsigned c = 0; c < vertexCount; ++c)
+		{
+			uint64_t edgeIndex = bestEdges[c].load(std::memory_order_relaxed);
+			if (components[c] != c || edgeIndex == noEdge)
+			{
+				continue;
+			}
 
-						//mutual dot product
-						//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-						//CCVector3 uAB = *P2 - *P1;
-						//uAB.normalize();
-						//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
+			unsigned v1 = static_cast<unsigned>(edgeIndex / k);
+			unsigned v2 = graph.row(v1)[edgeIndex % k];
+			unsigned r1 = FindRoot(links, v1);
+			unsigned r2 = FindRoot(links, v2);
+			if (r1 == r2)
+			{
+				//the same edge may have been selected by both components
+				continue;
+			}
 
-						priorityQueue.emplace( firstUnvisitedIndex, neighborIndex, weight );
-					}
-				}
-#endif
+			if (r1 < r2)
+				links[r2] = r1;
+			else
+				links[r1] = r2;
+			mstEdges.emplace_back(v1, v2);
+		}
 
-				if (progressCb && !nProgress.oneStep())
-				{
-					break;
-				}
+		if (mstEdges.size() == previousEdgeCount)
+		{
+			//no more edges between components
+			break;
+		}
+		componentCount -= static_cast<unsigned>(mstEdges.size() - previousEdgeCount);
+
+		//update the component index of each vertex
+		ParallelFor(vertexCount, [&](unsigned i)
+		{
+			components[i] = FindRootConst(links, components[i]);
+		});
+
+		if (progressCb)
+		{
+			progressCb->update(100.0f * (vertexCount - componentCount) / vertexCount);
+			if (progressCb->isCancelRequested())
+			{
+				return false;
 			}
+		}
+	}
 
-	#ifdef COLOR_PATCHES
-			ccColor::Rgb patchCol = ccColor::Generator::Random();
-			cloud->setPointColor(static_cast<unsigned>(firstUnvisitedIndex), patchCol.rgb);
-			sf->setValue(static_cast<unsigned>(firstUnvisitedIndex),static_cast<ScalarType>(visitedCount));
-	#endif
+	return true;
+}
 
-			while (!priorityQueue.empty() && (visitedCount < vertexCount))
+//! Propagates the normals orientation along the Minimum Spanning Forest (parallel breadth-first traversal)
+static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
+									const KNNGraph& graph,
+									ccProgressDialog* progressCb = nullptr)
+{
+	assert(cloud && cloud->hasNormals());
+
+	const unsigned vertexCount = graph.vertexCount();
+
+	//compute the Minimum Spanning Forest
+	std::vector< std::pair<unsigned, unsigned> > mstEdges;
+	std::vector<unsigned> components;
+	if (!ComputeMSTWithBoruvka(cloud, graph, mstEdges, components, progressCb))
+	{
+		return false;
+	}
+
+	try
+	{
+		//convert the forest edges to a (CSR) adjacency structure
+		std::vector<unsigned> offsets(static_cast<size_t>(vertexCount) + 1, 0);
+		for (const std::pair<unsigned, unsigned>& edge : mstEdges)
+		{
+			++offsets[edge.first + 1];
+			++offsets[edge.second + 1];
+		}
+		for (unsigned i = 0; i < vertexCount; ++i)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+		std::vector<unsigned> adjacency(offsets.back());
+		{
+			std::vector<unsigned> fillIndexes(offsets.begin(), offsets.end() - 1);
+			for (const std::pair<unsigned, unsigned>& edge : mstEdges)
 			{
-				//process next edge (with the lowest 'weight')
-				Edge element = priorityQueue.top();
-				priorityQueue.pop();
-
-				//shall the normal be inverted?
-				const CCVector3& N1 = cloud->getPointNormal(static_cast<unsigned>(element.v1()));
-				const CCVector3& N2 = cloud->getPointNormal(static_cast<unsigned>(element.v2()));
-				bool inverNormal = (N1.dot(N2) < 0);
-				unsigned v = 0;
-				//we should change the vertex that has not been visited yet
-				if (!visited[element.v1()])
-				{
-					v = element.v1();
-					if (inverNormal)
-					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N1);
-						++inversionCount;
-					}
-				}
-				else if (!visited[element.v2()])
-				{
-					v = element.v2();
-					if (inverNormal)
-					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N2);
-						++inversionCount;
-					}
-				}
-				else
-				{
-					continue;
-				}
+				adjacency[fillIndexes[edge.first]++] = edge.second;
+				adjacency[fillIndexes[edge.second]++] = edge.first;
+			}
+		}
+		mstEdges.clear();
+		mstEdges.shrink_to_fit();
 
-				//set it as "visited"
+		//one traversal starts from the root of each tree (= patch)
+		std::vector<unsigned> frontier;
+		for (unsigned i = 0; i < vertexCount; ++i)
+		{
+			if (components[i] == i)
+			{
+				frontier.push_back(i);
+			}
+		}
+		size_t patchCount = frontier.size();
+
+		//we reuse the 'components' array to store the parent of each vertex
+		std::vector<unsigned>& parents = components;
+		std::vector<uint8_t> inverted(vertexCount, 0);
+		std::vector<unsigned> nextFrontier;
+		std::vector<unsigned> nextOffsets;
+		
+		while (!frontier.empty())
+		{
+			//count the children of each frontier vertex
+			nextOffsets.resize(frontier.size() + 1);
+			nextOffsets[0] = 0;
+			for (size_t i = 0; i < frontier.size(); ++i)
+			{
+				unsigned v = frontier[i];
+				unsigned degree = offsets[v + 1] - offsets[v];
+				nextOffsets[i + 1] = nextOffsets[i] + (parents[v] == v ? degree : degree - 1);
+			}
+			nextFrontier.resize(nextOffsets.back());
+
+			//orient the children relatively to their (already oriented) parent
+			ParallelFor(static_cast<unsigned>(frontier.size()), [&](unsigned i)
+			{
+				unsigned v = frontier[i];
+				const CCVector3& N1 = cloud->getPointNormal(v);
+				unsigned childIndex = nextOffsets[i];
+				for (unsigned j = offsets[v]; j < offsets[v + 1]; ++j)
 				{
-					visited[v] = true;
-					++visitedCount;
-					//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-					const Graph::IndexSet& neighbors = graph.getVertexNeighbors(v);
-					for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-						priorityQueue.push(Edge(v, *it, graph.weight(v,*it)));
-#else
-					const CCVector3* P = cloud->getPoint(v);
-					nNSS.queryPoint = *P;
-					octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-					octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-					nNSS.pointsInNeighbourhood.clear();
-					nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-					//look for neighbors in a sphere
-					unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-					neighborCount = std::min(neighborCount, kNN + 1);
-					//current point index
-					const CCVector3& N1 = cloud->getPointNormal(v);
-					for (unsigned j = 0; j < neighborCount; ++j)
+					unsigned u = adjacency[j];
+					if (u == parents[v])
 					{
-						//current neighbor index
-						unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-						if (	v != neighborIndex
-							&&	!visited[neighborIndex])
-						{
-							const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-							//dot product
-							float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
-
-							//distance
-							//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-							//mutual dot product
-							//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-							//CCVector3 uAB = *P2 - *P1;
-							//uAB.normalize();
-							//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-							priorityQueue.emplace( v, neighborIndex, weight );
-						}
+						continue;
 					}
-#endif
+					parents[u] = v;
+					const CCVector3& N2 = cloud->getPointNormal(u);
+					inverted[u] = inverted[v] ^ (N1.dot(N2) < 0 ? 1 : 0);
+					nextFrontier[childIndex++] = u;
 				}
+			});
 
-	#ifdef COLOR_PATCHES
-				cloud->setPointColor(static_cast<unsigned>(v), patchCol);
-				sf->setValue(static_cast<unsigned>(v),static_cast<ScalarType>(visitedCount));
-	#endif
-				if (progressCb && !nProgress.oneStep())
-				{
-					visitedCount = static_cast<unsigned>(vertexCount); //early stop
-					break;
-				}
-			}
-
-			//new patch
-			++patchCount;
+			std::swap(frontier, nextFrontier);
 		}
 
-	#ifdef COLOR_PATCHES
-		sf->computeMinAndMax();
-		cloud->showSF(true);
-	#endif
+		//eventually apply the inversions
+		size_t inversionCount = 0;
+		for (unsigned i = 0; i < vertexCount; ++i)
+		{
+			if (inverted[i])
+			{
+				cloud->setPointNormal(i, -cloud->getPointNormal(i));
+				++inversionCount;
+			}
+		}
 
 		if (progressCb)
 		{
@@ -407,89 +453,39 @@ static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
 	return true;
 }
 
-#ifdef WITH_GRAPH
 static bool ComputeMSTGraphAtLevel(	const CCCoreLib::DgmOctree::octreeCell& cell,
 									void** additionalParameters,
 									CCCoreLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//parameters
-	Graph* graph = static_cast<Graph*>(additionalParameters[0]);
-	ccPointCloud* cloud = static_cast<ccPointCloud*>(additionalParameters[1]);
-
-	//structure for the nearest neighbor search
-	unsigned kNN = *static_cast<unsigned*>(additionalParameters[2]);
-
-	CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-	nNSS.level				  = cell.level;
-	nNSS.minNumberOfNeighbors = kNN + 1; //+1 because we'll get the query point itself!
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//we already know some of the neighbours: the points in the current cell!
-	{
-		try
-		{
-			nNSS.pointsInNeighbourhood.resize(n);
-		}
-		catch (.../*const std::bad_alloc&*/) //out of memory
-		{
-			return false;
-		}
+	KNNGraph* graph = static_cast<KNNGraph*>(additionalParameters[0]);
 
-		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-		for (unsigned i = 0; i < n; ++i, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
-		}
-	}
-	nNSS.alreadyVisitedNeighbourhoodSize = 1;
+	unsigned kNN = graph->k();
 
-	//for each point in the cell
-	for (unsigned i = 0; i < n; ++i)
+	//the neighbours of all the points of the cell are searched at once
+	return ccOctree::FindNearestNeighborsForCellPoints(cell, kNN + 1 /*+1 because we'll get the query point itself!*/, [&](ccOctree::QueryContext& context, unsigned i, unsigned neighborCount)
 	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
-		//look for neighbors in a sphere
-		unsigned neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS, false);
 		neighborCount = std::min(neighborCount, kNN + 1);
 
 		//current point index
 		unsigned index = cell.points->getPointGlobalIndex(i);
-		const CCVector3& N1 = cloud->getPointNormal(index);
-		//const CCVector3* P1 = cloud->getPoint(static_cast<unsigned>(index));
-		for (unsigned j = 0; j < neighborCount; ++j)
+
+		//each point only writes its own row (i.e. this is compatible with parallel strategies)
+		unsigned* neighbors = graph->row(index);
+		unsigned slot = 0;
+		for (unsigned j = 0; j < neighborCount && slot < kNN; ++j)
 		{
 			//current neighbor index
-			unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
+			unsigned neighborIndex = context.nNSS.pointsInNeighbourhood[j].pointIndex;
 			if (index != neighborIndex)
 			{
-				const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-				//dot product
-				float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
-
-				//distance
-				//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-				//mutual dot product
-				//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-				//CCVector3 uAB = *P2 - *P1;
-				//uAB.normalize();
-				//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-				graph->addEdge(index, neighborIndex, weight);
+				neighbors[slot++] = neighborIndex;
 			}
 		}
-
-		if (nProgress && !nProgress->oneStep())
-			return false;
-	}
-
-	return true;
+		return true;
+	},
+	nProgress);
 }
-#endif
 
 bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 															unsigned kNN/*=6*/,
@@ -516,29 +512,31 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 
 	unsigned char level = octree->findBestLevelForAGivenPopulationPerCell(kNN);
 
+	//make sure the normals decoding table is instantiated before the parallel processes
+	ccNormalVectors::GetUniqueInstance();
+
 	bool result = true;
 	try
 	{
-#ifdef WITH_GRAPH
-		Graph graph;
-		if (!graph.reserve(cloud->size()))
+		KNNGraph graph;
+		if (!graph.init(cloud->size(), kNN))
 		{
 			//not enough memory!
-			result = false;
+			ccLog::Warning(QString("Not enough memory to compute the kNN graph of cloud '%1'").arg(cloud->getName()));
+			return false;
 		}
 
 		//parameters
-		void* additionalParameters[3] = {	reinterpret_cast<void*>(&graph),
-											reinterpret_cast<void*>(cloud),
-											reinterpret_cast<void*>(&kNN)
-										};
-
-		if (octree->executeFunctionForAllCellsAtLevel(	level,
-														&ComputeMSTGraphAtLevel,
-														additionalParameters,
-														false, //not compatible with parallel strategies!
-														progressDlg,
-														"Build Spanning Tree") == 0)
+		void* additionalParameters[1] = { reinterpret_cast<void*>(&graph) };
+
+		unsigned processedCells = octree->executeFunctionForAllCellsAtLevel(level,
+																			&ComputeMSTGraphAtLevel,
+																			additionalParameters,
+																			true,
+																			progressDlg,
+																			"Build kNN graph");
+		ccOctree::ReleaseQueryContexts();
+		if (processedCells == 0)
 		{
 			//something went wrong
 			ccLog::Warning(QString("Failed to compute Spanning Tree on cloud '%1'").arg(cloud->getName()));
@@ -549,18 +547,10 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 			if (!ResolveNormalsWithMST(cloud, graph, progressDlg))
 			{
 				//something went wrong
-				ccLog::Warning(QString("Failed to compute Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
+				ccLog::Warning(QString("Failed to resolve normals orientation with Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
 				result = false;
 			}
 		}
-#else
-		if (!ResolveNormalsWithMST(cloud, octree, level, kNN, progressDlg))
-		{
-			//something went wrong
-			ccLog::Warning(QString("Failed to resolve normals orientation with Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
-			result = false;
-		}
-#endif
 	}
 	catch (...)
 	{
@@ -15,11 +15,16 @@
 //#                                                                        #
 //##########################################################################
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 #include "ccNormalVectors.h"
 
 //Local
 #include "ccSingleton.h"
 #include "ccNormalCompressor.h"
+#include "ccOctree.h"
 
 //CCCoreLib
 #include <CCGeom.h>
@@ -117,11 +122,126 @@ bool ccNormalVectors::init()
 		return false;
 	}
 
-	for (unsigned i = 0; i < numberOfVectors; ++i)
+	//each entry is independent
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0u, numberOfVectors, [&](unsigned i)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(numberOfVectors); ++i)
+#endif
 	{
 		ccNormalCompressor::Decompress(i, m_theNormalVectors[i].u);
 		m_theNormalVectors[i].normalize();
 	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
+
+	return true;
+}
+
+void ccNormalVectors::DecodeNormals(const CompressedNormType* codes, size_t count, PointCoordinateType* normals, size_t step/*=1*/)
+{
+	assert(codes && normals && step != 0);
+
+	const CCVector3* table = GetUniqueInstance()->m_theNormalVectors.data();
+	for (size_t i = 0; i < count; ++i, codes += step)
+	{
+		const CCVector3& N = table[*codes];
+		*normals++ = N.x;
+		*normals++ = N.y;
+		*normals++ = N.z;
+	}
+}
+
+void ccNormalVectors::EncodeOctahedral(const PointCoordinateType* normals, size_t count, OctahedralNormType* codes)
+{
+	assert(normals && codes);
+
+	for (size_t i = 0; i < count; ++i, normals += 3)
+	{
+		codes[i] = EncodeOctahedral(CCVector3::fromArray(normals));
+	}
+}
+
+void ccNormalVectors::DecodeOctahedral(const OctahedralNormType* codes, size_t count, PointCoordinateType* normals, size_t step/*=1*/)
+{
+	assert(codes && normals && step != 0);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		//same as the single version, but without branches
+		const OctahedralNormType code = codes[i * step];
+		PointCoordinateType x = static_cast<PointCoordinateType>(static_cast<int>(code & 0xFFFF) - 32768) / 32767;
+		PointCoordinateType y = static_cast<PointCoordinateType>(static_cast<int>(code >> 16) - 32768) / 32767;
+		PointCoordinateType z = 1 - std::abs(x) - std::abs(y);
+		PointCoordinateType t = std::max<PointCoordinateType>(-z, 0);
+		x -= std::copysign(t, x);
+		y -= std::copysign(t, y);
+		PointCoordinateType invNorm = 1 / std::sqrt(x * x + y * y + z * z);
+		normals[3 * i    ] = x * invNorm;
+		normals[3 * i + 1] = y * invNorm;
+		normals[3 * i + 2] = z * invNorm;
+	}
+}
+
+bool ccNormalVectors::ConvertToOctahedral(const NormsIndexesTableType& codes, std::vector<OctahedralNormType>& octCodes)
+{
+	try
+	{
+		octCodes.resize(codes.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccNormalVectors::ConvertToOctahedral] Not enough memory!");
+		return false;
+	}
+
+	const ccNormalVectors* instance = GetUniqueInstance();
+	int count = static_cast<int>(codes.size());
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, count, [&](int i)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < count; ++i)
+#endif
+	{
+		octCodes[i] = EncodeOctahedral(instance->getNormal(codes[i]));
+	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
+
+	return true;
+}
+
+bool ccNormalVectors::ConvertFromOctahedral(const std::vector<OctahedralNormType>& octCodes, NormsIndexesTableType& codes)
+{
+	if (!codes.resizeSafe(octCodes.size()))
+	{
+		ccLog::Warning("[ccNormalVectors::ConvertFromOctahedral] Not enough memory!");
+		return false;
+	}
+
+	int count = static_cast<int>(octCodes.size());
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, count, [&](int i)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < count; ++i)
+#endif
+	{
+		codes[i] = GetNormIndex(DecodeOctahedral(octCodes[i]));
+	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
 
 	return true;
 }
@@ -502,6 +622,8 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 		break;
 	}
 
+	ccOctree::ReleaseQueryContexts();
+
 	//error or canceled by user?
 	if (processedCells == 0 || (progressCb && progressCb->isCancelRequested()))
 	{
@@ -665,51 +787,28 @@ bool ccNormalVectors::ComputeNormsAtLevelWithQuadric(	const CCCoreLib::DgmOctree
 	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
 	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
-	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.prepare(radius, cell.parentOctree->getCellSize(nNSS.level));
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	//we already know which points are lying in the current cell
-	unsigned pointCount = cell.points->size();
-	nNSS.pointsInNeighbourhood.resize(pointCount);
-	CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-	for (unsigned j = 0; j < pointCount; ++j, ++it)
-	{
-		it->point = cell.points->getPointPersistentPtr(j);
-		it->pointIndex = cell.points->getPointGlobalIndex(j);
-	}
-	nNSS.alreadyVisitedNeighbourhoodSize = 1;
-
-	for (unsigned i = 0; i < pointCount; ++i)
+	return ccOctree::FindNeighborsInASphereForCellPoints(cell, radius, [&](ccOctree::QueryContext& context, unsigned i, unsigned k)
 	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
 		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (k)!
-		unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, radius, false);
 		float cur_radius = radius;
 		while (k < NUMBER_OF_POINTS_FOR_NORM_WITH_QUADRIC && cur_radius < 16*radius)
 		{
 			cur_radius *= 1.189207115f;
-			k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, cur_radius, false);
+			k = context.findNeighborsInASphere(cur_radius);
 		}
 		if (k >= NUMBER_OF_POINTS_FOR_NORM_WITH_QUADRIC)
 		{
-			CCCoreLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+			CCCoreLib::DgmOctreeReferenceCloud neighbours(&context.nNSS.pointsInNeighbourhood, k);
 
 			CCVector3 N;
-			if (ComputeNormalWithQuadric(&neighbours, nNSS.queryPoint, N))
+			if (ComputeNormalWithQuadric(&neighbours, context.nNSS.queryPoint, N))
 			{
 				theNorms->setValue(cell.points->getPointGlobalIndex(i), N);
 			}
 		}
-
-		if (nProgress && !nProgress->oneStep())
-			return false;
-	}
-
-	return true;
+		return true;
+	},
+	nProgress);
 }
 
 bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCCoreLib::DgmOctree::octreeCell& cell,
@@ -720,40 +819,18 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCCoreLib::DgmOctree::octr
 	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
 	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
-	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.prepare(radius, cell.parentOctree->getCellSize(nNSS.level));
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	//we already know which points are lying in the current cell
-	unsigned pointCount = cell.points->size();
-	nNSS.pointsInNeighbourhood.resize(pointCount);
-	{
-		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-		for (unsigned j = 0; j < pointCount; ++j, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(j);
-			it->pointIndex = cell.points->getPointGlobalIndex(j);
-		}
-	}
-	nNSS.alreadyVisitedNeighbourhoodSize = 1;
-
-	for (unsigned i = 0; i < pointCount; ++i)
+	return ccOctree::FindNeighborsInASphereForCellPoints(cell, radius, [&](ccOctree::QueryContext& context, unsigned i, unsigned k)
 	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
 		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (k)!
-		unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, radius, false);
 		float cur_radius = radius;
 		while (k < NUMBER_OF_POINTS_FOR_NORM_WITH_LS && cur_radius < 16*radius)
 		{
 			cur_radius *= 1.189207115f;
-			k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, cur_radius, false);
+			k = context.findNeighborsInASphere(cur_radius);
 		}
 		if (k >= NUMBER_OF_POINTS_FOR_NORM_WITH_LS)
 		{
-			CCCoreLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+			CCCoreLib::DgmOctreeReferenceCloud neighbours(&context.nNSS.pointsInNeighbourhood, k);
 
 			CCVector3 N;
 			if (ComputeNormalWithLS(&neighbours, N))
@@ -761,14 +838,9 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCCoreLib::DgmOctree::octr
 				theNorms->setValue(cell.points->getPointGlobalIndex(i), N);
 			}
 		}
-
-		if (nProgress && !nProgress->oneStep())
-		{
-			return false;
-		}
-	}
-
-	return true;
+		return true;
+	},
+	nProgress);
 }
 
 bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCCoreLib::DgmOctree::octreeCell& cell,
@@ -778,35 +850,13 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCCoreLib::DgmOctree::oc
 	//additional parameters
 	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
 
-	CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.minNumberOfNeighbors = NUMBER_OF_POINTS_FOR_NORM_WITH_TRI;
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	//we already know which points are lying in the current cell
-	unsigned pointCount = cell.points->size();
-	nNSS.pointsInNeighbourhood.resize(pointCount);
-	CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+	return ccOctree::FindNearestNeighborsForCellPoints(cell, NUMBER_OF_POINTS_FOR_NORM_WITH_TRI, [&](ccOctree::QueryContext& context, unsigned i, unsigned k)
 	{
-		for (unsigned j = 0; j < pointCount; ++j, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(j);
-			it->pointIndex = cell.points->getPointGlobalIndex(j);
-		}
-	}
-	nNSS.alreadyVisitedNeighbourhoodSize = 1;
-
-	for (unsigned i = 0; i < pointCount; ++i)
-	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
-		unsigned k = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
 		if (k > NUMBER_OF_POINTS_FOR_NORM_WITH_TRI)
 		{
 			if (k > NUMBER_OF_POINTS_FOR_NORM_WITH_TRI * 3)
 				k = NUMBER_OF_POINTS_FOR_NORM_WITH_TRI * 3;
-			CCCoreLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+			CCCoreLib::DgmOctreeReferenceCloud neighbours(&context.nNSS.pointsInNeighbourhood, k);
 
 			CCVector3 N;
 			if (ComputeNormalWithTri(&neighbours, N))
@@ -814,12 +864,9 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCCoreLib::DgmOctree::oc
 				theNorms->setValue(cell.points->getPointGlobalIndex(i), N);
 			}
 		}
-
-		if (nProgress && !nProgress->oneStep())
-			return false;
-	}
-
-	return true;
+		return true;
+	},
+	nProgress);
 }
 
 QString ccNormalVectors::ConvertStrikeAndDipToString(double& strike_deg, double& dip_deg)
@@ -32,6 +32,10 @@
 #include <RayAndBox.h>
 #include <ScalarFieldTools.h>
 
+//System
+#include <algorithm>
+#include <mutex>
+
 #ifdef QT_DEBUG
 //#define DEBUG_PICKING_MECHANISM
 #endif
@@ -477,6 +481,189 @@ CCVector3 ccOctree::ComputeAverageNorm(CCCoreLib::ReferenceCloud* subset, ccGene
 	return N;
 }
 
+//! Registry of the living thread query contexts
+struct QueryContextRegistry
+{
+	std::mutex mutex;
+	std::vector<ccOctree::QueryContext*> contexts;
+};
+
+static QueryContextRegistry& GetQueryContextRegistry()
+{
+	//never destroyed, as some worker threads may exit after the static objects destruction
+	static QueryContextRegistry* s_registry = new QueryContextRegistry;
+	return *s_registry;
+}
+
+//! Thread query context (automatically registered for the whole thread lifetime)
+struct RegisteredQueryContext
+{
+	RegisteredQueryContext()
+	{
+		QueryContextRegistry& registry = GetQueryContextRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.contexts.push_back(&context);
+	}
+
+	~RegisteredQueryContext()
+	{
+		QueryContextRegistry& registry = GetQueryContextRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.contexts.erase(std::remove(registry.contexts.begin(), registry.contexts.end(), &context), registry.contexts.end());
+	}
+
+	ccOctree::QueryContext context;
+};
+
+ccOctree::QueryContext& ccOctree::GetThreadQueryContext()
+{
+	static thread_local RegisteredQueryContext s_registeredContext;
+	return s_registeredContext.context;
+}
+
+void ccOctree::ReleaseQueryContexts()
+{
+	QueryContextRegistry& registry = GetQueryContextRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (QueryContext* context : registry.contexts)
+	{
+		//swapping with an empty structure actually releases the memory (contrarily to 'clear')
+		CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct emptyStruct;
+		std::swap(context->nNSS, emptyStruct);
+		context->octree = nullptr;
+	}
+}
+
+//! Above this size, the neighbourhood buffer of a query context is released between two cells
+static const size_t c_maxRetainedNeighbourhoodSize = (1 << 16);
+
+ccOctree::QueryContext& ccOctree::PrepareCellQuery(	const CCCoreLib::DgmOctree::octreeCell& cell,
+													const CCCoreLib::DgmOctree* searchOctree/*=nullptr*/,
+													PointCoordinateType radius/*=0*/,
+													unsigned minNumberOfNeighbors/*=0*/)
+{
+	assert(cell.parentOctree && cell.points);
+
+	QueryContext& context = GetThreadQueryContext();
+	context.octree = (searchOctree ? searchOctree : cell.parentOctree);
+
+	//reset the search structure, but keep the neighbourhood buffer (to avoid re-allocating it for each cell)
+	{
+		CCCoreLib::DgmOctree::NeighboursSet buffer;
+		std::swap(buffer, context.nNSS.pointsInNeighbourhood);
+		context.nNSS = CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct();
+		buffer.clear();
+		if (buffer.capacity() > c_maxRetainedNeighbourhoodSize)
+		{
+			buffer.shrink_to_fit();
+		}
+		std::swap(buffer, context.nNSS.pointsInNeighbourhood);
+	}
+
+	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct& nNSS = context.nNSS;
+	nNSS.level = cell.level;
+	if (minNumberOfNeighbors != 0)
+	{
+		nNSS.minNumberOfNeighbors = minNumberOfNeighbors;
+	}
+	if (radius > 0)
+	{
+		nNSS.prepare(radius, cell.parentOctree->getCellSize(cell.level));
+	}
+	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+	//we already know some of the neighbours: the points in the current cell!
+	if (context.octree == cell.parentOctree)
+	{
+		unsigned pointCount = cell.points->size();
+		nNSS.pointsInNeighbourhood.resize(pointCount); //may throw std::bad_alloc
+		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned i = 0; i < pointCount; ++i, ++it)
+		{
+			it->point = cell.points->getPointPersistentPtr(i);
+			it->pointIndex = cell.points->getPointGlobalIndex(i);
+		}
+		nNSS.alreadyVisitedNeighbourhoodSize = 1;
+	}
+
+	return context;
+}
+
+bool ccOctree::FindNeighborsInASphereForCellPoints(	const CCCoreLib::DgmOctree::octreeCell& cell,
+													PointCoordinateType radius,
+													const CellPointFunction& func,
+													CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/,
+													const CCCoreLib::DgmOctree* searchOctree/*=nullptr*/)
+{
+	QueryContext* context = nullptr;
+	try
+	{
+		context = &PrepareCellQuery(cell, searchOctree, radius);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	unsigned pointCount = cell.points->size();
+	for (unsigned i = 0; i < pointCount; ++i)
+	{
+		cell.points->getPoint(i, context->nNSS.queryPoint);
+
+		unsigned neighborCount = context->findNeighborsInASphere(radius);
+		if (!func(*context, i, neighborCount))
+		{
+			return false;
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ccOctree::FindNearestNeighborsForCellPoints(	const CCCoreLib::DgmOctree::octreeCell& cell,
+													unsigned k,
+													const CellPointFunction& func,
+													CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/,
+													const CCCoreLib::DgmOctree* searchOctree/*=nullptr*/)
+{
+	QueryContext* context = nullptr;
+	try
+	{
+		context = &PrepareCellQuery(cell, searchOctree, 0, k);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	unsigned pointCount = cell.points->size();
+	for (unsigned i = 0; i < pointCount; ++i)
+	{
+		cell.points->getPoint(i, context->nNSS.queryPoint);
+
+		unsigned neighborCount = context->findNearestNeighbors();
+		if (!func(*context, i, neighborCount))
+		{
+			return false;
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool ccOctree::intersectWithFrustum(ccCameraSensor* sensor, std::vector<unsigned>& inCameraFrustum)
 {
 	if (!sensor)
@@ -52,15 +52,22 @@
 #include <QElapsedTimer>
 
 //system
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <queue>
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 static const char s_deviationSFName[] = "Deviation";
 
 ccPointCloud::ccPointCloud(QString name/*=QString()*/, unsigned uniqueID/*=ccUniqueIDGenerator::InvalidUniqueID*/) throw()
 	: BaseClass(name, uniqueID)
 	, m_rgbaColors(nullptr)
 	, m_normals(nullptr)
+	, m_octahedralNormalsValid(false)
 	, m_sfColorScaleDisplayed(false)
 	, m_currentDisplayedScalarField(nullptr)
 	, m_currentDisplayedScalarFieldIndex(-1)
@@ -176,17 +183,133 @@ void UpdateGridIndexes(const std::vector<int>& newIndexMap, std::vector<ccPointC
 	}
 }
 
-ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* selection, int* warnings/*=0*/) const
+//! Runs a function for each index in [0 ; count[ (in parallel if possible)
+template <class Function> static void ParallelFor(unsigned count, const Function& func)
 {
-	if (warnings)
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0u, count, func);
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(count); ++i)
 	{
-		*warnings = 0;
+		func(static_cast<unsigned>(i));
 	}
+#endif
+}
 
-	if (!selection || selection->getAssociatedCloud() != static_cast<const GenericIndexedCloud*>(this))
+//! Subset of points defined by a ReferenceCloud (see ccPointCloud::createSubsetCloud)
+struct ReferenceCloudSubset
+{
+	explicit ReferenceCloudSubset(const CCCoreLib::ReferenceCloud& _selection) : selection(_selection) {}
+
+	template <class Function> void operator()(const Function& func) const
 	{
-		ccLog::Error("[ccPointCloud::partialClone] Invalid parameters");
-		return nullptr;
+		ParallelFor(selection.size(), [&](unsigned i)
+		{
+			func(i, selection.getPointGlobalIndex(i));
+		});
+	}
+
+	const CCCoreLib::ReferenceCloud& selection;
+};
+
+//! Subset of points defined by the visible points of a visibility table (see ccPointCloud::createSubsetCloud)
+/** The chunks of points are processed in parallel.
+**/
+struct VisiblePointsSubset
+{
+	VisiblePointsSubset(const ccVisibilityTable& _visTable, const std::vector<unsigned>& _chunkOffsets)
+		: visTable(_visTable)
+		, chunkOffsets(_chunkOffsets)
+	{}
+
+	template <class Function> void operator()(const Function& func) const
+	{
+		ParallelFor(static_cast<unsigned>(chunkOffsets.size()), [&](unsigned chunkIndex)
+		{
+			unsigned destIndex = chunkOffsets[chunkIndex];
+			switch (visTable.chunkState(chunkIndex))
+			{
+			case ccVisibilityTable::ALL_HIDDEN:
+				break;
+
+			case ccVisibilityTable::ALL_VISIBLE:
+			{
+				unsigned firstIndex = static_cast<unsigned>(ccChunk::StartPos(chunkIndex));
+				unsigned lastIndex = firstIndex + static_cast<unsigned>(ccChunk::Size(chunkIndex, visTable.size()));
+				for (unsigned i = firstIndex; i < lastIndex; ++i)
+				{
+					func(destIndex++, i);
+				}
+			}
+			break;
+
+			case ccVisibilityTable::MIXED:
+				visTable.forEachVisibleInChunk(chunkIndex, [&](size_t i)
+				{
+					func(destIndex++, static_cast<unsigned>(i));
+				});
+				break;
+			}
+		});
+	}
+
+	const ccVisibilityTable& visTable;
+	//! Output index of the first visible point of each chunk
+	const std::vector<unsigned>& chunkOffsets;
+};
+
+//! Moves the elements of an array corresponding to the hidden points to the front of the array
+/** The array is compacted in place and the order of the elements is preserved.
+	The array is not resized.
+	\param array array (one element per point)
+	\param visTable visibility table (its chunk summaries must be up to date)
+**/
+template <class Container> static void CompactHiddenElements(Container& array, const ccVisibilityTable& visTable)
+{
+	assert(array.size() >= visTable.size());
+
+	size_t destIndex = 0;
+	for (size_t chunkIndex = 0; chunkIndex < visTable.chunkCount(); ++chunkIndex)
+	{
+		ccVisibilityTable::ChunkState state = visTable.chunkState(chunkIndex);
+		if (state == ccVisibilityTable::ALL_VISIBLE)
+		{
+			//all the elements of this chunk are dropped
+			continue;
+		}
+
+		size_t firstIndex = ccChunk::StartPos(chunkIndex);
+		size_t lastIndex = firstIndex + ccChunk::Size(chunkIndex, visTable.size());
+		if (state == ccVisibilityTable::ALL_HIDDEN)
+		{
+			//all the elements of this chunk are kept (destIndex <= firstIndex)
+			if (destIndex != firstIndex)
+			{
+				std::copy(array.begin() + firstIndex, array.begin() + lastIndex, array.begin() + destIndex);
+			}
+			destIndex += (lastIndex - firstIndex);
+		}
+		else
+		{
+			for (size_t i = firstIndex; i < lastIndex; ++i)
+			{
+				if (!visTable.isVisible(i))
+				{
+					array[destIndex++] = array[i];
+				}
+			}
+		}
+	}
+}
+
+template <class SubsetFunction> ccPointCloud* ccPointCloud::createSubsetCloud(unsigned n, const SubsetFunction& forEachPoint, int* warnings) const
+{
+	if (warnings)
+	{
+		*warnings = 0;
 	}
 
 	ccPointCloud* result = new ccPointCloud(getName() + QString(".extract"));
@@ -200,10 +323,10 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 	result->importParametersFrom(this);
 
 	//from now on we will need some points to proceed ;)
-	unsigned n = selection->size();
 	if (n)
 	{
-		if (!result->reserveThePointsTable(n))
+		//the output arrays are allocated once, then filled in parallel
+		if (!result->reserveThePointsTable(n) || !result->BaseClass::resize(n))
 		{
 			ccLog::Error("[ccPointCloud::partialClone] Not enough memory to duplicate cloud!");
 			delete result;
@@ -211,22 +334,20 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 		}
 
 		//import points
+		forEachPoint([&](unsigned destIndex, unsigned srcIndex)
 		{
-			for (unsigned i = 0; i < n; i++)
-			{
-				result->addPoint(*getPointPersistentPtr(selection->getPointGlobalIndex(i)));
-			}
-		}
+			result->m_points[destIndex] = m_points[srcIndex];
+		});
 
 		//RGB colors
 		if (hasColors())
 		{
-			if (result->reserveTheRGBTable())
+			if (result->resizeTheRGBTable(false))
 			{
-				for (unsigned i = 0; i < n; i++)
+				forEachPoint([&](unsigned destIndex, unsigned srcIndex)
 				{
-					result->addColor(getPointColor(selection->getPointGlobalIndex(i)));
-				}
+					(*result->m_rgbaColors)[destIndex] = (*m_rgbaColors)[srcIndex];
+				});
 				result->showColors(colorsShown());
 			}
 			else
@@ -240,12 +361,12 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 		//normals
 		if (hasNormals())
 		{
-			if (result->reserveTheNormsTable())
+			if (result->resizeTheNormsTable())
 			{
-				for (unsigned i = 0; i < n; i++)
+				forEachPoint([&](unsigned destIndex, unsigned srcIndex)
 				{
-					result->addNormIndex(getPointNormalIndex(selection->getPointGlobalIndex(i)));
-				}
+					(*result->m_normals)[destIndex] = (*m_normals)[srcIndex];
+				});
 				result->showNormals(normalsShown());
 			}
 			else
@@ -259,34 +380,29 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 		//waveform
 		if (hasFWF())
 		{
-			if (result->reserveTheFWFTable())
+			try
 			{
-				try
+				result->m_fwfWaveforms.resize(n);
+				forEachPoint([&](unsigned destIndex, unsigned srcIndex)
 				{
-					for (unsigned i = 0; i < n; i++)
+					result->m_fwfWaveforms[destIndex] = m_fwfWaveforms[srcIndex];
+				});
+
+				//copy only the necessary descriptors
+				for (const ccWaveform& w : result->m_fwfWaveforms)
+				{
+					if (!result->fwfDescriptors().contains(w.descriptorID()))
 					{
-						const ccWaveform& w = m_fwfWaveforms[selection->getPointGlobalIndex(i)];
-						if (!result->fwfDescriptors().contains(w.descriptorID()))
-						{
-							//copy only the necessary descriptors
-							result->fwfDescriptors().insert(w.descriptorID(), m_fwfDescriptors[w.descriptorID()]);
-						}
-						result->waveforms().push_back(w);
+						result->fwfDescriptors().insert(w.descriptorID(), m_fwfDescriptors[w.descriptorID()]);
 					}
-					//we will use the same FWF data container
-					result->fwfData() = fwfData();
-				}
-				catch (const std::bad_alloc&)
-				{
-					ccLog::Warning("[ccPointCloud::partialClone] Not enough memory to copy waveform signals!");
-					result->clearFWFData();
-					if (warnings)
-						*warnings |= WRN_OUT_OF_MEM_FOR_FWF;
 				}
+				//we will use the same FWF data container
+				result->fwfData() = fwfData();
 			}
-			else
+			catch (const std::bad_alloc&)
 			{
 				ccLog::Warning("[ccPointCloud::partialClone] Not enough memory to copy waveform signals!");
+				result->clearFWFData();
 				if (warnings)
 					*warnings |= WRN_OUT_OF_MEM_FOR_FWF;
 			}
@@ -313,8 +429,10 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 							currentScalarField->setGlobalShift(sf->getGlobalShift());
 
 							//we copy data to new SF
-							for (unsigned i = 0; i < n; i++)
-								currentScalarField->setValue(i, sf->getValue(selection->getPointGlobalIndex(i)));
+							forEachPoint([&](unsigned destIndex, unsigned srcIndex)
+							{
+								currentScalarField->setValue(destIndex, sf->getValue(srcIndex));
+							});
 
 							currentScalarField->computeMinAndMax();
 							//copy display parameters
@@ -332,7 +450,7 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 				}
 			}
 
-			unsigned copiedSFCount = getNumberOfScalarFields();
+			unsigned copiedSFCount = result->getNumberOfScalarFields();
 			if (copiedSFCount)
 			{
 				//we display the same scalar field as the source (if we managed to copy it!)
@@ -356,12 +474,10 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 			{
 				//we need a map between old and new indexes
 				std::vector<int> newIndexMap(size(), -1);
+				forEachPoint([&](unsigned destIndex, unsigned srcIndex)
 				{
-					for (unsigned i = 0; i < n; i++)
-					{
-						newIndexMap[selection->getPointGlobalIndex(i)] = i;
-					}
-				}
+					newIndexMap[srcIndex] = static_cast<int>(destIndex);
+				});
 
 				//duplicate the grid structure(s)
 				std::vector<Grid::Shared> newGrids;
@@ -427,6 +543,22 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 	return result;
 }
 
+ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* selection, int* warnings/*=0*/) const
+{
+	if (warnings)
+	{
+		*warnings = 0;
+	}
+
+	if (!selection || selection->getAssociatedCloud() != static_cast<const GenericIndexedCloud*>(this))
+	{
+		ccLog::Error("[ccPointCloud::partialClone] Invalid parameters");
+		return nullptr;
+	}
+
+	return createSubsetCloud(selection->size(), ReferenceCloudSubset(*selection), warnings);
+}
+
 ccPointCloud::~ccPointCloud()
 {
 	clear();
@@ -1070,6 +1202,10 @@ void ccPointCloud::unallocateNorms()
 		m_normals->release();
 		m_normals = nullptr;
 
+		m_octahedralNormals.clear();
+		m_octahedralNormals.shrink_to_fit();
+		m_octahedralNormalsValid = false;
+
 		//We should update the VBOs to gain some free space in VRAM
 		releaseVBOs();
 	}
@@ -1496,7 +1632,7 @@ void ccPointCloud::setPointColor(unsigned pointIndex, const ccColor::Rgba& col)
 	m_rgbaColors->setValue(pointIndex, col);
 
 	//We must update the VBOs
-	colorsHaveChanged();
+	colorsHaveChanged(pointIndex, pointIndex);
 }
 
 void ccPointCloud::setPointNormalIndex(unsigned pointIndex, CompressedNormType norm)
@@ -1506,7 +1642,7 @@ void ccPointCloud::setPointNormalIndex(unsigned pointIndex, CompressedNormType n
 	m_normals->setValue(pointIndex, norm);
 
 	//We must update the VBOs
-	normalsHaveChanged();
+	normalsHaveChanged(pointIndex, pointIndex);
 }
 
 void ccPointCloud::setPointNormal(unsigned pointIndex, const CCVector3& N)
@@ -1559,6 +1695,7 @@ void ccPointCloud::addNormIndex(CompressedNormType index)
 {
 	assert(m_normals && m_normals->isAllocated());
 	m_normals->addElement(index);
+	m_octahedralNormalsValid = false;
 }
 
 void ccPointCloud::addNormAtIndex(const PointCoordinateType* N, unsigned index)
@@ -2122,6 +2259,7 @@ void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
 	{
 		assert(m_normals);
 		m_normals->swap(firstIndex, secondIndex);
+		m_octahedralNormalsValid = false;
 	}
 
 	//We must update the VBOs
@@ -2250,26 +2388,53 @@ void ccPointCloud::glChunkNormalPointer(const CC_DRAW_CONTEXT& context, size_t c
 	else if (m_normals)
 	{
 		//we must decode normals in a dedicated static array
-		PointCoordinateType* _normals = s_normalBuffer;
-		const CompressedNormType* _normalsIndexes = ccChunk::Start(*m_normals, chunkIndex);
 		size_t chunkSize = ccChunk::Size(chunkIndex, m_normals->size());
+		size_t decodedCount = (chunkSize + decimStep - 1) / decimStep;
+		decodeChunkNormals(chunkIndex, 0, decodedCount, s_normalBuffer, decimStep);
+		glFunc->glNormalPointer(GL_COORD_TYPE, 0, s_normalBuffer);
+	}
+	else
+	{
+		assert(false);
+	}
+}
 
-		//compressed normals set
-		const ccNormalVectors* compressedNormals = ccNormalVectors::GetUniqueInstance();
-		assert(compressedNormals);
+const ccNormalVectors::OctahedralNormType* ccPointCloud::getOctahedralNormals()
+{
+	if (!m_normals)
+	{
+		return nullptr;
+	}
 
-		for (size_t j = 0; j < chunkSize; j += decimStep, _normalsIndexes += decimStep)
+	//the codes are also outdated if the normals array has been resized in the meantime
+	if (!m_octahedralNormalsValid || (!m_octahedralNormals.empty() && m_octahedralNormals.size() != m_normals->size()))
+	{
+		//we don't try again before the next modification of the normals (even in case of failure)
+		m_octahedralNormalsValid = true;
+		if (!ccNormalVectors::ConvertToOctahedral(*m_normals, m_octahedralNormals))
 		{
-			const CCVector3& N = compressedNormals->getNormal(*_normalsIndexes);
-			*(_normals)++ = N.x;
-			*(_normals)++ = N.y;
-			*(_normals)++ = N.z;
+			m_octahedralNormals.clear();
+			m_octahedralNormals.shrink_to_fit();
 		}
-		glFunc->glNormalPointer(GL_COORD_TYPE, 0, s_normalBuffer);
+	}
+
+	return (m_octahedralNormals.size() == m_normals->size() ? m_octahedralNormals.data() : nullptr);
+}
+
+void ccPointCloud::decodeChunkNormals(size_t chunkIndex, size_t firstIndex, size_t count, PointCoordinateType* normals, unsigned decimStep/*=1*/)
+{
+	assert(m_normals);
+
+	size_t startIndex = ccChunk::StartPos(chunkIndex) + firstIndex;
+	const ccNormalVectors::OctahedralNormType* octNormals = getOctahedralNormals();
+	if (octNormals)
+	{
+		//table-free decoding
+		ccNormalVectors::DecodeOctahedral(octNormals + startIndex, count, normals, decimStep);
 	}
 	else
 	{
-		assert(false);
+		ccNormalVectors::DecodeNormals(m_normals->data() + startIndex, count, normals, decimStep);
 	}
 }
 
@@ -2714,7 +2879,7 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		//main display procedure
 		{
-			//if some points are hidden (= visibility table instantiated), we can't use display arrays :(
+			//if some points are hidden (= visibility table instantiated), we can only use display arrays for the fully visible chunks
 			if (isVisibilityTableInstantiated())
 			{
 				assert(m_pointsVisibility.size() == m_points.size());
@@ -2722,35 +2887,125 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 				const ccNormalVectors* compressedNormals = ccNormalVectors::GetUniqueInstance();
 				assert(compressedNormals);
 
-				glFunc->glBegin(GL_POINTS);
+				auto drawPoint = [&](unsigned pointIndex)
+				{
+					if (glParams.showSF)
+					{
+						assert(pointIndex < m_currentDisplayedScalarField->currentSize());
+						const ccColor::Rgb* col = m_currentDisplayedScalarField->getValueColor(pointIndex);
+						//we force display of points hidden because of their scalar field value
+						//to be sure that the user doesn't miss them (during manual segmentation for instance)
+						glFunc->glColor3ubv(col ? col->rgb : ccColor::lightGreyRGB.rgb); //Make sure all points are visible. No alpha used on purpose 
+					}
+					else if (glParams.showColors)
+					{
+						glFunc->glColor4ubv(m_rgbaColors->getValue(pointIndex).rgba);
+					}
+					if (glParams.showNorms)
+					{
+						ccGL::Normal3v(glFunc, compressedNormals->getNormal(m_normals->getValue(pointIndex)).u);
+					}
+					ccGL::Vertex3v(glFunc, m_points[pointIndex].u);
+				};
+
+				if (toDisplay.indexMap) //LoD display
+				{
+					glFunc->glBegin(GL_POINTS);
 
-				for (unsigned j = toDisplay.startIndex; j < toDisplay.endIndex; j += toDisplay.decimStep)
+					for (unsigned j = toDisplay.startIndex; j < toDisplay.endIndex; j += toDisplay.decimStep)
+					{
+						//we must test each point visibility
+						unsigned pointIndex = toDisplay.indexMap->at(j);
+						if (m_pointsVisibility.isVisible(pointIndex))
+						{
+							drawPoint(pointIndex);
+						}
+					}
+
+					glFunc->glEnd();
+				}
+				else
 				{
-					//we must test each point visibility
-					unsigned pointIndex = toDisplay.indexMap ? toDisplay.indexMap->at(j) : j;
-					if (m_pointsVisibility.empty() || m_pointsVisibility[pointIndex] == CCCoreLib::POINT_VISIBLE)
+					//the fully visible chunks can be displayed with arrays (as long as all the points have a color)
+					bool useArrays = (!glParams.showSF || !m_currentDisplayedScalarField->mayHaveHiddenValues());
+					
+					size_t chunkCount = ccChunk::Count(m_points);
+					for (size_t k = 0; k < chunkCount; ++k)
 					{
-						if (glParams.showSF)
+						//we use the chunk summaries to skip the hidden chunks
+						ccVisibilityTable::ChunkState chunkState = m_pointsVisibility.chunkState(k);
+						if (chunkState == ccVisibilityTable::ALL_HIDDEN)
 						{
-							assert(pointIndex < m_currentDisplayedScalarField->currentSize());
-							const ccColor::Rgb* col = m_currentDisplayedScalarField->getValueColor(pointIndex);
-							//we force display of points hidden because of their scalar field value
-							//to be sure that the user doesn't miss them (during manual segmentation for instance)
-							glFunc->glColor3ubv(col ? col->rgb : ccColor::lightGreyRGB.rgb); //Make sure all points are visible. No alpha used on purpose 
+							continue;
 						}
-						else if (glParams.showColors)
+
+						unsigned chunkStart = static_cast<unsigned>(ccChunk::StartPos(k));
+						unsigned chunkSize = static_cast<unsigned>(ccChunk::Size(k, m_points));
+						unsigned chunkEnd = chunkStart + chunkSize;
+						if (chunkEnd <= toDisplay.startIndex || chunkStart >= toDisplay.endIndex)
 						{
-							glFunc->glColor4ubv(m_rgbaColors->getValue(pointIndex).rgba);
+							continue;
 						}
-						if (glParams.showNorms)
+
+						if (	useArrays
+							&&	chunkState == ccVisibilityTable::ALL_VISIBLE
+							&&	chunkStart >= toDisplay.startIndex
+							&&	chunkEnd <= toDisplay.endIndex)
+						{
+							glFunc->glEnableClientState(GL_VERTEX_ARRAY);
+							glChunkVertexPointer(context, k, toDisplay.decimStep, false);
+							if (glParams.showNorms)
+							{
+								glFunc->glEnableClientState(GL_NORMAL_ARRAY);
+								glChunkNormalPointer(context, k, toDisplay.decimStep, false);
+							}
+							if (glParams.showSF || glParams.showColors)
+							{
+								glFunc->glEnableClientState(GL_COLOR_ARRAY);
+								if (glParams.showSF)
+									glChunkSFPointer(context, k, toDisplay.decimStep, false);
+								else
+									glChunkColorPointer(context, k, toDisplay.decimStep, false);
+							}
+
+							if (toDisplay.decimStep > 1)
+							{
+								chunkSize = static_cast<unsigned>(floor(static_cast<float>(chunkSize) / toDisplay.decimStep));
+							}
+							glFunc->glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(chunkSize));
+
+							glFunc->glDisableClientState(GL_VERTEX_ARRAY);
+							if (glParams.showNorms)
+								glFunc->glDisableClientState(GL_NORMAL_ARRAY);
+							if (glParams.showSF || glParams.showColors)
+								glFunc->glDisableClientState(GL_COLOR_ARRAY);
+						}
+						else
 						{
-							ccGL::Normal3v(glFunc, compressedNormals->getNormal(m_normals->getValue(pointIndex)).u);
+							//first index of the chunk (with respect to the decimation step)
+							unsigned firstIndex = std::max(chunkStart, toDisplay.startIndex);
+							unsigned offset = (firstIndex - toDisplay.startIndex) % toDisplay.decimStep;
+							if (offset != 0)
+							{
+								firstIndex += toDisplay.decimStep - offset;
+							}
+							unsigned lastIndex = std::min(chunkEnd, toDisplay.endIndex);
+
+							glFunc->glBegin(GL_POINTS);
+
+							for (unsigned j = firstIndex; j < lastIndex; j += toDisplay.decimStep)
+							{
+								//we must test each point visibility
+								if (m_pointsVisibility.isVisible(j))
+								{
+									drawPoint(j);
+								}
+							}
+
+							glFunc->glEnd();
 						}
-						ccGL::Vertex3v(glFunc, m_points[pointIndex].u);
 					}
 				}
-
-				glFunc->glEnd();
 			}
 			else if (glParams.showSF) //no visibility table enabled + scalar field
 			{
@@ -3249,26 +3504,32 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 		}
 	}
 
-	//we create a new cloud with the "visible" points
-	ccPointCloud* result = nullptr;
+	//output index of the first visible point of each chunk
+	//(prefix sum of the per-chunk counts, themselves computed in parallel)
+	std::vector<unsigned> chunkOffsets;
+	unsigned visibleCount = 0;
+	try
 	{
-		//we create a temporary entity with the visible points only
-		CCCoreLib::ReferenceCloud* rc = getTheVisiblePoints(visTable, silent);
-		if (!rc)
-		{
-			//a warning message has already been issued by getTheVisiblePoints!
-			//ccLog::Warning("[ccPointCloud] An error occurred during points selection!");
-			return nullptr;
-		}
-
-		//convert selection to cloud
-		result = partialClone(rc);
-
-		//don't need this one anymore
-		delete rc;
-		rc = nullptr;
+		chunkOffsets.resize(visTable->chunkCount());
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccPointCloud] Not enough memory!");
+		return nullptr;
+	}
+	for (size_t chunkIndex = 0; chunkIndex < chunkOffsets.size(); ++chunkIndex)
+	{
+		chunkOffsets[chunkIndex] = visibleCount;
+		visibleCount += visTable->chunkVisibleCount(chunkIndex);
+	}
+	if (visibleCount == 0 && !silent)
+	{
+		ccLog::Warning("[ccPointCloud] No point in selection");
 	}
 
+	//we create a new cloud with the "visible" points
+	//(directly from the visibility table, without any intermediate ReferenceCloud)
+	ccPointCloud* result = createSubsetCloud(visibleCount, VisiblePointsSubset(*visTable, chunkOffsets), nullptr);
 	if (!result)
 	{
 		ccLog::Warning("[ccPointCloud] Failed to generate a subset cloud");
@@ -3285,56 +3546,80 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 		clearLOD();
 
 		unsigned count = size();
+		unsigned remainingCount = count - visibleCount;
 
 		//we have to take care of scan grids first
+		if (!m_grids.empty())
 		{
-			//we need a map between old and new indexes
-			std::vector<int> newIndexMap(size(), -1);
+			try
 			{
-				unsigned newIndex = 0;
-				for (unsigned i = 0; i < count; ++i)
+				//we need a map between old and new indexes
+				std::vector<int> newIndexMap(count, -1);
 				{
-					if (m_pointsVisibility[i] != CCCoreLib::POINT_VISIBLE)
+					unsigned newIndex = 0;
+					for (unsigned i = 0; i < count; ++i)
 					{
-						newIndexMap[i] = newIndex++;
+						if (!visTable->isVisible(i))
+						{
+							newIndexMap[i] = newIndex++;
+						}
 					}
 				}
-			}
 
-			//then update the indexes
-			UpdateGridIndexes(newIndexMap, m_grids);
+				//then update the indexes
+				UpdateGridIndexes(newIndexMap, m_grids);
 
-			//and reset the invalid (empty) ones
-			//(DGM: we don't erase them as they may still be useful?)
-			for (Grid::Shared &grid : m_grids)
-			{
-				if (grid->validCount == 0)
+				//and reset the invalid (empty) ones
+				//(DGM: we don't erase them as they may still be useful?)
+				for (Grid::Shared &grid : m_grids)
 				{
-					grid->indexes.resize(0);
+					if (grid->validCount == 0)
+					{
+						grid->indexes.resize(0);
+					}
 				}
 			}
+			catch (const std::bad_alloc&)
+			{
+				ccLog::Warning("[ccPointCloud] Not enough memory to update the scan grids (they will be removed)");
+				removeGrids();
+			}
 		}
 
-		//we remove all visible points
-		unsigned lastPoint = 0;
-		for (unsigned i = 0; i < count; ++i)
+		//we remove all visible points: each array is compacted in place
+		//(the arrays are independent, so they are processed in parallel)
+		std::vector< std::function<void()> > compactionTasks;
+		compactionTasks.emplace_back([&]() { CompactHiddenElements(m_points, *visTable); });
+		if (hasColors())
 		{
-			if (m_pointsVisibility[i] != CCCoreLib::POINT_VISIBLE)
-			{
-				if (i != lastPoint)
-				{
-					swapPoints(lastPoint, i);
-				}
-				++lastPoint;
-			}
+			compactionTasks.emplace_back([&]() { CompactHiddenElements(*m_rgbaColors, *visTable); });
+		}
+		if (hasNormals())
+		{
+			compactionTasks.emplace_back([&]() { CompactHiddenElements(*m_normals, *visTable); });
+		}
+		if (hasFWF())
+		{
+			compactionTasks.emplace_back([&]() { CompactHiddenElements(m_fwfWaveforms, *visTable); });
+		}
+		for (unsigned k = 0; k < getNumberOfScalarFields(); ++k)
+		{
+			CCCoreLib::ScalarField* sf = getScalarField(k);
+			compactionTasks.emplace_back([sf, visTable]() { CompactHiddenElements(*sf, *visTable); });
 		}
+		ParallelFor(static_cast<unsigned>(compactionTasks.size()), [&](unsigned i) { compactionTasks[i](); });
 
 		unallocateVisibilityArray();
 
 		//TODO: handle associated meshes
 
-		resize(lastPoint);
-		
+		resize(remainingCount);
+
+		for (unsigned k = 0; k < getNumberOfScalarFields(); ++k)
+		{
+			getScalarField(k)->computeMinAndMax();
+		}
+
 		refreshBB(); //calls notifyGeometryUpdate + releaseVBOs
 	}
 
@@ -4388,6 +4673,15 @@ bool ccPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flags, Load
 				unallocateNorms();
 				return false;
 			}
+
+			//we directly convert the loaded normals to their table-free representation
+			//(used to send them in bulk to the graphic card)
+			if (!ccNormalVectors::ConvertToOctahedral(*m_normals, m_octahedralNormals))
+			{
+				//not a problem: the compressed normals table will be used instead
+				m_octahedralNormals.clear();
+			}
+			m_octahedralNormalsValid = true;
 		}
 	}
 
@@ -4764,9 +5058,6 @@ static bool CatchGLErrors(GLenum err, const char* context)
 	return true;
 }
 
-//DGM: normals are so slow to display that it's a waste of memory and time to load them in VBOs!
-#define DONT_LOAD_NORMALS_IN_VBOS
-
 bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams& glParams)
 {
 	if (isColorOverriden())
@@ -4805,14 +5096,12 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 			m_vboManager.updateFlags |= vboSet::UPDATE_COLORS;
 		}
 
-#ifndef DONT_LOAD_NORMALS_IN_VBOS
 		if ( glParams.showNorms && !m_vboManager.hasNormals )
 		{
-			updateFlags |= UPDATE_NORMALS;
+			m_vboManager.updateFlags |= vboSet::UPDATE_NORMALS;
 		}
-#endif
 		//nothing to do?
-		if (m_vboManager.updateFlags == 0)
+		if (m_vboManager.updateFlags == 0 && !m_vboManager.hasDirtyRanges)
 		{
 			return true;
 		}
@@ -4841,6 +5130,7 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 		try
 		{
 			m_vboManager.vbos.resize(chunksCount, nullptr);
+			m_vboManager.dirtyRanges.resize(chunksCount);
 		}
 		catch (const std::bad_alloc&)
 		{
@@ -4858,18 +5148,12 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 		//DGM: the context should be already active as this method should only be called from 'drawMeOnly'
 		assert(!glParams.showSF		|| m_currentDisplayedScalarField);
 		assert(!glParams.showColors	|| m_rgbaColors);
-#ifndef DONT_LOAD_NORMALS_IN_VBOS
-		assert(!glParams.showNorms	|| (m_normals && m_normals->chunksCount() >= chunksCount));
-#endif
+		assert(!glParams.showNorms	|| (m_normals && m_normals->size() == m_points.size()));
 
 		m_vboManager.hasColors  = glParams.showSF || glParams.showColors;
 		m_vboManager.colorIsSF  = glParams.showSF;
 		m_vboManager.sourceSF   = glParams.showSF ? m_currentDisplayedScalarField : nullptr;
-#ifndef DONT_LOAD_NORMALS_IN_VBOS
 		m_vboManager.hasNormals = glParams.showNorms;
-#else
-		m_vboManager.hasNormals  = false;
-#endif
 
 		//process each chunk
 		for (size_t chunkIndex = 0; chunkIndex < chunksCount; ++chunkIndex)
@@ -4877,6 +5161,9 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 			int chunkSize = static_cast<int>(ccChunk::Size(chunkIndex, m_points));
 
 			int chunkUpdateFlags = m_vboManager.updateFlags;
+			//partial update (only for the features that are not entirely updated)
+			vboSet::DirtyRange dirtyRange = (chunkIndex < m_vboManager.dirtyRanges.size() ? m_vboManager.dirtyRanges[chunkIndex] : vboSet::DirtyRange());
+			dirtyRange.updateFlags &= ~chunkUpdateFlags;
 			bool reallocated = false;
 			if (!m_vboManager.vbos[chunkIndex])
 			{
@@ -4900,6 +5187,13 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 				{
 					//if the vbo is reallocated, then all its content has been cleared!
 					chunkUpdateFlags = vboSet::UPDATE_ALL;
+					dirtyRange.updateFlags = 0;
+				}
+				else if (dirtyRange.updateFlags != 0 && dirtyRange.lastIndex >= static_cast<unsigned>(chunkSize))
+				{
+					//the cloud has been resized in the meantime
+					dirtyRange.updateFlags = (dirtyRange.firstIndex < static_cast<unsigned>(chunkSize) ? dirtyRange.updateFlags : 0);
+					dirtyRange.lastIndex = static_cast<unsigned>(chunkSize) - 1;
 				}
 
 				m_vboManager.vbos[chunkIndex]->bind();
@@ -4909,17 +5203,35 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 				{
 					m_vboManager.vbos[chunkIndex]->write(0, ccChunk::Start(m_points, chunkIndex), sizeof(PointCoordinateType)*chunkSize * 3);
 				}
+				else if (dirtyRange.updateFlags & vboSet::UPDATE_POINTS)
+				{
+					m_vboManager.vbos[chunkIndex]->write(	static_cast<int>(sizeof(PointCoordinateType) * dirtyRange.firstIndex * 3),
+															ccChunk::Start(m_points, chunkIndex) + dirtyRange.firstIndex,
+															static_cast<int>(sizeof(PointCoordinateType) * (dirtyRange.lastIndex - dirtyRange.firstIndex + 1) * 3));
+				}
 				//load colors
+				int colorsFirstIndex = 0;
+				int colorsCount = 0;
 				if (chunkUpdateFlags & vboSet::UPDATE_COLORS)
 				{
+					colorsCount = chunkSize;
+				}
+				else if (dirtyRange.updateFlags & vboSet::UPDATE_COLORS)
+				{
+					colorsFirstIndex = static_cast<int>(dirtyRange.firstIndex);
+					colorsCount = static_cast<int>(dirtyRange.lastIndex - dirtyRange.firstIndex + 1);
+				}
+				if (colorsCount != 0)
+				{
+					int colorsOffset = m_vboManager.vbos[chunkIndex]->rgbShift + static_cast<int>(sizeof(ColorCompType)) * colorsFirstIndex * 4;
 					if (glParams.showSF)
 					{
 						//copy SF colors in static array
 						{
 							assert(m_vboManager.sourceSF);
 							ColorCompType* _sfColors = s_rgbBuffer4ub;
-							ScalarType* _sf = ccChunk::Start(*m_vboManager.sourceSF, chunkIndex);
-							for (int j = 0; j < chunkSize; j++, _sf++)
+							ScalarType* _sf = ccChunk::Start(*m_vboManager.sourceSF, chunkIndex) + colorsFirstIndex;
+							for (int j = 0; j < colorsCount; j++, _sf++)
 							{
 								//we need to convert scalar value to color into a temporary structure
 								const ccColor::Rgb* col = _sf ? m_vboManager.sourceSF->getColor(*_sf) : nullptr;
@@ -4932,32 +5244,33 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 							}
 						}
 						//then send them in VRAM
-						m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->rgbShift, s_rgbBuffer4ub, sizeof(ColorCompType) * chunkSize * 4);
+						m_vboManager.vbos[chunkIndex]->write(colorsOffset, s_rgbBuffer4ub, sizeof(ColorCompType) * colorsCount * 4);
 						//upadte 'modification' flag for current displayed SF
-						m_vboManager.sourceSF->setModificationFlag(false);
+						if (chunkUpdateFlags & vboSet::UPDATE_COLORS)
+						{
+							m_vboManager.sourceSF->setModificationFlag(false);
+						}
 					}
 					else if (glParams.showColors)
 					{
-						m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->rgbShift, ccChunk::Start(*m_rgbaColors, chunkIndex), sizeof(ColorCompType) * chunkSize * 4);
+						m_vboManager.vbos[chunkIndex]->write(colorsOffset, ccChunk::Start(*m_rgbaColors, chunkIndex) + colorsFirstIndex, sizeof(ColorCompType) * colorsCount * 4);
 					}
 				}
-#ifndef DONT_LOAD_NORMALS_IN_VBOS
 				//load normals
-				if (glParams.showNorms && (chunkUpdateFlags & UPDATE_NORMALS))
+				if (glParams.showNorms && (chunkUpdateFlags & vboSet::UPDATE_NORMALS))
 				{
-					//we must decode the normals first!
-					CompressedNormType* inNorms = m_normals->chunkStartPtr(chunkIndex);
-					PointCoordinateType* outNorms = s_normalBuffer;
-					for (int j=0; j<chunkSize; ++j)
-					{
-						const CCVector3& N = ccNormalVectors::GetNormal(*inNorms++);
-						*(outNorms)++ = N.x;
-						*(outNorms)++ = N.y;
-						*(outNorms)++ = N.z;
-					}
+					//we must decode the normals first (in bulk, with the octahedral codes if possible)
+					decodeChunkNormals(chunkIndex, 0, chunkSize, s_normalBuffer);
 					m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->normalShift, s_normalBuffer, sizeof(PointCoordinateType)*chunkSize * 3);
 				}
-#endif
+				else if (glParams.showNorms && (dirtyRange.updateFlags & vboSet::UPDATE_NORMALS))
+				{
+					int normalsCount = static_cast<int>(dirtyRange.lastIndex - dirtyRange.firstIndex + 1);
+					decodeChunkNormals(chunkIndex, dirtyRange.firstIndex, normalsCount, s_normalBuffer);
+					m_vboManager.vbos[chunkIndex]->write(	m_vboManager.vbos[chunkIndex]->normalShift + static_cast<int>(sizeof(PointCoordinateType) * dirtyRange.firstIndex * 3),
+															s_normalBuffer,
+															sizeof(PointCoordinateType) * normalsCount * 3);
+				}
 				m_vboManager.vbos[chunkIndex]->release();
 
 				//if an error is detected
@@ -4986,6 +5299,7 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 					ccLog::Warning(QString("[ccPointCloud::updateVBOs] Failed to initialize VBOs (not enough memory?) (cloud '%1')").arg(getName()));
 					m_vboManager.state = vboSet::FAILED;
 					m_vboManager.vbos.resize(0);
+					m_vboManager.dirtyRanges.resize(0);
 					return false;
 				}
 				else
@@ -5016,10 +5330,54 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 
 	m_vboManager.state = vboSet::INITIALIZED;
 	m_vboManager.updateFlags = 0;
+	if (m_vboManager.hasDirtyRanges)
+	{
+		for (vboSet::DirtyRange& dirtyRange : m_vboManager.dirtyRanges)
+		{
+			dirtyRange.updateFlags = 0;
+		}
+		m_vboManager.hasDirtyRanges = false;
+	}
 
 	return true;
 }
 
+void ccPointCloud::vboRangeHasChanged(int updateFlags, unsigned firstIndex, unsigned lastIndex)
+{
+	assert(firstIndex <= lastIndex);
+
+	if (	m_vboManager.state != vboSet::INITIALIZED
+		||	(m_vboManager.updateFlags & updateFlags) == updateFlags)
+	{
+		//the VBOs will be entirely (re)loaded anyway
+		return;
+	}
+
+	size_t firstChunk = (firstIndex >> ccChunk::SIZE_POWER);
+	size_t lastChunk = (lastIndex >> ccChunk::SIZE_POWER);
+	for (size_t chunkIndex = firstChunk; chunkIndex <= lastChunk && chunkIndex < m_vboManager.dirtyRanges.size(); ++chunkIndex)
+	{
+		size_t chunkStart = ccChunk::StartPos(chunkIndex);
+		unsigned first = static_cast<unsigned>(std::max(static_cast<size_t>(firstIndex), chunkStart) - chunkStart);
+		unsigned last = static_cast<unsigned>(std::min(static_cast<size_t>(lastIndex), chunkStart + ccChunk::SIZE - 1) - chunkStart);
+
+		vboSet::DirtyRange& dirtyRange = m_vboManager.dirtyRanges[chunkIndex];
+		if (dirtyRange.updateFlags == 0)
+		{
+			dirtyRange.firstIndex = first;
+			dirtyRange.lastIndex = last;
+		}
+		else
+		{
+			//we only keep one range per chunk (for all the features)
+			dirtyRange.firstIndex = std::min(dirtyRange.firstIndex, first);
+			dirtyRange.lastIndex = std::max(dirtyRange.lastIndex, last);
+		}
+		dirtyRange.updateFlags |= updateFlags;
+		m_vboManager.hasDirtyRanges = true;
+	}
+}
+
 int ccPointCloud::VBO::init(int count, bool withColors, bool withNormals, bool* reallocated/*=0*/)
 {
 	//required memory
@@ -5102,6 +5460,8 @@ void ccPointCloud::releaseVBOs()
 	}
 
 	m_vboManager.vbos.resize(0);
+	m_vboManager.dirtyRanges.resize(0);
+	m_vboManager.hasDirtyRanges = false;
 	m_vboManager.hasColors = false;
 	m_vboManager.hasNormals = false;
 	m_vboManager.colorIsSF = false;
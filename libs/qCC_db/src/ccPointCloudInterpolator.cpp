@@ -18,6 +18,7 @@
 #include "ccPointCloudInterpolator.h"
 
 //qCC_db
+#include "ccOctree.h"
 #include "ccPointCloud.h"
 
 //CCCoreLib
@@ -51,55 +52,28 @@ bool cellSFInterpolator(const CCCoreLib::DgmOctree::octreeCell& cell,
 		normalDistWeighting = (interpSigma2x2 > 0);
 	}
 
-	//structure for nearest neighbors search
-	bool useKNN = (params->method == ccPointCloudInterpolator::Parameters::K_NEAREST_NEIGHBORS);
-	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	{
-		nNSS.level = cell.level;
-		if (useKNN)
-		{
-			nNSS.minNumberOfNeighbors = params->knn;
-		}
-		else
-		{
-			nNSS.prepare(static_cast<PointCoordinateType>(params->radius), cell.parentOctree->getCellSize(cell.level));
-		}
-		cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-		cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-	}
-
 	std::vector<double> sumValues;
+	std::vector<ScalarType> values;
 	size_t sfCount = scalarFields->size();
 	assert(sfCount != 0);
 	sumValues.resize(sfCount);
 
 	//for each point of the current cell (destination octree) we look for its nearest neighbours in the source cloud
-	unsigned pointCount = cell.points->size();
-	for (unsigned i = 0; i < pointCount; i++)
+	//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
+	auto interpolate = [&](ccOctree::QueryContext& context, unsigned i, unsigned neighborCount)
 	{
 		unsigned outPointIndex = cell.points->getPointGlobalIndex(i);
-		cell.points->getPoint(i, nNSS.queryPoint);
-
-		//look for neighbors (either inside a sphere or the k nearest ones)
-		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
-		unsigned neighborCount = 0;
 
-		if (useKNN)
+		if (params->method == ccPointCloudInterpolator::Parameters::K_NEAREST_NEIGHBORS)
 		{
-			neighborCount = srcOctree->findNearestNeighborsStartingFromCell(nNSS);
 			neighborCount = std::min(neighborCount, params->knn);
 		}
-		else
-		{
-			neighborCount = srcOctree->findNeighborsInASphereStartingFromCell(nNSS, params->radius, false);
-		}
 
 		if (neighborCount)
 		{
 			if (params->algo == ccPointCloudInterpolator::Parameters::MEDIAN)
 			{
 				//median
-				std::vector<ScalarType> values;
 				values.resize(neighborCount);
 				unsigned medianIndex = std::max(neighborCount / 2, 1u) - 1;
 
@@ -108,7 +82,7 @@ bool cellSFInterpolator(const CCCoreLib::DgmOctree::octreeCell& cell,
 					const CCCoreLib::ScalarField* sf = scalarFields->at(j).in;
 					for (unsigned k = 0; k < neighborCount; ++k)
 					{
-						CCCoreLib::DgmOctree::PointDescriptor& P = nNSS.pointsInNeighbourhood[k];
+						CCCoreLib::DgmOctree::PointDescriptor& P = context.nNSS.pointsInNeighbourhood[k];
 						values[k] = sf->getValue(P.pointIndex);
 					}
 					std::sort(values.begin(), values.end());
@@ -123,7 +97,7 @@ bool cellSFInterpolator(const CCCoreLib::DgmOctree::octreeCell& cell,
 				std::fill(sumValues.begin(), sumValues.end(), 0);
 				for (unsigned k = 0; k < neighborCount; ++k)
 				{
-					CCCoreLib::DgmOctree::PointDescriptor& P = nNSS.pointsInNeighbourhood[k];
+					CCCoreLib::DgmOctree::PointDescriptor& P = context.nNSS.pointsInNeighbourhood[k];
 					double w = 1.0;
 					if (normalDistWeighting)
 					{
@@ -155,13 +129,18 @@ bool cellSFInterpolator(const CCCoreLib::DgmOctree::octreeCell& cell,
 			//we assume the scalar fields have all been initialized to CCCoreLib::NAN_VALUE
 		}
 
-		if (nProgress && !nProgress->oneStep())
-		{
-			return false;
-		}
-	}
+		return true;
+	};
 
-	return true;
+	//look for neighbors (either inside a sphere or the k nearest ones)
+	if (params->method == ccPointCloudInterpolator::Parameters::K_NEAREST_NEIGHBORS)
+	{
+		return ccOctree::FindNearestNeighborsForCellPoints(cell, params->knn, interpolate, nProgress, srcOctree);
+	}
+	else
+	{
+		return ccOctree::FindNeighborsInASphereForCellPoints(cell, static_cast<PointCoordinateType>(params->radius), interpolate, nProgress, srcOctree);
+	}
 }
 
 bool ccPointCloudInterpolator::InterpolateScalarFieldsFrom(	ccPointCloud* destCloud,
@@ -315,13 +294,15 @@ bool ccPointCloudInterpolator::InterpolateScalarFieldsFrom(	ccPointCloud* destCl
 												(void*)(&params)
 			};
 
-			if (destOctree->executeFunctionForAllCellsAtLevel(	octreeLevel,
-																cellSFInterpolator,
-																additionalParameters,
-																true,
-																progressCb,
-																"Scalar field interpolation",
-																0) == 0)
+			unsigned processedCells = destOctree->executeFunctionForAllCellsAtLevel(octreeLevel,
+																					cellSFInterpolator,
+																					additionalParameters,
+																					true,
+																					progressCb,
+																					"Scalar field interpolation",
+																					0);
+			ccOctree::ReleaseQueryContexts();
+			if (processedCells == 0)
 			{
 				//something went wrong
 				ccLog::Warning("[InterpolateScalarFieldsFrom] Failed to perform the interpolation");
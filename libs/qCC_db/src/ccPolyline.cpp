@@ -120,7 +120,12 @@ void ccPolyline::importParametersFrom(const ccPolyline& poly)
 
 void ccPolyline::set2DMode(bool state)
 {
-	m_mode2D = state;
+	if (m_mode2D != state)
+	{
+		m_mode2D = state;
+		//a 2D polyline is considered as a purely 'GL' feature
+		invalidateBBCache();
+	}
 }
 
 void ccPolyline::setForeground(bool state)
@@ -143,6 +148,13 @@ ccBBox ccPolyline::getOwnBB(bool withGLFeatures/*=false*/)
 	return emptyBox;
 }
 
+bool ccPolyline::isBBCacheable() const
+{
+	//the vertices must be a child of the polyline so that their modifications are notified
+	const ccHObject* vertices = dynamic_cast<const ccHObject*>(m_theAssociatedCloud);
+	return (vertices && vertices->getParent() == this);
+}
+
 bool ccPolyline::hasColors() const
 {
 	return true;
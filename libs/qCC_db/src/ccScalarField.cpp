@@ -39,6 +39,7 @@ ccScalarField::ccScalarField(const char* name/*=0*/)
 	, m_alwaysShowZero(false)
 	, m_colorScale(nullptr)
 	, m_colorRampSteps(0)
+	, m_valuesVersion(0)
 	, m_modified(true)
 	, m_globalShift(0)
 {
@@ -58,6 +59,7 @@ ccScalarField::ccScalarField(const ccScalarField& sf)
 	, m_colorScale(sf.m_colorScale)
 	, m_colorRampSteps(sf.m_colorRampSteps)
 	, m_histogram(sf.m_histogram)
+	, m_valuesVersion(0)
 	, m_modified(sf.m_modified)
 	, m_globalShift(sf.m_globalShift)
 {
@@ -214,6 +216,7 @@ void ccScalarField::computeMinAndMax()
 		}
 	}
 
+	++m_valuesVersion;
 	m_modified = true;
 
 	updateSaturationBounds();
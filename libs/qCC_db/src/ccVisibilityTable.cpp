@@ -0,0 +1,335 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
+#include "ccVisibilityTable.h"
+
+//Local
+#include "ccSerializableObject.h"
+
+//! Returns the number of bits set
+static inline unsigned PopCount(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	return static_cast<unsigned>(__popcnt64(value));
+#elif defined(__GNUC__)
+	return static_cast<unsigned>(__builtin_popcountll(value));
+#else
+	unsigned count = 0;
+	for (; value; value &= (value - 1))
+	{
+		++count;
+	}
+	return count;
+#endif
+}
+
+ccVisibilityTable::ccVisibilityTable()
+	: m_size(0)
+	, m_wordCount(0)
+	, m_summariesValid(false)
+{
+}
+
+ccVisibilityTable::ccVisibilityTable(const ccVisibilityTable& table)
+	: ccVisibilityTable()
+{
+	*this = table;
+}
+
+ccVisibilityTable& ccVisibilityTable::operator=(const ccVisibilityTable& table)
+{
+	if (this != &table)
+	{
+		allocate(table.m_size);
+		for (size_t w = 0; w < m_wordCount; ++w)
+		{
+			m_hiddenBits[w].store(table.m_hiddenBits[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+	}
+	return *this;
+}
+
+void ccVisibilityTable::allocate(size_t count)
+{
+	size_t wordCount = (count + 63) / 64;
+	if (wordCount != m_wordCount)
+	{
+		m_hiddenBits.reset(); //release the memory first
+		if (wordCount != 0)
+		{
+			m_hiddenBits.reset(new std::atomic<uint64_t>[wordCount]); //may throw std::bad_alloc
+		}
+		m_wordCount = wordCount;
+	}
+	for (size_t w = 0; w < m_wordCount; ++w)
+	{
+		m_hiddenBits[w].store(0, std::memory_order_relaxed);
+	}
+	m_size = count;
+	m_chunkVisibleCounts.clear();
+	m_summariesValid = false;
+}
+
+void ccVisibilityTable::resize(size_t count)
+{
+	if (count == m_size)
+	{
+		return;
+	}
+	if (count == 0)
+	{
+		clear();
+		return;
+	}
+
+	//keep the current values
+	ccVisibilityTable previous;
+	previous.m_size = m_size;
+	previous.m_wordCount = m_wordCount;
+	previous.m_hiddenBits = std::move(m_hiddenBits);
+	m_wordCount = 0;
+
+	try
+	{
+		allocate(count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//restore the previous state
+		m_hiddenBits = std::move(previous.m_hiddenBits);
+		m_wordCount = previous.m_wordCount;
+		throw;
+	}
+
+	size_t commonWordCount = std::min(m_wordCount, previous.m_wordCount);
+	for (size_t w = 0; w < commonWordCount; ++w)
+	{
+		m_hiddenBits[w].store(previous.m_hiddenBits[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	if (count < previous.m_size && (count & 63))
+	{
+		//the bits after the end of the table must remain cleared
+		m_hiddenBits[m_wordCount - 1].fetch_and((uint64_t(1) << (count & 63)) - 1, std::memory_order_relaxed);
+	}
+}
+
+void ccVisibilityTable::clear()
+{
+	m_hiddenBits.reset();
+	m_wordCount = 0;
+	m_size = 0;
+	m_chunkVisibleCounts.clear();
+	m_chunkVisibleCounts.shrink_to_fit();
+	m_summariesValid = false;
+}
+
+void ccVisibilityTable::fill(unsigned char value)
+{
+	uint64_t word = (value == CCCoreLib::POINT_VISIBLE ? 0 : ~uint64_t(0));
+	for (size_t w = 0; w < m_wordCount; ++w)
+	{
+		m_hiddenBits[w].store(word, std::memory_order_relaxed);
+	}
+	if (word != 0 && (m_size & 63))
+	{
+		m_hiddenBits[m_wordCount - 1].store((uint64_t(1) << (m_size & 63)) - 1, std::memory_order_relaxed);
+	}
+	m_summariesValid = false;
+}
+
+void ccVisibilityTable::invert()
+{
+	for (size_t w = 0; w < m_wordCount; ++w)
+	{
+		m_hiddenBits[w].store(~m_hiddenBits[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	if (m_size & 63)
+	{
+		m_hiddenBits[m_wordCount - 1].fetch_and((uint64_t(1) << (m_size & 63)) - 1, std::memory_order_relaxed);
+	}
+	m_summariesValid = false;
+}
+
+void ccVisibilityTable::updateSummaries() const
+{
+	if (m_summariesValid)
+	{
+		return;
+	}
+
+	const size_t chunkCount = this->chunkCount();
+	m_chunkVisibleCounts.resize(chunkCount); //may throw std::bad_alloc (but it's very small)
+
+	//each chunk is made of complete words (ccChunk::SIZE is a multiple of 64)
+	static const size_t WordsPerChunk = (ccChunk::SIZE >> 6);
+
+	int count = static_cast<int>(chunkCount);
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, count, [&](int chunkIndex)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int chunkIndex = 0; chunkIndex < count; ++chunkIndex)
+#endif
+	{
+		size_t firstWord = static_cast<size_t>(chunkIndex) * WordsPerChunk;
+		size_t lastWord = std::min(firstWord + WordsPerChunk, m_wordCount);
+		unsigned hiddenCount = 0;
+		for (size_t w = firstWord; w < lastWord; ++w)
+		{
+			hiddenCount += PopCount(m_hiddenBits[w].load(std::memory_order_relaxed));
+		}
+		m_chunkVisibleCounts[chunkIndex] = static_cast<unsigned>(ccChunk::Size(chunkIndex, chunkCount, m_size)) - hiddenCount;
+	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
+
+	m_summariesValid = true;
+}
+
+size_t ccVisibilityTable::visibleCount() const
+{
+	updateSummaries();
+
+	size_t count = 0;
+	for (unsigned chunkVisibleCount : m_chunkVisibleCounts)
+	{
+		count += chunkVisibleCount;
+	}
+	return count;
+}
+
+unsigned ccVisibilityTable::chunkVisibleCount(size_t chunkIndex) const
+{
+	updateSummaries();
+
+	assert(chunkIndex < m_chunkVisibleCounts.size());
+	return m_chunkVisibleCounts[chunkIndex];
+}
+
+ccVisibilityTable::ChunkState ccVisibilityTable::chunkState(size_t chunkIndex) const
+{
+	unsigned visibleCount = chunkVisibleCount(chunkIndex);
+	if (visibleCount == 0)
+	{
+		return ALL_HIDDEN;
+	}
+	else if (visibleCount == ccChunk::Size(chunkIndex, m_size))
+	{
+		return ALL_VISIBLE;
+	}
+	else
+	{
+		return MIXED;
+	}
+}
+
+//same as ccSerializationHelper::GenericArrayToFile/FromFile (with one byte per point)
+static const size_t s_serializationBufferSize = (1 << 24);
+
+bool ccVisibilityTable::toFile(QFile& out) const
+{
+	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
+
+	//component count (dataVersion>=20)
+	::uint8_t componentCount = 1;
+	if (out.write((const char*)&componentCount, 1) < 0)
+		return ccSerializableObject::WriteError();
+
+	//element count = array size (dataVersion>=20)
+	::uint32_t elementCount = static_cast<::uint32_t>(m_size);
+	if (out.write((const char*)&elementCount, 4) < 0)
+		return ccSerializableObject::WriteError();
+
+	//array data (dataVersion>=20)
+	std::vector<unsigned char> buffer;
+	try
+	{
+		buffer.resize(std::min(m_size, s_serializationBufferSize));
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+
+	for (size_t start = 0; start < m_size; start += buffer.size())
+	{
+		size_t count = std::min(buffer.size(), m_size - start);
+		for (size_t i = 0; i < count; ++i)
+		{
+			buffer[i] = getValue(start + i);
+		}
+		if (out.write((const char*)buffer.data(), static_cast<qint64>(count)) < 0)
+			return ccSerializableObject::WriteError();
+	}
+
+	return true;
+}
+
+bool ccVisibilityTable::fromFile(QFile& in, short dataVersion)
+{
+	assert(in.isOpen() && (in.openMode() & QIODevice::ReadOnly));
+
+	if (dataVersion < 20)
+		return ccSerializableObject::CorruptError();
+
+	//component count (dataVersion>=20)
+	::uint8_t componentCount = 0;
+	if (in.read((char*)&componentCount, 1) < 0)
+		return ccSerializableObject::ReadError();
+	if (componentCount != 1)
+		return ccSerializableObject::CorruptError();
+
+	//element count = array size (dataVersion>=20)
+	::uint32_t elementCount = 0;
+	if (in.read((char*)&elementCount, 4) < 0)
+		return ccSerializableObject::ReadError();
+
+	std::vector<unsigned char> buffer;
+	try
+	{
+		allocate(elementCount);
+		buffer.resize(std::min(static_cast<size_t>(elementCount), s_serializationBufferSize));
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+
+	//array data (dataVersion>=20)
+	for (size_t start = 0; start < m_size; start += buffer.size())
+	{
+		size_t count = std::min(buffer.size(), m_size - start);
+		if (in.read((char*)buffer.data(), static_cast<qint64>(count)) < 0)
+			return ccSerializableObject::ReadError();
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (buffer[i] != CCCoreLib::POINT_VISIBLE)
+			{
+				setVisible(start + i, false);
+			}
+		}
+	}
+
+	return true;
+}
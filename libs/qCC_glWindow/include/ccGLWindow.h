@@ -821,6 +821,20 @@ protected: //rendering
 	**/
 	void drawForeground(CC_DRAW_CONTEXT& context, RenderingParams& params);
 
+	//! Reads the color buffer of the active FBO back into an image
+	/** The rows are read by batches, with two alternating PBOs (if supported)
+		so that the transfer of a batch overlaps the copy of the previous one.
+		\param readWidth width of the area to read
+		\param readHeight height of the area to read
+		\param image output image
+		\param imageX position of the area in the output image (left)
+		\param imageY position of the area in the output image (top)
+		\param readX position of the area in the color buffer (from the lower left corner)
+		\param readY position of the area in the color buffer (from the lower left corner)
+		\return success
+	**/
+	bool readColorBuffer(int readWidth, int readHeight, QImage& image, int imageX, int imageY, int readX = 0, int readY = 0);
+
 protected: //other methods
 
 	//these methods are now protected to prevent issues with Retina or other high DPI displays
@@ -896,6 +910,10 @@ protected: //other methods
 	void updateProjectionMatrix();
 	void setStandardOrthoCenter();
 	void setStandardOrthoCorner();
+	//! Returns the matrix that restricts the projection to the current capture tile
+	/** Identity if the image is not rendered by tiles.
+	**/
+	ccGLMatrixd computeCaptureTileMatrix() const;
 
 	//Lights controls (OpenGL scripts)
 	void glEnableSunLight();
@@ -1098,6 +1116,10 @@ protected: //members
 		bool enabled;
 		float zoomFactor;
 		bool renderOverlayItems;
+		//! Current tile (if the image is rendered by tiles)
+		/** In pixels, relatively to the lower left corner of the full image (m_glViewport).
+		**/
+		QRect tile;
 	};
 
 	//! Display capturing mode options
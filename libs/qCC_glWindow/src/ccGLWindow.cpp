@@ -88,6 +88,11 @@ constexpr GLuint GL_INVALID_LIST_ID = (~0);
 //GL filter banner margin (height = 2*margin + current font height)
 constexpr int CC_GL_FILTER_BANNER_MARGIN = 5;
 
+//Rendering to an image
+constexpr size_t CC_RENDER_READBACK_BATCH_SIZE = (16 << 20); //max size of each batch of rows read back from the GPU (in bytes)
+constexpr int CC_MIN_RENDER_TILE_SIZE = 256; //min size of the tiles (when the image doesn't fit in a single FBO)
+constexpr int CC_RENDER_TILE_FILTER_MARGIN = 32; //overlap between the tiles when a GL filter is active (so that the filter has the neighborhood of the pixels on the tile borders)
+
 //stereo passes
 static const unsigned char MONO_OR_LEFT_RENDERING_PASS = 0;
 static const unsigned char RIGHT_RENDERING_PASS = 1;
@@ -2395,6 +2400,12 @@ void ccGLWindow::draw3D(CC_DRAW_CONTEXT& CONTEXT, RenderingParams& renderingPara
 		projectionMat = getProjectionMatrix();
 	}
 
+	if (m_captureMode.enabled && m_captureMode.tile.isValid())
+	{
+		//we only render the current tile of the image
+		projectionMat = computeCaptureTileMatrix() * projectionMat;
+	}
+
 	//setup the projection matrix
 	{
 		glFunc->glMatrixMode(GL_PROJECTION);
@@ -3466,6 +3477,7 @@ void ccGLWindow::setStandardOrthoCenter()
 
 	glFunc->glMatrixMode(GL_PROJECTION);
 	glFunc->glLoadIdentity();
+	glFunc->glMultMatrixd(computeCaptureTileMatrix().data());
 	double halfW = m_glViewport.width() / 2.0;
 	double halfH = m_glViewport.height() / 2.0;
 	double maxS = std::max(halfW, halfH);
@@ -3481,11 +3493,32 @@ void ccGLWindow::setStandardOrthoCorner()
 
 	glFunc->glMatrixMode(GL_PROJECTION);
 	glFunc->glLoadIdentity();
+	glFunc->glMultMatrixd(computeCaptureTileMatrix().data());
 	glFunc->glOrtho(0.0, m_glViewport.width(), 0.0, m_glViewport.height(), 0.0, 1.0);
 	glFunc->glMatrixMode(GL_MODELVIEW);
 	glFunc->glLoadIdentity();
 }
 
+ccGLMatrixd ccGLWindow::computeCaptureTileMatrix() const
+{
+	ccGLMatrixd tileMat; //identity by default
+
+	const QRect& tile = m_captureMode.tile;
+	if (m_captureMode.enabled && tile.isValid())
+	{
+		//maps the tile area (in normalized device coordinates) to the whole viewport
+		const double W = m_glViewport.width();
+		const double H = m_glViewport.height();
+		double* mat = tileMat.data();
+		mat[0] = W / tile.width();
+		mat[5] = H / tile.height();
+		mat[12] = (W - 2.0 * tile.x() - tile.width()) / tile.width();
+		mat[13] = (H - 2.0 * tile.y() - tile.height()) / tile.height();
+	}
+
+	return tileMat;
+}
+
 void ccGLWindow::getContext(CC_DRAW_CONTEXT& CONTEXT)
 {
 	//display size
@@ -5975,9 +6008,37 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 		setFontPointSize(getFontPointSize());
 	}
 
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	//full image size
+	const int imageWidth = m_glViewport.width();
+	const int imageHeight = m_glViewport.height();
+
+	//if the image doesn't fit in a single FBO, we render it tile by tile
+	int tileWidth = imageWidth;
+	int tileHeight = imageHeight;
+	{
+		GLint maxTextureSize = 0;
+		glFunc->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+		if (maxTextureSize > 0)
+		{
+			tileWidth = std::min(tileWidth, static_cast<int>(maxTextureSize));
+			tileHeight = std::min(tileHeight, static_cast<int>(maxTextureSize));
+		}
+		//each tile is rendered with its own (tile-sized) viewport
+		GLint maxViewportDims[2] = { 0, 0 };
+		glFunc->glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+		if (maxViewportDims[0] > 0 && maxViewportDims[1] > 0)
+		{
+			tileWidth = std::min(tileWidth, static_cast<int>(maxViewportDims[0]));
+			tileHeight = std::min(tileHeight, static_cast<int>(maxViewportDims[1]));
+		}
+	}
+
 	ccFrameBufferObject* fbo = nullptr;
 	ccGlFilter* glFilter = nullptr;
-	if (m_fbo && zoomFactor == 1.0f)
+	if (m_fbo && zoomFactor == 1.0f && tileWidth == imageWidth && tileHeight == imageHeight)
 	{
 		//we can use the existing FBO
 		fbo = m_fbo;
@@ -5989,30 +6050,41 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 		//otherwise we create a new temporary one
 		fbo = new ccFrameBufferObject();
 
-		bool success = (	fbo->init(m_glViewport.width(), m_glViewport.height())
-						&&	fbo->initColor()
-						&&	fbo->initDepth());
-		if (!success)
+		//we use smaller tiles if the FBO can't be allocated
+		while (!(	fbo->init(tileWidth, tileHeight)
+				&&	fbo->initColor()
+				&&	fbo->initDepth()))
 		{
-			delete fbo;
-			fbo = nullptr;
-
-			if (!silent)
-			{
-				ccLog::Error("[FBO] Initialization failed! (not enough memory?)");
-			}
-			if (zoomFactor != 1.0f)
+			if (std::max(tileWidth, tileHeight) <= CC_MIN_RENDER_TILE_SIZE)
 			{
-				setGLViewport(0, 0, width(), height()); //restore m_glViewport
+				delete fbo;
+				fbo = nullptr;
+
+				if (!silent)
+				{
+					ccLog::Error("[FBO] Initialization failed! (not enough memory?)");
+				}
+				if (zoomFactor != 1.0f)
+				{
+					setGLViewport(0, 0, width(), height()); //restore m_glViewport
+				}
+				setPointSize(_defaultPointSize, true);
+				setLineWidth(_defaultLineWidth);
+				m_captureMode.enabled = false;
+				m_captureMode.zoomFactor = 1.0f;
+				setFontPointSize(getFontPointSize());
+				return QImage();
 			}
-			return QImage();
+
+			tileWidth = std::max(1, (tileWidth + 1) / 2);
+			tileHeight = std::max(1, (tileHeight + 1) / 2);
 		}
 
 		//and we change the current GL filter size (temporarily)
 		if (m_activeGLFilter)
 		{
 			QString error;
-			if (!m_activeGLFilter->init(m_glViewport.width(), m_glViewport.height(), *s_shaderPath, error))
+			if (!m_activeGLFilter->init(tileWidth, tileHeight, *s_shaderPath, error))
 			{
 				if (!silent)
 				{
@@ -6027,19 +6099,26 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 	}
 	assert(fbo);
 
-	ccQOpenGLFunctions* glFunc = functions();
-	assert(glFunc);
+	//the GL filters need the neighborhood of each pixel: the tiles must overlap in this case
+	int tileMargin = 0;
+	if (glFilter && (tileWidth < imageWidth || tileHeight < imageHeight))
+	{
+		tileMargin = std::min(CC_RENDER_TILE_FILTER_MARGIN, std::min(tileWidth, tileHeight) / 4);
+	}
+	//part of each tile actually copied to the output image
+	const int tileStepX = tileWidth - 2 * tileMargin;
+	const int tileStepY = tileHeight - 2 * tileMargin;
 
-	CC_DRAW_CONTEXT CONTEXT;
-	getContext(CONTEXT);
-	CONTEXT.renderZoom = zoomFactor;
+	const int tileCountX = (imageWidth + tileStepX - 1) / tileStepX;
+	const int tileCountY = (imageHeight + tileStepY - 1) / tileStepY;
+	if (!silent && tileCountX * tileCountY > 1)
+	{
+		ccLog::Print(QString("[Render screen via FBO] Tiled rendering: %1 x %2 tiles of %3 x %4 pixels").arg(tileCountX).arg(tileCountY).arg(tileWidth).arg(tileHeight));
+	}
 
 	//just to be sure
 	stopLODCycle();
 
-	RenderingParams renderingParams;
-	renderingParams.drawForeground = false;
-	renderingParams.useFBO = false; //DGM: make sure that no FBO is used internally!
 	bool stereoModeWasEnabled = m_stereoModeEnabled;
 	m_stereoModeEnabled = false;
 
@@ -6047,99 +6126,132 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 	bool wasLODEnabled = isLODEnabled();
 	setLODEnabled(false);
 
-	//enable the FBO
-	bindFBO(fbo);
-	logGLError("ccGLWindow::renderToFile/FBO start");
+	bool success = true;
+	for (int tileY = 0; tileY < imageHeight && success; tileY += tileStepY)
+	{
+		for (int tileX = 0; tileX < imageWidth && success; tileX += tileStepX)
+		{
+			//each tile is rendered with a tile-sized viewport: all the projections (including
+			//the 2D ones) are restricted to the tile area (see computeCaptureTileMatrix)
+			m_captureMode.tile = QRect(tileX - tileMargin, tileY - tileMargin, tileWidth, tileHeight);
+			const int readWidth = std::min(tileStepX, imageWidth - tileX);
+			const int readHeight = std::min(tileStepY, imageHeight - tileY);
 
-	fullRenderingPass(CONTEXT, renderingParams);
+			CC_DRAW_CONTEXT CONTEXT;
+			getContext(CONTEXT);
+			CONTEXT.renderZoom = zoomFactor;
 
-	//disable the FBO
-	logGLError("ccGLWindow::renderToFile/FBO stop");
-	bindFBO(nullptr);
+			RenderingParams renderingParams;
+			renderingParams.drawForeground = false;
+			renderingParams.useFBO = false; //DGM: make sure that no FBO is used internally!
 
-	setLODEnabled(wasLODEnabled);
+			//enable the FBO
+			bindFBO(fbo);
+			logGLError("ccGLWindow::renderToFile/FBO start");
 
-	m_stereoModeEnabled = stereoModeWasEnabled;
+			glFunc->glViewport(0, 0, tileWidth, tileHeight);
 
-	CONTEXT.drawingFlags = CC_DRAW_2D | CC_DRAW_FOREGROUND;
-	if (m_interactionFlags == INTERACT_TRANSFORM_ENTITIES)
-	{
-		CONTEXT.drawingFlags |= CC_VIRTUAL_TRANS_ENABLED;
-	}
+			fullRenderingPass(CONTEXT, renderingParams);
 
-	glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
-	glFunc->glDisable(GL_DEPTH_TEST);
+			//disable the FBO
+			logGLError("ccGLWindow::renderToFile/FBO stop");
+			bindFBO(nullptr);
 
-	if (glFilter)
-	{
-		//we process GL filter
-		GLuint depthTex = fbo->getDepthTexture();
-		GLuint colorTex = fbo->getColorTexture();
-		//minimal set of viewport parameters necessary for GL filters
-		ccGlFilter::ViewportParameters parameters;
-		{
-			parameters.perspectiveMode = m_viewportParams.perspectiveView;
-			parameters.zFar = m_viewportParams.zFar;
-			parameters.zNear = m_viewportParams.zNear;
-			parameters.zoomFactor = zoomFactor;
-		}
-		//apply shader
-		glFilter->shade(depthTex, colorTex, parameters);
-		logGLError("ccGLWindow::renderToFile/glFilter shade");
+			CONTEXT.drawingFlags = CC_DRAW_2D | CC_DRAW_FOREGROUND;
+			if (m_interactionFlags == INTERACT_TRANSFORM_ENTITIES)
+			{
+				CONTEXT.drawingFlags |= CC_VIRTUAL_TRANS_ENABLED;
+			}
 
-		//in render mode we only want to capture it, not to display it
-		bindFBO(fbo);
+			glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
+			glFunc->glDisable(GL_DEPTH_TEST);
 
-		setStandardOrthoCorner();
-		ccGLUtils::DisplayTexture2DPosition(glFilter->getTexture(), 0, 0, CONTEXT.glW, CONTEXT.glH);
+			if (glFilter)
+			{
+				//we process GL filter (on the tile only)
 
-		bindFBO(nullptr);
-	}
+				GLuint depthTex = fbo->getDepthTexture();
+				GLuint colorTex = fbo->getColorTexture();
+				//minimal set of viewport parameters necessary for GL filters
+				ccGlFilter::ViewportParameters parameters;
+				{
+					parameters.perspectiveMode = m_viewportParams.perspectiveView;
+					parameters.zFar = m_viewportParams.zFar;
+					parameters.zNear = m_viewportParams.zNear;
+					parameters.zoomFactor = zoomFactor;
+				}
+				//apply shader
+				glFilter->shade(depthTex, colorTex, parameters);
+				logGLError("ccGLWindow::renderToFile/glFilter shade");
 
-	bindFBO(fbo);
-	setStandardOrthoCenter();
+				//in render mode we only want to capture it, not to display it
+				bindFBO(fbo);
 
-	//we draw 2D entities (mainly for the color ramp!)
-	if (m_globalDBRoot)
-		m_globalDBRoot->draw(CONTEXT);
-	if (m_winDBRoot)
-		m_winDBRoot->draw(CONTEXT);
+				setStandardOrthoCorner();
+				ccGLUtils::DisplayTexture2DPosition(glFilter->getTexture(), m_captureMode.tile.x(), m_captureMode.tile.y(), tileWidth, tileHeight);
 
-	//current displayed scalar field color ramp (if any)
-	ccRenderingTools::DrawColorRamp(CONTEXT);
+				bindFBO(nullptr);
+			}
 
-	if (m_displayOverlayEntities && m_captureMode.renderOverlayItems)
-	{
-		//scale: only in ortho mode
-		if (!m_viewportParams.perspectiveView)
-		{
-			//DGM FIXME: with a zoom > 1, the renderText call inside drawScale will result in the wrong FBO being used?!
-			drawScale(getDisplayParameters().textDefaultCol);
-		}
+			bindFBO(fbo);
+			setStandardOrthoCenter();
 
-		//trihedron
-		drawTrihedron();
-	}
+			//we draw 2D entities (mainly for the color ramp!)
+			if (m_globalDBRoot)
+				m_globalDBRoot->draw(CONTEXT);
+			if (m_winDBRoot)
+				m_winDBRoot->draw(CONTEXT);
 
-	glFunc->glFlush();
+			//current displayed scalar field color ramp (if any)
+			ccRenderingTools::DrawColorRamp(CONTEXT);
 
-	//read from fbo
-	glFunc->glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
-	//to avoid memory issues, we read line by line
-	for (int i = 0; i < m_glViewport.height(); ++i)
-	{
-		glFunc->glReadPixels(0, i, m_glViewport.width(), 1, GL_BGRA, GL_UNSIGNED_BYTE, data + (m_glViewport.height() - 1 - i) * m_glViewport.width() * 4);
+			if (m_displayOverlayEntities && m_captureMode.renderOverlayItems)
+			{
+				//scale: only in ortho mode
+				if (!m_viewportParams.perspectiveView)
+				{
+					//DGM FIXME: with a zoom > 1, the renderText call inside drawScale will result in the wrong FBO being used?!
+					drawScale(getDisplayParameters().textDefaultCol);
+				}
+
+				//trihedron
+				drawTrihedron();
+			}
+
+			glFunc->glFlush();
+
+			//read from fbo
+			success = readColorBuffer(readWidth, readHeight, outputImage, tileX, imageHeight - tileY - readHeight, tileMargin, tileMargin);
+
+			//restore the default FBO
+			bindFBO(nullptr);
+
+			glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
+		}
 	}
-	glFunc->glReadBuffer(GL_NONE);
 
-	//restore the default FBO
-	bindFBO(nullptr);
+	setLODEnabled(wasLODEnabled);
 
-	glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
+	m_stereoModeEnabled = stereoModeWasEnabled;
+
+	m_captureMode.tile = QRect();
+
+	//restore the viewport
+	glFunc->glViewport(m_glViewport.x(), m_glViewport.y(), m_glViewport.width(), m_glViewport.height());
+
+	if (!success)
+	{
+		if (!silent)
+		{
+			ccLog::Error("Failed to read the rendered image back! (not enough memory?)");
+		}
+		outputImage = QImage();
+	}
 
 	logGLError("ccGLWindow::renderToFile");
 
-	if (m_fbo != fbo)
+	bool temporaryFBO = (m_fbo != fbo);
+	if (temporaryFBO)
 	{
 		delete fbo;
 	}
@@ -6150,7 +6262,7 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 		setGLViewport(0, 0, width(), height()); //restore m_glViewport
 	}
 
-	if (glFilter && zoomFactor != 1.0f)
+	if (glFilter && temporaryFBO)
 	{
 		QString error;
 		m_activeGLFilter->init(m_glViewport.width(), m_glViewport.height(), *s_shaderPath, error);
@@ -6170,6 +6282,113 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 	return outputImage;
 }
 
+bool ccGLWindow::readColorBuffer(int readWidth, int readHeight, QImage& image, int imageX, int imageY, int readX/*=0*/, int readY/*=0*/)
+{
+	assert(readWidth > 0 && readHeight > 0);
+	assert(imageX >= 0 && imageX + readWidth <= image.width());
+	assert(imageY >= 0 && imageY + readHeight <= image.height());
+
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	const size_t rowSize = static_cast<size_t>(readWidth) * 4;
+	const int batchRowCount = std::max(1, std::min(readHeight, static_cast<int>(CC_RENDER_READBACK_BATCH_SIZE / rowSize)));
+	const size_t batchSize = rowSize * batchRowCount;
+
+	//copies a batch of rows to the output image (the GL rows are stored bottom-up)
+	auto copyBatch = [&](const GLubyte* batchData, int firstRow, int rowCount)
+	{
+		for (int i = 0; i < rowCount; ++i)
+		{
+			uchar* dest = image.scanLine(imageY + readHeight - 1 - (firstRow + i)) + static_cast<size_t>(imageX) * 4;
+			memcpy(dest, batchData + i * rowSize, rowSize);
+		}
+	};
+
+	glFunc->glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+
+	//we try to use two PBOs, so that the transfer of each batch overlaps the copy of the previous one
+	QOpenGLBuffer pbos[2] = { QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer), QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer) };
+	bool usePBOs = true;
+	for (QOpenGLBuffer& pbo : pbos)
+	{
+		if (!pbo.create())
+		{
+			usePBOs = false;
+			break;
+		}
+		pbo.setUsagePattern(QOpenGLBuffer::StreamRead);
+		pbo.bind();
+		pbo.allocate(static_cast<int>(batchSize));
+		pbo.release();
+	}
+
+	bool success = true;
+	if (usePBOs)
+	{
+		const int batchCount = (readHeight + batchRowCount - 1) / batchRowCount;
+		for (int batchIndex = 0; batchIndex <= batchCount && success; ++batchIndex)
+		{
+			if (batchIndex < batchCount)
+			{
+				//asynchronous read of the current batch
+				int firstRow = batchIndex * batchRowCount;
+				pbos[batchIndex & 1].bind();
+				glFunc->glReadPixels(readX, readY + firstRow, readWidth, std::min(batchRowCount, readHeight - firstRow), GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+				pbos[batchIndex & 1].release();
+			}
+
+			if (batchIndex != 0)
+			{
+				//copy of the previous batch
+				int firstRow = (batchIndex - 1) * batchRowCount;
+				QOpenGLBuffer& pbo = pbos[(batchIndex - 1) & 1];
+				pbo.bind();
+				const GLubyte* batchData = static_cast<const GLubyte*>(pbo.map(QOpenGLBuffer::ReadOnly));
+				if (batchData)
+				{
+					copyBatch(batchData, firstRow, std::min(batchRowCount, readHeight - firstRow));
+					pbo.unmap();
+				}
+				else
+				{
+					success = false;
+				}
+				pbo.release();
+			}
+		}
+	}
+	else
+	{
+		//to avoid memory issues, we read the rows by (small) batches
+		std::vector<GLubyte> batchData;
+		try
+		{
+			batchData.resize(batchSize);
+		}
+		catch (const std::bad_alloc&)
+		{
+			success = false;
+		}
+
+		for (int firstRow = 0; firstRow < readHeight && success; firstRow += batchRowCount)
+		{
+			int rowCount = std::min(batchRowCount, readHeight - firstRow);
+			glFunc->glReadPixels(readX, readY + firstRow, readWidth, rowCount, GL_BGRA, GL_UNSIGNED_BYTE, batchData.data());
+			copyBatch(batchData.data(), firstRow, rowCount);
+		}
+	}
+
+	for (QOpenGLBuffer& pbo : pbos)
+	{
+		pbo.destroy();
+	}
+
+	glFunc->glReadBuffer(GL_NONE);
+
+	return success;
+}
+
 void ccGLWindow::removeFBO()
 {
 	removeFBOSafe(m_fbo);
@@ -6802,6 +7021,7 @@ void ccGLWindow::renderText(int x, int y, const QString & str, uint16_t uniqueID
 		glFunc->glMatrixMode(GL_PROJECTION);
 		glFunc->glPushMatrix();
 		glFunc->glLoadIdentity();
+		glFunc->glMultMatrixd(computeCaptureTileMatrix().data());
 		glFunc->glOrtho(0, m_glViewport.width(), 0, m_glViewport.height(), -1, 1);
 		glFunc->glMatrixMode(GL_MODELVIEW);
 		glFunc->glPushMatrix();
@@ -29,8 +29,10 @@
 
 //qCC_db
 #include <cc2DLabel.h>
+#include <ccChunkedArray.h>
 #include <ccHObjectCaster.h>
 #include <ccLog.h>
+#include <ccNormalVectors.h>
 #include <ccPointCloud.h>
 #include <ccProgressDialog.h>
 #include <ccScalarField.h>
@@ -508,6 +510,13 @@ struct cloudAttributesDescriptor
 	bool hasRGBColors;
 	bool hasFloatRGBColors[4];
 
+	//reallocation-free storage of the points read so far (see transferBuffers)
+	ccChunkedArray<CCVector3> points;
+	ccChunkedArray<CompressedNormType> normals; //compressed as they are read (4 bytes per point instead of 12)
+	ccChunkedArray<ccColor::Rgba> colors;
+	std::vector< ccChunkedArray<ScalarType> > scalarValues;
+	std::vector< std::pair<unsigned, QString> > labels;
+
 	cloudAttributesDescriptor()
 	{
 		reset();
@@ -526,8 +535,16 @@ struct cloudAttributesDescriptor
 		
 		scalarIndexes.clear();
 		scalarFields.clear();
+
+		points.clear();
+		normals.clear();
+		colors.clear();
+		scalarValues.clear();
+		labels.clear();
 	}
 
+	inline bool hasColors() const { return hasRGBColors || greyIndex >= 0; }
+
 	void updateMaxIndex(int& maxIndex)
 	{
 		for (int attribIndex : indexes)
@@ -549,16 +566,12 @@ void clearStructure(cloudAttributesDescriptor &cloudDesc)
 }
 
 cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequence,
-										unsigned numberOfPoints,
 										int& maxIndex,
 										unsigned step = 1)
 {
+	//the points are first stored in chunks: the cloud arrays will be allocated once
+	//the number of points is known (see transferBuffers)
 	ccPointCloud* cloud = new ccPointCloud();
-	if (!cloud || !cloud->reserveThePointsTable(numberOfPoints))
-	{
-		delete cloud;
-		return cloudAttributesDescriptor();
-	}
 
 	if (step == 1)
 		cloud->setName("unnamed - Cloud");
@@ -585,40 +598,19 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 			cloudDesc.zCoordIndex = i;
 			break;
 		case ASCII_OPEN_DLG_NX:
-			if (cloud->reserveTheNormsTable())
-			{
-				cloudDesc.xNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
-			}
+			cloudDesc.xNormIndex = i;
+			cloudDesc.hasNorms = true;
+			cloud->showNormals(true);
 			break;
 		case ASCII_OPEN_DLG_NY:
-			if (cloud->reserveTheNormsTable())
-			{
-				cloudDesc.yNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
-			}
+			cloudDesc.yNormIndex = i;
+			cloudDesc.hasNorms = true;
+			cloud->showNormals(true);
 			break;
 		case ASCII_OPEN_DLG_NZ:
-			if (cloud->reserveTheNormsTable())
-			{
-				cloudDesc.zNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
-			}
+			cloudDesc.zNormIndex = i;
+			cloudDesc.hasNorms = true;
+			cloud->showNormals(true);
 			break;
 		case ASCII_OPEN_DLG_Scalar:
 			{
@@ -643,6 +635,7 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 				{
 					cloudDesc.scalarIndexes.push_back(i);
 					cloudDesc.scalarFields.push_back(sf);
+					cloudDesc.scalarValues.emplace_back();
 				}
 				else
 				{
@@ -655,85 +648,43 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 		case ASCII_OPEN_DLG_Rf:
 			cloudDesc.hasFloatRGBColors[0] = true;
 		case ASCII_OPEN_DLG_R:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.redIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+			cloudDesc.redIndex = i;
+			cloudDesc.hasRGBColors = true;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_Gf:
 			cloudDesc.hasFloatRGBColors[1] = true;
 		case ASCII_OPEN_DLG_G:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.greenIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+			cloudDesc.greenIndex = i;
+			cloudDesc.hasRGBColors = true;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_Bf:
 			cloudDesc.hasFloatRGBColors[2] = true;
 		case ASCII_OPEN_DLG_B:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.blueIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+			cloudDesc.blueIndex = i;
+			cloudDesc.hasRGBColors = true;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_Af:
 			cloudDesc.hasFloatRGBColors[3] = true;
 		case ASCII_OPEN_DLG_A:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.alphaIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+			cloudDesc.alphaIndex = i;
+			cloudDesc.hasRGBColors = true;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_RGB32i:
 		case ASCII_OPEN_DLG_RGB32f:
-			if (cloud->reserveTheRGBTable())
-			{
-				if (openSequence[i].type == ASCII_OPEN_DLG_RGB32i)
-					cloudDesc.iRgbaIndex = i;
-				else
-					cloudDesc.fRgbaIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
+			if (openSequence[i].type == ASCII_OPEN_DLG_RGB32i)
+				cloudDesc.iRgbaIndex = i;
 			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+				cloudDesc.fRgbaIndex = i;
+			cloudDesc.hasRGBColors = true;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_Grey:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.greyIndex = i;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
+			cloudDesc.greyIndex = i;
+			cloud->showColors(true);
 			break;
 		case ASCII_OPEN_DLG_Label:
 			assert(cloudDesc.labelIndex < 0); //There Can Be Only One
@@ -753,6 +704,91 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 	return cloudDesc;
 }
 
+//! Transfers the points read so far (see cloudAttributesDescriptor) to the actual cloud
+/** The cloud arrays are allocated once, with the exact number of points.
+	\return false if there's not enough memory to store the points
+**/
+bool transferBuffers(cloudAttributesDescriptor& cloudDesc, bool showLabelsIn2D)
+{
+	ccPointCloud* cloud = cloudDesc.cloud;
+	assert(cloud && cloud->size() == 0);
+
+	//number of complete points (the attributes of the last point may be missing if the process was interrupted)
+	size_t pointCount = cloudDesc.points.size();
+	if (cloudDesc.hasNorms)
+		pointCount = std::min(pointCount, cloudDesc.normals.size());
+	if (cloudDesc.hasColors())
+		pointCount = std::min(pointCount, cloudDesc.colors.size());
+	for (const ccChunkedArray<ScalarType>& values : cloudDesc.scalarValues)
+		pointCount = std::min(pointCount, values.size());
+	unsigned n = static_cast<unsigned>(pointCount);
+
+	if (!cloud->reserveThePointsTable(n))
+	{
+		return false;
+	}
+	cloudDesc.points.moveTo(n, [cloud](const CCVector3& P) { cloud->addPoint(P); });
+
+	//Normal vectors
+	if (cloudDesc.hasNorms)
+	{
+		if (cloud->reserveTheNormsTable())
+		{
+			cloudDesc.normals.moveTo(n, [cloud](CompressedNormType index) { cloud->addNormIndex(index); });
+		}
+		else
+		{
+			ccLog::Warning("Failed to allocate memory for normals! (skipped)");
+			cloudDesc.normals.clear();
+			cloud->showNormals(false);
+		}
+	}
+
+	//Colors
+	if (cloudDesc.hasColors())
+	{
+		if (cloud->reserveTheRGBTable())
+		{
+			cloudDesc.colors.moveTo(n, [cloud](const ccColor::Rgba& col) { cloud->addColor(col); });
+		}
+		else
+		{
+			ccLog::Warning("Failed to allocate memory for colors! (skipped)");
+			cloudDesc.colors.clear();
+			cloud->showColors(false);
+		}
+	}
+
+	//Scalar fields
+	for (size_t j = 0; j < cloudDesc.scalarFields.size(); ++j)
+	{
+		CCCoreLib::ScalarField* sf = cloudDesc.scalarFields[j];
+		if (!sf->reserveSafe(n))
+		{
+			return false;
+		}
+		cloudDesc.scalarValues[j].moveTo(n, [sf](ScalarType D) { sf->emplace_back(D); });
+	}
+
+	//Labels
+	for (const std::pair<unsigned, QString>& labelDesc : cloudDesc.labels)
+	{
+		if (labelDesc.first < n)
+		{
+			cc2DLabel* label = new cc2DLabel();
+			label->addPickedPoint(cloud, labelDesc.first);
+			label->setName(labelDesc.second);
+			label->setDisplayedIn2D(showLabelsIn2D);
+			label->displayPointLegend(!showLabelsIn2D);
+			label->setVisible(true);
+			cloud->addChild(label);
+		}
+	}
+	cloudDesc.labels.clear();
+
+	return true;
+}
+
 CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filename,
 															ccHObject& container,
 															const AsciiOpenDlg::Sequence& openSequence,
@@ -773,7 +809,7 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 
 	//we initialize the loading accelerator structure and point cloud
 	int maxPartIndex = -1;
-	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, chunkRank);
+	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, maxPartIndex, chunkRank);
 
 	if (!cloudDesc.cloud)
 	{
@@ -874,21 +910,21 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 			{
 				ccLog::PrintDebug("[ASCII] We choose to enlarge existing clouds");
 
+				//(nothing to reallocate: the points are stored in chunks until the cloud is complete)
 				cloudChunkSize = std::min(maxCloudSize, approximateNumberOfLines - cloudChunkPos);
-				if (!cloudDesc.cloud->reserve(cloudChunkSize))
-				{
-					ccLog::Error("Not enough memory! Process stopped ...");
-					result = CC_FERR_NOT_ENOUGH_MEMORY;
-					break;
-				}
 			}
 			else //otherwise we have to create new clouds
 			{
 				ccLog::PrintDebug("[ASCII] We choose to instantiate new clouds");
 
-				//we store (and resize) actual cloud
-				if (!cloudDesc.cloud->resize(cloudChunkSize))
-					ccLog::Warning("Memory reallocation failed ... some memory may have been wasted ...");
+				//we store actual cloud
+				if (!transferBuffers(cloudDesc, showLabelsIn2D))
+				{
+					ccLog::Error("Not enough memory! Process stopped ...");
+					result = CC_FERR_NOT_ENOUGH_MEMORY;
+					clearStructure(cloudDesc);
+					break;
+				}
 				if (!cloudDesc.scalarFields.empty())
 				{
 					for (unsigned k = 0; k < cloudDesc.scalarFields.size(); ++k)
@@ -903,7 +939,7 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 				//and create new one
 				cloudChunkPos = pointsRead;
 				cloudChunkSize = std::min(maxCloudSize, approximateNumberOfLines - cloudChunkPos);
-				cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, ++chunkRank);
+				cloudDesc = prepareCloud(openSequence, maxPartIndex, ++chunkRank);
 				if (!cloudDesc.cloud)
 				{
 					ccLog::Error("Not enough memory! Process stopped ...");
@@ -983,94 +1019,97 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 				}
 			}
 
-			//add point
-			cloudDesc.cloud->addPoint(CCVector3::fromArray((P + Pshift).u));
-
-			//Normal vector
-			if (cloudDesc.hasNorms)
-			{
-				if (cloudDesc.xNormIndex >= 0)
-					N.x = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.xNormIndex]));
-				if (cloudDesc.yNormIndex >= 0)
-					N.y = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.yNormIndex]));
-				if (cloudDesc.zNormIndex >= 0)
-					N.z = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.zNormIndex]));
-				cloudDesc.cloud->addNorm(N);
-			}
-
-			//Colors
-			if (cloudDesc.hasRGBColors)
+			try
 			{
-				if (cloudDesc.iRgbaIndex >= 0)
-				{
-					const uint32_t rgba = parts[cloudDesc.iRgbaIndex].toInt();
-					col.a = ((rgba >> 24) & 0x0000ff);
-					col.r = ((rgba >> 16) & 0x0000ff);
-					col.g = ((rgba >>  8) & 0x0000ff);
-					col.b = ((rgba      ) & 0x0000ff);
+				//add point
+				cloudDesc.points.addElement(CCVector3::fromArray((P + Pshift).u));
 
-				}
-				else if (cloudDesc.fRgbaIndex >= 0)
+				//Normal vector
+				if (cloudDesc.hasNorms)
 				{
-					const float rgbaf = locale.toFloat(parts[cloudDesc.fRgbaIndex]);
-					const uint32_t rgba = *(reinterpret_cast<const uint32_t *>(&rgbaf));
-					col.a = ((rgba >> 24) & 0x0000ff);
-					col.r = ((rgba >> 16) & 0x0000ff);
-					col.g = ((rgba >>  8) & 0x0000ff);
-					col.b = ((rgba      ) & 0x0000ff);
+					if (cloudDesc.xNormIndex >= 0)
+						N.x = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.xNormIndex]));
+					if (cloudDesc.yNormIndex >= 0)
+						N.y = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.yNormIndex]));
+					if (cloudDesc.zNormIndex >= 0)
+						N.z = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.zNormIndex]));
+					cloudDesc.normals.addElement(ccNormalVectors::GetNormIndex(N));
 				}
-				else
+
+				//Colors
+				if (cloudDesc.hasRGBColors)
 				{
-					if (cloudDesc.redIndex >= 0)
+					if (cloudDesc.iRgbaIndex >= 0)
 					{
-						float multiplier = cloudDesc.hasFloatRGBColors[0] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.r = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.redIndex]) * multiplier);
+						const uint32_t rgba = parts[cloudDesc.iRgbaIndex].toInt();
+						col.a = ((rgba >> 24) & 0x0000ff);
+						col.r = ((rgba >> 16) & 0x0000ff);
+						col.g = ((rgba >>  8) & 0x0000ff);
+						col.b = ((rgba      ) & 0x0000ff);
+
 					}
-					if (cloudDesc.greenIndex >= 0)
+					else if (cloudDesc.fRgbaIndex >= 0)
 					{
-						float multiplier = cloudDesc.hasFloatRGBColors[1] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.g = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.greenIndex]) * multiplier);
+						const float rgbaf = locale.toFloat(parts[cloudDesc.fRgbaIndex]);
+						const uint32_t rgba = *(reinterpret_cast<const uint32_t *>(&rgbaf));
+						col.a = ((rgba >> 24) & 0x0000ff);
+						col.r = ((rgba >> 16) & 0x0000ff);
+						col.g = ((rgba >>  8) & 0x0000ff);
+						col.b = ((rgba      ) & 0x0000ff);
 					}
-					if (cloudDesc.blueIndex >= 0)
+					else
 					{
-						float multiplier = cloudDesc.hasFloatRGBColors[2] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.b = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.blueIndex]) * multiplier);
+						if (cloudDesc.redIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[0] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.r = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.redIndex]) * multiplier);
+						}
+						if (cloudDesc.greenIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[1] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.g = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.greenIndex]) * multiplier);
+						}
+						if (cloudDesc.blueIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[2] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.b = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.blueIndex]) * multiplier);
+						}
+						if (cloudDesc.alphaIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[3] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.a = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.alphaIndex]) * multiplier);
+						}
 					}
-					if (cloudDesc.alphaIndex >= 0)
+					cloudDesc.colors.addElement(col);
+				}
+				else if (cloudDesc.greyIndex >= 0)
+				{
+					col.r = col.g = col.b = static_cast<ColorCompType>(parts[cloudDesc.greyIndex].toInt());
+					col.a = ccColor::MAX;
+					cloudDesc.colors.addElement(col);
+				}
+
+				//Scalar distance
+				if (!cloudDesc.scalarIndexes.empty())
+				{
+					for (size_t j = 0; j < cloudDesc.scalarIndexes.size(); ++j)
 					{
-						float multiplier = cloudDesc.hasFloatRGBColors[3] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.a = static_cast<ColorCompType>(locale.toFloat(parts[cloudDesc.alphaIndex]) * multiplier);
+						D = static_cast<ScalarType>(locale.toDouble(parts[cloudDesc.scalarIndexes[j]]));
+						cloudDesc.scalarValues[j].addElement(D);
 					}
 				}
-				cloudDesc.cloud->addColor(col);
-			}
-			else if (cloudDesc.greyIndex >= 0)
-			{
-				col.r = col.g = col.b = static_cast<ColorCompType>(parts[cloudDesc.greyIndex].toInt());
-				col.a = ccColor::MAX;
-				cloudDesc.cloud->addColor(col);
-			}
 
-			//Scalar distance
-			if (!cloudDesc.scalarIndexes.empty())
-			{
-				for (size_t j = 0; j < cloudDesc.scalarIndexes.size(); ++j)
+				//Label (the labels are created once the points have been transferred to the cloud)
+				if (cloudDesc.labelIndex >= 0)
 				{
-					D = static_cast<ScalarType>(locale.toDouble(parts[cloudDesc.scalarIndexes[j]]));
-					cloudDesc.scalarFields[j]->emplace_back(D);
+					cloudDesc.labels.emplace_back(static_cast<unsigned>(cloudDesc.points.size() - 1), parts[cloudDesc.labelIndex]);
 				}
 			}
-
-			//Label
-			if (cloudDesc.labelIndex >= 0)
+			catch (const std::bad_alloc&)
 			{
-				cc2DLabel* label = new cc2DLabel();
-				label->addPickedPoint(cloudDesc.cloud, cloudDesc.cloud->size() - 1);
-				label->setName(parts[cloudDesc.labelIndex]);
-				label->setDisplayedIn2D(showLabelsIn2D);
-				label->displayPointLegend(!showLabelsIn2D);
-				label->setVisible(true);
-				cloudDesc.cloud->addChild(label);
+				ccLog::Error("Not enough memory! Process stopped ...");
+				result = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
 			}
 
 			++pointsRead;
@@ -1092,8 +1131,13 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 
 	if (cloudDesc.cloud)
 	{
-		if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
-			cloudDesc.cloud->resize(cloudDesc.cloud->size());
+		//we store actual cloud
+		if (!transferBuffers(cloudDesc, showLabelsIn2D))
+		{
+			ccLog::Error("Not enough memory!");
+			clearStructure(cloudDesc);
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
 
 		//add cloud to output
 		if (!cloudDesc.scalarFields.empty())
@@ -0,0 +1,36 @@
+#ifndef STLCOMMAND_H
+#define STLCOMMAND_H
+
+//##########################################################################
+//#                                                                        #
+//#                      CLOUDCOMPARE PLUGIN                               #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: CloudCompare project                               #
+//#                                                                        #
+//##########################################################################
+
+#include "ccCommandLineInterface.h"
+
+//! STL loading options (command line)
+/** -STL [-WELDING {NONE|HASH|OCTREE|AUTO}] [-WELDING_STEP {step}]
+**/
+class STLCommand : public ccCommandLineInterface::Command
+{
+public:
+	STLCommand();
+
+	~STLCommand() override = default;
+
+	bool process( ccCommandLineInterface& cmd ) override;
+};
+
+#endif
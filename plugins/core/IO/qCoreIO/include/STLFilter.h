@@ -23,6 +23,7 @@
 class ccGenericMesh;
 class ccMesh;
 class ccPointCloud;
+class STLVertexWelder;
 
 //! StereoLithography file I/O filter
 /** See http://www.ennex.com/~fabbers/StL.asp
@@ -31,6 +32,24 @@ class STLFilter : public FileIOFilter
 {
 public:
 	STLFilter();
+
+	//! Duplicate vertices removal (welding) modes
+	enum VertexWeldingMode
+	{
+		NO_WELDING,		/**< Vertices are kept as is (3 per facet) **/
+		HASH_WELDING,	/**< Exact (or quantized) welding based on a hash of the vertex coordinates, performed while the file is read **/
+		OCTREE_WELDING,	/**< Tolerance-based ('fuzzy') welding performed with an octree once the file is loaded **/
+		AUTO_WELDING	/**< OCTREE_WELDING for ASCII files (the shared vertices may be written with slightly different coordinates), HASH_WELDING for binary files (default) **/
+	};
+
+	//static accessors
+	static void SetVertexWeldingMode(VertexWeldingMode mode);
+	static VertexWeldingMode GetVertexWeldingMode();
+	//! Sets the quantization step used by the HASH_WELDING mode
+	/** Vertices falling in the same quantization cell are merged.
+		A zero (default) step means that only bit-identical vertices are merged.
+	**/
+	static void SetHashWeldingStep(double step);
 	
 	//inherited from FileIOFilter
 	CC_FILE_ERROR loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters) override;
@@ -47,13 +66,20 @@ private:
 	CC_FILE_ERROR loadASCIIFile(QFile& fp,
 								ccMesh* mesh,
 								ccPointCloud* vertices,
+								STLVertexWelder* welder,
 								LoadParameters& parameters);
 
 	//! Custom load method for binary files
 	CC_FILE_ERROR loadBinaryFile(QFile& fp,
 								ccMesh* mesh,
 								ccPointCloud* vertices,
+								STLVertexWelder* welder,
 								LoadParameters& parameters);
+
+	//! Removes the duplicated vertices with an octree (tolerance-based)
+	static void RemoveDuplicatedVerticesWithOctree(	ccMesh* mesh,
+													ccPointCloud*& vertices,
+													LoadParameters& parameters);
 };
 
 #endif //CC_STL_FILTER_HEADER
@@ -0,0 +1,104 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: CloudCompare project                               #
+//#                                                                        #
+//##########################################################################
+
+#include "STLCommand.h"
+#include "STLFilter.h"
+
+constexpr char COMMAND_STL[] = "STL";
+constexpr char COMMAND_STL_WELDING[] = "WELDING";
+constexpr char COMMAND_STL_WELDING_STEP[] = "WELDING_STEP";
+
+
+STLCommand::STLCommand() :
+	Command( "STL", COMMAND_STL )
+{
+}
+
+bool STLCommand::process( ccCommandLineInterface &cmd )
+{
+	cmd.print( "[STL]" );
+
+	while (!cmd.arguments().empty())
+	{
+		const QString& arg = cmd.arguments().front();
+
+		if (ccCommandLineInterface::IsCommand(arg, COMMAND_STL_WELDING))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: welding mode (NONE, HASH, OCTREE or AUTO) after '%1'").arg(COMMAND_STL_WELDING));
+			}
+
+			QString modeStr = cmd.arguments().takeFirst().toUpper();
+			STLFilter::VertexWeldingMode mode = STLFilter::AUTO_WELDING;
+			if (modeStr == "NONE")
+			{
+				mode = STLFilter::NO_WELDING;
+			}
+			else if (modeStr == "HASH")
+			{
+				mode = STLFilter::HASH_WELDING;
+			}
+			else if (modeStr == "OCTREE")
+			{
+				mode = STLFilter::OCTREE_WELDING;
+			}
+			else if (modeStr == "AUTO")
+			{
+				mode = STLFilter::AUTO_WELDING;
+			}
+			else
+			{
+				return cmd.error(QObject::tr("Invalid welding mode! ('%1')").arg(modeStr));
+			}
+
+			cmd.print(QObject::tr("Vertex welding mode: %1").arg(modeStr));
+
+			STLFilter::SetVertexWeldingMode(mode);
+		}
+		else if (ccCommandLineInterface::IsCommand(arg, COMMAND_STL_WELDING_STEP))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: quantization step after '%1'").arg(COMMAND_STL_WELDING_STEP));
+			}
+
+			bool ok = false;
+			double step = cmd.arguments().takeFirst().toDouble(&ok);
+			if (!ok || step < 0.0)
+			{
+				return cmd.error(QObject::tr("Invalid value for the quantization step! (%1)").arg(COMMAND_STL_WELDING_STEP));
+			}
+
+			cmd.print(QObject::tr("Vertex welding quantization step: %1 (hash welding)").arg(step));
+
+			STLFilter::SetHashWeldingStep(step);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return true;
+}
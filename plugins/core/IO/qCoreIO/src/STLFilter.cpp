@@ -26,6 +26,7 @@
 #include <QString>
 #include <QStringList>
 #include <QTextStream>
+#include <QtConcurrentRun>
 
 //qCC_db
 #include <ccHObjectCaster.h>
@@ -37,9 +38,148 @@
 #include <ccProgressDialog.h>
 
 //System
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <unordered_map>
 
 
+//! Default vertex welding mode
+static STLFilter::VertexWeldingMode s_weldingMode = STLFilter::AUTO_WELDING;
+//! Quantization step for the HASH_WELDING mode (0 = bit-identical vertices only)
+static double s_hashWeldingStep = 0.0;
+
+void STLFilter::SetVertexWeldingMode(VertexWeldingMode mode)
+{
+	s_weldingMode = mode;
+}
+
+STLFilter::VertexWeldingMode STLFilter::GetVertexWeldingMode()
+{
+	return s_weldingMode;
+}
+
+void STLFilter::SetHashWeldingStep(double step)
+{
+	s_hashWeldingStep = std::max(0.0, step);
+}
+
+//! Merges the vertices sharing the same (quantized) coordinates as they are inserted
+/** STL files store 3 vertices per facet. In practice, the shared vertices
+	are written with the very same coordinates, so that a simple hash
+	on the coordinates is enough to weld them back together.
+**/
+class STLVertexWelder
+{
+public:
+	//! Default constructor
+	/** \param vertices destination cloud
+		\param step quantization step (0 = bit-identical vertices only)
+	**/
+	STLVertexWelder(ccPointCloud* vertices, double step)
+		: m_vertices(vertices)
+		, m_step(step)
+	{
+		assert(m_vertices);
+	}
+
+	//! Inserts a new vertex (or retrieves the index of the equivalent one)
+	/** \return false if not enough memory
+	**/
+	bool insert(const CCVector3& P, unsigned& index)
+	{
+		Key key = toKey(P);
+
+		try
+		{
+			auto it = m_indexes.find(key);
+			if (it != m_indexes.end())
+			{
+				index = it->second;
+				return true;
+			}
+
+			index = m_vertices->size();
+			if (m_vertices->capacity() == index)
+			{
+				//we don't know the final number of vertices: grow geometrically
+				if (!m_vertices->reserve(std::max(1024u, 2 * index)))
+				{
+					return false;
+				}
+			}
+			m_vertices->addPoint(P);
+
+			m_indexes.emplace(key, index);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+protected:
+
+	//! Hash key
+	struct Key
+	{
+		int64_t x, y, z;
+
+		inline bool operator == (const Key& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	//! Hash function
+	struct KeyHash
+	{
+		inline size_t operator()(const Key& k) const
+		{
+			uint64_t h = static_cast<uint64_t>(k.x) * 0x9E3779B97F4A7C15ULL
+					^	static_cast<uint64_t>(k.y) * 0xC2B2AE3D27D4EB4FULL
+					^	static_cast<uint64_t>(k.z) * 0x165667B19E3779F9ULL;
+			h ^= (h >> 29);
+			return static_cast<size_t>(h);
+		}
+	};
+
+	//! Converts a vertex to its hash key
+	inline Key toKey(const CCVector3& P) const
+	{
+		Key key;
+		if (m_step > 0)
+		{
+			key.x = static_cast<int64_t>(std::floor(P.x / m_step + 0.5));
+			key.y = static_cast<int64_t>(std::floor(P.y / m_step + 0.5));
+			key.z = static_cast<int64_t>(std::floor(P.z / m_step + 0.5));
+		}
+		else
+		{
+			//bit-identical coordinates (we only take care of the -0/+0 case)
+			key.x = ExactKey(P.x);
+			key.y = ExactKey(P.y);
+			key.z = ExactKey(P.z);
+		}
+		return key;
+	}
+
+	static inline int64_t ExactKey(PointCoordinateType c)
+	{
+		double d = (c == 0 ? 0.0 : static_cast<double>(c));
+		int64_t bits = 0;
+		memcpy(&bits, &d, sizeof(double));
+		return bits;
+	}
+
+	//! Destination cloud
+	ccPointCloud* m_vertices;
+	//! Quantization step
+	double m_step;
+	//! Vertex indexes
+	std::unordered_map<Key, unsigned, KeyHash> m_indexes;
+};
+
 STLFilter::STLFilter()
 	: FileIOFilter( {
 					"_STL Filter",
@@ -287,36 +427,19 @@ static bool TagDuplicatedVertices(	const CCCoreLib::DgmOctree::octreeCell& cell,
 
 	//we look for points very near to the others (only if not yet tagged!)
 
-	//structure for nearest neighbors search
-	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.prepare(c_defaultSearchRadius, cell.parentOctree->getCellSize(nNSS.level));
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-	//*/
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//we already know some of the neighbours: the points in the current cell!
+	//structure for nearest neighbors search (we already know some of the neighbours: the points in the current cell!)
+	ccOctree::QueryContext* context = nullptr;
 	try
 	{
-		nNSS.pointsInNeighbourhood.resize(n);
+		context = &ccOctree::PrepareCellQuery(cell, nullptr, c_defaultSearchRadius);
 	}
-	catch (.../*const std::bad_alloc&*/) //out of memory
+	catch (const std::bad_alloc&) //out of memory
 	{
 		return false;
 	}
+	CCCoreLib::DgmOctree::NearestNeighboursSphericalSearchStruct& nNSS = context->nNSS;
 
-	//init structure with cell points
-	{
-		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-		for (unsigned i = 0; i < n; ++i, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
-		}
-		nNSS.alreadyVisitedNeighbourhoodSize = 1;
-	}
+	unsigned n = cell.points->size(); //number of points in the current cell
 
 	//for each point in the cell
 	for (unsigned i = 0; i < n; ++i)
@@ -328,7 +451,7 @@ static bool TagDuplicatedVertices(	const CCCoreLib::DgmOctree::octreeCell& cell,
 
 			//look for neighbors in a (very small) sphere
 			//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (k)!
-			unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, c_defaultSearchRadius, false);
+			unsigned k = context->findNeighborsInASphere(c_defaultSearchRadius);
 
 			//if there are some very close points
 			if (k > 1)
@@ -355,6 +478,135 @@ static bool TagDuplicatedVertices(	const CCCoreLib::DgmOctree::octreeCell& cell,
 	return true;
 }
 
+void STLFilter::RemoveDuplicatedVerticesWithOctree(	ccMesh* mesh,
+													ccPointCloud*& vertices,
+													LoadParameters& parameters)
+{
+	assert(mesh && vertices);
+	unsigned vertCount = vertices->size();
+	unsigned faceCount = mesh->size();
+
+	try
+	{
+		std::vector<int> equivalentIndexes;
+		const int razValue = -1;
+		equivalentIndexes.resize(vertCount, razValue);
+		
+		QScopedPointer<ccProgressDialog> pDlg(nullptr);
+		if (parameters.parentWidget)
+		{
+			pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
+		}
+		ccOctree::Shared octree = ccOctree::Shared(new ccOctree(vertices));
+		if (!octree->build(pDlg.data()))
+		{
+			octree.clear();
+		}
+		if (octree)
+		{
+			void* additionalParameters[] = { static_cast<void*>(&equivalentIndexes) };
+			unsigned result = octree->executeFunctionForAllCellsAtLevel(10,
+																		TagDuplicatedVertices,
+																		additionalParameters,
+																		false,
+																		pDlg.data(),
+																		"Tag duplicated vertices");
+			ccOctree::ReleaseQueryContexts();
+
+			octree.clear();
+
+			if (result != 0)
+			{
+				unsigned remainingCount = 0;
+				for (unsigned i = 0; i < vertCount; ++i)
+				{
+					int eqIndex = equivalentIndexes[i];
+					assert(eqIndex >= 0);
+					if (eqIndex == static_cast<int>(i)) //root point
+					{
+						int newIndex = static_cast<int>(vertCount + remainingCount); //We replace the root index by its 'new' index (+ vertCount, to differentiate it later)
+						equivalentIndexes[i] = newIndex;
+						++remainingCount;
+					}
+				}
+
+				ccPointCloud* newVertices = new ccPointCloud("vertices");
+				if (newVertices->reserve(remainingCount))
+				{
+					//copy root points in a new cloud
+					{
+						for (unsigned i = 0; i < vertCount; ++i)
+						{
+							int eqIndex = equivalentIndexes[i];
+							if (eqIndex >= static_cast<int>(vertCount)) //root point
+								newVertices->addPoint(*vertices->getPoint(i));
+							else
+								equivalentIndexes[i] = equivalentIndexes[eqIndex]; //and update the other indexes
+						}
+					}
+
+					//update face indexes
+					{
+						unsigned newFaceCount = 0;
+						for (unsigned i = 0; i < faceCount; ++i)
+						{
+							CCCoreLib::VerticesIndexes* tri = mesh->getTriangleVertIndexes(i);
+							tri->i1 = static_cast<unsigned>(equivalentIndexes[tri->i1]) - vertCount;
+							tri->i2 = static_cast<unsigned>(equivalentIndexes[tri->i2]) - vertCount;
+							tri->i3 = static_cast<unsigned>(equivalentIndexes[tri->i3]) - vertCount;
+
+							//very small triangles (or flat ones) may be implicitly removed by vertex fusion!
+							if (tri->i1 != tri->i2 && tri->i1 != tri->i3 && tri->i2 != tri->i3)
+							{
+								if (newFaceCount != i)
+									mesh->swapTriangles(i, newFaceCount);
+								++newFaceCount;
+							}
+						}
+
+						if (newFaceCount == 0)
+						{
+							ccLog::Warning("[STL] After vertex fusion, all triangles would collapse! We'll keep the non-fused version...");
+							delete newVertices;
+							newVertices = nullptr;
+						}
+						else
+						{
+							mesh->resize(newFaceCount);
+						}
+					}
+
+					if (newVertices)
+					{
+						mesh->setAssociatedCloud(newVertices);
+						delete vertices;
+						vertices = newVertices;
+						vertCount = vertices->size();
+						ccLog::Print("[STL] Remaining vertices after auto-removal of duplicate ones: %i", vertCount);
+						ccLog::Print("[STL] Remaining faces after auto-removal of duplicate ones: %i", mesh->size());
+					}
+				}
+				else
+				{
+					ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
+				}
+			}
+			else
+			{
+				ccLog::Warning("[STL] Duplicated vertices removal algorithm failed?!");
+			}
+		}
+		else
+		{
+			ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
+	}
+}
+
 CC_FILE_ERROR STLFilter::loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters)
 {
 	ccLog::Print(QString("[STL] Loading '%1'").arg(filename));
@@ -412,11 +664,26 @@ CC_FILE_ERROR STLFilter::loadFile(const QString& filename, ccHObject& container,
 	//add normals
 	mesh->setTriNormsTable(new NormsIndexesTableType());
 
+	//the vertices written in ASCII files may have slightly different coordinates
+	VertexWeldingMode weldingMode = s_weldingMode;
+	if (weldingMode == AUTO_WELDING)
+	{
+		weldingMode = (ascii ? OCTREE_WELDING : HASH_WELDING);
+	}
+
+	//vertices welding (on the fly)
+	QScopedPointer<STLVertexWelder> welder(nullptr);
+	if (weldingMode == HASH_WELDING)
+	{
+		welder.reset(new STLVertexWelder(vertices, s_hashWeldingStep));
+	}
+
 	CC_FILE_ERROR error = CC_FERR_NO_ERROR;
 	if (ascii)
-		error = loadASCIIFile(fp, mesh, vertices, parameters);
+		error = loadASCIIFile(fp, mesh, vertices, welder.data(), parameters);
 	else
-		error = loadBinaryFile(fp, mesh, vertices, parameters);
+		error = loadBinaryFile(fp, mesh, vertices, welder.data(), parameters);
+	welder.reset();
 
 	if (error != CC_FERR_NO_ERROR)
 	{
@@ -439,126 +706,13 @@ CC_FILE_ERROR STLFilter::loadFile(const QString& filename, ccHObject& container,
 	}
 
 	//remove duplicated vertices
-	//if (false)
+	if (weldingMode == OCTREE_WELDING)
 	{
-		try
-		{
-			std::vector<int> equivalentIndexes;
-			const int razValue = -1;
-			equivalentIndexes.resize(vertCount, razValue);
-			
-			QScopedPointer<ccProgressDialog> pDlg(nullptr);
-			if (parameters.parentWidget)
-			{
-				pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
-			}
-			ccOctree::Shared octree = ccOctree::Shared(new ccOctree(vertices));
-			if (!octree->build(pDlg.data()))
-			{
-				octree.clear();
-			}
-			if (octree)
-			{
-				void* additionalParameters[] = { static_cast<void*>(&equivalentIndexes) };
-				unsigned result = octree->executeFunctionForAllCellsAtLevel(10,
-																			TagDuplicatedVertices,
-																			additionalParameters,
-																			false,
-																			pDlg.data(),
-																			"Tag duplicated vertices");
-
-				octree.clear();
-
-				if (result != 0)
-				{
-					unsigned remainingCount = 0;
-					for (unsigned i = 0; i < vertCount; ++i)
-					{
-						int eqIndex = equivalentIndexes[i];
-						assert(eqIndex >= 0);
-						if (eqIndex == static_cast<int>(i)) //root point
-						{
-							int newIndex = static_cast<int>(vertCount + remainingCount); //We replace the root index by its 'new' index (+ vertCount, to differentiate it later)
-							equivalentIndexes[i] = newIndex;
-							++remainingCount;
-						}
-					}
-
-					ccPointCloud* newVertices = new ccPointCloud("vertices");
-					if (newVertices->reserve(remainingCount))
-					{
-						//copy root points in a new cloud
-						{
-							for (unsigned i = 0; i < vertCount; ++i)
-							{
-								int eqIndex = equivalentIndexes[i];
-								if (eqIndex >= static_cast<int>(vertCount)) //root point
-									newVertices->addPoint(*vertices->getPoint(i));
-								else
-									equivalentIndexes[i] = equivalentIndexes[eqIndex]; //and update the other indexes
-							}
-						}
-
-						//update face indexes
-						{
-							unsigned newFaceCount = 0;
-							for (unsigned i = 0; i < faceCount; ++i)
-							{
-								CCCoreLib::VerticesIndexes* tri = mesh->getTriangleVertIndexes(i);
-								tri->i1 = static_cast<unsigned>(equivalentIndexes[tri->i1]) - vertCount;
-								tri->i2 = static_cast<unsigned>(equivalentIndexes[tri->i2]) - vertCount;
-								tri->i3 = static_cast<unsigned>(equivalentIndexes[tri->i3]) - vertCount;
-
-								//very small triangles (or flat ones) may be implicitly removed by vertex fusion!
-								if (tri->i1 != tri->i2 && tri->i1 != tri->i3 && tri->i2 != tri->i3)
-								{
-									if (newFaceCount != i)
-										mesh->swapTriangles(i, newFaceCount);
-									++newFaceCount;
-								}
-							}
-
-							if (newFaceCount == 0)
-							{
-								ccLog::Warning("[STL] After vertex fusion, all triangles would collapse! We'll keep the non-fused version...");
-								delete newVertices;
-								newVertices = nullptr;
-							}
-							else
-							{
-								mesh->resize(newFaceCount);
-							}
-						}
-
-						if (newVertices)
-						{
-							mesh->setAssociatedCloud(newVertices);
-							delete vertices;
-							vertices = newVertices;
-							vertCount = vertices->size();
-							ccLog::Print("[STL] Remaining vertices after auto-removal of duplicate ones: %i", vertCount);
-							ccLog::Print("[STL] Remaining faces after auto-removal of duplicate ones: %i", mesh->size());
-						}
-					}
-					else
-					{
-						ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
-					}
-				}
-				else
-				{
-					ccLog::Warning("[STL] Duplicated vertices removal algorithm failed?!");
-				}
-			}
-			else
-			{
-				ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
-			}
-		}
-		catch (const std::bad_alloc&)
-		{
-			ccLog::Warning("[STL] Not enough memory: couldn't removed duplicated vertices!");
-		}
+		RemoveDuplicatedVerticesWithOctree(mesh, vertices, parameters);
+	}
+	else if (weldingMode == HASH_WELDING)
+	{
+		ccLog::Print("[STL] Duplicated vertices have been merged while loading the file");
 	}
 
 	NormsIndexesTableType* normals = mesh->getTriNormsTable();
@@ -590,6 +744,7 @@ CC_FILE_ERROR STLFilter::loadFile(const QString& filename, ccHObject& container,
 CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 	ccMesh* mesh,
 	ccPointCloud* vertices,
+	STLVertexWelder* welder,
 	LoadParameters& parameters)
 {
 	assert(fp.isOpen() && mesh && vertices);
@@ -637,6 +792,7 @@ CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 
 	unsigned pointCount = 0;
 	unsigned faceCount = 0;
+	unsigned degenerateCount = 0;
 	bool normalWarningAlreadyDisplayed = false;
 	NormsIndexesTableType* normals = mesh->getTriNormsTable();
 
@@ -780,44 +936,38 @@ CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 			CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
 
 			//look for existing vertices at the same place! (STL format is so dumb...)
+			if (welder)
 			{
-				//int equivalentIndex = -1;
-				//if (pointCount>2)
-				//{
-				//	//brute force!
-				//	for (int j=(int)pointCountBefore-1; j>=0; j--)
-				//	{
-				//		const CCVector3* Pj = vertices->getPoint(j);
-				//		if (Pj->x == P.x &&
-				//			Pj->y == P.y &&
-				//			Pj->z == P.z)
-				//		{
-				//			equivalentIndex = j;
-				//			break;
-				//		}
-				//	}
-				//}
-
-				////new point ?
-				//if (equivalentIndex < 0)
-				{
-					//cloud is already full?
-					if (vertices->capacity() == pointCount && !vertices->reserve(pointCount + 1000))
-						return CC_FERR_NOT_ENOUGH_MEMORY;
+				if (!welder->insert(P, vertIndexes[i]))
+					return CC_FERR_NOT_ENOUGH_MEMORY;
+				++pointCount;
+			}
+			else
+			{
+				//cloud is already full?
+				if (vertices->capacity() == pointCount && !vertices->reserve(pointCount + 1000))
+					return CC_FERR_NOT_ENOUGH_MEMORY;
 
-					//insert new point
-					vertIndexes[i] = pointCount++;
-					vertices->addPoint(P);
-				}
-				//else
-				//{
-				//	vertIndexes[i] = (unsigned)equivalentIndex;
-				//}
+				//insert new point
+				vertIndexes[i] = pointCount++;
+				vertices->addPoint(P);
 			}
 		}
+		if (result != CC_FERR_NO_ERROR)
+		{
+			break;
+		}
+
+		//very small triangles may collapse after vertex welding
+		bool degenerate = (vertIndexes[0] == vertIndexes[1] || vertIndexes[1] == vertIndexes[2] || vertIndexes[2] == vertIndexes[0]);
+		if (degenerate)
+		{
+			++degenerateCount;
+		}
 
 		//we have successfully read the 3 vertices
 		//let's add a new triangle
+		if (!degenerate)
 		{
 			//mesh is full?
 			if (mesh->capacity() == faceCount)
@@ -852,7 +1002,7 @@ CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 		}
 
 		//and a new normal?
-		if (normals)
+		if (normals && !degenerate)
 		{
 			int index = -1;
 			if (normalIsOk)
@@ -907,6 +1057,11 @@ CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 		ccLog::Warning("[STL] Failed to read some 'normal' values!");
 	}
 
+	if (degenerateCount != 0)
+	{
+		ccLog::Warning("[STL] %i degenerate facet(s) ignored", degenerateCount);
+	}
+
 	if (pDlg)
 	{
 		pDlg->close();
@@ -915,14 +1070,88 @@ CC_FILE_ERROR STLFilter::loadASCIIFile(QFile& fp,
 	return result;
 }
 
+//! Size of a facet record in a binary STL file
+static const unsigned c_binaryFacetSize = 50;
+
+//! Decodes a block of binary facets
+static CC_FILE_ERROR ProcessBinaryFacets(	const char* data,
+											unsigned facetCount,
+											const CCVector3d& Pshift,
+											ccMesh* mesh,
+											ccPointCloud* vertices,
+											NormsIndexesTableType* normals,
+											STLVertexWelder* welder,
+											unsigned& degenerateCount)
+{
+	assert(sizeof(float) == 4);
+
+	for (unsigned f = 0; f < facetCount; ++f, data += c_binaryFacetSize)
+	{
+		//REAL32[3] Normal vector
+		float Nf[3];
+		memcpy(Nf, data, 12);
+		CCVector3 N(Nf[0], Nf[1], Nf[2]);
+
+		//3 vertices
+		unsigned vertIndexes[3];
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			//REAL32[3] Vertex 1,2 & 3
+			float Pf[3];
+			memcpy(Pf, data + 12 * (i + 1), 12);
+
+			CCVector3d Pd(Pf[0], Pf[1], Pf[2]);
+			CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
+
+			//look for existing vertices at the same place! (STL format is so dumb...)
+			if (welder)
+			{
+				if (!welder->insert(P, vertIndexes[i]))
+					return CC_FERR_NOT_ENOUGH_MEMORY;
+			}
+			else
+			{
+				//insert new point (the cloud has already been reserved)
+				vertIndexes[i] = vertices->size();
+				vertices->addPoint(P);
+			}
+		}
+
+		//UINT16 Attribute byte count (not used)
+
+		//very small triangles may collapse after vertex welding
+		if (vertIndexes[0] == vertIndexes[1] || vertIndexes[1] == vertIndexes[2] || vertIndexes[2] == vertIndexes[0])
+		{
+			++degenerateCount;
+			continue;
+		}
+
+		//we have successfully read the 3 vertices
+		//let's add a new triangle
+		mesh->addTriangle(vertIndexes[0], vertIndexes[1], vertIndexes[2]);
+
+		//and a new normal?
+		if (normals)
+		{
+			//compress normal
+			int index = static_cast<int>(normals->currentSize());
+			CompressedNormType nIndex = ccNormalVectors::GetNormIndex(N.u);
+			normals->addElement(nIndex);
+			mesh->addTriangleNormalIndexes(index, index, index);
+		}
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
 CC_FILE_ERROR STLFilter::loadBinaryFile(QFile& fp,
 	ccMesh* mesh,
 	ccPointCloud* vertices,
+	STLVertexWelder* welder,
 	LoadParameters& parameters)
 {
 	assert(fp.isOpen() && mesh && vertices);
 
-	unsigned pointCount = 0;
 	unsigned faceCount = 0;
 
 	//UINT8[80] Header (we skip it)
@@ -945,6 +1174,12 @@ CC_FILE_ERROR STLFilter::loadBinaryFile(QFile& fp,
 		ccLog::Warning("[STL] Not enough memory: can't store normals!");
 		mesh->removePerTriangleNormalIndexes();
 		mesh->setTriNormsTable(nullptr);
+		normals = nullptr;
+	}
+	//without welding, we know the exact number of vertices
+	if (!welder && !vertices->reserve(3 * faceCount))
+	{
+		return CC_FERR_NOT_ENOUGH_MEMORY;
 	}
 
 	//progress dialog
@@ -962,105 +1197,78 @@ CC_FILE_ERROR STLFilter::loadBinaryFile(QFile& fp,
 	//current vertex shift
 	CCVector3d Pshift(0, 0, 0);
 
-	for (unsigned f = 0; f < faceCount; ++f)
+	//The file is read by blocks of facets. Each block is decoded (and its
+	//vertices welded) in a background thread while the next one is read.
+	static const unsigned c_blockFacetCount = 65536;
+	QByteArray buffers[2];
+	QFuture<CC_FILE_ERROR> processing;
+	bool processingStarted = false;
+	unsigned degenerateCount = 0;
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	unsigned blockIndex = 0;
+	for (unsigned firstFacet = 0; firstFacet < faceCount; firstFacet += c_blockFacetCount, ++blockIndex)
 	{
-		//REAL32[3] Normal vector
-		assert(sizeof(float) == 4);
-		CCVector3 N;
-		if (fp.read((char*)N.u, 12) < 12)
-			return CC_FERR_READING;
+		unsigned blockFacetCount = std::min(c_blockFacetCount, faceCount - firstFacet);
+		QByteArray& buffer = buffers[blockIndex & 1];
+		qint64 blockSize = static_cast<qint64>(blockFacetCount) * c_binaryFacetSize;
+		buffer = fp.read(blockSize);
+		if (buffer.size() < blockSize)
+		{
+			result = CC_FERR_READING;
+			break;
+		}
 
-		//3 vertices
-		unsigned vertIndexes[3];
-		//		unsigned pointCountBefore=pointCount;
-		for (unsigned i = 0; i < 3; ++i)
+		//first point: check for 'big' coordinates
+		//(must be done by this thread as it may display a dialog)
+		if (firstFacet == 0)
 		{
-			//REAL32[3] Vertex 1,2 & 3
 			float Pf[3];
-			if (fp.read((char*)Pf, 12) < 0)
-				return CC_FERR_READING;
-
-			//first point: check for 'big' coordinates
+			memcpy(Pf, buffer.constData() + 12, 12);
 			CCVector3d Pd(Pf[0], Pf[1], Pf[2]);
-			if (pointCount == 0)
-			{
-				bool preserveCoordinateShift = true;
-				if (HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, parameters))
-				{
-					if (preserveCoordinateShift)
-					{
-						vertices->setGlobalShift(Pshift);
-					}
-					ccLog::Warning("[STLFilter::loadFile] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
-				}
-			}
-
-			CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
-
-			//look for existing vertices at the same place! (STL format is so dumb...)
+			bool preserveCoordinateShift = true;
+			if (HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, parameters))
 			{
-				//int equivalentIndex = -1;
-				//if (pointCount>2)
-				//{
-				//	//brute force!
-				//	for (int j=static_cast<int>(pointCountBefore)-1; j>=0; j--)
-				//	{
-				//		const CCVector3* Pj = vertices->getPoint(j);
-				//		if (Pj->x == P.x &&
-				//			Pj->y == P.y &&
-				//			Pj->z == P.z)
-				//		{
-				//			equivalentIndex = j;
-				//			break;
-				//		}
-				//	}
-				//}
-
-				////new point ?
-				//if (equivalentIndex < 0)
+				if (preserveCoordinateShift)
 				{
-					//cloud is already full?
-					if (vertices->capacity() == pointCount && !vertices->reserve(pointCount + 1000))
-						return CC_FERR_NOT_ENOUGH_MEMORY;
-
-					//insert new point
-					vertIndexes[i] = pointCount++;
-					vertices->addPoint(P);
+					vertices->setGlobalShift(Pshift);
 				}
-				//else
-				//{
-				//	vertIndexes[i] = static_cast<unsigned>(equivalentIndex);
-				//}
+				ccLog::Warning("[STLFilter::loadFile] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
 			}
 		}
 
-		//UINT16 Attribute byte count (not used)
+		//wait for the previous block to be processed
+		if (processingStarted)
 		{
-			char a[2];
-			if (fp.read(a, 2) < 0)
-				return CC_FERR_READING;
+			processing.waitForFinished();
+			result = processing.result();
+			processingStarted = false;
+			if (result != CC_FERR_NO_ERROR)
+			{
+				break;
+			}
 		}
 
-		//we have successfully read the 3 vertices
-		//let's add a new triangle
+		//progress
+		if (pDlg && !nProgress.steps(blockFacetCount))
 		{
-			mesh->addTriangle(vertIndexes[0], vertIndexes[1], vertIndexes[2]);
+			break;
 		}
 
-		//and a new normal?
-		if (normals)
+		const char* data = buffer.constData();
+		processing = QtConcurrent::run([=, &degenerateCount]()
 		{
-			//compress normal
-			int index = static_cast<int>(normals->currentSize());
-			CompressedNormType nIndex = ccNormalVectors::GetNormIndex(N.u);
-			normals->addElement(nIndex);
-			mesh->addTriangleNormalIndexes(index, index, index);
-		}
+			return ProcessBinaryFacets(data, blockFacetCount, Pshift, mesh, vertices, normals, welder, degenerateCount);
+		});
+		processingStarted = true;
+	}
 
-		//progress
-		if (pDlg && !nProgress.oneStep())
+	if (processingStarted)
+	{
+		processing.waitForFinished();
+		if (result == CC_FERR_NO_ERROR)
 		{
-			break;
+			result = processing.result();
 		}
 	}
 
@@ -1069,5 +1277,10 @@ CC_FILE_ERROR STLFilter::loadBinaryFile(QFile& fp,
 		pDlg->stop();
 	}
 
-	return CC_FERR_NO_ERROR;
+	if (degenerateCount != 0)
+	{
+		ccLog::Warning("[STL] %i degenerate facet(s) ignored", degenerateCount);
+	}
+
+	return result;
 }
@@ -25,6 +25,7 @@
 #include "PDMSFilter.h"
 #include "PTXFilter.h"
 #include "SimpleBinFilter.h"
+#include "STLCommand.h"
 #include "STLFilter.h"
 #include "VTKFilter.h"
 
@@ -37,7 +38,7 @@ qCoreIO::qCoreIO( QObject *parent ) :
 
 void qCoreIO::registerCommands( ccCommandLineInterface *inCmdLine )
 {
-	Q_UNUSED( inCmdLine );
+	inCmdLine->registerCommand( ccCommandLineInterface::Command::Shared( new STLCommand ) );
 }
 
 ccIOPluginInterface::FilterList qCoreIO::getFilters()
@@ -26,6 +26,10 @@ class E57Filter : public FileIOFilter
 {
 public:
 	E57Filter();
+
+	//static accessors
+	//! Sets whether the scans should be decoded in parallel (one E57 file handle per thread)
+	static void SetParallelScanLoading(bool state);
 	
 	//inherited from FileIOFilter
 	CC_FILE_ERROR loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters) override;
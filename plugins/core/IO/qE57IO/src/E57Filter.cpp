@@ -36,10 +36,15 @@
 //Qt
 #include <QApplication>
 #include <QBuffer>
+#include <QMutex>
+#include <QThread>
 #include <QUuid>
+#include <QtConcurrentRun>
 
 //system
+#include <atomic>
 #include <cassert>
+#include <exception>
 #include <string>
 
 using colorFieldType = double;
@@ -50,7 +55,10 @@ namespace  {
 	constexpr char s_e57PoseKey[] = "E57_pose";
 	
 	unsigned s_absoluteScanIndex = 0;
-	bool s_cancelRequestedByUser = false;
+	std::atomic<bool> s_cancelRequestedByUser(false);
+
+	//whether scans should be decoded in parallel
+	bool s_parallelScanLoading = true;
 	
 	unsigned s_absoluteImageIndex = 0;
 	
@@ -87,6 +95,27 @@ namespace  {
 		std::vector<colorFieldType> blueData;
 	};
 	
+	//Per-scan loading state
+	struct ScanLoadingState
+	{
+		//! Scan GUID
+		QString guidStr;
+		//! Scan pose (possibly shifted)
+		ccGLMatrixd poseMat;
+		//! Whether the scan pose is valid
+		bool validPoseMat = false;
+		//! Shift applied to the points
+		CCVector3d pointShift = CCVector3d(0, 0, 0);
+		//! Global shift to be set on the cloud
+		CCVector3d globalShift = CCVector3d(0, 0, 0);
+		//! Whether a global shift should be set on the cloud
+		bool hasGlobalShift = false;
+		//! Intensity range
+		ScalarType minIntensity = 0;
+		ScalarType maxIntensity = 0;
+		bool hasIntensityRange = false;
+	};
+
 	inline QString GetNewGuid()
 	{
 		return QUuid::createUuid().toString();
@@ -107,6 +136,11 @@ E57Filter::E57Filter()
 {
 }
 
+void E57Filter::SetParallelScanLoading(bool state)
+{
+	s_parallelScanLoading = state;
+}
+
 bool E57Filter::canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) const
 {
 	if (type == CC_TYPES::POINT_CLOUD)
@@ -146,6 +180,68 @@ static void SavePoseInformation(e57::StructureNode& parentNode, const e57::Image
 	}
 }
 
+//! Prepares the buffers to write a chunk of points
+static void CreateWriteBuffers(	e57::ImageFile& imf,
+								unsigned chunkSize,
+								bool hasNormals,
+								bool hasReturnIndex,
+								bool hasIntensity,
+								bool hasInvalidIntensities,
+								bool hasColors,
+								TempArrays& arrays,
+								std::vector<e57::SourceDestBuffer>& dbufs)
+{
+	//Cartesian field
+	arrays.xData.resize(chunkSize);
+	dbufs.emplace_back( imf, "cartesianX",  arrays.xData.data(),  chunkSize, true, true );
+	arrays.yData.resize(chunkSize);
+	dbufs.emplace_back( imf, "cartesianY",  arrays.yData.data(),  chunkSize, true, true );
+	arrays.zData.resize(chunkSize);
+	dbufs.emplace_back( imf, "cartesianZ",  arrays.zData.data(),  chunkSize, true, true );
+
+	//Normals
+	if (hasNormals)
+	{
+		arrays.xNormData.resize(chunkSize);
+		dbufs.emplace_back( imf, "nor:normalX",  arrays.xNormData.data(),  chunkSize, true, true );
+		arrays.yNormData.resize(chunkSize);
+		dbufs.emplace_back( imf, "nor:normalY",  arrays.yNormData.data(),  chunkSize, true, true );
+		arrays.zNormData.resize(chunkSize);
+		dbufs.emplace_back( imf, "nor:normalZ",  arrays.zNormData.data(),  chunkSize, true, true );
+	}
+
+	//Return index
+	if (hasReturnIndex)
+	{
+		arrays.scanIndexData.resize(chunkSize);
+		dbufs.emplace_back( imf, "returnIndex",  arrays.scanIndexData.data(),  chunkSize, true, true );
+	}
+
+	//Intensity field
+	if (hasIntensity)
+	{
+		arrays.intData.resize(chunkSize);
+		dbufs.emplace_back( imf, "intensity",  arrays.intData.data(),  chunkSize, true, true );
+
+		if (hasInvalidIntensities)
+		{
+			arrays.isInvalidIntData.resize(chunkSize);
+			dbufs.emplace_back( imf, "isIntensityInvalid",  arrays.isInvalidIntData.data(),  chunkSize, true, true );
+		}
+	}
+
+	//Color fields
+	if (hasColors)
+	{
+		arrays.redData.resize(chunkSize);
+		dbufs.emplace_back( imf, "colorRed",  arrays.redData.data(),  chunkSize, true, true );
+		arrays.greenData.resize(chunkSize);
+		dbufs.emplace_back( imf, "colorGreen",  arrays.greenData.data(),  chunkSize, true, true );
+		arrays.blueData.resize(chunkSize);
+		dbufs.emplace_back( imf, "colorBlue",  arrays.blueData.data(),  chunkSize, true, true );
+	}
+}
+
 static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::ImageFile& imf, e57::VectorNode& data3D, QString& guidStr, ccProgressDialog* progressDlg = nullptr)
 {
 	assert(cloud);
@@ -396,9 +492,7 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 	e57::StructureNode proto = e57::StructureNode(imf);
 
 	//prepare temporary structures
-	const unsigned chunkSize = std::min<unsigned>(pointCount,(1 << 20)); //we save the file in several steps to limit the memory consumption
-	TempArrays arrays;
-	std::vector<e57::SourceDestBuffer> dbufs;
+	const unsigned chunkSize = std::min<unsigned>(pointCount,(1 << 19)); //we save the file in several steps to limit the memory consumption
 
 	//Cartesian field
 	{
@@ -411,24 +505,18 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 												precision,
 												bbMin.x,
 												bbMax.x ) );
-		arrays.xData.resize(chunkSize);
-		dbufs.emplace_back( imf, "cartesianX",  arrays.xData.data(),  chunkSize, true, true );
 
 		proto.set("cartesianY", e57::FloatNode(	imf,
 												bbCenter.y,
 												precision,
 												bbMin.y,
 												bbMax.y ) );
-		arrays.yData.resize(chunkSize);
-		dbufs.emplace_back( imf, "cartesianY",  arrays.yData.data(),  chunkSize, true, true );
 
 		proto.set("cartesianZ", e57::FloatNode(	imf,
 												bbCenter.z,
 												precision,
 												bbMin.z,
 												bbMax.z ) );
-		arrays.zData.resize(chunkSize);
-		dbufs.emplace_back( imf, "cartesianZ",  arrays.zData.data(),  chunkSize, true, true );
 	}
 
 	//Normals
@@ -438,16 +526,8 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 		e57::FloatPrecision precision = sizeof(PointCoordinateType) == 8 ? e57::E57_DOUBLE : e57::E57_SINGLE;
 
 		proto.set("nor:normalX", e57::FloatNode(imf, 0.0, precision, -1.0, 1.0));
-		arrays.xNormData.resize(chunkSize);
-		dbufs.emplace_back( imf, "nor:normalX",  arrays.xNormData.data(),  chunkSize, true, true );
-
 		proto.set("nor:normalY", e57::FloatNode(imf, 0.0, precision, -1.0, 1.0));
-		arrays.yNormData.resize(chunkSize);
-		dbufs.emplace_back( imf, "nor:normalY",  arrays.yNormData.data(),  chunkSize, true, true );
-
 		proto.set("nor:normalZ", e57::FloatNode(imf, 0.0, precision, -1.0, 1.0));
-		arrays.zNormData.resize(chunkSize);
-		dbufs.emplace_back( imf, "nor:normalZ",  arrays.zNormData.data(),  chunkSize, true, true );
 	}
 
 	//Return index
@@ -455,21 +535,15 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 	{
 		assert(maxReturnIndex > minReturnIndex);
 		proto.set("returnIndex", e57::IntegerNode(imf, minReturnIndex, minReturnIndex, maxReturnIndex));
-		arrays.scanIndexData.resize(chunkSize);
-		dbufs.emplace_back( imf, "returnIndex",  arrays.scanIndexData.data(),  chunkSize, true, true );
 	}
 	//Intensity field
 	if (intensitySF)
 	{
 		proto.set("intensity", e57::FloatNode(imf, intensitySF->getMin(), sizeof(ScalarType) == 8 ? e57::E57_DOUBLE : e57::E57_SINGLE, intensitySF->getMin(), intensitySF->getMax()));
-		arrays.intData.resize(chunkSize);
-		dbufs.emplace_back( imf, "intensity",  arrays.intData.data(),  chunkSize, true, true );
 
 		if (hasInvalidIntensities)
 		{
 			proto.set("isIntensityInvalid", e57::IntegerNode(imf, 0, 0, 1));
-			arrays.isInvalidIntData.resize(chunkSize);
-			dbufs.emplace_back( imf, "isIntensityInvalid",  arrays.isInvalidIntData.data(),  chunkSize, true, true );
 		}
 	}
 
@@ -477,14 +551,8 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 	if (hasColors)
 	{
 		proto.set("colorRed",	e57::IntegerNode(imf, 0, 0, 255));
-		arrays.redData.resize(chunkSize);
-		dbufs.emplace_back( imf, "colorRed",  arrays.redData.data(),  chunkSize, true, true );
 		proto.set("colorGreen",	e57::IntegerNode(imf, 0, 0, 255));
-		arrays.greenData.resize(chunkSize);
-		dbufs.emplace_back( imf, "colorGreen",  arrays.greenData.data(),  chunkSize, true, true );
 		proto.set("colorBlue",	e57::IntegerNode(imf, 0, 0, 255));
-		arrays.blueData.resize(chunkSize);
-		dbufs.emplace_back( imf, "colorBlue",  arrays.blueData.data(),  chunkSize, true, true );
 	}
 
 	//ignored fields
@@ -499,6 +567,14 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 	//"isColorInvalid"
 	//"isTimeStampInvalid"
 
+	//we use two sets of buffers: one is filled while the other is written
+	TempArrays arrays[2];
+	std::vector<e57::SourceDestBuffer> dbufs[2];
+	for (unsigned b = 0; b < 2; ++b)
+	{
+		CreateWriteBuffers(imf, chunkSize, hasNormals, returnIndexSF != nullptr, intensitySF != nullptr, hasInvalidIntensities, hasColors, arrays[b], dbufs[b]);
+	}
+
 	// Make empty codecs vector for use in creating points CompressedVector.
 	/// If this vector is empty, it is assumed that all fields will use the BitPack codec.
 	e57::VectorNode codecs = e57::VectorNode(imf, true);
@@ -509,7 +585,7 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 	scanNode.set("points", points);
 	data3D.append(scanNode);
 
-	e57::CompressedVectorWriter writer = points.writer(dbufs);
+	e57::CompressedVectorWriter writer = points.writer(dbufs[0]);
 
 	//progress bar
 	CCCoreLib::NormalizedProgress nprogress(progressDlg, pointCount);
@@ -527,15 +603,13 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 		inversePoseMat = ccGLMatrix(localPoseMat.inverse().data());
 	}
 
-	unsigned index = 0;
-	unsigned remainingPointCount = pointCount;
-	while (remainingPointCount != 0)
+	//fills the arrays with a chunk of points
+	auto fillArrays = [&](TempArrays& chunkArrays, unsigned firstIndex, unsigned count)
 	{
-		unsigned thisChunkSize = std::min(remainingPointCount,chunkSize);
-
-		//load arrays
-		for (unsigned i = 0; i < thisChunkSize; ++i, ++index)
+		for (unsigned i = 0; i < count; ++i)
 		{
+			unsigned index = firstIndex + i;
+
 			const CCVector3* P = cloud->getPointPersistentPtr(index);
 			//CCVector3d Pglobal = cloud->toGlobal3d<PointCoordinateType>(*P);
 			CCVector3d Pglobal = CCVector3d::fromArray(P->u) / globalScale;
@@ -543,54 +617,87 @@ static bool SaveScan(ccPointCloud* cloud, e57::StructureNode& scanNode, e57::Ima
 			{
 				Pglobal = inversePoseMat * Pglobal;
 			}
-			arrays.xData[i] = Pglobal.x;
-			arrays.yData[i] = Pglobal.y;
-			arrays.zData[i] = Pglobal.z;
+			chunkArrays.xData[i] = Pglobal.x;
+			chunkArrays.yData[i] = Pglobal.y;
+			chunkArrays.zData[i] = Pglobal.z;
 
 			if (intensitySF)
 			{
-				assert(!arrays.intData.empty());
+				assert(!chunkArrays.intData.empty());
 				ScalarType sfVal = intensitySF->getValue(index);
-				arrays.intData[i] = static_cast<double>(sfVal);
-				if (!arrays.isInvalidIntData.empty())
-					arrays.isInvalidIntData[i] = ccScalarField::ValidValue(sfVal) ? 0 : 1;
+				chunkArrays.intData[i] = static_cast<double>(sfVal);
+				if (!chunkArrays.isInvalidIntData.empty())
+					chunkArrays.isInvalidIntData[i] = ccScalarField::ValidValue(sfVal) ? 0 : 1;
 			}
 
 			if (hasNormals)
 			{
 				const CCVector3& N = cloud->getPointNormal(index);
-				arrays.xNormData[i] = static_cast<double>(N.x);
-				arrays.yNormData[i] = static_cast<double>(N.y);
-				arrays.zNormData[i] = static_cast<double>(N.z);
+				chunkArrays.xNormData[i] = static_cast<double>(N.x);
+				chunkArrays.yNormData[i] = static_cast<double>(N.y);
+				chunkArrays.zNormData[i] = static_cast<double>(N.z);
 			}
 
 			if (hasColors)
 			{
 				//Normalize color to 0 - 255
 				const ccColor::Rgb& C = cloud->getPointColor(index);
-				arrays.redData[i]	= static_cast<double>(C.r);
-				arrays.greenData[i]	= static_cast<double>(C.g);
-				arrays.blueData[i]	= static_cast<double>(C.b);
+				chunkArrays.redData[i]	= static_cast<double>(C.r);
+				chunkArrays.greenData[i]	= static_cast<double>(C.g);
+				chunkArrays.blueData[i]	= static_cast<double>(C.b);
 			}
 
 			if (returnIndexSF)
 			{
-				assert(!arrays.scanIndexData.empty());
-				arrays.scanIndexData[i] = static_cast<int8_t>(returnIndexSF->getValue(index));
+				assert(!chunkArrays.scanIndexData.empty());
+				chunkArrays.scanIndexData[i] = static_cast<int8_t>(returnIndexSF->getValue(index));
 			}
-			
-			if (!nprogress.oneStep())
+		}
+	};
+
+	//the next chunk is filled (in a background thread) while the current one is written
+	unsigned bufferIndex = 0;
+	unsigned firstIndex = 0;
+	unsigned currentChunkSize = std::min(pointCount, chunkSize);
+	fillArrays(arrays[bufferIndex], firstIndex, currentChunkSize);
+
+	while (currentChunkSize != 0)
+	{
+		const unsigned nextFirstIndex = firstIndex + currentChunkSize;
+		const unsigned nextChunkSize = std::min(pointCount - nextFirstIndex, chunkSize);
+
+		QFuture<void> filling;
+		if (nextChunkSize != 0)
+		{
+			TempArrays& nextArrays = arrays[1 - bufferIndex];
+			filling = QtConcurrent::run([&fillArrays, &nextArrays, nextFirstIndex, nextChunkSize]()
 			{
-				QApplication::processEvents();
-				s_cancelRequestedByUser = true;
-				break;
-			}
+				fillArrays(nextArrays, nextFirstIndex, nextChunkSize);
+			});
 		}
 
-		writer.write(thisChunkSize);
-		
-		assert(thisChunkSize <= remainingPointCount);
-		remainingPointCount -= thisChunkSize;
+		try
+		{
+			writer.write(dbufs[bufferIndex], currentChunkSize);
+		}
+		catch (...)
+		{
+			//the arrays must not be released while they are being filled
+			filling.waitForFinished();
+			throw;
+		}
+		filling.waitForFinished();
+
+		if (!nprogress.steps(currentChunkSize))
+		{
+			QApplication::processEvents();
+			s_cancelRequestedByUser = true;
+			break;
+		}
+
+		firstIndex = nextFirstIndex;
+		currentChunkSize = nextChunkSize;
+		bufferIndex = 1 - bufferIndex;
 	}
 
 	writer.close();
@@ -1425,22 +1532,185 @@ static bool GetPoseInformation(const e57::StructureNode& node, ccGLMatrixd& pose
 	return validPoseMat;
 }
 
-static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDialog* progressDlg = nullptr)
+//! Returns whether the scan coordinates are stored as spherical (or cartesian) ones
+static bool GetCoordinatesMode(const e57::StructureNode& scanNode, const E57ScanHeader& header, bool& sphericalMode)
+{
+	sphericalMode = false;
+	//no cartesian fields?
+	if (!header.pointFields.cartesianXField &&
+		!header.pointFields.cartesianYField && 
+		!header.pointFields.cartesianZField)
+	{
+		//let's look for spherical ones
+		if (!header.pointFields.sphericalRangeField &&
+			!header.pointFields.sphericalAzimuthField &&
+			!header.pointFields.sphericalElevationField)
+		{
+			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(scanNode.elementName().c_str()));
+			return false;
+		}
+		sphericalMode = true;
+	}
+	return true;
+}
+
+//! Prepares the buffers to read the point coordinates (and their validity)
+static void CreateCoordinatesBuffers(	const e57::Node& node,
+										const e57::StructureNode& prototype,
+										const E57ScanHeader& header,
+										bool sphericalMode,
+										unsigned chunkSize,
+										TempArrays& arrays,
+										std::vector<e57::SourceDestBuffer>& dbufs)
+{
+	if (sphericalMode)
+	{
+		//spherical coordinates
+		if (header.pointFields.sphericalRangeField)
+		{
+			arrays.xData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "sphericalRange", arrays.xData.data(), chunkSize, true, (prototype.get("sphericalRange").type() == e57::E57_SCALED_INTEGER) );
+		}
+		if (header.pointFields.sphericalAzimuthField)
+		{
+			arrays.yData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "sphericalAzimuth", arrays.yData.data(), chunkSize, true, (prototype.get("sphericalAzimuth").type() == e57::E57_SCALED_INTEGER) );
+		}
+		if (header.pointFields.sphericalElevationField)
+		{
+			arrays.zData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "sphericalElevation", arrays.zData.data(), chunkSize, true, (prototype.get("sphericalElevation").type() == e57::E57_SCALED_INTEGER) );
+		}
+
+		//data validity
+		if (header.pointFields.sphericalInvalidStateField)
+		{
+			arrays.isInvalidData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "sphericalInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("sphericalInvalidState").type() == e57::E57_SCALED_INTEGER) );
+		}
+	}
+	else
+	{
+		//cartesian coordinates
+		if (header.pointFields.cartesianXField)
+		{
+			arrays.xData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "cartesianX", arrays.xData.data(), chunkSize, true, (prototype.get("cartesianX").type() == e57::E57_SCALED_INTEGER) );
+		}
+		if (header.pointFields.cartesianYField)
+		{
+			arrays.yData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "cartesianY", arrays.yData.data(), chunkSize, true, (prototype.get("cartesianY").type() == e57::E57_SCALED_INTEGER) );
+		}
+		if (header.pointFields.cartesianZField)
+		{
+			arrays.zData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "cartesianZ", arrays.zData.data(), chunkSize, true, (prototype.get("cartesianZ").type() == e57::E57_SCALED_INTEGER) );
+		}
+
+		//data validity
+		if ( header.pointFields.cartesianInvalidStateField)
+		{
+			arrays.isInvalidData.resize(chunkSize);
+			dbufs.emplace_back( node.destImageFile(), "cartesianInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("cartesianInvalidState").type() == e57::E57_SCALED_INTEGER) );
+		}
+	}
+}
+
+//! Converts the i-th read coordinates to cartesian coordinates
+static inline CCVector3d GetCartesianCoordinates(const TempArrays& arrays, unsigned i, bool sphericalMode)
+{
+	CCVector3d Pd(0, 0, 0);
+	if (sphericalMode)
+	{
+		double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
+		double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
+		double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
+
+		double cos_phi = cos(phi);
+		Pd.x = r * cos_phi * cos(theta);
+		Pd.y = r * cos_phi * sin(theta);
+		Pd.z = r * sin(phi);
+	}
+	//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
+	/*else if (cylindricalMode)
+	{
+		//from cylindrical coordinates
+		assert(arrays.xData);
+		double theta = (arrays.yData ? arrays.yData[i] : 0);
+		Pd.x = arrays.xData[i] * cos(theta);
+		Pd.y = arrays.xData[i] * sin(theta);
+		if (arrays.zData)
+			Pd.z = arrays.zData[i];
+	}
+	//*/
+	else //cartesian
+	{
+		if (!arrays.xData.empty())
+			Pd.x = arrays.xData[i];
+		if (!arrays.yData.empty())
+			Pd.y = arrays.yData[i];
+		if (!arrays.zData.empty())
+			Pd.z = arrays.zData[i];
+	}
+	return Pd;
+}
+
+//! Reads the first valid point of a scan
+static bool ReadFirstValidPoint(const e57::Node& node, e57::CompressedVectorNode& points, const E57ScanHeader& header, bool sphericalMode, CCVector3d& Pd)
+{
+	e57::StructureNode prototype(points.prototype());
+
+	const unsigned chunkSize = static_cast<unsigned>(std::min<int64_t>(points.childCount(), 256));
+	if (chunkSize == 0)
+	{
+		return false;
+	}
+	TempArrays arrays;
+	std::vector<e57::SourceDestBuffer> dbufs;
+	CreateCoordinatesBuffers(node, prototype, header, sphericalMode, chunkSize, arrays, dbufs);
+	if (dbufs.empty())
+	{
+		return false;
+	}
+
+	e57::CompressedVectorReader dataReader = points.reader(dbufs);
+	bool found = false;
+	unsigned size = 0;
+	while (!found && (size = dataReader.read()))
+	{
+		for (unsigned i = 0; i < size; ++i)
+		{
+			if (arrays.isInvalidData.empty() || arrays.isInvalidData[i] == 0)
+			{
+				Pd = GetCartesianCoordinates(arrays, i, sphericalMode);
+				found = true;
+				break;
+			}
+		}
+	}
+	dataReader.close();
+
+	return found;
+}
+
+//! Reads the scan header and handles the global shift (must be called from the main thread)
+/** The global shift may require a user interaction, so it is determined once for
+	each scan before the points are actually decoded (potentially by another thread).
+**/
+static bool PrepareScan(const e57::Node& node, ScanLoadingState& state)
 {
 	if (node.type() != e57::E57_STRUCTURE)
 	{
 		ccLog::Warning("[E57Filter] Scan nodes should be STRUCTURES!");
-		return nullptr;
+		return false;
 	}
 	e57::StructureNode scanNode(node);
 
-	//log
-	ccLog::Print(QString("[E57] Reading new scan node (%1)").arg(scanNode.elementName().c_str()));
-
 	if (!scanNode.isDefined("points"))
 	{
 		ccLog::Warning(QString("[E57Filter] No point in scan '%1'!").arg(scanNode.elementName().c_str()));
-		return nullptr;
+		return false;
 	}
 
 	//unique GUID
@@ -1448,14 +1718,81 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 	{
 		e57::Node guidNode = scanNode.get("guid");
 		assert(guidNode.type() == e57::E57_STRING);
-		guidStr = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
+		state.guidStr = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
 	}
 	else
 	{
 		//No GUID!
-		guidStr.clear();
+		state.guidStr.clear();
 	}
 
+	//prototype for points
+	e57::CompressedVectorNode points(scanNode.get("points"));
+	e57::StructureNode prototype(points.prototype());
+	E57ScanHeader header;
+	DecodePrototype(scanNode, prototype, header);
+
+	bool sphericalMode = false;
+	if (!GetCoordinatesMode(scanNode, header, sphericalMode))
+	{
+		return false;
+	}
+
+	//scan "pose" relatively to the others
+	state.validPoseMat = GetPoseInformation(scanNode, state.poseMat);
+	bool poseMatWasShifted = false;
+
+	if (state.validPoseMat)
+	{
+		const CCVector3d T = state.poseMat.getTranslationAsVec3D();
+		CCVector3d Tshift;
+		bool preserveCoordinateShift = true;
+		if (FileIOFilter::HandleGlobalShift(T, Tshift, preserveCoordinateShift, s_loadParameters))
+		{
+			state.poseMat.setTranslation((T + Tshift).u);
+			if (preserveCoordinateShift)
+			{
+				state.globalShift = Tshift;
+				state.hasGlobalShift = true;
+			}
+			poseMatWasShifted = true;
+			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(state.guidStr), Tshift.x, Tshift.y, Tshift.z);
+		}
+	}
+
+	//first point: check for 'big' coordinates
+	if (!state.validPoseMat || !poseMatWasShifted)
+	{
+		CCVector3d Pd;
+		if (ReadFirstValidPoint(node, points, header, sphericalMode, Pd))
+		{
+			bool preserveCoordinateShift = true;
+			if (FileIOFilter::HandleGlobalShift(Pd, state.pointShift, preserveCoordinateShift, s_loadParameters))
+			{
+				if (preserveCoordinateShift)
+				{
+					state.globalShift = state.pointShift;
+					state.hasGlobalShift = true;
+				}
+				ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(state.guidStr), state.pointShift.x, state.pointShift.y, state.pointShift.z);
+			}
+		}
+	}
+
+	return true;
+}
+
+//! Decodes the points of a scan previously prepared with PrepareScan
+/** This method doesn't require the main thread (no user interaction, no
+	access to global states) as long as each thread uses its own E57 file handle.
+**/
+static ccPointCloud* LoadScan(const e57::Node& node, ScanLoadingState& state, ccProgressDialog* progressDlg = nullptr, unsigned maxChunkSize = (1 << 20))
+{
+	e57::StructureNode scanNode(node);
+
+	//log
+	ccLog::Print(QString("[E57] Reading new scan node (%1)").arg(scanNode.elementName().c_str()));
+
 	//points
 	e57::CompressedVectorNode points(scanNode.get("points"));
 	const int64_t pointCount = points.childCount();
@@ -1466,20 +1803,9 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 	DecodePrototype(scanNode, prototype, header);
 
 	bool sphericalMode = false;
-	//no cartesian fields?
-	if (!header.pointFields.cartesianXField &&
-		!header.pointFields.cartesianYField && 
-		!header.pointFields.cartesianZField)
+	if (!GetCoordinatesMode(scanNode, header, sphericalMode))
 	{
-		//let's look for spherical ones
-		if (!header.pointFields.sphericalRangeField &&
-			!header.pointFields.sphericalAzimuthField &&
-			!header.pointFields.sphericalElevationField)
-		{
-			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(scanNode.elementName().c_str()));
-			return nullptr;
-		}
-		sphericalMode = true;
+		return nullptr;
 	}
 
 	ccPointCloud* cloud = new ccPointCloud();
@@ -1514,36 +1840,14 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 	if (scan.isDefined("acquisitionEnd"))
 	//*/
 
-	//scan "pose" relatively to the others
-	ccGLMatrixd poseMat;
-	const bool validPoseMat = GetPoseInformation(scanNode, poseMat);
-	bool poseMatWasShifted = false;
-	ccGBLSensor* sensor = nullptr;
-
-	if (validPoseMat)
+	//global shift (see PrepareScan)
+	if (state.hasGlobalShift)
 	{
-		const CCVector3d T = poseMat.getTranslationAsVec3D();
-		CCVector3d Tshift;
-		bool preserveCoordinateShift = true;
-		if (FileIOFilter::HandleGlobalShift(T, Tshift, preserveCoordinateShift, s_loadParameters))
-		{
-			poseMat.setTranslation((T + Tshift).u);
-			if (preserveCoordinateShift)
-			{
-				cloud->setGlobalShift(Tshift);
-			}
-			poseMatWasShifted = true;
-			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(guidStr), Tshift.x, Tshift.y, Tshift.z);
-		}
-
-		//cloud->setGLTransformation(poseMat); //TODO-> apply it at the end instead! Otherwise we will loose original coordinates!
-
-		sensor = new ccGBLSensor();
-		sensor->setRigidTransformation(ccGLMatrix(poseMat.data()));
+		cloud->setGlobalShift(state.globalShift);
 	}
 
 	//prepare temporary structures
-	const unsigned chunkSize = std::min<unsigned>(pointCount, (1 << 20)); //we load the file in several steps to limit the memory consumption
+	const unsigned chunkSize = std::min<unsigned>(pointCount, maxChunkSize); //we load the file in several steps to limit the memory consumption
 	TempArrays arrays;
 	std::vector<e57::SourceDestBuffer> dbufs;
 
@@ -1554,58 +1858,7 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 		return nullptr;
 	}
 
-	if (sphericalMode)
-	{
-		//spherical coordinates
-		if (header.pointFields.sphericalRangeField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "sphericalRange", arrays.xData.data(), chunkSize, true, (prototype.get("sphericalRange").type() == e57::E57_SCALED_INTEGER) );
-		}
-		if (header.pointFields.sphericalAzimuthField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "sphericalAzimuth", arrays.yData.data(), chunkSize, true, (prototype.get("sphericalAzimuth").type() == e57::E57_SCALED_INTEGER) );
-		}
-		if (header.pointFields.sphericalElevationField)
-		{
-			arrays.zData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "sphericalElevation", arrays.zData.data(), chunkSize, true, (prototype.get("sphericalElevation").type() == e57::E57_SCALED_INTEGER) );
-		}
-
-		//data validity
-		if (header.pointFields.sphericalInvalidStateField)
-		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "sphericalInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("sphericalInvalidState").type() == e57::E57_SCALED_INTEGER) );
-		}
-	}
-	else
-	{
-		//cartesian coordinates
-		if (header.pointFields.cartesianXField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "cartesianX", arrays.xData.data(), chunkSize, true, (prototype.get("cartesianX").type() == e57::E57_SCALED_INTEGER) );
-		}
-		if (header.pointFields.cartesianYField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "cartesianY", arrays.yData.data(), chunkSize, true, (prototype.get("cartesianY").type() == e57::E57_SCALED_INTEGER) );
-		}
-		if (header.pointFields.cartesianZField)
-		{
-			arrays.zData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "cartesianZ", arrays.zData.data(), chunkSize, true, (prototype.get("cartesianZ").type() == e57::E57_SCALED_INTEGER) );
-		}
-
-		//data validity
-		if ( header.pointFields.cartesianInvalidStateField)
-		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.emplace_back( node.destImageFile(), "cartesianInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("cartesianInvalidState").type() == e57::E57_SCALED_INTEGER) );
-		}
-	}
+	CreateCoordinatesBuffers(node, prototype, header, sphericalMode, chunkSize, arrays, dbufs);
 
 	//normals
 	bool hasNormals = (  header.pointFields.normXField
@@ -1746,7 +1999,7 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 		QApplication::processEvents();
 	}
 
-	CCVector3d Pshift(0, 0, 0);
+	const CCVector3d& Pshift = state.pointShift;
 	unsigned size = 0;
 	int64_t realCount = 0;
 	int64_t invalidCount = 0;
@@ -1761,54 +2014,7 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 				continue;
 			}
 
-			CCVector3d Pd(0, 0, 0);
-			if (sphericalMode)
-			{
-				double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
-				double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
-				double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
-
-				double cos_phi = cos(phi);
-				Pd.x = r * cos_phi * cos(theta);
-				Pd.y = r * cos_phi * sin(theta);
-				Pd.z = r * sin(phi);
-			}
-			//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
-			/*else if (cylindricalMode)
-			{
-				//from cylindrical coordinates
-				assert(arrays.xData);
-				double theta = (arrays.yData ? arrays.yData[i] : 0);
-				Pd.x = arrays.xData[i] * cos(theta);
-				Pd.y = arrays.xData[i] * sin(theta);
-				if (arrays.zData)
-					Pd.z = arrays.zData[i];
-			}
-			//*/
-			else //cartesian
-			{
-				if (!arrays.xData.empty())
-					Pd.x = arrays.xData[i];
-				if (!arrays.yData.empty())
-					Pd.y = arrays.yData[i];
-				if (!arrays.zData.empty())
-					Pd.z = arrays.zData[i];
-			}
-
-			//first point: check for 'big' coordinates
-			if (	realCount == 0
-				&& (!validPoseMat || !poseMatWasShifted) )
-			{
-				bool preserveCoordinateShift = true;
-				if (FileIOFilter::HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, s_loadParameters))
-				{
-					if (preserveCoordinateShift)
-					{
-						cloud->setGlobalShift(Pshift);
-					}
-					ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(guidStr), Pshift.x, Pshift.y, Pshift.z);
-				}
-			}
+			CCVector3d Pd = GetCartesianCoordinates(arrays, i, sphericalMode);
 
 			const CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
 			cloud->addPoint(P);
@@ -1836,16 +2042,17 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 					intensitySF->setValue(static_cast<unsigned>(realCount),intensity);
 
 					//track max intensity (for proper visualization)
-					if (s_absoluteScanIndex != 0 || realCount != 0)
+					if (state.hasIntensityRange)
 					{
-						if (s_maxIntensity < intensity)
-							s_maxIntensity = intensity;
-						else if (s_minIntensity > intensity)
-							s_minIntensity = intensity;
+						if (state.maxIntensity < intensity)
+							state.maxIntensity = intensity;
+						else if (state.minIntensity > intensity)
+							state.minIntensity = intensity;
 					}
 					else
 					{
-						s_maxIntensity = s_minIntensity = intensity;
+						state.maxIntensity = state.minIntensity = intensity;
+						state.hasIntensityRange = true;
 					}
 				}
 				else
@@ -1884,6 +2091,10 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 			s_cancelRequestedByUser = true;
 			break;
 		}
+		else if (s_cancelRequestedByUser) //the process may have been cancelled by another thread
+		{
+			break;
+		}
 	}
 
 	dataReader.close();
@@ -1904,6 +2115,28 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 		cloud->resize(static_cast<unsigned>(realCount));
 	}
 
+	return cloud;
+}
+
+//! Finalizes a loaded scan (display parameters, pose, sensor, etc.) - must be called from the main thread
+static void FinalizeScan(ccPointCloud* cloud, const ScanLoadingState& state)
+{
+	assert(cloud);
+
+	ccScalarField* intensitySF = nullptr;
+	{
+		int sfIndex = cloud->getScalarFieldIndexByName(CC_E57_INTENSITY_FIELD_NAME);
+		if (sfIndex >= 0)
+			intensitySF = static_cast<ccScalarField*>(cloud->getScalarField(sfIndex));
+	}
+	ccScalarField* returnIndexSF = nullptr;
+	{
+		int sfIndex = cloud->getScalarFieldIndexByName(CC_E57_RETURN_INDEX_FIELD_NAME);
+		if (sfIndex >= 0)
+			returnIndexSF = static_cast<ccScalarField*>(cloud->getScalarField(sfIndex));
+	}
+
+
 	//Scalar fields
 	if (intensitySF)
 	{
@@ -1924,33 +2157,32 @@ static ccHObject* LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 		cloud->showSF(true);
 	}
 
-	cloud->showColors(hasColors);
+	cloud->showColors(cloud->hasColors());
 	cloud->setVisible(true);
 
 	//we don't deal with virtual transformation (yet)
-	if (validPoseMat)
+	if (state.validPoseMat)
 	{
-		const ccGLMatrix poseMatf(poseMat.data());
+		const ccGLMatrix poseMatf(state.poseMat.data());
 		
 		cloud->applyGLTransformation_recursive(&poseMatf);
 		//this transformation is of no interest for the user
 		cloud->resetGLTransformationHistory_recursive();
 
 		//save the original pose matrix as meta-data
-		cloud->setMetaData(s_e57PoseKey, poseMat.toString(12, ' '));
-	}
+		cloud->setMetaData(s_e57PoseKey, state.poseMat.toString(12, ' '));
 
-	if (sensor) //add the sensor at the end, after calling applyGLTransformation_recursive!
-	{
+		//add the sensor at the end, after calling applyGLTransformation_recursive!
+		ccGBLSensor* sensor = new ccGBLSensor();
+		sensor->setRigidTransformation(poseMatf);
 		sensor->setVisible(false);
 		sensor->setEnabled(false);
 		sensor->setGraphicScale(cloud->getOwnBB().getDiagNorm() / 20);
 		cloud->addChild(sensor);
 	}
-
-	return cloud;
 }
 
+
 static ccHObject* LoadImage(const e57::Node& node, QString& associatedData3DGuid)
 {
 	if (node.type() != e57::E57_STRUCTURE)
@@ -2291,41 +2523,176 @@ CC_FILE_ERROR E57Filter::loadFile(const QString& filename, ccHObject& container,
 			s_absoluteScanIndex = 0;
 			s_cancelRequestedByUser = false;
 			s_minIntensity = s_maxIntensity = 0;
+
+			//first, we read the scans headers and handle the global shift
+			//(this may require user interaction, so it's done by this thread)
+			std::vector<ScanLoadingState> states(scanCount);
+			std::vector<bool> validScans(scanCount, false);
 			for (unsigned i = 0; i < scanCount; ++i)
 			{
-				const e57::Node scanNode = data3D.get(i);
-				QString scanGUID;
-				
-				ccHObject* scan = LoadScan(scanNode, scanGUID, showGlobalProgress ? nullptr : progressDlg.data());
-				
-				if (scan)
+				validScans[i] = PrepareScan(data3D.get(i), states[i]);
+			}
+
+			//then we decode the points
+			std::vector<ccPointCloud*> clouds(scanCount, nullptr);
+			int threadCount = std::min(static_cast<int>(scanCount), QThread::idealThreadCount());
+			if (s_parallelScanLoading && threadCount > 1)
+			{
+				//the color scales manager must be instantiated by the main thread (used by ccScalarField)
+				ccColorScalesManager::GetUniqueInstance();
+
+				ccLog::Print(QString("[E57] Decoding %1 scans with %2 threads").arg(scanCount).arg(threadCount));
+
+				//each thread opens its own file handle (libE57Format is not thread-safe)
+				std::atomic<unsigned> nextScanIndex(0);
+				std::atomic<unsigned> processedScanCount(0);
+				std::atomic<bool> abortRequested(false);
+				std::exception_ptr firstError;
+				QMutex errorMutex;
+
+				auto decodeScans = [&]()
 				{
-					if (scan->getName().isEmpty())
+					try
 					{
-						QString name("Scan ");
-						e57::ustring nodeName = scanNode.elementName();
-						
-						if ( !nodeName.empty() )
-							name += QString::fromStdString( nodeName );
-						else
-							name += QString::number( i );
+						e57::ImageFile threadImf( qPrintable(filename), "r", e57::CHECKSUM_POLICY_SPARSE );
+						e57::ustring threadNormalsExtension;
+						if (!threadImf.extensionsLookupPrefix("nor", threadNormalsExtension))
+						{
+							threadImf.extensionsAdd("nor", normalsExtension);
+						}
+						e57::VectorNode threadData3D(threadImf.root().get("/data3D"));
+
+						while (!s_cancelRequestedByUser && !abortRequested)
+						{
+							unsigned scanIndex = nextScanIndex++;
+							if (scanIndex >= scanCount)
+							{
+								break;
+							}
+							if (validScans[scanIndex])
+							{
+								//smaller chunks, as several scans are decoded simultaneously
+								clouds[scanIndex] = LoadScan(threadData3D.get(scanIndex), states[scanIndex], nullptr, (1 << 18));
+							}
+							++processedScanCount;
+						}
 
-						scan->setName(name);
+						threadImf.close();
 					}
-					container.addChild(scan);
+					catch (...)
+					{
+						QMutexLocker locker(&errorMutex);
+						if (!firstError)
+						{
+							firstError = std::current_exception();
+						}
+						abortRequested = true;
+					}
+				};
+
+				std::vector< QFuture<void> > futures;
+				futures.reserve(threadCount);
+				for (int t = 0; t < threadCount; ++t)
+				{
+					futures.push_back(QtConcurrent::run(decodeScans));
+				}
 
-					//we also add the scan to the GUID/object map
-					if (!scanGUID.isEmpty())
+				if (progressDlg)
+				{
+					progressDlg->setMethodTitle(QObject::tr("Read E57 file"));
+					progressDlg->setInfo(QObject::tr("Scans: %1").arg(scanCount));
+					progressDlg->start();
+				}
+				for (QFuture<void>& future : futures)
+				{
+					while (!future.isFinished())
 					{
-						scans.insert(scanGUID, scan);
+						if (progressDlg)
+						{
+							progressDlg->update(100.0f * processedScanCount / scanCount);
+							QApplication::processEvents();
+							if (progressDlg->isCancelRequested())
+							{
+								s_cancelRequestedByUser = true;
+							}
+						}
+						QThread::msleep(50);
 					}
 				}
-				
-				if ((showGlobalProgress && progressDlg && !nprogress.oneStep()) || s_cancelRequestedByUser)
+
+				if (firstError)
 				{
-					break;
+					for (ccPointCloud* cloud : clouds)
+					{
+						delete cloud;
+					}
+					std::rethrow_exception(firstError);
+				}
+			}
+			else
+			{
+				for (unsigned i = 0; i < scanCount; ++i)
+				{
+					if (validScans[i])
+					{
+						clouds[i] = LoadScan(data3D.get(i), states[i], showGlobalProgress ? nullptr : progressDlg.data());
+					}
+
+					if ((showGlobalProgress && progressDlg && !nprogress.oneStep()) || s_cancelRequestedByUser)
+					{
+						break;
+					}
+					++s_absoluteScanIndex;
+				}
+			}
+
+			//eventually we add the scans to the DB (in their original order)
+			bool firstIntensityRange = true;
+			for (unsigned i = 0; i < scanCount; ++i)
+			{
+				ccPointCloud* scan = clouds[i];
+				if (!scan)
+				{
+					continue;
+				}
+
+				FinalizeScan(scan, states[i]);
+
+				if (scan->getName().isEmpty())
+				{
+					QString name("Scan ");
+					e57::ustring nodeName = data3D.get(i).elementName();
+
+					if ( !nodeName.empty() )
+						name += QString::fromStdString( nodeName );
+					else
+						name += QString::number( i );
+
+					scan->setName(name);
+				}
+				container.addChild(scan);
+
+				//we also add the scan to the GUID/object map
+				if (!states[i].guidStr.isEmpty())
+				{
+					scans.insert(states[i].guidStr, scan);
+				}
+
+				//global intensity range
+				if (states[i].hasIntensityRange)
+				{
+					if (firstIntensityRange)
+					{
+						s_minIntensity = states[i].minIntensity;
+						s_maxIntensity = states[i].maxIntensity;
+						firstIntensityRange = false;
+					}
+					else
+					{
+						s_minIntensity = std::min(s_minIntensity, states[i].minIntensity);
+						s_maxIntensity = std::max(s_maxIntensity, states[i].maxIntensity);
+					}
 				}
-				++s_absoluteScanIndex;
 			}
 
 			if (progressDlg)
@@ -36,6 +36,11 @@
 #include <QElapsedTimer>
 #include <QProgressDialog>
 #include <QMessageBox>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
 
 //standard includes
 #include <vector>
@@ -1132,6 +1137,113 @@ void qAnimationDlg::preview()
 	setEnabled(true);
 }
 
+//! Bounded queue between the (GUI) rendering thread and the background frame writer(s)
+/** The GUI thread pushes the raw rendered frames, while the consumer thread(s)
+	take care of the super-resolution downsampling, the export of the frames
+	as image files or their encoding in the video stream.
+**/
+class FramePipeline
+{
+public:
+
+	struct Frame
+	{
+		QImage image;
+		int index = 0;
+	};
+
+	explicit FramePipeline(int capacity)
+		: m_capacity(std::max(1, capacity))
+		, m_finished(false)
+		, m_aborted(false)
+	{}
+
+	//! Pushes a new frame (blocks while the queue is full)
+	/** \return false if the pipeline has been aborted
+	**/
+	bool push(QImage&& image, int index)
+	{
+		QMutexLocker locker(&m_mutex);
+		while (m_queue.size() >= m_capacity && !m_aborted)
+		{
+			m_notFull.wait(&m_mutex);
+		}
+		if (m_aborted)
+		{
+			return false;
+		}
+		m_queue.enqueue(Frame{ std::move(image), index });
+		m_notEmpty.wakeOne();
+		return true;
+	}
+
+	//! Pops the next frame (blocks while the queue is empty)
+	/** \return false if there's no more frames to process
+	**/
+	bool pop(Frame& frame)
+	{
+		QMutexLocker locker(&m_mutex);
+		while (m_queue.isEmpty() && !m_finished && !m_aborted)
+		{
+			m_notEmpty.wait(&m_mutex);
+		}
+		if (m_aborted || m_queue.isEmpty())
+		{
+			return false;
+		}
+		frame = m_queue.dequeue();
+		m_notFull.wakeOne();
+		return true;
+	}
+
+	//! Signals that no more frames will be pushed
+	void finish()
+	{
+		QMutexLocker locker(&m_mutex);
+		m_finished = true;
+		m_notEmpty.wakeAll();
+	}
+
+	//! Stops the pipeline (pending frames are dropped)
+	void abort(const QString& error = QString())
+	{
+		QMutexLocker locker(&m_mutex);
+		if (!m_aborted && !error.isEmpty())
+		{
+			m_error = error;
+		}
+		m_aborted = true;
+		m_queue.clear();
+		m_notEmpty.wakeAll();
+		m_notFull.wakeAll();
+	}
+
+	//! Returns the first error reported by a consumer (if any)
+	QString error()
+	{
+		QMutexLocker locker(&m_mutex);
+		return m_error;
+	}
+
+	//! Returns whether the pipeline has been aborted
+	bool aborted()
+	{
+		QMutexLocker locker(&m_mutex);
+		return m_aborted;
+	}
+
+protected:
+
+	QMutex m_mutex;
+	QWaitCondition m_notEmpty;
+	QWaitCondition m_notFull;
+	QQueue<Frame> m_queue;
+	int m_capacity;
+	bool m_finished;
+	bool m_aborted;
+	QString m_error;
+};
+
 void qAnimationDlg::render(bool asSeparateFrames)
 {
 	if (!m_view3d)
@@ -1260,6 +1372,54 @@ void qAnimationDlg::render(bool asSeparateFrames)
 
 	QDir outputDir(QFileInfo(outputFilename).absolutePath());
 
+	//the frames are downsampled and saved/encoded by background thread(s)
+	//while the GUI thread keeps rendering the next ones
+	int downsamplingFactor = (renderingMode == SUPER_RESOLUTION ? superRes : 1);
+	//image files can be written concurrently, but the video frames must be encoded in order
+	int writerCount = (asSeparateFrames ? std::max(1, QThread::idealThreadCount() - 1) : 1);
+	//don't keep too many (potentially huge) frames in memory
+	FramePipeline pipeline(writerCount + 2);
+
+	auto writeFrames = [&]()
+	{
+		FramePipeline::Frame frame;
+		while (pipeline.pop(frame))
+		{
+			if (downsamplingFactor > 1)
+			{
+				frame.image = frame.image.scaled(frame.image.width() / downsamplingFactor, frame.image.height() / downsamplingFactor, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+			}
+
+			if (asSeparateFrames)
+			{
+				QString filename = QString("frame_%1.png").arg(frame.index, 6, 10, QChar('0'));
+				QString fullPath = outputDir.filePath(filename);
+				if (!frame.image.save(fullPath))
+				{
+					pipeline.abort(QString("Failed to save frame #%1").arg(frame.index + 1));
+					return;
+				}
+			}
+			else
+			{
+#ifdef QFFMPEG_SUPPORT
+				QString errorString;
+				if (!encoder->encodeImage(frame.image, frame.index, &errorString))
+				{
+					pipeline.abort(QString("Failed to encode frame #%1: %2").arg(frame.index + 1).arg(errorString));
+					return;
+				}
+#endif
+			}
+		}
+	};
+
+	QList< QFuture<void> > writers;
+	for (int i = 0; i < writerCount; ++i)
+	{
+		writers.push_back(QtConcurrent::run(writeFrames));
+	}
+
 	bool success = true;
 	double currentTime = 0.0;
 	double currentStepStartTime = 0.0;
@@ -1291,40 +1451,20 @@ void qAnimationDlg::render(bool asSeparateFrames)
 
 			if (image.isNull())
 			{
+				pipeline.abort();
 				QMessageBox::critical(this, "Error", "Failed to grab the screen!");
 				success = false;
 				break;
 			}
 
-			if (renderingMode == SUPER_RESOLUTION && superRes > 1)
+			//hand the frame over to the writer thread(s)
+			if (!pipeline.push(std::move(image), frameIndex))
 			{
-				image = image.scaled(image.width() / superRes, image.height() / superRes, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+				//a writer has failed (the error will be reported below)
+				success = false;
+				break;
 			}
 
-			if (asSeparateFrames)
-			{
-				QString filename = QString("frame_%1.png").arg(frameIndex, 6, 10, QChar('0'));
-				QString fullPath = outputDir.filePath(filename);
-				if (!image.save(fullPath))
-				{
-					QMessageBox::critical(this, "Error", QString("Failed to save frame #%1").arg(frameIndex + 1));
-					success = false;
-					break;
-				}
-			}
-			else
-			{
-#ifdef QFFMPEG_SUPPORT
-				QString errorString;
-				if (!encoder->encodeImage(image, frameIndex, &errorString))
-				{
-					QMessageBox::critical(this, "Error", QString("Failed to encode frame #%1: %2").arg(frameIndex + 1).arg(errorString));
-					success = false;
-					break;
-				}
-#endif
-			}
-			
 			//next frame
 			currentTime += timeStep;
 			++frameIndex;
@@ -1333,6 +1473,7 @@ void qAnimationDlg::render(bool asSeparateFrames)
 			QApplication::processEvents();
 			if (progressDialog.wasCanceled())
 			{
+				pipeline.abort();
 				QMessageBox::warning(this, "Warning", QString("Process has been cancelled"));
 				success = false;
 				break;
@@ -1351,6 +1492,26 @@ void qAnimationDlg::render(bool asSeparateFrames)
 		}
 	}
 
+	//wait for the remaining frames to be written
+	pipeline.finish();
+	for (QFuture<void>& writer : writers)
+	{
+		while (!writer.isFinished())
+		{
+			QThread::msleep(50);
+			QApplication::processEvents();
+		}
+	}
+	if (success && pipeline.aborted())
+	{
+		success = false;
+	}
+	QString writerError = pipeline.error();
+	if (!writerError.isEmpty())
+	{
+		QMessageBox::critical(this, "Error", writerError);
+	}
+
 	m_view3d->setLODEnabled(lodWasEnabled);
 
 #ifdef QFFMPEG_SUPPORT
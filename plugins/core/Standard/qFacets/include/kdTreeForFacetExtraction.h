@@ -30,6 +30,7 @@ public:
 
 	//! Fuses cells
 	/** Creates a new scalar fields with the groups indexes.
+		The facets are grown in parallel (the biggest cells are used as seeds first).
 		\param kdTree Kd-tree
 		\param maxError max error after fusion (see errorMeasure)
 		\param errorMeasure error measure type
@@ -19,49 +19,131 @@
 
 //CCCoreLib
 #include <GenericProgressCallback.h>
-#include <Neighbourhood.h>
-#include <ParallelSort.h>
+#include <Jacobi.h>
 
 //qCC_db
 #include <ccPointCloud.h>
 
 //Qt
 #include <QApplication>
+#include <QThread>
+#include <QtConcurrentMap>
 
-//static bool AscendingLeafErrorComparison(const ccKdTree::Leaf* a, const ccKdTree::Leaf* b)
-//{
-//	return a->error < b->error;
-//}
+//System
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 static bool DescendingLeafSizeComparison(const ccKdTree::Leaf* a, const ccKdTree::Leaf* b)
 {
 	return a->points->size() > b->points->size();
 }
 
-struct Candidate
+//! Running sums of the coordinates of a set of points
+/** The LS plane of the union of two sets can be deduced
+	from their respective sums in constant time.
+	Coordinates are expressed relatively to a common origin
+	to limit the numerical cancellation.
+**/
+struct PointSetMoments
 {
-	ccKdTree::Leaf* leaf;
-	PointCoordinateType dist;
-	PointCoordinateType radius;
-	CCVector3 centroid;
+	double count = 0;
+	CCVector3d sum = CCVector3d(0, 0, 0);
+	double sxx = 0, sxy = 0, sxz = 0, syy = 0, syz = 0, szz = 0;
 
-	Candidate() : leaf(nullptr), dist(CCCoreLib::PC_NAN), radius(0) {}
-	Candidate(ccKdTree::Leaf* l) : leaf(l), dist(CCCoreLib::PC_NAN), radius(0)
+	inline void add(const CCVector3d& P)
 	{
-		if (leaf && leaf->points)
-		{
-			CCCoreLib::Neighbourhood N(leaf->points);
-			centroid = *N.getGravityCenter();
-			radius = N.computeLargestRadius();
-		}
+		count += 1.0;
+		sum += P;
+		sxx += P.x * P.x; sxy += P.x * P.y; sxz += P.x * P.z;
+		syy += P.y * P.y; syz += P.y * P.z; szz += P.z * P.z;
+	}
+
+	inline void add(const PointSetMoments& m)
+	{
+		count += m.count;
+		sum += m.sum;
+		sxx += m.sxx; sxy += m.sxy; sxz += m.sxz;
+		syy += m.syy; syz += m.syz; szz += m.szz;
+	}
+
+	//! Computes the LS plane and the mean square distance of the points to this plane
+	bool computeLSPlane(CCVector3d& N, CCVector3d& G, double& meanSquareDist) const
+	{
+		if (count < 3)
+			return false;
+
+		G = sum / count;
+
+		CCCoreLib::SquareMatrixd cov(3);
+		cov.setValue(0, 0, sxx / count - G.x * G.x);
+		cov.setValue(1, 1, syy / count - G.y * G.y);
+		cov.setValue(2, 2, szz / count - G.z * G.z);
+		cov.setValue(0, 1, sxy / count - G.x * G.y);
+		cov.setValue(0, 2, sxz / count - G.x * G.z);
+		cov.setValue(1, 2, syz / count - G.y * G.z);
+		cov.setValue(1, 0, cov.getValue(0, 1));
+		cov.setValue(2, 0, cov.getValue(0, 2));
+		cov.setValue(2, 1, cov.getValue(1, 2));
+
+		CCCoreLib::SquareMatrixd eigVectors;
+		std::vector<double> eigValues;
+		if (!CCCoreLib::Jacobi<double>::ComputeEigenValuesAndVectors(cov, eigVectors, eigValues, true))
+			return false;
+
+		//the smallest eigen vector corresponds to the plane normal
+		double vec[3];
+		double minEigValue = 0;
+		CCCoreLib::Jacobi<double>::GetMinEigenValueAndVector(eigVectors, eigValues, minEigValue, vec);
+		N = CCVector3d::fromArray(vec);
+		N.normalize();
+
+		//the smallest eigen value is the mean square distance to the plane
+		meanSquareDist = std::max(0.0, minEigValue);
+
+		return true;
 	}
 };
 
-static bool CandidateDistAscendingComparison(const Candidate& a, const Candidate& b)
+//! Precomputed information about a leaf
+struct LeafInfo
 {
-	return a.dist < b.dist;
+	PointSetMoments moments;
+	CCVector3 centroid;
+	PointCoordinateType radius = 0;
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	CCVector3 normal;
+	std::vector<unsigned> neighbors;
+};
+
+//! Squared distance between a point and a bounding-box (0 if inside)
+static PointCoordinateType SquareDistToBox(const CCVector3& P, const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	PointCoordinateType d2 = 0;
+	for (unsigned k = 0; k < 3; ++k)
+	{
+		PointCoordinateType d = std::max(bbMin.u[k] - P.u[k], P.u[k] - bbMax.u[k]);
+		if (d > 0)
+			d2 += d * d;
+	}
+	return d2;
 }
 
+//! Fusion candidate (for a given facet)
+struct FusionCandidate
+{
+	unsigned leafIndex = 0;
+	//! Squared distance to the facet seed (priority)
+	PointCoordinateType dist2ToSeed = 0;
+	//! Squared distance between the candidate centroid and the facet points
+	PointCoordinateType minDist2ToFacet = 0;
+	//! Number of facet leaves already taken into account in 'minDist2ToFacet'
+	size_t checkedLeafCount = 0;
+};
+
 bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 											double maxError,
 											CCCoreLib::DistanceComputationTools::ERROR_MEASURES errorMeasure,
@@ -83,7 +165,6 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 		return false;
 
 	//progress notification
-	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(leaves.size()));
 	if (progressCb)
 	{
 		progressCb->update(0);
@@ -98,263 +179,430 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 	ccPointCloud* pc = static_cast<ccPointCloud*>(associatedGenericCloud);
 
 	//sort cells based on their population size (we start by the biggest ones)
-	ParallelSort(leaves.begin(), leaves.end(), DescendingLeafSizeComparison);
+	//(stable sort: the order of the leaves of same size must not vary from one run to the other)
+	std::stable_sort(leaves.begin(), leaves.end(), DescendingLeafSizeComparison);
+
+	const unsigned leafCount = static_cast<unsigned>(leaves.size());
 
-	//set all 'userData' to -1 (i.e. unfused cells)
+	//precompute the leaves information (moments, centroid, radius, bounding-box and neighbors)
+	std::vector<LeafInfo> leafInfo;
+	try
 	{
-		for (size_t i=0; i<leaves.size(); ++i)
+		leafInfo.resize(leafCount);
+
+		std::unordered_map<ccKdTree::Leaf*, unsigned> leafIndexes;
+		leafIndexes.reserve(leafCount);
+		for (unsigned i = 0; i < leafCount; ++i)
 		{
-			leaves[i]->userData = -1;
-			//check by the way that the plane normal is unit!
-			assert(static_cast<double>(fabs(CCVector3(leaves[i]->planeEq).norm2()) - 1.0) < 1.0e-6);
+			leafIndexes[leaves[i]] = i;
 		}
+
+		for (unsigned i = 0; i < leafCount; ++i)
+		{
+			ccKdTree::LeafSet neighbors;
+			if (!kdTree->getNeighborLeaves(leaves[i], neighbors))
+			{
+				//an error occurred
+				return false;
+			}
+			leafInfo[i].neighbors.reserve(neighbors.size());
+			for (ccKdTree::Leaf* neighbor : neighbors)
+			{
+				leafInfo[i].neighbors.push_back(leafIndexes[neighbor]);
+			}
+			//(the neighbors set is sorted by address)
+			std::sort(leafInfo[i].neighbors.begin(), leafInfo[i].neighbors.end());
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory!
+		ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
+		return false;
+	}
+
+	//common origin for the moments
+	const CCVector3d origin = pc->getOwnBB().getCenter().toDouble();
+
+	std::vector<unsigned> leafIndexes(leafCount);
+	for (unsigned i = 0; i < leafCount; ++i)
+	{
+		leafIndexes[i] = i;
 	}
+	QtConcurrent::blockingMap(leafIndexes, [&](unsigned i)
+	{
+		CCCoreLib::ReferenceCloud* points = leaves[i]->points;
+		assert(points);
+		LeafInfo& info = leafInfo[i];
+		//check by the way that the plane normal is unit!
+		assert(static_cast<double>(fabs(CCVector3(leaves[i]->planeEq).norm2()) - 1.0) < 1.0e-6);
+		info.normal = CCVector3(leaves[i]->planeEq);
+
+		unsigned count = points->size();
+		for (unsigned j = 0; j < count; ++j)
+		{
+			const CCVector3* P = points->getPoint(j);
+			info.moments.add(P->toDouble() - origin);
+			if (j == 0)
+			{
+				info.bbMin = info.bbMax = *P;
+			}
+			else
+			{
+				for (unsigned k = 0; k < 3; ++k)
+				{
+					info.bbMin.u[k] = std::min(info.bbMin.u[k], P->u[k]);
+					info.bbMax.u[k] = std::max(info.bbMax.u[k], P->u[k]);
+				}
+			}
+		}
+
+		if (count != 0)
+		{
+			info.centroid = CCVector3::fromArray((info.moments.sum / info.moments.count + origin).u);
+			PointCoordinateType maxSquareDist = 0;
+			for (unsigned j = 0; j < count; ++j)
+			{
+				maxSquareDist = std::max(maxSquareDist, (*points->getPoint(j) - info.centroid).norm2());
+			}
+			info.radius = sqrt(maxSquareDist);
+		}
+	});
 
 	// cosine of the max angle between fused 'planes'
 	const double c_minCosNormAngle = cos( CCCoreLib::DegreesToRadians( maxAngle_deg ) );
 
-	//fuse all cells, starting from the ones with the best error
-	const int unvisitedNeighborValue = -1;
-	bool cancelled = false;
-	int macroIndex = 1; //starts at 1 (0 is reserved for cells already above the max error)
+	//Facet label of each leaf:
+	// -1 = not yet fused
+	//  0 = special group for cells already above the user defined threshold
+	// >0 = 1 + index of the facet seed leaf
+	//The result must not depend on the threads scheduling. Therefore the seeds are grown
+	//by rounds: in each round, the next seeds (in the leaves order, i.e. the biggest first)
+	//are grown in parallel against the facets committed so far (read-only), then their
+	//results are committed in the seeds order. As soon as a seed competes for a leaf with
+	//a previous seed of the same round, the previous seed wins: this seed and the next
+	//ones are grown again in the next round. This gives the same facets as a sequential
+	//growth, whatever the number of threads.
+	std::vector<int> owners(leafCount, -1);
+
+	std::atomic<unsigned> claimedLeafCount(0);
+	std::atomic<bool> cancelled(false);
+	std::atomic<bool> notEnoughMemory(false);
+
+	//grows a facet from a given seed (the leaves of the facet are returned, the seed first)
+	auto growFacet = [&](unsigned seedIndex, std::vector<unsigned>& facetLeaves)
 	{
-		for (size_t i=0; i<leaves.size(); ++i)
+		//scratch structures
+		CCCoreLib::ReferenceCloud fusedPoints(pc);
+		std::vector<FusionCandidate> candidates;
+		std::vector<size_t> queue; //heap of candidate indexes (closest to the seed first)
+		std::vector<size_t> deferred;
+		std::vector<unsigned> cellsToTest;
+		std::unordered_set<unsigned> visitedLeaves;
+
+		auto queueComparison = [&](size_t a, size_t b)
 		{
-			ccKdTree::Leaf* currentCell = leaves[i];
-			if (currentCell->error >= maxError)
-				currentCell->userData = 0; //0 = special group for cells already above the user defined threshold!
+			//ties are broken with the leaf index (so that the order doesn't depend on the insertion order)
+			if (candidates[a].dist2ToSeed != candidates[b].dist2ToSeed)
+				return candidates[a].dist2ToSeed > candidates[b].dist2ToSeed;
+			return candidates[a].leafIndex > candidates[b].leafIndex;
+		};
+
+		//estimates the error of the plane fitted to the facet and an additional leaf
+		auto computeFusedError = [&](const PointSetMoments& fusedMoments, unsigned extraLeafIndex) -> double
+		{
+			CCVector3d N;
+			CCVector3d G;
+			double meanSquareDist = 0;
+			if (!fusedMoments.computeLSPlane(N, G, meanSquareDist))
+				return -1.0;
 
-			//already fused?
-			if (currentCell->userData != -1)
+			if (errorMeasure == CCCoreLib::DistanceComputationTools::RMS)
 			{
-				if (progressCb && !nProgress.oneStep()) //process canceled by user
+				//constant time
+				return sqrt(meanSquareDist);
+			}
+
+			//other measures require the actual distances
+			fusedPoints.clear(false);
+			if (!fusedPoints.reserve(static_cast<unsigned>(fusedMoments.count)))
+			{
+				throw std::bad_alloc();
+			}
+			for (unsigned leafIndex : facetLeaves)
+			{
+				fusedPoints.add(*leaves[leafIndex]->points);
+			}
+			fusedPoints.add(*leaves[extraLeafIndex]->points);
+
+			PointCoordinateType planeEquation[4] = { static_cast<PointCoordinateType>(N.x),
+													 static_cast<PointCoordinateType>(N.y),
+													 static_cast<PointCoordinateType>(N.z),
+													 static_cast<PointCoordinateType>(N.dot(G + origin)) };
+			return CCCoreLib::DistanceComputationTools::ComputeCloud2PlaneDistance(&fusedPoints, planeEquation, errorMeasure);
+		};
+
+		//updates the distance between a candidate and the facet points (only the new facet leaves are considered)
+		auto updateMinDist = [&](FusionCandidate& candidate)
+		{
+			const CCVector3& C = leafInfo[candidate.leafIndex].centroid;
+			for (; candidate.checkedLeafCount < facetLeaves.size(); ++candidate.checkedLeafCount)
+			{
+				const LeafInfo& info = leafInfo[facetLeaves[candidate.checkedLeafCount]];
+				if (SquareDistToBox(C, info.bbMin, info.bbMax) >= candidate.minDist2ToFacet)
 				{
-					cancelled = true;
-					break;
+					//this leaf can't be closer
+					continue;
+				}
+				CCCoreLib::ReferenceCloud* points = leaves[facetLeaves[candidate.checkedLeafCount]]->points;
+				for (unsigned j = 0; j < points->size(); ++j)
+				{
+					candidate.minDist2ToFacet = std::min(candidate.minDist2ToFacet, (*points->getPoint(j) - C).norm2());
 				}
-				continue;
 			}
+		};
 
-			//we create a new "macro cell" index
-			currentCell->userData = macroIndex++;
+		//we init the current set of 'fused' points with the cell's points
+		facetLeaves.clear();
+		facetLeaves.push_back(seedIndex);
+		PointSetMoments facetMoments = leafInfo[seedIndex].moments;
+		//the seed centroid and normal are not updated (otherwise the search would naturally shift along one dimension!)
+		const CCVector3& seedCentroid = leafInfo[seedIndex].centroid;
+		const CCVector3& seedNormal = leafInfo[seedIndex].normal;
 
-			//we init the current set of 'fused' points with the cell's points
-			CCCoreLib::ReferenceCloud* currentPointSet = currentCell->points;
-			//get current fused set centroid and normal
-			CCVector3 currentCentroid = *CCCoreLib::Neighbourhood(currentPointSet).getGravityCenter();
-			CCVector3 currentNormal(currentCell->planeEq);
+		visitedLeaves.insert(seedIndex);
 
-			//visited neighbors
-			ccKdTree::LeafSet visitedNeighbors;
-			//set of candidates
-			std::list<Candidate> candidates;
+		//we are going to iteratively look for neighbor cells that could be fused to this one
+		cellsToTest.push_back(seedIndex);
 
-			//we are going to iteratively look for neighbor cells that could be fused to this one
-			ccKdTree::LeafVector cellsToTest;
-			cellsToTest.push_back(currentCell);
+		while (!cancelled)
+		{
+			//add the (new and unvisited) neighbors of the 'waiting' cell(s) to the candidates
+			for (unsigned cellIndex : cellsToTest)
+			{
+				for (unsigned neighborIndex : leafInfo[cellIndex].neighbors)
+				{
+					if (owners[neighborIndex] == -1 && visitedLeaves.insert(neighborIndex).second)
+					{
+						FusionCandidate candidate;
+						candidate.leafIndex = neighborIndex;
+						candidate.dist2ToSeed = closestFirst ? (leafInfo[neighborIndex].centroid - seedCentroid).norm2() : 0;
+						candidate.minDist2ToFacet = std::numeric_limits<PointCoordinateType>::max();
+						candidates.push_back(candidate);
+						queue.push_back(candidates.size() - 1);
+						std::push_heap(queue.begin(), queue.end(), queueComparison);
+					}
+				}
+			}
+			cellsToTest.clear();
 
-			if (progressCb && !nProgress.oneStep()) //process canceled by user
+			//we will keep track of the best candidate at each pass
+			size_t bestCandidateIndex = candidates.size();
+			double bestError = -1.0;
+
+			while (!queue.empty())
 			{
-				cancelled = true;
+				std::pop_heap(queue.begin(), queue.end(), queueComparison);
+				size_t candidateIndex = queue.back();
+				queue.pop_back();
+				FusionCandidate& candidate = candidates[candidateIndex];
+				const LeafInfo& info = leafInfo[candidate.leafIndex];
+
+				//already fused with another (committed) facet?
+				if (owners[candidate.leafIndex] != -1)
+					continue;
+
+				//if the leaf orientation is too different, the candidate is rejected
+				if (fabs(info.normal.dot(seedNormal)) < c_minCosNormAngle)
+					continue;
+
+				//if the leaf is too far, we'll test it again once the facet has grown
+				updateMinDist(candidate);
+				if (info.radius < sqrt(candidate.minDist2ToFacet) / overlapCoef)
+				{
+					deferred.push_back(candidateIndex);
+					continue;
+				}
+
+				//estimate the error after fusion
+				PointSetMoments fusedMoments = facetMoments;
+				fusedMoments.add(info.moments);
+				double error = computeFusedError(fusedMoments, candidate.leafIndex);
+
+				if (error < 0.0 || error > maxError)
+				{
+					//candidate is rejected
+					continue;
+				}
+
+				//otherwise we keep track of the best one!
+				if (bestError < 0.0 || error < bestError)
+				{
+					if (bestCandidateIndex != candidates.size())
+						deferred.push_back(bestCandidateIndex);
+					bestCandidateIndex = candidateIndex;
+					bestError = error;
+
+					if (closestFirst)
+						break; //if we have found a good candidate, we stop here (closest first ;)
+				}
+				else
+				{
+					deferred.push_back(candidateIndex);
+				}
+			}
+
+			if (bestCandidateIndex == candidates.size())
+			{
+				//only far leaves remain...
 				break;
 			}
 
-			while (!cellsToTest.empty() || !candidates.empty())
+			unsigned bestLeafIndex = candidates[bestCandidateIndex].leafIndex;
+			facetMoments.add(leafInfo[bestLeafIndex].moments);
+			facetLeaves.push_back(bestLeafIndex);
+
+			//we will test this cell's neighbors as well
+			cellsToTest.push_back(bestLeafIndex);
+
+			//the deferred candidates will be tested again
+			for (size_t candidateIndex : deferred)
 			{
-				//get all neighbors around the 'waiting' cell(s)
-				if (!cellsToTest.empty())
+				queue.push_back(candidateIndex);
+				std::push_heap(queue.begin(), queue.end(), queueComparison);
+			}
+			deferred.clear();
+		} //no more candidates or cells to test
+	};
+
+	//seeds (or leaves above the threshold) of the current round
+	struct RoundItem
+	{
+		unsigned seedIndex;
+		bool aboveThreshold;
+		std::vector<unsigned> facetLeaves;
+	};
+	std::vector<RoundItem> roundItems;
+	std::vector<unsigned> postponedSeeds; //seeds to grow again (in the seeds order)
+	const size_t roundSize = 4 * static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+	unsigned nextSeedIndex = 0;
+
+	try
+	{
+		while (!cancelled)
+		{
+			//prepare the next round (the postponed seeds come first as their index is lower)
+			roundItems.clear();
+			for (unsigned seedIndex : postponedSeeds)
+			{
+				roundItems.push_back({ seedIndex, leaves[seedIndex]->error >= maxError, {} });
+			}
+			postponedSeeds.clear();
+			for (; roundItems.size() < roundSize && nextSeedIndex < leafCount; ++nextSeedIndex)
+			{
+				if (owners[nextSeedIndex] == -1)
 				{
-					ccKdTree::LeafSet neighbors;
-					while (!cellsToTest.empty())
-					{
-						if (!kdTree->getNeighborLeaves(cellsToTest.back(), neighbors, &unvisitedNeighborValue)) //we only consider unvisited cells!
-						{
-							//an error occurred
-							return false;
-						}
-						cellsToTest.pop_back();
-					}
+					roundItems.push_back({ nextSeedIndex, leaves[nextSeedIndex]->error >= maxError, {} });
+				}
+			}
+			if (roundItems.empty())
+			{
+				//no more seeds
+				break;
+			}
 
-					//add those (new) neighbors to the 'visitedNeighbors' set
-					//and to the candidates set by the way if they are not yet there
-					for (ccKdTree::LeafSet::iterator it=neighbors.begin(); it != neighbors.end(); ++it)
+			//grow the seeds in parallel
+			QFuture<void> future = QtConcurrent::map(roundItems, [&](RoundItem& item)
+			{
+				if (cancelled || item.aboveThreshold)
+					return;
+				try
+				{
+					growFacet(item.seedIndex, item.facetLeaves);
+				}
+				catch (const std::bad_alloc&)
+				{
+					notEnoughMemory = true;
+					cancelled = true;
+				}
+			});
+
+			//wait for the round to be processed (the progress is reported by the main thread)
+			while (!future.isFinished())
+			{
+				QThread::msleep(20);
+				if (progressCb)
+				{
+					progressCb->update(100.0f * claimedLeafCount / leafCount);
+					if (progressCb->isCancelRequested())
 					{
-						ccKdTree::Leaf* neighbor = *it;
-						std::pair<ccKdTree::LeafSet::iterator,bool> ret = visitedNeighbors.insert(neighbor);
-						//neighbour not already in the set?
-						if (ret.second)
-						{
-							//we create the corresponding candidate
-							try
-							{
-								candidates.push_back(Candidate(neighbor));
-							}
-							catch (const std::bad_alloc&)
-							{
-								//not enough memory!
-								ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
-								return false;
-							}
-						}
+						cancelled = true;
 					}
 				}
+				QApplication::processEvents();
+			}
+			if (cancelled)
+			{
+				break;
+			}
 
-				//is there remaining candidates?
-				if (!candidates.empty())
+			//commit the results (in the seeds order)
+			for (size_t i = 0; i < roundItems.size(); ++i)
+			{
+				const RoundItem& item = roundItems[i];
+				if (owners[item.seedIndex] != -1)
 				{
-					//update the set of candidates
-					if (closestFirst && candidates.size() > 1)
-					{
-						for (std::list<Candidate>::iterator it = candidates.begin(); it !=candidates.end(); ++it)
-							it->dist = (it->centroid-currentCentroid).norm2();
+					//already fused with a previous facet
+					continue;
+				}
 
-						//sort candidates by their distance
-						candidates.sort(CandidateDistAscendingComparison);
-					}
-					
-					//we will keep track of the best fused 'couple' at each pass
-					std::list<Candidate>::iterator bestIt = candidates.end();
-					CCCoreLib::ReferenceCloud* bestFused = nullptr;
-					CCVector3 bestNormal(0,0,0);
-					double bestError = -1.0;
-
-					unsigned skipCount = 0;
-					for (std::list<Candidate>::iterator it = candidates.begin(); it != candidates.end(); /*++it*/)
-					{
-						assert(it->leaf && it->leaf->points);
-						assert(currentPointSet->getAssociatedCloud() == it->leaf->points->getAssociatedCloud());
-
-						//if the leaf orientation is too different
-						if (fabs(CCVector3(it->leaf->planeEq).dot(currentNormal)) < c_minCosNormAngle)
-						{
-							it = candidates.erase(it);
-							//++it;
-							//++skipCount;
-							continue;
-						}
-
-						//compute the minimum distance between the candidate centroid and the 'currentPointSet'
-						PointCoordinateType minDistToMainSet = 0.0;
-						{
-							for (unsigned j = 0; j < currentPointSet->size(); ++j)
-							{
-								const CCVector3* P = currentPointSet->getPoint(j);
-								PointCoordinateType d2 = (*P - it->centroid).norm2();
-								if (d2 < minDistToMainSet || j == 0)
-									minDistToMainSet = d2;
-							}
-							minDistToMainSet = sqrt(minDistToMainSet);
-						}
-
-						//if the leaf is too far
-						if (it->radius < minDistToMainSet / overlapCoef)
-						{
-							++it;
-							++skipCount;
-							continue;
-						}
-
-						//fuse the main set with the current candidate
-						CCCoreLib::ReferenceCloud* fused = new CCCoreLib::ReferenceCloud(*currentPointSet);
-						if (!fused->add(*(it->leaf->points)))
-						{
-							//not enough memory!
-							ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
-							delete fused;
-							if (currentPointSet != currentCell->points)
-								delete currentPointSet;
-							return false;
-						}
-
-						//fit a plane and estimate the resulting error
-						double error = -1.0;
-						const PointCoordinateType* planeEquation = CCCoreLib::Neighbourhood(fused).getLSPlane();
-						if (planeEquation)
-							error = CCCoreLib::DistanceComputationTools::ComputeCloud2PlaneDistance(fused, planeEquation, errorMeasure);
-
-						if (error < 0.0 || error > maxError)
-						{
-							//candidate is rejected
-							it = candidates.erase(it);
-						}
-						else
-						{
-							//otherwise we keep track of the best one!
-							if (bestError < 0.0 || error < bestError)
-							{
-								bestIt = it;
-								bestError = error;
-								if (bestFused)
-									delete bestFused;
-								bestFused = fused;
-								bestNormal = CCVector3(planeEquation);
-								fused = nullptr;
-
-								if (closestFirst)
-									break; //if we have found a good candidate, we stop here (closest first ;)
-							}
-							++it;
-						}
-
-						if (fused)
-						{
-							delete fused;
-							fused = nullptr;
-						}
-					}
+				if (item.aboveThreshold)
+				{
+					owners[item.seedIndex] = 0;
+					++claimedLeafCount;
+					continue;
+				}
 
-					//we have a (best) candidate for this pass?
-					if (bestIt != candidates.end())
+				bool conflict = false;
+				for (unsigned leafIndex : item.facetLeaves)
+				{
+					if (owners[leafIndex] != -1)
 					{
-						assert(bestFused && bestError >= 0.0);
-						if (currentPointSet != currentCell->points)
-							delete currentPointSet;
-						currentPointSet = bestFused;
-						{
-							//update infos
-							CCCoreLib::Neighbourhood N(currentPointSet);
-							//currentCentroid = *N.getGravityCenter(); //if we update it, the search will naturally shift along one dimension!
-							//currentNormal = bestNormal; //same thing here for normals
-						}
-
-						bestIt->leaf->userData = currentCell->userData;
-
-						//we will test this cell's neighbors as well
-						cellsToTest.push_back(bestIt->leaf);
-
-						if (progressCb && !nProgress.oneStep()) //process canceled by user
-						{
-							//premature end!
-							candidates.clear();
-							cellsToTest.clear();
-							cancelled = true;
-							break;
-						}
-						QApplication::processEvents();
-
-						//we also remove it from the candidates list
-						candidates.erase(bestIt);
+						conflict = true;
+						break;
 					}
+				}
 
-					if (skipCount == candidates.size() && cellsToTest.empty())
+				if (conflict)
+				{
+					//the previous seeds win: this seed and the next ones will be grown again
+					for (size_t j = i; j < roundItems.size(); ++j)
 					{
-						//only far leaves remain...
-						candidates.clear();
+						postponedSeeds.push_back(roundItems[j].seedIndex);
 					}
-
+					break;
 				}
 
-			} //no more candidates or cells to test
-
-			//end of the fusion process for the current leaf
-			if (currentPointSet != currentCell->points)
-				delete currentPointSet;
-			currentPointSet = nullptr;
-
-			if (cancelled)
-				break;
+				const int label = static_cast<int>(item.seedIndex) + 1;
+				for (unsigned leafIndex : item.facetLeaves)
+				{
+					owners[leafIndex] = label;
+				}
+				claimedLeafCount += static_cast<unsigned>(item.facetLeaves.size());
+			}
 		}
 	}
+	catch (const std::bad_alloc&)
+	{
+		notEnoughMemory = true;
+		cancelled = true;
+	}
+
+	if (notEnoughMemory)
+	{
+		ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
+		return false;
+	}
 
 	//convert fused indexes to SF
 	if (!cancelled)
@@ -365,8 +613,22 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 			return false;
 		}
 
-		for (size_t i = 0; i < leaves.size(); ++i)
+		//the facets are numbered in the seeds order (starts at 1)
+		std::vector<int> facetIndexes(leafCount, 0);
+		int macroIndex = 1;
+		for (unsigned i = 0; i < leafCount; ++i)
 		{
+			if (owners[i] == static_cast<int>(i) + 1)
+			{
+				facetIndexes[i] = macroIndex++;
+			}
+		}
+
+		for (unsigned i = 0; i < leafCount; ++i)
+		{
+			int owner = owners[i];
+			leaves[i]->userData = (owner > 0 ? facetIndexes[owner - 1] : owner);
+
 			CCCoreLib::ReferenceCloud* subset = leaves[i]->points;
 			if (subset)
 			{
@@ -374,7 +636,6 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 				if (leaves[i]->userData <= 0) //for unfused cells, we create new individual groups
 				{
 					scalar = static_cast<ScalarType>(macroIndex++);
-					//scalar = NAN_VALUE; //FIXME TEST
 				}
 				for (unsigned j = 0; j < subset->size(); ++j)
 				{
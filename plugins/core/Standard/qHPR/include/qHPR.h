@@ -23,6 +23,9 @@
 //CCCoreLib
 #include <ReferenceCloud.h>
 
+class ccPointCloud;
+class ccPolyline;
+
 //! Wrapper to the "Hidden Point Removal" algorithm for approximating points visibility in an N dimensional point cloud, as seen from a given viewpoint
 /** "Direct Visibility of Point Sets", Sagi Katz, Ayellet Tal, and Ronen Basri.
 	SIGGRAPH 2007
@@ -45,16 +48,40 @@ public:
 	//inherited from ccStdPluginInterface
 	virtual void onNewSelection(const ccHObject::Container& selectedEntities) override;
 	virtual QList<QAction *> getActions() override;
+	virtual void registerCommands(ccCommandLineInterface* cmd) override;
+
+	//! Computes the visibility of the cloud points from multiple viewpoints (batch mode)
+	/** The cloud shape is approximated by the octree cells (at the given level) and the
+		HPR algorithm is applied once per viewpoint (in parallel). The number of viewpoints
+		from which each point is visible is stored in a scalar field.
+		The viewpoints for which qhull fails (e.g. degenerate set of cells) are skipped (with a warning).
+		\param cloud input cloud
+		\param viewPoints list of viewpoints (e.g. the vertices of a trajectory)
+		\param octreeLevel octree subdivision level (for point cloud shape approximation)
+		\param cropRadius only the cells closer than this radius to each viewpoint are considered (0 = no cropping)
+		\param progressCb optional progress callback
+		\param errorMessage optional error message (if the process fails)
+		\return the index of the visibility count scalar field (or -1 if the process failed)
+	**/
+	static int ComputeVisibilityCounts(	ccPointCloud* cloud,
+										const std::vector<CCVector3d>& viewPoints,
+										unsigned char octreeLevel,
+										double cropRadius = 0.0,
+										CCCoreLib::GenericProgressCallback* progressCb = nullptr,
+										QString* errorMessage = nullptr);
 
 protected:
 
 	//! Slot called when associated ation is triggered
 	void doAction();
 
+	//! Batch mode: computes the points visibility from all the vertices of a trajectory
+	void doBatchAction(ccPointCloud* cloud, ccPolyline* trajectory);
+
 protected:
 
 	//! Katz et al. algorithm
-	CCCoreLib::ReferenceCloud* removeHiddenPoints(CCCoreLib::GenericIndexedCloudPersist* theCloud, const CCVector3d& viewPoint, double fParam);
+	static CCCoreLib::ReferenceCloud* removeHiddenPoints(CCCoreLib::GenericIndexedCloudPersist* theCloud, const CCVector3d& viewPoint, double fParam);
 
 	//! Associated action
 	QAction* m_action;
@@ -0,0 +1,211 @@
+//##########################################################################
+//#                                                                        #
+//#                       CLOUDCOMPARE PLUGIN: qHPR                        #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#ifndef Q_HPR_PLUGIN_COMMANDS_HEADER
+#define Q_HPR_PLUGIN_COMMANDS_HEADER
+
+//CloudCompare
+#include "ccCommandLineInterface.h"
+
+//Local
+#include "qHPR.h"
+
+//qCC_db
+#include <ccPointCloud.h>
+#include <ccProgressDialog.h>
+
+//Qt
+#include <QFile>
+#include <QTextStream>
+
+static const char COMMAND_HPR[] = "HPR";
+static const char COMMAND_HPR_OCTREE_LEVEL[] = "OCTREE_LEVEL";
+static const char COMMAND_HPR_CROP_RADIUS[] = "CROP_RADIUS";
+static const char COMMAND_HPR_VIEWPOINTS[] = "VIEWPOINTS";
+
+//! Batch (multi-viewpoint) Hidden Point Removal
+/** Syntax: -HPR [-OCTREE_LEVEL level] [-CROP_RADIUS radius] [-VIEWPOINTS filename]
+	The viewpoints are read from an ASCII file (one 'X Y Z' triplet per line). If no
+	file is specified, the last loaded cloud is considered as the trajectory (its points
+	are the viewpoints) and the visibility counts are computed for all the other clouds.
+**/
+struct CommandHPR : public ccCommandLineInterface::Command
+{
+	CommandHPR() : ccCommandLineInterface::Command("HPR", COMMAND_HPR) {}
+
+	static bool LoadViewPoints(const QString& filename, std::vector<CCVector3d>& viewPoints)
+	{
+		QFile file(filename);
+		if (!file.open(QFile::ReadOnly | QFile::Text))
+		{
+			return false;
+		}
+
+		QTextStream stream(&file);
+		while (!stream.atEnd())
+		{
+			QStringList parts = stream.readLine().simplified().split(' ', QString::SkipEmptyParts);
+			if (parts.empty() || parts.front().startsWith("//"))
+			{
+				continue;
+			}
+			if (parts.size() < 3)
+			{
+				return false;
+			}
+
+			bool okX = false;
+			bool okY = false;
+			bool okZ = false;
+			CCVector3d P(parts[0].toDouble(&okX), parts[1].toDouble(&okY), parts[2].toDouble(&okZ));
+			if (!okX || !okY || !okZ)
+			{
+				return false;
+			}
+			viewPoints.push_back(P);
+		}
+
+		return true;
+	}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		cmd.print("[HPR]");
+
+		int octreeLevel = 7;
+		double cropRadius = 0.0;
+		QString viewPointsFilename;
+
+		while (!cmd.arguments().empty())
+		{
+			const QString& arg = cmd.arguments().front();
+			if (ccCommandLineInterface::IsCommand(arg, COMMAND_HPR_OCTREE_LEVEL))
+			{
+				cmd.arguments().pop_front();
+				bool conversionOk = false;
+				octreeLevel = (cmd.arguments().empty() ? -1 : cmd.arguments().takeFirst().toInt(&conversionOk));
+				if (!conversionOk || octreeLevel < 1 || octreeLevel > CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)
+				{
+					return cmd.error(QObject::tr("Invalid parameter: value after \"-%1\"").arg(COMMAND_HPR_OCTREE_LEVEL));
+				}
+			}
+			else if (ccCommandLineInterface::IsCommand(arg, COMMAND_HPR_CROP_RADIUS))
+			{
+				cmd.arguments().pop_front();
+				bool conversionOk = false;
+				cropRadius = (cmd.arguments().empty() ? -1.0 : cmd.arguments().takeFirst().toDouble(&conversionOk));
+				if (!conversionOk || cropRadius < 0)
+				{
+					return cmd.error(QObject::tr("Invalid parameter: value after \"-%1\"").arg(COMMAND_HPR_CROP_RADIUS));
+				}
+			}
+			else if (ccCommandLineInterface::IsCommand(arg, COMMAND_HPR_VIEWPOINTS))
+			{
+				cmd.arguments().pop_front();
+				if (cmd.arguments().empty())
+				{
+					return cmd.error(QObject::tr("Missing parameter: filename after \"-%1\"").arg(COMMAND_HPR_VIEWPOINTS));
+				}
+				viewPointsFilename = cmd.arguments().takeFirst();
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		//load the viewpoints
+		std::vector<CCVector3d> viewPoints;
+		size_t cloudCount = cmd.clouds().size();
+		try
+		{
+			if (!viewPointsFilename.isEmpty())
+			{
+				cmd.print(QObject::tr("Viewpoints file: '%1'").arg(viewPointsFilename));
+				if (!LoadViewPoints(viewPointsFilename, viewPoints))
+				{
+					return cmd.error(QObject::tr("Failed to read the viewpoints file '%1'").arg(viewPointsFilename));
+				}
+			}
+			else
+			{
+				//the last loaded cloud is the trajectory
+				if (cloudCount < 2)
+				{
+					return cmd.error(QObject::tr("Not enough clouds loaded (the last loaded cloud is used as trajectory if no viewpoints file is specified)"));
+				}
+				ccPointCloud* trajectory = cmd.clouds().back().pc;
+				--cloudCount;
+
+				viewPoints.reserve(trajectory->size());
+				for (unsigned i = 0; i < trajectory->size(); ++i)
+				{
+					viewPoints.push_back(CCVector3d::fromArray(trajectory->getPoint(i)->u));
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			return cmd.error(QObject::tr("Not enough memory"));
+		}
+
+		if (viewPoints.empty())
+		{
+			return cmd.error(QObject::tr("No viewpoint"));
+		}
+		if (cloudCount == 0)
+		{
+			return cmd.error(QObject::tr("No point cloud loaded"));
+		}
+		cmd.print(QObject::tr("Viewpoints: %1").arg(viewPoints.size()));
+
+		QScopedPointer<ccProgressDialog> progressDlg;
+		if (!cmd.silentMode())
+		{
+			progressDlg.reset(new ccProgressDialog(false, cmd.widgetParent()));
+			progressDlg->setAutoClose(false);
+		}
+
+		for (size_t i = 0; i < cloudCount; ++i)
+		{
+			CLCloudDesc& desc = cmd.clouds()[i];
+
+			QString errorMessage;
+			int sfIdx = qHPR::ComputeVisibilityCounts(desc.pc, viewPoints, static_cast<unsigned char>(octreeLevel), cropRadius, progressDlg.data(), &errorMessage);
+			if (sfIdx < 0)
+			{
+				return cmd.error(QObject::tr("Failed to compute the visibility of cloud '%1': %2").arg(desc.pc->getName(), errorMessage));
+			}
+			desc.pc->setCurrentDisplayedScalarField(sfIdx);
+			desc.basename += QObject::tr("_HPR");
+
+			//save output
+			if (cmd.autoSaveMode())
+			{
+				QString errorStr = cmd.exportEntity(desc);
+				if (!errorStr.isEmpty())
+				{
+					return cmd.error(errorStr);
+				}
+			}
+		}
+
+		return true;
+	}
+};
+
+#endif //Q_HPR_PLUGIN_COMMANDS_HEADER
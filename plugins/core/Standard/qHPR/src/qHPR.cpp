@@ -17,13 +17,21 @@
 
 #include "qHPR.h"
 #include "ccHprDlg.h"
+#include "qHPRCommands.h"
 
 //Qt
 #include <QtGui>
+#include <QApplication>
 #include <QMainWindow>
+#include <QMutex>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //qCC_db
+#include <ccHObjectCaster.h>
+#include <ccLog.h>
 #include <ccPointCloud.h>
+#include <ccPolyline.h>
 #include <ccOctree.h>
 #include <ccOctreeProxy.h>
 #include <ccProgressDialog.h>
@@ -41,6 +49,32 @@ extern "C"
 #include <qhull_a.h>
 }
 
+//system
+#include <atomic>
+
+//! Retrieves the cloud and the trajectory (polyline) from the current selection (batch mode)
+static bool GetCloudAndTrajectory(const ccHObject::Container& selectedEntities, ccPointCloud** cloud, ccPolyline** trajectory)
+{
+	if (selectedEntities.size() != 2)
+		return false;
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		ccHObject* first = selectedEntities[i];
+		ccHObject* second = selectedEntities[1 - i];
+		if (first->isA(CC_TYPES::POINT_CLOUD) && second->isA(CC_TYPES::POLY_LINE))
+		{
+			if (cloud)
+				*cloud = static_cast<ccPointCloud*>(first);
+			if (trajectory)
+				*trajectory = static_cast<ccPolyline*>(second);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 qHPR::qHPR(QObject* parent)
 	: QObject(parent)
 	, ccStdPluginInterface(":/CC/plugin/qHPR/info.json")
@@ -67,42 +101,50 @@ void qHPR::onNewSelection(const ccHObject::Container& selectedEntities)
 {
 	if (m_action)
 	{
-		//a single point cloud must be selected
-		m_action->setEnabled(selectedEntities.size() == 1 && selectedEntities.front()->isA(CC_TYPES::POINT_CLOUD));
+		//a single point cloud must be selected (optionally with a polyline for the batch mode)
+		m_action->setEnabled(	(selectedEntities.size() == 1 && selectedEntities.front()->isA(CC_TYPES::POINT_CLOUD))
+							||	(selectedEntities.size() == 2 && GetCloudAndTrajectory(selectedEntities, nullptr, nullptr)) );
 	}
 }
 
-CCCoreLib::ReferenceCloud* qHPR::removeHiddenPoints(CCCoreLib::GenericIndexedCloudPersist* theCloud, const CCVector3d& viewPoint, double fParam)
+void qHPR::registerCommands(ccCommandLineInterface* cmd)
 {
-	assert(theCloud);
+	if (!cmd)
+	{
+		assert(false);
+		return;
+	}
+	cmd->registerCommand(ccCommandLineInterface::Command::Shared(new CommandHPR));
+}
 
-	unsigned nbPoints = theCloud->size();
-	if (nbPoints == 0)
-		return nullptr;
+//! Lock protecting the qhull calls (the bundled qhull library relies on a global state)
+static QMutex s_qhullMutex;
 
-	//less than 4 points? no need for calculation, we return the whole cloud
-	if (nbPoints < 4)
+//! Default name of the (batch mode) visibility count scalar field
+constexpr char CC_HPR_VISIBILITY_COUNT_SF_NAME[] = "HPR visibility count";
+
+//! Converts a set of points to an array of spherically flipped coordinates (for qhull)
+/** The points are expressed relatively to the viewpoint, and the viewpoint itself
+	(i.e. the origin) is appended at the end of the array (Cf. HPR).
+**/
+template <class PointGetter> static bool SphericalFlipping(unsigned pointCount, PointGetter getPoint, const CCVector3d& viewPoint, double fParam, std::vector<coordT>& pt_array)
+{
+	try
 	{
-		CCCoreLib::ReferenceCloud* visiblePoints = new CCCoreLib::ReferenceCloud(theCloud);
-		if (!visiblePoints->addPointIndex(0, nbPoints)) //well even for less than 4 points we never know ;)
-		{
-			//not enough memory!
-			delete visiblePoints;
-			visiblePoints = nullptr;
-		}
-		return visiblePoints;
+		pt_array.resize((static_cast<size_t>(pointCount) + 1) * 3);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory!
+		return false;
 	}
 
 	double maxRadius = 0;
-
-	//convert point cloud to an array of double triplets (for qHull)
-	coordT* pt_array = new coordT[(nbPoints + 1) * 3];
 	{
-		coordT* _pt_array = pt_array;
-
-		for (unsigned i = 0; i < nbPoints; ++i)
+		coordT* _pt_array = pt_array.data();
+		for (unsigned i = 0; i < pointCount; ++i)
 		{
-			CCVector3d P = CCVector3d::fromArray(theCloud->getPoint(i)->u) - viewPoint;
+			CCVector3d P = getPoint(i) - viewPoint;
 			*_pt_array++ = static_cast<coordT>(P.x);
 			*_pt_array++ = static_cast<coordT>(P.y);
 			*_pt_array++ = static_cast<coordT>(P.z);
@@ -117,64 +159,77 @@ CCCoreLib::ReferenceCloud* qHPR::removeHiddenPoints(CCCoreLib::GenericIndexedClo
 		*_pt_array++ = 0;
 		*_pt_array++ = 0;
 		*_pt_array++ = 0;
-
-		maxRadius = sqrt(maxRadius);
 	}
 
 	//apply spherical flipping
 	{
-		maxRadius *= pow(10.0, fParam) * 2;
+		maxRadius = sqrt(maxRadius) * pow(10.0, fParam) * 2;
 
-		coordT* _pt_array = pt_array;
-		for (unsigned i = 0; i < nbPoints; ++i)
+		coordT* _pt_array = pt_array.data();
+		for (unsigned i = 0; i < pointCount; ++i, _pt_array += 3)
 		{
-			CCVector3d P = CCVector3d::fromArray(theCloud->getPoint(i)->u) - viewPoint;
-
-			double r = (maxRadius / P.norm()) - 1.0;
-			*_pt_array++ *= r;
-			*_pt_array++ *= r;
-			*_pt_array++ *= r;
+			double norm = sqrt(_pt_array[0] * _pt_array[0] + _pt_array[1] * _pt_array[1] + _pt_array[2] * _pt_array[2]);
+			if (norm == 0)
+				continue; //point located at the viewpoint
+
+			double r = (maxRadius / norm) - 1.0;
+			_pt_array[0] *= r;
+			_pt_array[1] *= r;
+			_pt_array[2] *= r;
 		}
 	}
 
-	//array to flag points on the convex hull
-	std::vector<bool> pointBelongsToCvxHull;
+	return true;
+}
+
+//! Result of FlagConvexHullPoints
+enum ConvexHullResult { CVX_HULL_SUCCESS, CVX_HULL_NOT_ENOUGH_MEMORY, CVX_HULL_QHULL_FAILURE };
 
+//! Flags the points belonging to the convex hull of a set of 3D points
+/** Thread-safe: the qhull calls are serialized.
+**/
+static ConvexHullResult FlagConvexHullPoints(std::vector<coordT>& pt_array, std::vector<bool>& pointBelongsToCvxHull)
+{
+	int pointCount = static_cast<int>(pt_array.size() / 3);
+
+	QMutexLocker locker(&s_qhullMutex);
+
+	ConvexHullResult result = CVX_HULL_QHULL_FAILURE;
 	static char qHullCommand[] = "qhull QJ Qci";
-	if (!qh_new_qhull(3, nbPoints + 1, pt_array, False, qHullCommand, nullptr, stderr))
+	if (!qh_new_qhull(3, pointCount, pt_array.data(), False, qHullCommand, nullptr, stderr))
 	{
 		try
 		{
-			pointBelongsToCvxHull.resize(nbPoints + 1, false);
+			pointBelongsToCvxHull.assign(pointCount, false);
+			result = CVX_HULL_SUCCESS;
 		}
 		catch (const std::bad_alloc&)
 		{
 			//not enough memory!
-			delete[] pt_array;
-			return nullptr;
+			result = CVX_HULL_NOT_ENOUGH_MEMORY;
 		}
 
-		vertexT *vertex = nullptr;
-		vertexT **vertexp = nullptr;
-		facetT *facet = nullptr;
-
-		FORALLfacets
+		if (result == CVX_HULL_SUCCESS)
 		{
-			//if (!facet->simplicial)
-			//	error("convhulln: non-simplicial facet"); // should never happen with QJ
+			vertexT *vertex = nullptr;
+			vertexT **vertexp = nullptr;
+			facetT *facet = nullptr;
 
-			setT* vertices = qh_facet3vertex(facet);
-			FOREACHvertex_(vertices)
+			FORALLfacets
 			{
-				pointBelongsToCvxHull[qh_pointid(vertex->point)] = true;
+				//if (!facet->simplicial)
+				//	error("convhulln: non-simplicial facet"); // should never happen with QJ
+
+				setT* vertices = qh_facet3vertex(facet);
+				FOREACHvertex_(vertices)
+				{
+					pointBelongsToCvxHull[qh_pointid(vertex->point)] = true;
+				}
+				qh_settempfree(&vertices);
 			}
-			qh_settempfree(&vertices);
 		}
 	}
 
-	delete[] pt_array;
-	pt_array = nullptr;
-
 	qh_freeqhull(!qh_ALL);
 	//free long memory
 	int curlong = 0;
@@ -182,7 +237,45 @@ CCCoreLib::ReferenceCloud* qHPR::removeHiddenPoints(CCCoreLib::GenericIndexedClo
 	qh_memfreeshort(&curlong, &totlong);
 	//free short memory and memory allocator
 
-	if (!pointBelongsToCvxHull.empty())
+	return result;
+}
+
+CCCoreLib::ReferenceCloud* qHPR::removeHiddenPoints(CCCoreLib::GenericIndexedCloudPersist* theCloud, const CCVector3d& viewPoint, double fParam)
+{
+	assert(theCloud);
+
+	unsigned nbPoints = theCloud->size();
+	if (nbPoints == 0)
+		return nullptr;
+
+	//less than 4 points? no need for calculation, we return the whole cloud
+	if (nbPoints < 4)
+	{
+		CCCoreLib::ReferenceCloud* visiblePoints = new CCCoreLib::ReferenceCloud(theCloud);
+		if (!visiblePoints->addPointIndex(0, nbPoints)) //well even for less than 4 points we never know ;)
+		{
+			//not enough memory!
+			delete visiblePoints;
+			visiblePoints = nullptr;
+		}
+		return visiblePoints;
+	}
+
+	//convert point cloud to an array of double triplets (for qHull)
+	std::vector<coordT> pt_array;
+	if (!SphericalFlipping(nbPoints, [theCloud](unsigned i) { return CCVector3d::fromArray(theCloud->getPoint(i)->u); }, viewPoint, fParam, pt_array))
+	{
+		//not enough memory!
+		return nullptr;
+	}
+
+	//array to flag points on the convex hull
+	std::vector<bool> pointBelongsToCvxHull;
+	bool success = (FlagConvexHullPoints(pt_array, pointBelongsToCvxHull) == CVX_HULL_SUCCESS);
+	pt_array.clear();
+	pt_array.shrink_to_fit();
+
+	if (success)
 	{
 		//compute the number of points belonging to the convex hull
 		unsigned cvxHullSize = 0;
@@ -212,6 +305,244 @@ CCCoreLib::ReferenceCloud* qHPR::removeHiddenPoints(CCCoreLib::GenericIndexedClo
 	return nullptr;
 }
 
+int qHPR::ComputeVisibilityCounts(	ccPointCloud* cloud,
+									const std::vector<CCVector3d>& viewPoints,
+									unsigned char octreeLevel,
+									double cropRadius/*=0.0*/,
+									CCCoreLib::GenericProgressCallback* progressCb/*=nullptr*/,
+									QString* errorMessage/*=nullptr*/)
+{
+	auto failure = [errorMessage](const QString& message)
+	{
+		if (errorMessage)
+			*errorMessage = message;
+		return -1;
+	};
+
+	if (!cloud || cloud->size() == 0)
+	{
+		return failure("Invalid input cloud");
+	}
+	if (viewPoints.empty())
+	{
+		return failure("No viewpoint");
+	}
+	assert(octreeLevel <= CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL);
+
+	//compute octree if cloud hasn't any
+	ccOctree::Shared theOctree = cloud->getOctree();
+	if (!theOctree)
+	{
+		theOctree = cloud->computeOctree(progressCb);
+		if (!theOctree)
+		{
+			return failure("Couldn't compute octree!");
+		}
+	}
+
+	//the cloud shape is approximated once by the octree cells (shared by all viewpoints)
+	std::vector<CCVector3d> cellCenters;
+	{
+		QScopedPointer<CCCoreLib::ReferenceCloud> theCellCenters(CCCoreLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel(	cloud,
+																																octreeLevel,
+																																CCCoreLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER,
+																																progressCb,
+																																theOctree.data()));
+		if (!theCellCenters)
+		{
+			return failure("Error while simplifying point cloud with octree!");
+		}
+
+		try
+		{
+			cellCenters.resize(theCellCenters->size());
+		}
+		catch (const std::bad_alloc&)
+		{
+			return failure("Not enough memory!");
+		}
+		for (unsigned i = 0; i < theCellCenters->size(); ++i)
+		{
+			cellCenters[i] = CCVector3d::fromArray(theCellCenters->getPoint(i)->u);
+		}
+	}
+	unsigned cellCount = static_cast<unsigned>(cellCenters.size());
+
+	//number of viewpoints from which each cell is visible
+	std::vector< std::atomic<unsigned> > cellVisibilityCounts(cellCount);
+	for (std::atomic<unsigned>& count : cellVisibilityCounts)
+	{
+		count = 0;
+	}
+
+	//progress notification
+	if (progressCb)
+	{
+		progressCb->update(0);
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Hidden Point Removal (batch)");
+			progressCb->setInfo(qPrintable(QString("Viewpoints: %1\nCells: %2").arg(viewPoints.size()).arg(cellCount)));
+		}
+		progressCb->start();
+	}
+
+	double squareCropRadius = cropRadius * cropRadius;
+	std::atomic<unsigned> processedViewPoints(0);
+	std::atomic<bool> cancelled(false);
+	std::atomic<bool> notEnoughMemory(false);
+	std::atomic<unsigned> qhullFailures(0);
+
+	//each viewpoint is processed independently: the cropping and the spherical flipping
+	//are done in parallel, and only the convex hull computation is serialized (qhull)
+	auto processViewPoint = [&](const CCVector3d& viewPoint)
+	{
+		if (cancelled)
+			return;
+
+		try
+		{
+			//spatial cropping
+			std::vector<unsigned> cellIndexes;
+			cellIndexes.reserve(cellCount);
+			for (unsigned i = 0; i < cellCount; ++i)
+			{
+				if (cropRadius <= 0 || (cellCenters[i] - viewPoint).norm2() <= squareCropRadius)
+				{
+					cellIndexes.push_back(i);
+				}
+			}
+			unsigned subsetSize = static_cast<unsigned>(cellIndexes.size());
+
+			if (subsetSize < 4)
+			{
+				//less than 4 points: they are all visible
+				for (unsigned index : cellIndexes)
+				{
+					++cellVisibilityCounts[index];
+				}
+			}
+			else
+			{
+				std::vector<coordT> pt_array;
+				std::vector<bool> pointBelongsToCvxHull;
+				if (!SphericalFlipping(subsetSize, [&](unsigned i) { return cellCenters[cellIndexes[i]]; }, viewPoint, 3.5, pt_array))
+				{
+					notEnoughMemory = true;
+					cancelled = true;
+					return;
+				}
+
+				switch (FlagConvexHullPoints(pt_array, pointBelongsToCvxHull))
+				{
+				case CVX_HULL_SUCCESS:
+					for (unsigned i = 0; i < subsetSize; ++i)
+					{
+						if (pointBelongsToCvxHull[i])
+						{
+							++cellVisibilityCounts[cellIndexes[i]];
+						}
+					}
+					break;
+
+				case CVX_HULL_NOT_ENOUGH_MEMORY:
+					notEnoughMemory = true;
+					cancelled = true;
+					return;
+
+				case CVX_HULL_QHULL_FAILURE:
+					//qhull failed (e.g. degenerate subset of cells): this viewpoint is skipped
+					++qhullFailures;
+					break;
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			notEnoughMemory = true;
+			cancelled = true;
+			return;
+		}
+
+		++processedViewPoints;
+	};
+
+	QFuture<void> future = QtConcurrent::map(viewPoints, processViewPoint);
+
+	//wait for the viewpoints to be processed (the progress is reported by the main thread)
+	while (!future.isFinished())
+	{
+		QThread::msleep(50);
+		if (progressCb)
+		{
+			progressCb->update(100.0f * processedViewPoints / viewPoints.size());
+			if (progressCb->isCancelRequested())
+			{
+				cancelled = true;
+			}
+		}
+		QApplication::processEvents();
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (notEnoughMemory)
+	{
+		return failure("Not enough memory!");
+	}
+	if (cancelled)
+	{
+		return failure("Process cancelled by the user");
+	}
+	if (qhullFailures == viewPoints.size())
+	{
+		return failure("Failed to compute the convex hull (qhull) for all the viewpoints! (degenerate cloud?)");
+	}
+	else if (qhullFailures != 0)
+	{
+		ccLog::Warning(QString("[HPR] Failed to compute the convex hull (qhull) for %1 viewpoint(s): they have been skipped").arg(qhullFailures.load()));
+	}
+
+	//eventually, we project the cells visibility on the points
+	int sfIdx = cloud->getScalarFieldIndexByName(CC_HPR_VISIBILITY_COUNT_SF_NAME);
+	if (sfIdx < 0)
+	{
+		sfIdx = cloud->addScalarField(CC_HPR_VISIBILITY_COUNT_SF_NAME);
+		if (sfIdx < 0)
+		{
+			return failure("Not enough memory!");
+		}
+	}
+	CCCoreLib::ScalarField* sf = cloud->getScalarField(sfIdx);
+	assert(sf);
+
+	CCCoreLib::DgmOctree::cellIndexesContainer cellCodes;
+	if (!theOctree->getCellIndexes(octreeLevel, cellCodes) || cellCodes.size() != cellCount)
+	{
+		cloud->deleteScalarField(sfIdx);
+		return failure("Couldn't fetch the list of octree cell indexes! (Not enough memory?)");
+	}
+
+	CCCoreLib::ReferenceCloud Yk(theOctree->associatedCloud());
+	for (unsigned i = 0; i < cellCount; ++i)
+	{
+		//points in this cell...
+		theOctree->getPointsInCellByCellIndex(&Yk, cellCodes[i], octreeLevel);
+		//...share the same visibility count
+		ScalarType count = static_cast<ScalarType>(cellVisibilityCounts[i].load());
+		for (unsigned j = 0; j < Yk.size(); ++j)
+		{
+			sf->setValue(Yk.getPointGlobalIndex(j), count);
+		}
+	}
+	sf->computeMinAndMax();
+
+	return sfIdx;
+}
+
 void qHPR::doAction()
 {
 	assert(m_app);
@@ -220,9 +551,20 @@ void qHPR::doAction()
 
 	const ccHObject::Container& selectedEntities = m_app->getSelectedEntities();
 
+	//batch mode: the viewpoints are the vertices of the selected polyline
+	{
+		ccPointCloud* cloud = nullptr;
+		ccPolyline* trajectory = nullptr;
+		if (GetCloudAndTrajectory(selectedEntities, &cloud, &trajectory))
+		{
+			doBatchAction(cloud, trajectory);
+			return;
+		}
+	}
+
 	if (!m_app->haveOneSelection() || !selectedEntities.front()->isA(CC_TYPES::POINT_CLOUD))
 	{
-		m_app->dispToConsole("Select only one cloud!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		m_app->dispToConsole("Select only one cloud (and optionally a trajectory polyline)!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
 		return;
 	}
 
@@ -243,6 +585,7 @@ void qHPR::doAction()
 	}
 
 	ccHprDlg dlg(m_app->getMainWindow());
+	dlg.cropRadiusDoubleSpinBox->setEnabled(false); //batch mode only
 	if (!dlg.exec())
 		return;
 
@@ -388,3 +731,70 @@ void qHPR::doAction()
 	//currently selected entities appearance may have changed!
 	m_app->refreshAll();
 }
+
+void qHPR::doBatchAction(ccPointCloud* cloud, ccPolyline* trajectory)
+{
+	assert(m_app && cloud && trajectory);
+
+	CCCoreLib::GenericIndexedCloudPersist* vertices = trajectory->getAssociatedCloud();
+	if (!vertices || trajectory->size() == 0)
+	{
+		m_app->dispToConsole("Empty trajectory!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return;
+	}
+
+	std::vector<CCVector3d> viewPoints;
+	try
+	{
+		viewPoints.reserve(trajectory->size());
+		for (unsigned i = 0; i < trajectory->size(); ++i)
+		{
+			viewPoints.push_back(CCVector3d::fromArray(trajectory->getPoint(i)->u));
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		m_app->dispToConsole("Not enough memory!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return;
+	}
+
+	ccHprDlg dlg(m_app->getMainWindow());
+	if (!dlg.exec())
+		return;
+
+	int octreeLevel = dlg.octreeLevelSpinBox->value();
+	assert(octreeLevel >= 0 && octreeLevel <= CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL);
+	double cropRadius = dlg.cropRadiusDoubleSpinBox->value();
+
+	//progress dialog
+	ccProgressDialog progressCb(true, m_app->getMainWindow());
+
+	bool hadOctree = static_cast<bool>(cloud->getOctree());
+
+	QElapsedTimer eTimer;
+	eTimer.start();
+
+	QString errorMessage;
+	int sfIdx = ComputeVisibilityCounts(cloud, viewPoints, static_cast<unsigned char>(octreeLevel), cropRadius, &progressCb, &errorMessage);
+
+	if (!hadOctree && cloud->getOctree() && cloud->getParent())
+	{
+		m_app->addToDB(cloud->getOctreeProxy());
+	}
+
+	if (sfIdx < 0)
+	{
+		m_app->dispToConsole(QString("[HPR] %1").arg(errorMessage), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return;
+	}
+
+	m_app->dispToConsole(QString("[HPR] Viewpoints: %1 - Time: %2 s").arg(viewPoints.size()).arg(eTimer.elapsed() / 1.0e3));
+
+	cloud->setCurrentDisplayedScalarField(sfIdx);
+	cloud->showSF(true);
+	cloud->prepareDisplayForRefresh();
+
+	//currently selected entities appearance may have changed!
+	m_app->updateUI();
+	m_app->refreshAll();
+}
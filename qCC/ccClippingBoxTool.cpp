@@ -15,6 +15,10 @@
 //#                                                                        #
 //##########################################################################
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 #include "ccClippingBoxTool.h"
 
 //Local
@@ -36,6 +40,11 @@
 
 //Qt
 #include <QMessageBox>
+#include <QThread>
+#include <QtConcurrentMap>
+
+//System
+#include <atomic>
 
 namespace
 {
@@ -540,6 +549,90 @@ static unsigned ComputeGridDimensions(	const ccBBox& localBox,
 	return cellCount;
 }
 
+//! Adds the points of a cloud (expressed in the local clipping box ref.) to a bounding-box
+static void AddToLocalBoundingBox(	ccGenericPointCloud* cloud,
+									const ccGLMatrix& localTrans,
+									ccBBox& localBox)
+{
+	assert(cloud);
+	const unsigned pointCount = cloud->size();
+
+	//we process the points by chunks (one bounding-box per chunk)
+	static const unsigned c_chunkSize = 65536;
+	const int chunkCount = static_cast<int>((pointCount + c_chunkSize - 1) / c_chunkSize);
+	std::vector<ccBBox> chunkBoxes(chunkCount);
+
+#ifdef CC_CORE_LIB_USES_TBB
+	tbb::parallel_for(0, chunkCount, [&](int c)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int c = 0; c < chunkCount; ++c)
+#endif
+	{
+		unsigned firstIndex = static_cast<unsigned>(c) * c_chunkSize;
+		unsigned lastIndex = std::min(firstIndex + c_chunkSize, pointCount);
+		ccBBox& chunkBox = chunkBoxes[c];
+		for (unsigned i = firstIndex; i < lastIndex; ++i)
+		{
+			CCVector3 P = *cloud->getPoint(i);
+			localTrans.apply(P);
+			chunkBox.add(P);
+		}
+	}
+#ifdef CC_CORE_LIB_USES_TBB
+	);
+#endif
+
+	for (const ccBBox& chunkBox : chunkBoxes)
+	{
+		if (chunkBox.isValid())
+		{
+			localBox.add(chunkBox.minCorner());
+			localBox.add(chunkBox.maxCorner());
+		}
+	}
+}
+
+//! Applies a function to all the items of a vector in parallel (with progress and cancellation)
+/** \return false if the process was canceled by the user
+**/
+template <class Item, class Function> static bool ProcessInParallel(std::vector<Item>& items,
+																	Function func,
+																	ccProgressDialog* progressDialog)
+{
+	std::atomic<int> processedCount(0);
+	QFuture<void> future = QtConcurrent::map(items, [&](Item& item)
+	{
+		func(item);
+		++processedCount;
+	});
+
+	while (!future.isFinished())
+	{
+		if (progressDialog)
+		{
+			progressDialog->setValue(processedCount);
+			QApplication::processEvents();
+			if (progressDialog->wasCanceled())
+			{
+				future.cancel();
+				future.waitForFinished();
+				return false;
+			}
+		}
+		QThread::msleep(20);
+	}
+
+	if (progressDialog)
+	{
+		progressDialog->setValue(processedCount);
+	}
+
+	return true;
+}
+
 bool ccClippingBoxTool::ExtractSlicesAndContours
 (
 	const std::vector<ccGenericPointCloud*>& clouds,
@@ -653,12 +746,7 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				ccBBox localBox;
 				for (ccGenericPointCloud* cloud : clouds)
 				{
-					for (unsigned i = 0; i < cloud->size(); ++i)
-					{
-						CCVector3 P = *cloud->getPoint(i);
-						localTrans.apply(P);
-						localBox.add(P);
-					}
+					AddToLocalBoundingBox(cloud, localTrans, localBox);
 				}
 
 				int indexMins[3]{ 0, 0, 0 };
@@ -681,7 +769,9 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				unsigned subCloudsCount = 0;
 
 				//project points into grid
-				for (size_t ci = 0; ci != clouds.size(); ++ci)
+				std::vector<int> pointCells;
+				std::vector<unsigned> cellPointCounts;
+				for (size_t ci = 0; ci != clouds.size() && !error; ++ci)
 				{
 					ccGenericPointCloud* cloud = clouds[ci];
 					unsigned pointCount = cloud->size();
@@ -694,10 +784,19 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 					}
 					QApplication::processEvents();
 
-					CCCoreLib::NormalizedProgress nProgress(progressDialog, pointCount);
-					for (unsigned i = 0; i < pointCount; ++i)
+					//compute the cell index of each point (in parallel)
+					pointCells.resize(pointCount);
+					int pointCountInt = static_cast<int>(pointCount);
+#ifdef CC_CORE_LIB_USES_TBB
+					tbb::parallel_for(0, pointCountInt, [&](int i)
+#else
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+					for (int i = 0; i < pointCountInt; ++i)
+#endif
 					{
-						CCVector3 P = *cloud->getPoint(i);
+						CCVector3 P = *cloud->getPoint(static_cast<unsigned>(i));
 						localTrans.apply(P);
 
 						//relative coordinates (between 0 and 1)
@@ -718,17 +817,36 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 							&&	(P.y - static_cast<PointCoordinateType>(yi))*cellSizePlusGap.y <= cellSize.y
 							&&	(P.z - static_cast<PointCoordinateType>(zi))*cellSizePlusGap.z <= cellSize.z))
 						{
-							int cloudIndex = ((zi - indexMins[2]) * static_cast<int>(gridDim[1]) + (yi - indexMins[1])) * static_cast<int>(gridDim[0]) + (xi - indexMins[0]);
-							assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() + ci < refClouds.size());
+							pointCells[i] = ((zi - indexMins[2]) * static_cast<int>(gridDim[1]) + (yi - indexMins[1])) * static_cast<int>(gridDim[0]) + (xi - indexMins[0]);
+						}
+						else
+						{
+							pointCells[i] = -1; //in the gap
+						}
+					}
+#ifdef CC_CORE_LIB_USES_TBB
+					);
+#endif
 
-							CCCoreLib::ReferenceCloud*& destCloud = refClouds[cloudIndex * clouds.size() + ci];
-							if (!destCloud)
-							{
-								destCloud = new CCCoreLib::ReferenceCloud(cloud);
-								++subCloudsCount;
-							}
+					//count the points per cell (so as to allocate the reference clouds only once)
+					cellPointCounts.assign(cellCount, 0);
+					for (int cloudIndex : pointCells)
+					{
+						if (cloudIndex >= 0)
+						{
+							++cellPointCounts[cloudIndex];
+						}
+					}
 
-							if (!destCloud->addPointIndex(i))
+					for (unsigned cloudIndex = 0; cloudIndex < cellCount; ++cloudIndex)
+					{
+						if (cellPointCounts[cloudIndex] != 0)
+						{
+							assert(static_cast<size_t>(cloudIndex)* clouds.size() + ci < refClouds.size());
+							CCCoreLib::ReferenceCloud*& destCloud = refClouds[cloudIndex * clouds.size() + ci];
+							destCloud = new CCCoreLib::ReferenceCloud(cloud);
+							++subCloudsCount;
+							if (!destCloud->reserve(cellPointCounts[cloudIndex]))
 							{
 								ccLog::Error("Not enough memory!");
 								error = true;
@@ -737,9 +855,56 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 						}
 					}
 
-					nProgress.oneStep();
+					//eventually fill the reference clouds
+					for (unsigned i = 0; i < pointCount && !error; ++i)
+					{
+						int cloudIndex = pointCells[i];
+						if (cloudIndex >= 0)
+						{
+							//enough memory has already been reserved
+							refClouds[cloudIndex * clouds.size() + ci]->addPointIndex(i);
+						}
+					}
 				} //project points into grid
 
+				pointCells.clear();
+				pointCells.shrink_to_fit();
+
+				//list the slices to extract (in the same order as the former sequential process)
+				struct SliceToExtract
+				{
+					int i, j, k;
+					size_t ci;
+					CCCoreLib::ReferenceCloud* refCloud;
+					ccPointCloud* sliceCloud;
+					int warnings;
+				};
+				std::vector<SliceToExtract> slicesToExtract;
+				if (!error)
+				{
+					slicesToExtract.reserve(subCloudsCount);
+					for (int i = indexMins[0]; i <= indexMaxs[0]; ++i)
+					{
+						for (int j = indexMins[1]; j <= indexMaxs[1]; ++j)
+						{
+							for (int k = indexMins[2]; k <= indexMaxs[2]; ++k)
+							{
+								int cloudIndex = ((k - indexMins[2]) * static_cast<int>(gridDim[1]) + (j - indexMins[1])) * static_cast<int>(gridDim[0]) + (i - indexMins[0]);
+								assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() < refClouds.size());
+
+								for (size_t ci = 0; ci != clouds.size(); ++ci)
+								{
+									CCCoreLib::ReferenceCloud* destCloud = refClouds[cloudIndex * clouds.size() + ci];
+									if (destCloud) //some slices can be empty!
+									{
+										slicesToExtract.push_back({ i, j, k, ci, destCloud, nullptr, 0 });
+									}
+								}
+							}
+						}
+					}
+				}
+
 				if (progressDialog)
 				{
 					progressDialog->setWindowTitle(QObject::tr("Section extraction"));
@@ -749,88 +914,66 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 					QApplication::processEvents();
 				}
 
-				//reset count
-				subCloudsCount = 0;
+				//now create the real clouds (in parallel)
+				if (!error && !ProcessInParallel(slicesToExtract, [&](SliceToExtract& slice)
+					{
+						//generate slice from previous selection
+						ccGenericPointCloud* cloud = clouds[slice.ci];
+						slice.sliceCloud = cloud->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(cloud)->partialClone(slice.refCloud, &slice.warnings) : ccPointCloud::From(slice.refCloud, cloud);
+					}, progressDialog))
+				{
+					error = true;
+					ccLog::Warning(QString("[ExtractSlicesAndContours] Process canceled by user"));
+				}
 
-				//now create the real clouds
-				for (int i = indexMins[0]; i <= indexMaxs[0]; ++i)
+				//and finalize them (sequentially)
+				for (SliceToExtract& slice : slicesToExtract)
 				{
-					for (int j = indexMins[1]; j <= indexMaxs[1]; ++j)
+					ccPointCloud* sliceCloud = slice.sliceCloud;
+					if (!sliceCloud)
 					{
-						for (int k = indexMins[2]; k <= indexMaxs[2]; ++k)
-						{
-							int cloudIndex = ((k - indexMins[2]) * static_cast<int>(gridDim[1]) + (j - indexMins[1])) * static_cast<int>(gridDim[0]) + (i - indexMins[0]);
-							assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() < refClouds.size());
-
-							for (size_t ci = 0; ci != clouds.size(); ++ci)
-							{
-								ccGenericPointCloud* cloud = clouds[ci];
-								CCCoreLib::ReferenceCloud* destCloud = refClouds[cloudIndex * clouds.size() + ci];
-								if (destCloud) //some slices can be empty!
-								{
-									//generate slice from previous selection
-									int warnings = 0;
-									ccPointCloud* sliceCloud = cloud->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(cloud)->partialClone(destCloud, &warnings) : ccPointCloud::From(destCloud, cloud);
-									warningsIssued |= (warnings != 0);
-
-									if (sliceCloud)
-									{
-										if (generateRandomColors)
-										{
-											ccColor::Rgb col = ccColor::Generator::Random();
-											if (!sliceCloud->setColor(col))
-											{
-												ccLog::Error("Not enough memory!");
-												error = true;
-												i = indexMaxs[0];
-												j = indexMaxs[1];
-												k = indexMaxs[2];
-											}
-											sliceCloud->showColors(true);
-										}
-
-										sliceCloud->setEnabled(true);
-										sliceCloud->setVisible(true);
-										sliceCloud->setDisplay(cloud->getDisplay());
+						continue;
+					}
+					if (error)
+					{
+						delete sliceCloud;
+						continue;
+					}
+					warningsIssued |= (slice.warnings != 0);
 
-										CCVector3 cellOrigin(	gridOrigin.x + i * cellSizePlusGap.x,
-																gridOrigin.y + j * cellSizePlusGap.y,
-																gridOrigin.z + k * cellSizePlusGap.z);
-										QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
-										sliceCloud->setName(cloud->getName() + QString(".slice @ ") + slicePosStr);
+					ccGenericPointCloud* cloud = clouds[slice.ci];
 
-										//set meta-data
-										sliceCloud->setMetaData(s_originEntityUUID, cloud->getUniqueID());
-										sliceCloud->setMetaData(s_sliceID, slicePosStr);
-										sliceCloud->setMetaData("slice.origin.dim(0)", cellOrigin.x);
-										sliceCloud->setMetaData("slice.origin.dim(1)", cellOrigin.y);
-										sliceCloud->setMetaData("slice.origin.dim(2)", cellOrigin.z);
+					if (generateRandomColors)
+					{
+						ccColor::Rgb col = ccColor::Generator::Random();
+						if (!sliceCloud->setColor(col))
+						{
+							ccLog::Error("Not enough memory!");
+							error = true;
+						}
+						sliceCloud->showColors(true);
+					}
 
-										//add slice to group
-										outputSlices.push_back(sliceCloud);
-										++subCloudsCount;
+					sliceCloud->setEnabled(true);
+					sliceCloud->setVisible(true);
+					sliceCloud->setDisplay(cloud->getDisplay());
 
-										if (progressDialog)
-										{
-											progressDialog->setValue(static_cast<int>(subCloudsCount));
-										}
-									}
+					CCVector3 cellOrigin(	gridOrigin.x + slice.i * cellSizePlusGap.x,
+											gridOrigin.y + slice.j * cellSizePlusGap.y,
+											gridOrigin.z + slice.k * cellSizePlusGap.z);
+					QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
+					sliceCloud->setName(cloud->getName() + QString(".slice @ ") + slicePosStr);
 
-									if (progressDialog && progressDialog->wasCanceled())
-									{
-										error = true;
-										ccLog::Warning(QString("[ExtractSlicesAndContours] Process canceled by user"));
-										//early stop
-										i = indexMaxs[0];
-										j = indexMaxs[1];
-										k = indexMaxs[2];
-										break;
-									}
-								}
-							}
-						}
-					}
-				} //now create the real clouds
+					//set meta-data
+					sliceCloud->setMetaData(s_originEntityUUID, cloud->getUniqueID());
+					sliceCloud->setMetaData(s_sliceID, slicePosStr);
+					sliceCloud->setMetaData("slice.origin.dim(0)", cellOrigin.x);
+					sliceCloud->setMetaData("slice.origin.dim(1)", cellOrigin.y);
+					sliceCloud->setMetaData("slice.origin.dim(2)", cellOrigin.z);
+
+					//add slice to group
+					outputSlices.push_back(sliceCloud);
+				}
 
 				//release memory
 				{
@@ -850,13 +993,7 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				ccBBox localBox;
 				for (ccGenericMesh* mesh : meshes)
 				{
-					ccGenericPointCloud* cloud = mesh->getAssociatedCloud();
-					for (unsigned i = 0; i < cloud->size(); ++i)
-					{
-						CCVector3 P = *cloud->getPoint(i);
-						localTrans.apply(P);
-						localBox.add(P);
-					}
+					AddToLocalBoundingBox(mesh->getAssociatedCloud(), localTrans, localBox);
 				}
 
 				int indexMins[3]{ 0, 0, 0 };
@@ -1137,13 +1274,13 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 			//preferred dimension?
 			PointCoordinateType* preferredNormDir = nullptr;
 			PointCoordinateType* preferredUpDir = nullptr;
+			ccGLMatrix invLocalTrans = localTrans.inverse();
 			if (repeatDimensionsSum == 1)
 			{
 				for (int i = 0; i < 3; ++i)
 				{
 					if (repeatDimensions[i])
 					{
-						ccGLMatrix invLocalTrans = localTrans.inverse();
 						if (!projectOnBestFitPlane) //otherwise the normal will be automatically computed
 							preferredNormDir = invLocalTrans.getColumn(i);
 						preferredUpDir = invLocalTrans.getColumn(i < 2 ? 2 : 0);
@@ -1154,22 +1291,63 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 
 			assert(cloudSliceCount <= outputSlices.size());
 
-			//process all the slices originating from point clouds
+			struct EnvelopeToExtract
+			{
+				ccPointCloud* sliceCloud;
+				std::vector<ccPolyline*> polys;
+				bool success;
+			};
+			std::vector<EnvelopeToExtract> envelopesToExtract(cloudSliceCount);
 			for (size_t i = 0; i < cloudSliceCount; ++i)
 			{
-				ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
-				assert(sliceCloud);
+				envelopesToExtract[i].sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+				assert(envelopesToExtract[i].sliceCloud);
+				envelopesToExtract[i].success = false;
+			}
 
-				std::vector<ccPolyline*> polys;
-				if (ccEnvelopeExtractor::ExtractFlatEnvelope(sliceCloud,
+			auto extractEnvelope = [&](EnvelopeToExtract& envelope)
+			{
+				envelope.success = ccEnvelopeExtractor::ExtractFlatEnvelope(envelope.sliceCloud,
 					multiPass,
 					maxEdgeLength,
-					polys,
+					envelope.polys,
 					envelopeType,
 					splitEnvelopes,
 					preferredNormDir,
 					preferredUpDir,
-					visualDebugMode))
+					visualDebugMode);
+			};
+
+			//process all the slices originating from point clouds
+			if (visualDebugMode)
+			{
+				//the debug mode requires a sequential process (display)
+				for (EnvelopeToExtract& envelope : envelopesToExtract)
+				{
+					extractEnvelope(envelope);
+				}
+			}
+			else if (!ProcessInParallel(envelopesToExtract, extractEnvelope, progressDialog))
+			{
+				error = true;
+				ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
+			}
+
+			for (EnvelopeToExtract& envelope : envelopesToExtract)
+			{
+				ccPointCloud* sliceCloud = envelope.sliceCloud;
+				std::vector<ccPolyline*>& polys = envelope.polys;
+
+				if (error)
+				{
+					for (ccPolyline* poly : polys)
+					{
+						delete poly;
+					}
+					continue;
+				}
+
+				if (envelope.success)
 				{
 					if (!polys.empty())
 					{
@@ -1209,18 +1387,6 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 					ccLog::Warning(tr("%1: envelope extraction failed!").arg(sliceCloud->getName()));
 					warningsIssued = true;
 				}
-
-				if (progressDialog && !visualDebugMode)
-				{
-					if (progressDialog->wasCanceled())
-					{
-						error = true;
-						ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
-						//early stop
-						break;
-					}
-					progressDialog->setValue(static_cast<int>(i));
-				}
 			}
 
 		} //extract envelope polylines
@@ -118,6 +118,7 @@ constexpr char COMMAND_VOLUME_TO_FILE[]					= "TO_FILE";
 constexpr char COMMAND_SAVE_CLOUDS[]					= "SAVE_CLOUDS";
 constexpr char COMMAND_SAVE_MESHES[]					= "SAVE_MESHES";
 constexpr char COMMAND_AUTO_SAVE[]						= "AUTO_SAVE";
+constexpr char COMMAND_ASYNC_SAVE[]						= "ASYNC_SAVE";
 constexpr char COMMAND_LOG_FILE[]						= "LOG_FILE";
 constexpr char COMMAND_CLEAR[]							= "CLEAR";
 constexpr char COMMAND_CLEAR_CLOUDS[]					= "CLEAR_CLOUDS";
@@ -4721,6 +4722,56 @@ bool CommandAutoSave::process(ccCommandLineInterface &cmd)
 	return true;
 }
 
+CommandAsyncSave::CommandAsyncSave()
+	: ccCommandLineInterface::Command(QObject::tr("Asynchronous save state"), COMMAND_ASYNC_SAVE)
+{}
+
+bool CommandAsyncSave::process(ccCommandLineInterface &cmd)
+{
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QObject::tr("Missing parameter: option after '%1' (%2/%3)").arg(COMMAND_ASYNC_SAVE, OPTION_ON, OPTION_OFF));
+	}
+	
+	QString option = cmd.arguments().takeFirst().toUpper();
+	if (option == OPTION_ON)
+	{
+		size_t maxPendingMemory = ccCommandLineInterface::DEFAULT_ASYNC_SAVE_MAX_MEMORY;
+
+		//optional: max memory (in MB)
+		if (!cmd.arguments().empty() && !cmd.arguments().front().startsWith("-"))
+		{
+			bool ok = false;
+			unsigned maxMemoryMB = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				maxPendingMemory = static_cast<size_t>(maxMemoryMB) << 20;
+			}
+		}
+
+		cmd.print(QObject::tr("Asynchronous save is enabled (max. pending memory: %1 MB)").arg(maxPendingMemory >> 20));
+		cmd.toggleAsyncSaveMode(true, maxPendingMemory);
+	}
+	else if (option == OPTION_OFF)
+	{
+		cmd.print(QObject::tr("Asynchronous save is disabled"));
+		cmd.toggleAsyncSaveMode(false);
+
+		//wait for the pending saves
+		if (!cmd.flushPendingSaves())
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return cmd.error(QObject::tr("Unrecognized option after '%1' (%2 or %3 expected)").arg(COMMAND_ASYNC_SAVE, OPTION_ON, OPTION_OFF));
+	}
+	
+	return true;
+}
+
 CommandLogFile::CommandLogFile()
 	: ccCommandLineInterface::Command(QObject::tr("Set log file"), COMMAND_LOG_FILE)
 {}
@@ -377,6 +377,13 @@ struct CommandAutoSave : public ccCommandLineInterface::Command
 	bool process(ccCommandLineInterface& cmd) override;
 };
 
+struct CommandAsyncSave : public ccCommandLineInterface::Command
+{
+	CommandAsyncSave();
+
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
 struct CommandLogFile : public ccCommandLineInterface::Command
 {
 	CommandLogFile();
@@ -4,12 +4,16 @@
 #include "ccCommandCrossSection.h"
 #include "ccCommandLineCommands.h"
 #include "ccCommandRaster.h"
+#include "ccCommandRender.h"
 #include "ccPluginInterface.h"
 
 //qCC_db
 #include <ccGenericMesh.h>
 #include <ccHObjectCaster.h>
+#include <ccMesh.h>
+#include <ccPointCloud.h>
 #include <ccProgressDialog.h>
+#include <ccScalarField.h>
 
 //qCC_io
 #include <AsciiFilter.h>
@@ -24,13 +28,21 @@
 #include <QDateTime>
 #include <QElapsedTimer>
 #include <QMessageBox>
+#include <QThread>
+#include <QtConcurrentRun>
 
 //system
 #include <unordered_set>
 
 //commands
-constexpr char COMMAND_HELP[]			= "HELP";
-constexpr char COMMAND_SILENT_MODE[]	= "SILENT";
+constexpr char COMMAND_HELP[]				= "HELP";
+constexpr char COMMAND_SILENT_MODE[]		= "SILENT";
+constexpr char COMMAND_PARALLEL_ENTITIES[]	= "PARALLEL_ENTITIES";	//+ ON/OFF + optional max thread count
+constexpr char OPTION_ON[]					= "ON";
+constexpr char OPTION_OFF[]					= "OFF";
+
+//commands that can be applied to each cloud independently
+static const char* s_parallelizableCommands[] = { "SS", "SOR", "OCTREE_NORMALS", "CURV", "ROUGH", "DENSITY", "APPROX_DENSITY", "FEATURE", "MOMENT", "FILTER_SF" };
 
 /*****************************************************/
 /*************** ccCommandLineParser *****************/
@@ -38,19 +50,35 @@ constexpr char COMMAND_SILENT_MODE[]	= "SILENT";
 
 void ccCommandLineParser::print(const QString& message) const
 {
+	if (m_bufferLog)
+	{
+		m_bufferedLog.emplace_back(ccLog::LOG_STANDARD, message);
+		return;
+	}
+
 	ccConsole::Print(message);
 }
 
 void ccCommandLineParser::warning(const QString& message) const
 {
+	if (m_bufferLog)
+	{
+		m_bufferedLog.emplace_back(ccLog::LOG_WARNING, message);
+		return;
+	}
+
 	ccConsole::Warning(message);
-	
 }
 
 bool ccCommandLineParser::error(const QString& message) const
 {
+	if (m_bufferLog)
+	{
+		m_bufferedLog.emplace_back(ccLog::LOG_ERROR, message);
+		return false;
+	}
+
 	ccConsole::Error(message);
-	
 
 	return false;
 }
@@ -144,11 +172,18 @@ ccCommandLineParser::ccCommandLineParser()
 	, m_orphans("orphans")
 	, m_progressDialog(nullptr)
 	, m_parentWidget(nullptr)
+	, m_pendingSavesMemory(0)
+	, m_parallelEntities(false)
+	, m_bufferLog(false)
 {
+	//files are saved one at a time (the next commands are processed meanwhile)
+	m_saveThreadPool.setMaxThreadCount(1);
 }
 
 ccCommandLineParser::~ccCommandLineParser()
 {
+	flushPendingSaves();
+
 	if (m_progressDialog)
 	{
 		m_progressDialog->close();
@@ -295,6 +330,46 @@ QString ccCommandLineParser::exportEntity(	CLEntityDesc& entityDesc,
 		entity->setName(entName);
 	}
 
+	//asynchronous (write-behind) mode
+	if (asyncSaveMode())
+	{
+		size_t memSize = 0;
+		ccHObject* snapshot = CreateSnapshot(entity, memSize);
+		if (snapshot)
+		{
+			//wait for the oldest saves if too much memory is already used
+			size_t maxMemory = asyncSaveMaxMemory();
+			if (!releaseCompletedSaves(maxMemory > memSize ? maxMemory - memSize : 0))
+			{
+				delete snapshot;
+				return QString("Failed to save previous results");
+			}
+
+			print(QString("Output file '%1' will be saved in the background").arg(outputFilename));
+
+			PendingSave pendingSave;
+			pendingSave.snapshot = snapshot;
+			pendingSave.memSize = memSize;
+			pendingSave.future = QtConcurrent::run(&m_saveThreadPool, [snapshot, outputFilename, format]() -> QString
+			{
+				FileIOFilter::SaveParameters parameters;
+				//no dialog in the background!
+				parameters.alwaysDisplaySaveDialog = false;
+				parameters.parentWidget = nullptr;
+
+				CC_FILE_ERROR result = FileIOFilter::SaveToFile(snapshot, outputFilename, parameters, format);
+
+				return (result != CC_FERR_NO_ERROR ? QString("Failed to save result in file '%1'").arg(outputFilename) : QString());
+			});
+
+			m_pendingSaves.push_back(pendingSave);
+			m_pendingSavesMemory += memSize;
+
+			return QString();
+		}
+		//otherwise we fall back to the standard (synchronous) way
+	}
+
 	bool tempDependencyCreated = false;
 	ccGenericMesh* mesh = nullptr;
 	if (entity->isKindOf(CC_TYPES::MESH) && m_meshExportFormat == BinFilter::GetFileFilter())
@@ -346,6 +421,229 @@ QString ccCommandLineParser::exportEntity(	CLEntityDesc& entityDesc,
 	return (result != CC_FERR_NO_ERROR ? QString("Failed to save result in file '%1'").arg(outputFilename) : QString());
 }
 
+ccHObject* ccCommandLineParser::CreateSnapshot(ccHObject* entity, size_t& memSize)
+{
+	memSize = 0;
+	if (!entity)
+	{
+		assert(false);
+		return nullptr;
+	}
+
+	//(rough) estimation of the memory used by a cloud
+	auto cloudMemSize = [](const ccPointCloud* cloud) -> size_t
+	{
+		size_t pointSize = sizeof(CCVector3);
+		if (cloud->hasColors())
+			pointSize += sizeof(ccColor::Rgba);
+		if (cloud->hasNormals())
+			pointSize += sizeof(CompressedNormType);
+		pointSize += cloud->getNumberOfScalarFields() * sizeof(ScalarType);
+		return pointSize * cloud->size();
+	};
+
+	ccHObject* snapshot = nullptr;
+
+	if (entity->isA(CC_TYPES::POINT_CLOUD))
+	{
+		ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
+		ccPointCloud* clone = cloud->cloneThis();
+		if (clone)
+		{
+			clone->setName(cloud->getName());
+			memSize = cloudMemSize(clone);
+			snapshot = clone;
+		}
+	}
+	else if (entity->isA(CC_TYPES::MESH))
+	{
+		ccMesh* mesh = static_cast<ccMesh*>(entity);
+		ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
+		if (vertices && vertices->isA(CC_TYPES::POINT_CLOUD))
+		{
+			ccMesh* clone = mesh->cloneMesh();
+			if (clone)
+			{
+				clone->setName(mesh->getName());
+				memSize = mesh->size() * 3 * sizeof(unsigned);
+				if (clone->getAssociatedCloud())
+				{
+					clone->getAssociatedCloud()->setName(vertices->getName());
+					memSize += cloudMemSize(static_cast<ccPointCloud*>(clone->getAssociatedCloud()));
+				}
+				snapshot = clone;
+			}
+		}
+	}
+	//other entities (groups, sub-meshes, etc.) are not handled
+
+	return snapshot;
+}
+
+bool ccCommandLineParser::releaseCompletedSaves(size_t maxPendingMemory)
+{
+	bool success = true;
+
+	while (!m_pendingSaves.empty())
+	{
+		PendingSave& pendingSave = m_pendingSaves.front();
+		if (!pendingSave.future.isFinished())
+		{
+			if (m_pendingSavesMemory <= maxPendingMemory)
+			{
+				//we don't need to wait
+				break;
+			}
+			pendingSave.future.waitForFinished();
+		}
+
+		QString errorStr = pendingSave.future.result();
+		if (!errorStr.isEmpty())
+		{
+			error(errorStr);
+			success = false;
+		}
+
+		delete pendingSave.snapshot;
+		assert(m_pendingSavesMemory >= pendingSave.memSize);
+		m_pendingSavesMemory -= pendingSave.memSize;
+		m_pendingSaves.pop_front();
+	}
+
+	return success;
+}
+
+bool ccCommandLineParser::IsParallelizable(const QString& keyword)
+{
+	for (const char* command : s_parallelizableCommands)
+	{
+		if (keyword == command)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ccCommandLineParser::processInParallel(Command::Shared command)
+{
+	assert(command);
+	const size_t cloudCount = m_clouds.size();
+	print(QString("[PARALLEL] Processing %1 clouds (max. %2 at a time)").arg(cloudCount).arg(m_entityThreadPool.maxThreadCount()));
+
+	//one (silent) sub-parser per cloud
+	std::vector< QSharedPointer<ccCommandLineParser> > subParsers(cloudCount);
+	std::vector< QFuture<bool> > futures(cloudCount);
+	for (size_t i = 0; i < cloudCount; ++i)
+	{
+		QSharedPointer<ccCommandLineParser> subParser(new ccCommandLineParser);
+		subParser->m_arguments = m_arguments;
+		subParser->m_cloudExportFormat = m_cloudExportFormat;
+		subParser->m_cloudExportExt = m_cloudExportExt;
+		subParser->m_meshExportFormat = m_meshExportFormat;
+		subParser->m_meshExportExt = m_meshExportExt;
+		subParser->m_hierarchyExportFormat = m_hierarchyExportFormat;
+		subParser->m_hierarchyExportExt = m_hierarchyExportExt;
+		subParser->m_silentMode = true; //no dialog outside of the main thread!
+		subParser->m_autoSaveMode = m_autoSaveMode;
+		subParser->m_addTimestamp = m_addTimestamp;
+		subParser->m_precision = m_precision;
+		subParser->m_loadingParameters = m_loadingParameters;
+		subParser->m_loadingParameters.parentWidget = nullptr;
+		subParser->m_coordinatesShiftWasEnabled = m_coordinatesShiftWasEnabled;
+		subParser->m_formerCoordinatesShift = m_formerCoordinatesShift;
+		subParser->m_bufferLog = true;
+		subParser->m_clouds.push_back(m_clouds[i]);
+		subParsers[i] = subParser;
+
+		ccCommandLineParser* subParserPtr = subParser.data();
+		futures[i] = QtConcurrent::run(&m_entityThreadPool, [command, subParserPtr]() { return command->process(*subParserPtr); });
+	}
+
+	//wait for all the clouds to be processed
+	for (QFuture<bool>& future : futures)
+	{
+		//we keep the GUI (console) responsive in the meantime
+		while (!future.isFinished())
+		{
+			QThread::msleep(50);
+			QApplication::processEvents();
+		}
+	}
+
+	//gather the results (in the clouds order)
+	bool success = true;
+	int consumedArgumentCount = -1;
+	std::vector<CLCloudDesc> clouds;
+	clouds.reserve(cloudCount);
+	for (size_t i = 0; i < cloudCount; ++i)
+	{
+		ccCommandLineParser* subParser = subParsers[i].data();
+
+		//display the buffered messages
+		QString prefix = QString("[#%1] ").arg(i + 1);
+		for (const std::pair<int, QString>& message : subParser->m_bufferedLog)
+		{
+			switch (message.first)
+			{
+			case ccLog::LOG_ERROR:
+				error(prefix + message.second);
+				break;
+			case ccLog::LOG_WARNING:
+				warning(prefix + message.second);
+				break;
+			default:
+				print(prefix + message.second);
+				break;
+			}
+		}
+
+		if (!futures[i].result())
+		{
+			success = false;
+		}
+
+		//all the sub-parsers should have consumed the same arguments
+		int consumed = m_arguments.size() - subParser->m_arguments.size();
+		if (consumedArgumentCount < 0)
+		{
+			consumedArgumentCount = consumed;
+		}
+		else if (consumed != consumedArgumentCount)
+		{
+			warning(QString("Cloud #%1 consumed an unexpected number of arguments").arg(i + 1));
+		}
+
+		//the clouds may have been replaced by the command
+		for (CLCloudDesc& desc : subParser->m_clouds)
+		{
+			clouds.push_back(desc);
+		}
+		subParser->m_clouds.clear();
+		subParser->m_orphans.transferChildren(m_orphans);
+		subParser->removeMeshes();
+	}
+	m_clouds = clouds;
+
+	for (int i = 0; i < consumedArgumentCount; ++i)
+	{
+		m_arguments.pop_front();
+	}
+
+	return success;
+}
+
+bool ccCommandLineParser::flushPendingSaves()
+{
+	if (m_pendingSaves.empty())
+	{
+		return true;
+	}
+
+	print(QString("Waiting for %1 pending save(s)...").arg(m_pendingSaves.size()));
+	return releaseCompletedSaves(0);
+}
+
 void ccCommandLineParser::removeClouds(bool onlyLast/*=false*/)
 {
 	while (!m_clouds.empty())
@@ -639,6 +937,7 @@ void ccCommandLineParser::registerBuiltInCommands()
 	registerCommand(Command::Shared(new CommandSaveClouds));
 	registerCommand(Command::Shared(new CommandSaveMeshes));
 	registerCommand(Command::Shared(new CommandAutoSave));
+	registerCommand(Command::Shared(new CommandAsyncSave));
 	registerCommand(Command::Shared(new CommandLogFile));
 	registerCommand(Command::Shared(new CommandClear));
 	registerCommand(Command::Shared(new CommandClearClouds));
@@ -648,6 +947,7 @@ void ccCommandLineParser::registerBuiltInCommands()
 	registerCommand(Command::Shared(new CommandSetNoTimestamp));
 	registerCommand(Command::Shared(new CommandVolume25D));
 	registerCommand(Command::Shared(new CommandRasterize));
+	registerCommand(Command::Shared(new CommandRender));
 	registerCommand(Command::Shared(new CommandOctreeNormal));
 	registerCommand(Command::Shared(new CommandConvertNormalsToDipAndDipDir));
 	registerCommand(Command::Shared(new CommandConvertNormalsToSFs));
@@ -662,6 +962,7 @@ void ccCommandLineParser::registerBuiltInCommands()
 
 void ccCommandLineParser::cleanup()
 {
+	flushPendingSaves();
 	removeClouds();
 	removeMeshes();
 }
@@ -690,6 +991,14 @@ int ccCommandLineParser::start(QDialog* parent/*=0*/)
 	while (success && !m_arguments.empty())
 	{
 		QApplication::processEvents();	//Without this the console is just a spinner until the end of all processing
+
+		//release the completed asynchronous saves (if any)
+		if (!releaseCompletedSaves(asyncSaveMaxMemory()))
+		{
+			success = false;
+			break;
+		}
+
 		QString argument = m_arguments.takeFirst();
 
 		if (!argument.startsWith("-"))
@@ -703,7 +1012,57 @@ int ccCommandLineParser::start(QDialog* parent/*=0*/)
 		if (m_commands.contains(keyword))
 		{
 			assert(m_commands[keyword]);
-			success = m_commands[keyword]->process(*this);
+			if (m_parallelEntities && m_clouds.size() > 1 && IsParallelizable(keyword))
+			{
+				success = processInParallel(m_commands[keyword]);
+			}
+			else
+			{
+				success = m_commands[keyword]->process(*this);
+			}
+		}
+		//parallel processing of the clouds
+		else if (keyword == COMMAND_PARALLEL_ENTITIES)
+		{
+			if (m_arguments.empty())
+			{
+				error(QString("Missing parameter: option after '%1' (%2/%3)").arg(COMMAND_PARALLEL_ENTITIES, OPTION_ON, OPTION_OFF));
+				success = false;
+				break;
+			}
+
+			QString option = m_arguments.takeFirst().toUpper();
+			if (option == OPTION_ON)
+			{
+				int maxThreadCount = QThread::idealThreadCount();
+
+				//optional: max thread count
+				if (!m_arguments.empty() && !m_arguments.front().startsWith("-"))
+				{
+					bool ok = false;
+					int count = m_arguments.front().toInt(&ok);
+					if (ok && count > 0)
+					{
+						m_arguments.pop_front();
+						maxThreadCount = count;
+					}
+				}
+
+				m_entityThreadPool.setMaxThreadCount(maxThreadCount);
+				m_parallelEntities = true;
+				print(QString("Parallel processing of the clouds is enabled (max. %1 at a time)").arg(maxThreadCount));
+			}
+			else if (option == OPTION_OFF)
+			{
+				m_parallelEntities = false;
+				print("Parallel processing of the clouds is disabled");
+			}
+			else
+			{
+				error(QString("Unrecognized option after '%1' (%2 or %3 expected)").arg(COMMAND_PARALLEL_ENTITIES, OPTION_ON, OPTION_OFF));
+				success = false;
+				break;
+			}
 		}
 		//silent mode (i.e. no console)
 		else if (keyword == COMMAND_SILENT_MODE)
@@ -726,6 +1085,12 @@ int ccCommandLineParser::start(QDialog* parent/*=0*/)
 		}
 	}
 
+	//all the pending saves must be completed
+	if (!flushPendingSaves())
+	{
+		success = false;
+	}
+
 	print(QString("Processed finished in %1 s.").arg(eTimer.elapsed() / 1.0e3, 0, 'f', 2));
 
 	return success ? EXIT_SUCCESS : EXIT_FAILURE;
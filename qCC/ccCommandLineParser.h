@@ -7,6 +7,14 @@
 //Local
 #include "ccPluginManager.h"
 
+//Qt
+#include <QFuture>
+#include <QThreadPool>
+
+//system
+#include <list>
+#include <vector>
+
 class ccProgressDialog;
 class QDialog;
 
@@ -52,6 +60,7 @@ public:
 	void setCloudExportFormat(QString format, QString ext) override { m_cloudExportFormat = format; m_cloudExportExt = ext; }
 	void setMeshExportFormat(QString format, QString ext) override { m_meshExportFormat = format; m_meshExportExt = ext; }
 	void setHierarchyExportFormat(QString format, QString ext) override { m_hierarchyExportFormat = format; m_hierarchyExportExt = ext; }
+	bool flushPendingSaves() override;
 
 protected: //other methods
 
@@ -67,6 +76,30 @@ protected: //other methods
 	//! Parses the command line
 	int start(QDialog* parent = nullptr);
 
+	//! Creates a snapshot of an entity (for asynchronous saving)
+	/** \param entity entity to save
+		\param[out] memSize (estimated) memory used by the snapshot
+		\return the snapshot or nullptr if the entity type is not handled or if there's not enough memory
+	**/
+	static ccHObject* CreateSnapshot(ccHObject* entity, size_t& memSize);
+
+	//! Releases the completed (asynchronous) saves
+	/** Also waits for the oldest pending saves until the memory they use is below a given limit.
+		\param maxPendingMemory max. amount of memory used by the pending saves
+		\return false if at least one save failed (errors are reported in the console)
+	**/
+	bool releaseCompletedSaves(size_t maxPendingMemory);
+
+	//! Returns whether a command can be applied to each cloud independently (see processInParallel)
+	static bool IsParallelizable(const QString& keyword);
+
+	//! Applies a command to each cloud independently (in parallel)
+	/** Each cloud is processed by a dedicated (silent) sub-parser. Their console
+		messages are buffered and displayed in the clouds order once they are all done.
+		\return success
+	**/
+	bool processInParallel(Command::Shared command);
+
 private: //members
 
 	//! Current cloud(s) export format (can be modified with the 'COMMAND_CLOUD_EXPORT_FORMAT' option)
@@ -99,6 +132,38 @@ private: //members
 
 	//! Widget parent
 	QDialog* m_parentWidget;
+
+	//! Asynchronous save
+	struct PendingSave
+	{
+		//! Background process (returns an error string if any)
+		QFuture<QString> future;
+		//! Saved snapshot
+		ccHObject* snapshot = nullptr;
+		//! Memory used by the snapshot
+		size_t memSize = 0;
+	};
+
+	//! Pending (asynchronous) saves (in the order they have been queued)
+	std::list<PendingSave> m_pendingSaves;
+
+	//! Memory used by the pending saves
+	size_t m_pendingSavesMemory;
+
+	//! Thread pool dedicated to the asynchronous saves
+	QThreadPool m_saveThreadPool;
+
+	//! Whether the clouds should be processed in parallel (when possible)
+	bool m_parallelEntities;
+
+	//! Thread pool dedicated to the parallel processing of the clouds
+	QThreadPool m_entityThreadPool;
+
+	//! Whether the console messages should be buffered (see m_bufferedLog)
+	bool m_bufferLog;
+
+	//! Buffered console messages (level + message)
+	mutable std::vector< std::pair<int, QString> > m_bufferedLog;
 };
 
 #endif
@@ -0,0 +1,257 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccCommandRender.h"
+
+//local
+#include "ccSoftwareRenderer.h"
+
+//qCC_db
+#include <ccGenericMesh.h>
+#include <ccHObjectCaster.h>
+#include <ccPointCloud.h>
+
+//Qt
+#include <QElapsedTimer>
+#include <QImage>
+
+constexpr char COMMAND_RENDER[]				= "RENDER";
+constexpr char COMMAND_RENDER_WIDTH[]		= "WIDTH";
+constexpr char COMMAND_RENDER_HEIGHT[]		= "HEIGHT";
+constexpr char COMMAND_RENDER_VIEW[]		= "VIEW";
+constexpr char COMMAND_RENDER_PERSPECTIVE[]	= "PERSPECTIVE";
+constexpr char COMMAND_RENDER_POINT_SIZE[]	= "POINT_SIZE";
+constexpr char COMMAND_RENDER_EDL[]			= "EDL";
+constexpr char COMMAND_RENDER_SF_COLORS[]	= "SF_COLORS";
+
+//! Reads a positive integer value after a local option
+static bool ReadPositiveInteger(ccCommandLineInterface& cmd, const char* option, int& value)
+{
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QObject::tr("Missing parameter: value after '%1'").arg(option));
+	}
+
+	bool ok = false;
+	value = cmd.arguments().takeFirst().toInt(&ok);
+	if (!ok || value <= 0)
+	{
+		return cmd.error(QObject::tr("Invalid value after '%1' (positive integer expected)").arg(option));
+	}
+
+	return true;
+}
+
+CommandRender::CommandRender()
+	: ccCommandLineInterface::Command(QObject::tr("Render"), COMMAND_RENDER)
+{}
+
+bool CommandRender::process(ccCommandLineInterface& cmd)
+{
+	cmd.print(QObject::tr("[RENDER]"));
+
+	ccSoftwareRenderer::Parameters params;
+	bool showSF = false;
+
+	//look for local options
+	while (!cmd.arguments().empty())
+	{
+		QString argument = cmd.arguments().front();
+		if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_WIDTH))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (!ReadPositiveInteger(cmd, COMMAND_RENDER_WIDTH, params.width))
+			{
+				return false;
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_HEIGHT))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (!ReadPositiveInteger(cmd, COMMAND_RENDER_HEIGHT, params.height))
+			{
+				return false;
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_VIEW))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: view after '%1' (TOP, BOTTOM, FRONT, BACK, LEFT, RIGHT, ISO1 or ISO2)").arg(COMMAND_RENDER_VIEW));
+			}
+
+			QString view = cmd.arguments().takeFirst().toUpper();
+			params.upDir = CCVector3d(0, 0, 1);
+			if (view == "TOP")
+			{
+				params.viewDir = CCVector3d(0, 0, -1);
+				params.upDir = CCVector3d(0, 1, 0);
+			}
+			else if (view == "BOTTOM")
+			{
+				params.viewDir = CCVector3d(0, 0, 1);
+				params.upDir = CCVector3d(0, -1, 0);
+			}
+			else if (view == "FRONT")
+			{
+				params.viewDir = CCVector3d(0, 1, 0);
+			}
+			else if (view == "BACK")
+			{
+				params.viewDir = CCVector3d(0, -1, 0);
+			}
+			else if (view == "LEFT")
+			{
+				params.viewDir = CCVector3d(1, 0, 0);
+			}
+			else if (view == "RIGHT")
+			{
+				params.viewDir = CCVector3d(-1, 0, 0);
+			}
+			else if (view == "ISO1")
+			{
+				params.viewDir = CCVector3d(1, 1, -1);
+			}
+			else if (view == "ISO2")
+			{
+				params.viewDir = CCVector3d(-1, -1, -1);
+			}
+			else
+			{
+				return cmd.error(QObject::tr("Unknown view '%1' after '%2'").arg(view, COMMAND_RENDER_VIEW));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_PERSPECTIVE))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: field of view (in degrees) after '%1'").arg(COMMAND_RENDER_PERSPECTIVE));
+			}
+
+			bool ok = false;
+			params.fov_deg = cmd.arguments().takeFirst().toDouble(&ok);
+			if (!ok || params.fov_deg <= 0 || params.fov_deg >= 180.0)
+			{
+				return cmd.error(QObject::tr("Invalid field of view after '%1'").arg(COMMAND_RENDER_PERSPECTIVE));
+			}
+			params.perspective = true;
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_POINT_SIZE))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (!ReadPositiveInteger(cmd, COMMAND_RENDER_POINT_SIZE, params.pointSize))
+			{
+				return false;
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_EDL))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: strength after '%1'").arg(COMMAND_RENDER_EDL));
+			}
+
+			bool ok = false;
+			params.edlStrength = cmd.arguments().takeFirst().toDouble(&ok);
+			if (!ok || params.edlStrength < 0)
+			{
+				return cmd.error(QObject::tr("Invalid strength after '%1'").arg(COMMAND_RENDER_EDL));
+			}
+			params.edl = true;
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_SF_COLORS))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			showSF = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (cmd.clouds().empty() && cmd.meshes().empty())
+	{
+		return cmd.error(QObject::tr("No entity loaded (be sure to open at least one file with \"-O [filename]\" before \"-%1\")").arg(COMMAND_RENDER));
+	}
+
+	ccSoftwareRenderer renderer(params);
+	for (CLMeshDesc& desc : cmd.meshes())
+	{
+		if (showSF)
+		{
+			ccPointCloud* vertices = ccHObjectCaster::ToPointCloud(desc.mesh->getAssociatedCloud());
+			if (vertices && vertices->getCurrentOutScalarFieldIndex() >= 0)
+			{
+				vertices->setCurrentDisplayedScalarField(vertices->getCurrentOutScalarFieldIndex());
+				desc.mesh->showSF(true);
+			}
+		}
+		renderer.addEntity(desc.mesh);
+	}
+	for (CLCloudDesc& desc : cmd.clouds())
+	{
+		if (showSF && desc.pc->getCurrentOutScalarFieldIndex() >= 0)
+		{
+			desc.pc->setCurrentDisplayedScalarField(desc.pc->getCurrentOutScalarFieldIndex());
+			desc.pc->showSF(true);
+		}
+		renderer.addEntity(desc.pc);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QImage image = renderer.render();
+	if (image.isNull())
+	{
+		return cmd.error(QObject::tr("Failed to render the image (not enough memory?)"));
+	}
+
+	const CLEntityDesc& desc = cmd.clouds().empty() ? static_cast<const CLEntityDesc&>(cmd.meshes().front()) : static_cast<const CLEntityDesc&>(cmd.clouds().front());
+	QString outputFilename = cmd.getExportFilename(desc, "png", "RENDER", nullptr, !cmd.addTimestamp());
+	if (outputFilename.isEmpty())
+	{
+		outputFilename = "render.png";
+	}
+
+	if (!image.save(outputFilename))
+	{
+		return cmd.error(QObject::tr("Failed to save the image to '%1'").arg(outputFilename));
+	}
+
+	cmd.print(QObject::tr("Image saved to '%1' (%2 x %3 pixels, rendered in %4 s.)").arg(outputFilename).arg(image.width()).arg(image.height()).arg(timer.elapsed() / 1.0e3, 0, 'f', 2));
+
+	return true;
+}
@@ -0,0 +1,13 @@
+#ifndef COMMAND_LINE_RENDER_HEADER
+#define COMMAND_LINE_RENDER_HEADER
+
+#include "ccCommandLineInterface.h"
+
+struct CommandRender : public ccCommandLineInterface::Command
+{
+	CommandRender();
+
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+#endif //COMMAND_LINE_RENDER_HEADER
@@ -23,6 +23,7 @@
 #define CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME "C2C absolute distances"
 #define CC_TEMP_APPROX_DISTANCES_DEFAULT_SF_NAME "Approx. distances"
 #define CC_TEMP_DISTANCES_DEFAULT_SF_NAME "Temp. approx. distances"
+#define CC_TEMP_PREVIEW_DISTANCES_DEFAULT_SF_NAME "Preview distances"
 #define CC_CLOUD2CLOUD_APPROX_DISTANCES_DEFAULT_SF_NAME "C2C approx. distances"
 #define CC_CLOUD2MESH_DISTANCES_DEFAULT_SF_NAME "C2M absolute distances"
 #define CC_CLOUD2MESH_SIGNED_DISTANCES_DEFAULT_SF_NAME "C2M signed distances"
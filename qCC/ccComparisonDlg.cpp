@@ -22,8 +22,10 @@
 #include <QMessageBox>
 
 //CCCoreLib
+#include <CloudSamplingTools.h>
 #include <DistanceComputationTools.h>
 #include <MeshSamplingTools.h>
+#include <ReferenceCloud.h>
 #include <ScalarField.h>
 #include <DgmOctree.h>
 #include <ScalarFieldTools.h>
@@ -43,14 +45,47 @@
 #include "ccHistogramWindow.h"
 
 //Qt
+#include <QApplication>
 #include <QElapsedTimer>
+#include <QThread>
 #include <QThreadPool>
+#include <QtConcurrentRun>
 
 //System
+#include <algorithm>
 #include <assert.h>
 
 const unsigned char DEFAULT_OCTREE_LEVEL = 7;
 
+//! Thread-safe progress callback for the background computations
+/** The progress is only stored (it is displayed by the dialog itself, in the main thread).
+**/
+class BackgroundProgressCallback : public CCCoreLib::GenericProgressCallback
+{
+public:
+	explicit BackgroundProgressCallback(const QAtomicInt& cancelRequested)
+		: m_cancelRequested(cancelRequested)
+		, m_percent(0)
+	{}
+
+	//inherited from GenericProgressCallback
+	void update(float percent) override { m_percent = static_cast<int>(percent); }
+	void setMethodTitle(const char* methodTitle) override {}
+	void setInfo(const char* infoStr) override {}
+	void start() override { m_percent = 0; }
+	void stop() override {}
+	bool isCancelRequested() override { return m_cancelRequested.loadAcquire() != 0; }
+
+	//! Returns the current progress (percent)
+	int percent() const { return m_percent.loadAcquire(); }
+
+protected:
+	//! Cancel flag (owned by the dialog)
+	const QAtomicInt& m_cancelRequested;
+	//! Current progress (percent)
+	QAtomicInt m_percent;
+};
+
 ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 									ccHObject* refEntity,
 									CC_COMPARISON_TYPE cpType,
@@ -72,9 +107,18 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 	, m_compType(cpType)
 	, m_noDisplay(noDisplay)
 	, m_bestOctreeLevel(0)
+	, m_backgroundComputationRunning(false)
+	, m_cancelRequested(0)
+	, m_previewPending(false)
 {
 	setupUi(this);
 
+	computationProgressBar->setVisible(false);
+
+	//the preview is only computed once the user has stopped editing the parameters
+	m_previewTimer.setSingleShot(true);
+	m_previewTimer.setInterval(500);
+
 	int maxThreadCount = QThread::idealThreadCount();
 	maxThreadCountSpinBox->setRange(1, maxThreadCount);
 	maxThreadCountSpinBox->setSuffix(QString(" / %1").arg(maxThreadCount));
@@ -136,10 +180,26 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 	connect(maxDistCheckBox,		&QCheckBox::toggled,					this,	&ccComparisonDlg::maxDistUpdated);
 	connect(localModelComboBox, static_cast<void (QComboBox::*)(int)> (&QComboBox::currentIndexChanged),		this,	&ccComparisonDlg::locaModelChanged);
 	connect(maxSearchDistSpinBox, static_cast<void (QDoubleSpinBox::*)(double)> (&QDoubleSpinBox::valueChanged),this,	&ccComparisonDlg::maxDistUpdated);
+
+	//any change of the parameters cancels the current computation (and triggers a new preview if necessary)
+	connect(octreeLevelComboBox, static_cast<void (QComboBox::*)(int)> (&QComboBox::currentIndexChanged),		this,	&ccComparisonDlg::parametersChanged);
+	connect(maxDistCheckBox,		&QCheckBox::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(maxSearchDistSpinBox, static_cast<void (QDoubleSpinBox::*)(double)> (&QDoubleSpinBox::valueChanged),this,	&ccComparisonDlg::parametersChanged);
+	connect(signedDistCheckBox,		&QCheckBox::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(flipNormalsCheckBox,	&QCheckBox::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(localModelComboBox, static_cast<void (QComboBox::*)(int)> (&QComboBox::currentIndexChanged),		this,	&ccComparisonDlg::parametersChanged);
+	connect(lmRadiusRadioButton,	&QRadioButton::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(lmKNNSpinBox, static_cast<void (QSpinBox::*)(int)> (&QSpinBox::valueChanged),						this,	&ccComparisonDlg::parametersChanged);
+	connect(lmRadiusDoubleSpinBox, static_cast<void (QDoubleSpinBox::*)(double)> (&QDoubleSpinBox::valueChanged),this,	&ccComparisonDlg::parametersChanged);
+	connect(lmOptimizeCheckBox,		&QCheckBox::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(previewCheckBox,		&QCheckBox::toggled,					this,	&ccComparisonDlg::parametersChanged);
+	connect(previewPointCountSpinBox, static_cast<void (QSpinBox::*)(int)> (&QSpinBox::valueChanged),			this,	&ccComparisonDlg::parametersChanged);
+	connect(&m_previewTimer,		&QTimer::timeout,						this,	&ccComparisonDlg::computePreview);
 }
 
 ccComparisonDlg::~ccComparisonDlg()
 {
+	stopBackgroundComputation();
 	releaseOctrees();
 }
 
@@ -218,6 +278,238 @@ void ccComparisonDlg::maxDistUpdated()
 	m_bestOctreeLevel = 0;
 }
 
+void ccComparisonDlg::parametersChanged()
+{
+	//the current computation (if any) is deprecated
+	if (m_backgroundComputationRunning)
+	{
+		m_cancelRequested = 1;
+	}
+
+	if (previewCheckBox->isChecked())
+	{
+		//(re)start the countdown
+		m_previewTimer.start();
+	}
+	else
+	{
+		m_previewTimer.stop();
+		m_previewPending = false;
+	}
+}
+
+void ccComparisonDlg::setupParameters(	unsigned char octreeLevel,
+										CCCoreLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams& c2cParams,
+										CCCoreLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams& c2mParams) const
+{
+	//max search distance
+	ScalarType maxSearchDist = static_cast<ScalarType>(maxDistCheckBox->isChecked() ? maxSearchDistSpinBox->value() : 0);
+	//multi-thread
+	bool multiThread = multiThreadedCheckBox->isChecked();
+	//signed distances (cloud/mesh only)
+	bool signedDistances = signedDistCheckBox->isEnabled() && signedDistCheckBox->isChecked();
+	bool flipNormals = (signedDistances ? flipNormalsCheckBox->isChecked() : false);
+
+	c2cParams.maxThreadCount = c2mParams.maxThreadCount = maxThreadCountSpinBox->value();
+
+	//cloud/cloud
+	{
+		c2cParams.octreeLevel = octreeLevel;
+		if (localModelingTab->isEnabled())
+		{
+			c2cParams.localModel = (CCCoreLib::LOCAL_MODEL_TYPES)localModelComboBox->currentIndex();
+			if (c2cParams.localModel != CCCoreLib::NO_MODEL)
+			{
+				c2cParams.useSphericalSearchForLocalModel = lmRadiusRadioButton->isChecked();
+				c2cParams.kNNForLocalModel = static_cast<unsigned>(std::max(0, lmKNNSpinBox->value()));
+				c2cParams.radiusForLocalModel = static_cast<ScalarType>(lmRadiusDoubleSpinBox->value());
+				c2cParams.reuseExistingLocalModels = lmOptimizeCheckBox->isChecked();
+			}
+		}
+		c2cParams.maxSearchDist = maxSearchDist;
+		c2cParams.multiThread = multiThread;
+		c2cParams.CPSet = nullptr;
+	}
+
+	//cloud/mesh
+	{
+		c2mParams.octreeLevel = octreeLevel;
+		c2mParams.maxSearchDist = maxSearchDist;
+		c2mParams.useDistanceMap = false;
+		c2mParams.signedDistances = signedDistances;
+		c2mParams.flipNormals = flipNormals;
+		c2mParams.multiThread = multiThread;
+	}
+}
+
+int ccComparisonDlg::runInBackground(std::function<int(CCCoreLib::GenericProgressCallback*)> task, const QString& info, bool& canceled)
+{
+	assert(!m_backgroundComputationRunning);
+	m_backgroundComputationRunning = true;
+	m_cancelRequested = 0;
+
+	computeButton->setEnabled(false);
+	okButton->setEnabled(false);
+	computationProgressBar->setFormat(info + QStringLiteral(" (%p%)"));
+	computationProgressBar->setValue(0);
+	computationProgressBar->setVisible(true);
+
+	BackgroundProgressCallback progressCb(m_cancelRequested);
+	m_backgroundComputation = QtConcurrent::run([&task, &progressCb]() { return task(&progressCb); });
+
+	//we keep the GUI responsive while the computation is running
+	while (!m_backgroundComputation.isFinished())
+	{
+		QThread::msleep(50);
+		computationProgressBar->setValue(progressCb.percent());
+		QApplication::processEvents();
+	}
+
+	int result = m_backgroundComputation.result();
+	canceled = (m_cancelRequested.loadAcquire() != 0);
+
+	computationProgressBar->setVisible(false);
+	computeButton->setEnabled(true);
+	m_backgroundComputationRunning = false;
+
+	if (m_previewPending)
+	{
+		//a new preview has been requested in the meantime
+		m_previewPending = false;
+		m_previewTimer.start();
+	}
+
+	return result;
+}
+
+void ccComparisonDlg::stopBackgroundComputation()
+{
+	m_previewTimer.stop();
+	m_previewPending = false;
+
+	if (m_backgroundComputationRunning)
+	{
+		m_cancelRequested = 1;
+		m_backgroundComputation.waitForFinished();
+	}
+}
+
+void ccComparisonDlg::computePreview()
+{
+	if (!previewCheckBox->isChecked() || !isValid())
+	{
+		return;
+	}
+
+	if (m_backgroundComputationRunning)
+	{
+		//we'll compute the preview once the current computation is over
+		m_previewPending = true;
+		m_cancelRequested = 1;
+		return;
+	}
+
+	//the approximate distances are required (to guess the best octree level)
+	int approxSfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_APPROX_DISTANCES_DEFAULT_SF_NAME);
+	if (approxSfIdx < 0)
+	{
+		//the approximate distances computation has failed
+		return;
+	}
+
+	int octreeLevel = octreeLevelComboBox->currentIndex();
+	if (octreeLevel == 0)
+	{
+		octreeLevel = getBestOctreeLevel();
+		if (octreeLevel <= 0)
+		{
+			return;
+		}
+	}
+
+	//random subset of the compared points
+	unsigned sampleCount = std::min(m_compCloud->size(), static_cast<unsigned>(previewPointCountSpinBox->value()));
+	QScopedPointer<CCCoreLib::ReferenceCloud> sampledCloud(CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(m_compCloud, sampleCount));
+	if (!sampledCloud)
+	{
+		ccLog::Warning("[Preview] Not enough memory");
+		return;
+	}
+
+	//the preview distances are written in a dedicated SF, initialized with the approximate distances
+	//(so that the approximate distances remain valid if the preview is canceled)
+	int sfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_PREVIEW_DISTANCES_DEFAULT_SF_NAME);
+	if (sfIdx < 0)
+	{
+		sfIdx = m_compCloud->addScalarField(CC_TEMP_PREVIEW_DISTANCES_DEFAULT_SF_NAME);
+		if (sfIdx < 0)
+		{
+			ccLog::Warning("[Preview] Not enough memory");
+			return;
+		}
+	}
+	{
+		const CCCoreLib::ScalarField* approxSF = m_compCloud->getScalarField(approxSfIdx);
+		CCCoreLib::ScalarField* previewSF = m_compCloud->getScalarField(sfIdx);
+		assert(approxSF && previewSF);
+		if (!previewSF->resizeSafe(approxSF->size()))
+		{
+			m_compCloud->deleteScalarField(sfIdx);
+			ccLog::Warning("[Preview] Not enough memory");
+			return;
+		}
+		std::copy(approxSF->begin(), approxSF->end(), previewSF->begin());
+	}
+
+	CCCoreLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams c2cParams;
+	CCCoreLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams  c2mParams;
+	setupParameters(static_cast<unsigned char>(octreeLevel), c2cParams, c2mParams);
+
+	m_compCloud->setCurrentScalarField(sfIdx);
+	bool okWasEnabled = okButton->isEnabled();
+
+	QElapsedTimer eTimer;
+	eTimer.start();
+	bool canceled = false;
+	int result = runInBackground([&](CCCoreLib::GenericProgressCallback* progressCb)
+	{
+		if (m_compType == CLOUDCLOUD_DIST)
+		{
+			return CCCoreLib::DistanceComputationTools::computeCloud2CloudDistance(sampledCloud.data(), m_refCloud, c2cParams, progressCb, nullptr, m_refOctree.data());
+		}
+		else
+		{
+			return CCCoreLib::DistanceComputationTools::computeCloud2MeshDistance(sampledCloud.data(), m_refMesh, c2mParams, progressCb, nullptr);
+		}
+	}, tr("Preview"), canceled);
+
+	//restore the OK button state (whatever the outcome, as another preview may be pending)
+	okButton->setEnabled(okWasEnabled);
+
+	if (canceled)
+	{
+		//the dialog may have been closed in the meantime
+		return;
+	}
+
+	if (result < 0)
+	{
+		ccLog::Warning(QString("[Preview] Computation failed (error code %1)").arg(result));
+		return;
+	}
+
+	ccLog::Print(QString("[Preview] %1 points processed in %2 s.").arg(sampleCount).arg(eTimer.elapsed() / 1.0e3, 0, 'f', 2));
+
+	CCCoreLib::ScalarField* sf = m_compCloud->getScalarField(sfIdx);
+	assert(sf);
+	sf->computeMinAndMax();
+
+	m_compCloud->setCurrentDisplayedScalarField(sfIdx);
+	m_compCloud->showSF(true);
+
+	updateDisplay(true, false);
+}
+
 int ccComparisonDlg::getBestOctreeLevel()
 {
 	if (m_bestOctreeLevel == 0)
@@ -707,17 +999,9 @@ bool ccComparisonDlg::computeDistances()
 
 	CCCoreLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams c2cParams;
 	CCCoreLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams  c2mParams;
-	c2cParams.maxThreadCount = c2mParams.maxThreadCount = maxThreadCountSpinBox->value();
+	setupParameters(static_cast<unsigned char>(octreeLevel), c2cParams, c2mParams);
 
-	int result = -1;
-	QScopedPointer<ccProgressDialog> progressDlg;
-	if (parentWidget())
-	{
-		progressDlg.reset(new ccProgressDialog(true, this));
-	}
-
-	QElapsedTimer eTimer;
-	eTimer.start();
+	bool proceed = true;
 	switch(m_compType)
 	{
 	case CLOUDCLOUD_DIST: //cloud-cloud
@@ -802,6 +1086,7 @@ bool ccComparisonDlg::computeDistances()
 												QMessageBox::Yes,
 												QMessageBox::No) == QMessageBox::No)
 					{
+						proceed = false;
 						break;
 					}
 					filterVisibility = false;
@@ -810,31 +1095,6 @@ bool ccComparisonDlg::computeDistances()
 			pc->enableVisibilityCheck(filterVisibility);
 		}
 
-		//setup parameters
-		{
-			c2cParams.octreeLevel = static_cast<unsigned char>(octreeLevel);
-			if (localModelingTab->isEnabled())
-			{
-				c2cParams.localModel = (CCCoreLib::LOCAL_MODEL_TYPES)localModelComboBox->currentIndex();
-				if (c2cParams.localModel != CCCoreLib::NO_MODEL)
-				{
-					c2cParams.useSphericalSearchForLocalModel = lmRadiusRadioButton->isChecked();
-					c2cParams.kNNForLocalModel = static_cast<unsigned>(std::max(0,lmKNNSpinBox->value()));
-					c2cParams.radiusForLocalModel = static_cast<ScalarType>(lmRadiusDoubleSpinBox->value());
-					c2cParams.reuseExistingLocalModels = lmOptimizeCheckBox->isChecked();
-				}
-			}
-			c2cParams.maxSearchDist = maxSearchDist;
-			c2cParams.multiThread = multiThread;
-			c2cParams.CPSet = nullptr;
-		}
-		
-		result = CCCoreLib::DistanceComputationTools::computeCloud2CloudDistance(	m_compCloud,
-																				m_refCloud,
-																				c2cParams,
-																				progressDlg.data(),
-																				m_compOctree.data(),
-																				m_refOctree.data());
 		break;
 
 	case CLOUDMESH_DIST: //cloud-mesh
@@ -844,31 +1104,57 @@ bool ccComparisonDlg::computeDistances()
 			ccLog::Warning("[Cloud/Mesh comparison] Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
 		}
 
-		//setup parameters
-		{
-			c2mParams.octreeLevel = static_cast<unsigned char>(octreeLevel);
-			c2mParams.maxSearchDist = maxSearchDist;
-			c2mParams.useDistanceMap = false;
-			c2mParams.signedDistances = signedDistances;
-			c2mParams.flipNormals = flipNormals;
-			c2mParams.multiThread = multiThread;
-		}
-		
-		result = CCCoreLib::DistanceComputationTools::computeCloud2MeshDistance(	m_compCloud,
-																				m_refMesh,
-																				c2mParams,
-																				progressDlg.data(),
-																				m_compOctree.data());
 		break;
 	}
-	qint64 elapsedTime_ms = eTimer.elapsed();
 
-	if (progressDlg)
+	int result = -1;
+	qint64 elapsedTime_ms = 0;
+	bool canceled = false;
+	if (proceed)
 	{
-		progressDlg->stop();
+		//the distances are computed in a background thread: in the meantime, we display the approximate distances
+		int approxSfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_APPROX_DISTANCES_DEFAULT_SF_NAME);
+		m_compCloud->setCurrentDisplayedScalarField(approxSfIdx);
+		updateDisplay(approxSfIdx >= 0, false);
+
+		QElapsedTimer eTimer;
+		eTimer.start();
+		result = runInBackground([&](CCCoreLib::GenericProgressCallback* progressCb)
+		{
+			if (m_compType == CLOUDCLOUD_DIST)
+			{
+				return CCCoreLib::DistanceComputationTools::computeCloud2CloudDistance(	m_compCloud,
+																						m_refCloud,
+																						c2cParams,
+																						progressCb,
+																						m_compOctree.data(),
+																						m_refOctree.data());
+			}
+			else
+			{
+				return CCCoreLib::DistanceComputationTools::computeCloud2MeshDistance(	m_compCloud,
+																						m_refMesh,
+																						c2mParams,
+																						progressCb,
+																						m_compOctree.data());
+			}
+		}, tr("Computing distances"), canceled);
+		elapsedTime_ms = eTimer.elapsed();
 	}
 
-	if (result >= 0)
+	if (canceled)
+	{
+		ccLog::Warning("[ComputeDistances] Computation canceled");
+
+		//the partially computed distances are meaningless
+		//(we look for the SF by its name as the dialog may have been closed in the meantime)
+		int tempSfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
+		if (tempSfIdx >= 0)
+		{
+			m_compCloud->deleteScalarField(tempSfIdx);
+		}
+	}
+	else if (result >= 0)
 	{
 		ccLog::Print("[ComputeDistances] Time: %3.2f s.",static_cast<double>(elapsedTime_ms)/1.0e3);
 
@@ -957,7 +1243,12 @@ bool ccComparisonDlg::computeDistances()
 			sf = nullptr;
 		}
 	}
-			
+
+	if (canceled)
+	{
+		return false;
+	}
+
 	updateDisplay(sfIdx >= 0, false);
 
 	return result >= 0;
@@ -986,6 +1277,8 @@ void ccComparisonDlg::showHisto()
 
 void ccComparisonDlg::applyAndExit()
 {
+	stopBackgroundComputation();
+
 	if (m_compCloud)
 	{
 		//m_compCloud->setCurrentDisplayedScalarField(-1);
@@ -999,6 +1292,14 @@ void ccComparisonDlg::applyAndExit()
 			tmpSfIdx = -1;
 		}
 
+		//remove the preview dist. SF
+		tmpSfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_PREVIEW_DISTANCES_DEFAULT_SF_NAME);
+		if (tmpSfIdx >= 0)
+		{
+			m_compCloud->deleteScalarField(tmpSfIdx);
+			tmpSfIdx = -1;
+		}
+
 		//now, if we have a temp distance scalar field (the 'real' distances computed by the user)
 		//we should rename it properly
 		int sfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
@@ -1042,6 +1343,8 @@ void ccComparisonDlg::applyAndExit()
 
 void ccComparisonDlg::cancelAndExit()
 {
+	stopBackgroundComputation();
+
 	if (m_compCloud)
 	{
 		m_compCloud->setCurrentDisplayedScalarField(-1);
@@ -1055,6 +1358,14 @@ void ccComparisonDlg::cancelAndExit()
 			tmpSfIdx = -1;
 		}
 
+		//remove the preview dist. SF
+		tmpSfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_PREVIEW_DISTANCES_DEFAULT_SF_NAME);
+		if (tmpSfIdx >= 0)
+		{
+			m_compCloud->deleteScalarField(tmpSfIdx);
+			tmpSfIdx = -1;
+		}
+
 		int sfIdx = m_compCloud->getScalarFieldIndexByName(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
 		if (sfIdx >= 0)
 		{
@@ -21,9 +21,18 @@
 //qCC_db
 #include <ccOctree.h>
 
+//CCCoreLib
+#include <DistanceComputationTools.h>
+
 //Qt
+#include <QAtomicInt>
 #include <QDialog>
+#include <QFuture>
 #include <QString>
+#include <QTimer>
+
+//System
+#include <functional>
 
 #include <ui_comparisonDlg.h>
 
@@ -73,6 +82,8 @@ protected:
 	void showHisto();
 	void locaModelChanged(int);
 	void maxDistUpdated();
+	void parametersChanged();
+	void computePreview();
 
 protected:
 
@@ -84,6 +95,25 @@ protected:
 	void updateDisplay(bool showSF, bool hideRef);
 	void releaseOctrees();
 
+	//! Sets the distance computation parameters from the dialog state
+	void setupParameters(	unsigned char octreeLevel,
+							CCCoreLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams& c2cParams,
+							CCCoreLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams& c2mParams) const;
+
+	//! Runs a distance computation in a background thread
+	/** The GUI remains responsive during the computation (and the progress is
+		displayed in the dialog). The computation is canceled as soon as the
+		parameters are changed or the dialog is closed.
+		\param task computation to run (receives a thread-safe progress callback)
+		\param info short description of the computation
+		\param[out] canceled whether the computation has been canceled
+		\return the computation result
+	**/
+	int runInBackground(std::function<int(CCCoreLib::GenericProgressCallback*)> task, const QString& info, bool& canceled);
+
+	//! Cancels the background computation (if any) and waits for it to stop
+	void stopBackgroundComputation();
+
 	//! Compared entity
 	ccHObject* m_compEnt;
 	//! Compared entity equivalent cloud
@@ -122,6 +152,17 @@ protected:
 
 	//! Best octree level (or 0 if none has been guessed already)
 	int m_bestOctreeLevel;
+
+	//! Background computation (preview or full computation)
+	QFuture<int> m_backgroundComputation;
+	//! Whether a background computation is running
+	bool m_backgroundComputationRunning;
+	//! Whether the background computation should be canceled
+	QAtomicInt m_cancelRequested;
+	//! Whether a preview should be computed once the current background computation is over
+	bool m_previewPending;
+	//! Timer to delay the preview computation (while the user is still editing the parameters)
+	QTimer m_previewTimer;
 };
 
 #endif
@@ -25,11 +25,12 @@
 #include <ccScalarField.h>
 
 //System
+#include <algorithm>
 #include <cassert>
 
 #ifndef CC_GDAL_SUPPORT
 
-#include "ccIsolines.h" //old alternative code to generate contour lines (doesn't work very well :( )
+#include "ccMarchingSquares.h"
 
 //Qt
 #include <QCoreApplication>
@@ -337,131 +338,148 @@ bool ccContourLinesGenerator::GenerateContourLines(	ccRasterGrid* rasterGrid,
 			}
 		}
 
-		//generate contour lines
+		//create a one pixel border (so as to close the contour lines)
+		if (!params.ignoreBorders)
 		{
-			Isolines<double> iso(static_cast<int>(xDim), static_cast<int>(yDim));
-			if (!params.ignoreBorders)
+			const double borderValue = params.startAltitude - 1.0;
+			std::fill(grid.begin(), grid.begin() + xDim, borderValue);
+			std::fill(grid.end() - xDim, grid.end(), borderValue);
+			for (unsigned j = 0; j < yDim; ++j)
 			{
-				iso.createOnePixelBorder(grid.data(), params.startAltitude - 1.0);
+				grid[j * xDim] = grid[(j + 1) * xDim - 1] = borderValue;
 			}
+		}
 
+		std::vector<double> levels(levelCount);
+		for (unsigned i = 0; i < levelCount; ++i)
+		{
+			levels[i] = params.startAltitude + i * params.step;
+		}
+
+		//generate contour lines (all levels and grid tiles are processed in parallel)
+		std::vector<ccMarchingSquares::LevelLines> isolines;
+		{
 			ccProgressDialog pDlg(true, params.parentWidget);
 			pDlg.setMethodTitle(QObject::tr("Contour plot"));
 			pDlg.setInfo(QObject::tr("Levels: %1\nCells: %2 x %3").arg(levelCount).arg(rasterGrid->width).arg(rasterGrid->height));
 			pDlg.start();
-			pDlg.show();
 			QCoreApplication::processEvents();
-			CCCoreLib::NormalizedProgress nProgress(&pDlg, levelCount);
 
-			for (double v = params.startAltitude; v <= params.maxAltitude; v += params.step)
+			ccMarchingSquares marchingSquares(grid.data(), xDim, yDim);
+			if (!marchingSquares.extract(levels, isolines, &pDlg))
 			{
-				//extract contour lines for the current level
-				iso.setThreshold(v);
-				int lineCount = iso.find(grid.data());
+				if (pDlg.wasCanceled())
+				{
+					ccLog::Warning("[ccContourLinesGenerator] Process cancelled by user");
+					return true;
+				}
+				ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
+				return false;
+			}
+		}
+
+		//convert them to polylines
+		for (const ccMarchingSquares::LevelLines& levelLines : isolines)
+		{
+			const double v = levelLines.level;
 
-				ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(lineCount));
+			ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(levelLines.lines.size()));
 
-				//convert them to poylines
-				int realCount = 0;
-				for (int i = 0; i < lineCount; ++i)
+			int realCount = 0;
+			std::vector<double> heights;
+			for (const ccMarchingSquares::Line& line : levelLines.lines)
+			{
+				if (static_cast<int>(line.vertexCount) < params.minVertexCount)
+				{
+					continue;
+				}
+
+				const CCVector2d* lineVertices = levelLines.vertices.data() + line.firstVertex;
+
+				//vertices heights
+				heights.resize(line.vertexCount, v);
+				if (params.projectContourOnAltitudes)
 				{
-					int vertCount = iso.getContourLength(i);
-					if (vertCount >= params.minVertexCount)
+					for (unsigned vi = 0; vi < line.vertexCount; ++vi)
 					{
-						int startVi = 0; //we may have to split the polyline in multiple chunks
-						while (startVi < vertCount)
-						{
-							ccPointCloud* vertices = new ccPointCloud("vertices");
-							ccPolyline* poly = new ccPolyline(vertices);
-							poly->addChild(vertices);
-							bool isClosed = (startVi == 0 ? iso.isContourClosed(i) : false);
-							if (poly->reserve(vertCount - startVi) && vertices->reserve(vertCount - startVi))
-							{
-								unsigned localIndex = 0;
-								for (int vi = startVi; vi < vertCount; ++vi)
-								{
-									++startVi;
-								
-									double x = iso.getContourX(i, vi) - margin;
-									double y = iso.getContourY(i, vi) - margin;
-
-									CCVector3 P;
-									//DGM: we will only do the dimension mapping at export time
-									//(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
-									// is in the XY plane by default!)
-									/*P.u[X] = */P.x = static_cast<PointCoordinateType>((x + 0.5) * rasterGrid->gridStep + gridMinCornerXY.x);
-									/*P.u[Y] = */P.y = static_cast<PointCoordinateType>((y + 0.5) * rasterGrid->gridStep + gridMinCornerXY.y);
-									if (params.projectContourOnAltitudes)
-									{
-										int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(rasterGrid->width) - 1);
-										int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(rasterGrid->height) - 1);
-										double h = rasterGrid->rows[yi][xi].h;
-										if (std::isfinite(h))
-										{
-											/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
-										}
-										else
-										{
-											//DGM: we stop the current polyline
-											isClosed = false;
-											break;
-										}
-									}
-									else
-									{
-										/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(v);
-									}
-
-									vertices->addPoint(P);
-									assert(localIndex < vertices->size());
-									poly->addPointIndex(localIndex++);
-								}
-
-								assert(poly);
-								if (poly->size() > 1)
-								{
-									poly->setClosed(isClosed); //if we have less vertices, it means we have 'chopped' the original contour
-									vertices->setEnabled(false);
-
-									++realCount;
-									poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
-
-									//add the 'const altitude' meta-data as well
-									poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
-
-									//add contour
-									poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
-									try
-									{
-										contourLines.push_back(poly);
-									}
-									catch (const std::bad_alloc&)
-									{
-										ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
-										return false;
-									}
-								}
-								else
-								{
-									delete poly;
-									poly = nullptr;
-								}
-							}
-							else
-							{
-								delete poly;
-								poly = nullptr;
-								ccLog::Warning("Not enough memory!");
-								return false;
-							}
-						}
+						int xi = std::min(std::max(static_cast<int>(lineVertices[vi].x - margin), 0), static_cast<int>(rasterGrid->width) - 1);
+						int yi = std::min(std::max(static_cast<int>(lineVertices[vi].y - margin), 0), static_cast<int>(rasterGrid->height) - 1);
+						heights[vi] = rasterGrid->rows[yi][xi].h; //DGM: invalid heights will split the polyline
 					}
 				}
+				else
+				{
+					std::fill(heights.begin(), heights.end(), v);
+				}
 
-				if (!nProgress.oneStep())
+				//we may have to split the polyline in multiple chunks
+				unsigned vi = 0;
+				while (vi < line.vertexCount)
 				{
-					//process cancelled by user
-					break;
+					//skip the invalid vertices
+					while (vi < line.vertexCount && !std::isfinite(heights[vi]))
+					{
+						++vi;
+					}
+					unsigned chunkStart = vi;
+					while (vi < line.vertexCount && std::isfinite(heights[vi]))
+					{
+						++vi;
+					}
+					unsigned chunkSize = vi - chunkStart;
+					if (chunkSize < 2)
+					{
+						continue;
+					}
+
+					//if we have less vertices, it means we have 'chopped' the original contour
+					bool isClosed = (line.closed && chunkSize == line.vertexCount);
+
+					ccPointCloud* vertices = new ccPointCloud("vertices");
+					ccPolyline* poly = new ccPolyline(vertices);
+					poly->addChild(vertices);
+
+					//the buffers are allocated once
+					if (!vertices->reserve(chunkSize) || !poly->reserve(chunkSize))
+					{
+						delete poly;
+						ccLog::Warning("Not enough memory!");
+						return false;
+					}
+
+					for (unsigned k = chunkStart; k < vi; ++k)
+					{
+						//DGM: we will only do the dimension mapping at export time
+						//(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
+						// is in the XY plane by default!)
+						CCVector3 P(	static_cast<PointCoordinateType>((lineVertices[k].x - margin + 0.5) * rasterGrid->gridStep + gridMinCornerXY.x),
+										static_cast<PointCoordinateType>((lineVertices[k].y - margin + 0.5) * rasterGrid->gridStep + gridMinCornerXY.y),
+										static_cast<PointCoordinateType>(heights[k]) );
+						vertices->addPoint(P);
+					}
+					poly->addPointIndex(0, chunkSize);
+
+					poly->setClosed(isClosed);
+					vertices->setEnabled(false);
+
+					++realCount;
+					poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
+
+					//add the 'const altitude' meta-data as well
+					poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
+
+					//add contour
+					poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
+					try
+					{
+						contourLines.push_back(poly);
+					}
+					catch (const std::bad_alloc&)
+					{
+						delete poly;
+						ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
+						return false;
+					}
 				}
 			}
 		}
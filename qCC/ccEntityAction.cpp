@@ -656,30 +656,75 @@ namespace ccEntityAction
 	//////////
 	// Scalar Fields
 	
-	bool sfGaussianFilter(const ccHObject::Container &selectedEntities, QWidget *parent)
+	//! Number of points above which the approximate (multi-resolution) filter is suggested
+	static const unsigned s_approxSFGaussianFilterPointCount = 10000000;
+
+	//! Applies the Gaussian (scalarSigma <= 0) or bilateral filter on a selection of scalar fields
+	static bool ApplySFGaussianFilter(	const ccHObject::Container &selectedEntities,
+										double sigma,
+										double scalarSigma,
+										QWidget *parent)
 	{
-		if (selectedEntities.empty())
-			return false;
-		
-		double sigma = ccLibAlgorithms::GetDefaultCloudKernelSize(selectedEntities);
-		if (sigma < 0.0)
+		const bool bilateral = (scalarSigma > 0);
+		const char* logPrefix = (bilateral ? "[BilateralFilter]" : "[GaussianFilter]");
+
+		//the scalar fields to filter are selected on the first cloud (by name)
+		QStringList sfNames;
+		unsigned totalPointCount = 0;
+		for (ccHObject* ent : selectedEntities)
 		{
-			ccConsole::Error("No eligible point cloud in selection!");
-			return false;
+			ccPointCloud* pc = ccHObjectCaster::ToPointCloud(ent);
+			if (!pc)
+				continue;
+
+			totalPointCount += pc->size();
+			if (!sfNames.empty() || !pc->getCurrentDisplayedScalarField())
+				continue;
+
+			int displayedSFIdx = pc->getCurrentDisplayedScalarFieldIndex();
+			unsigned sfCount = pc->getNumberOfScalarFields();
+			if (sfCount > 1)
+			{
+				ccItemSelectionDlg isDlg(true, parent, "scalar fields");
+				QStringList scalarFields;
+				for (unsigned i = 0; i < sfCount; ++i)
+				{
+					scalarFields << pc->getScalarFieldName(i);
+				}
+				isDlg.setItems(scalarFields, displayedSFIdx);
+				if (!isDlg.exec())
+				{
+					//cancelled by the user
+					return false;
+				}
+				std::vector<int> sfIndexes;
+				isDlg.getSelectedIndexes(sfIndexes);
+				for (int index : sfIndexes)
+				{
+					sfNames << scalarFields[index];
+				}
+				if (sfNames.empty())
+				{
+					ccConsole::Error("No scalar field was selected");
+					return false;
+				}
+			}
+			else
+			{
+				sfNames << pc->getScalarFieldName(displayedSFIdx);
+			}
 		}
-		
-		bool ok = false;
-		sigma = QInputDialog::getDouble(parent,
-										"Gaussian filter",
-										"sigma:",
-										sigma,
-										DBL_MIN,
-										1.0e9,
-										8,
-										&ok);
-		if (!ok)
-			return false;
-		
+
+		bool approximate = false;
+		if (totalPointCount >= s_approxSFGaussianFilterPointCount)
+		{
+			approximate = (QMessageBox::question(	parent,
+													bilateral ? "Bilateral filter" : "Gaussian filter",
+													"Large cloud(s): use the faster approximate (multi-resolution) filter?",
+													QMessageBox::Yes | QMessageBox::No,
+													QMessageBox::Yes) == QMessageBox::Yes);
+		}
+
 		ccProgressDialog pDlg(true, parent);
 		pDlg.setAutoClose(false);
 
@@ -692,73 +737,104 @@ namespace ccEntityAction
 				ccUtils::DisplayLockedVerticesWarning(ent->getName(), selectedEntities.size() == 1);
 				continue;
 			}
-			
-			//la methode est activee sur le champ scalaire affiche
-			CCCoreLib::ScalarField* sf = pc->getCurrentDisplayedScalarField();
-			if (sf != nullptr)
+
+			//the selected scalar fields (or the displayed one by default)
+			std::vector<CCCoreLib::ScalarField*> inputSFs;
+			for (const QString& sfName : sfNames)
 			{
-				//on met en lecture (OUT) le champ scalaire actuellement affiche
-				int outSfIdx = pc->getCurrentDisplayedScalarFieldIndex();
-				Q_ASSERT(outSfIdx >= 0);
-				
-				pc->setCurrentOutScalarField(outSfIdx);
-				CCCoreLib::ScalarField* outSF = pc->getCurrentOutScalarField();
-				Q_ASSERT(sf != nullptr);
-				
-				QString sfName = QString("%1.smooth(%2)").arg(outSF->getName()).arg(sigma);
 				int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfName));
-				if (sfIdx < 0)
-					sfIdx = pc->addScalarField(qPrintable(sfName)); //output SF has same type as input SF
 				if (sfIdx >= 0)
-					pc->setCurrentInScalarField(sfIdx);
-				else
+					inputSFs.push_back(pc->getScalarField(sfIdx));
+			}
+			if (inputSFs.empty() && pc->getCurrentDisplayedScalarField())
+			{
+				inputSFs.push_back(pc->getCurrentDisplayedScalarField());
+			}
+			if (inputSFs.empty())
+			{
+				ccConsole::Warning(QString("Entity [%1] has no active scalar field!").arg(pc->getName()));
+				continue;
+			}
+
+			//the output scalar fields (one per input SF)
+			std::vector<CCCoreLib::ScalarField*> outputSFs;
+			int lastOutSfIdx = -1;
+			for (CCCoreLib::ScalarField* sf : inputSFs)
+			{
+				QString sfName = bilateral	? QString("%1.bilsmooth(%2,%3)").arg(sf->getName()).arg(sigma).arg(scalarSigma)
+											: QString("%1.smooth(%2)").arg(sf->getName()).arg(sigma);
+				int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfName));
+				if (sfIdx < 0)
+					sfIdx = pc->addScalarField(qPrintable(sfName));
+				if (sfIdx < 0)
 				{
 					ccConsole::Error(QString("Failed to create scalar field for cloud '%1' (not enough memory?)").arg(pc->getName()));
-					continue;
-				}
-				
-				ccOctree::Shared octree = pc->getOctree();
-				if (!octree)
-				{
-					octree = pc->computeOctree(&pDlg);
-					if (!octree)
-					{
-						ccConsole::Error(QString("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
-						continue;
-					}
-				}
-				
-				if (octree)
-				{
-					QElapsedTimer eTimer;
-					eTimer.start();
-					CCCoreLib::ScalarFieldTools::applyScalarFieldGaussianFilter(static_cast<PointCoordinateType>(sigma),
-																			pc,
-																			-1,
-																			&pDlg,
-																			octree.data());
-					
-					ccConsole::Print("[GaussianFilter] Timing: %3.2f s.", static_cast<double>(eTimer.elapsed()) / 1000.0);
-					pc->setCurrentDisplayedScalarField(sfIdx);
-					pc->showSF(sfIdx >= 0);
-					sf = pc->getCurrentDisplayedScalarField();
-					if (sf)
-						sf->computeMinAndMax();
-					pc->prepareDisplayForRefresh_recursive();
-				}
-				else
-				{
-					ccConsole::Error(QString("Failed to compute entity [%1] octree! (not enough memory?)").arg(pc->getName()));
+					break;
 				}
+				outputSFs.push_back(pc->getScalarField(sfIdx));
+				lastOutSfIdx = sfIdx;
 			}
-			else
+			if (outputSFs.size() != inputSFs.size())
 			{
-				ccConsole::Warning(QString("Entity [%1] has no active scalar field!").arg(pc->getName()));
+				continue;
+			}
+
+			QElapsedTimer eTimer;
+			eTimer.start();
+
+			if (!ccLibAlgorithms::ApplyScalarFieldsGaussianFilter(	static_cast<PointCoordinateType>(sigma),
+																	scalarSigma,
+																	pc,
+																	inputSFs,
+																	outputSFs,
+																	approximate,
+																	&pDlg))
+			{
+				ccConsole::Warning(QString("%1 Failed to apply the process on entity '%2'").arg(logPrefix).arg(pc->getName()));
+				ccConsole::Warning(pDlg.wasCanceled() ? "Process cancelled by user" : "Process failed (not enough memory?)");
+				continue;
+			}
+
+			ccConsole::Print("%s Timing: %3.2f s.", logPrefix, static_cast<double>(eTimer.elapsed()) / 1000.0);
+
+			for (CCCoreLib::ScalarField* sf : outputSFs)
+			{
+				sf->computeMinAndMax();
 			}
+			pc->setCurrentDisplayedScalarField(lastOutSfIdx);
+			pc->showSF(true);
+			pc->prepareDisplayForRefresh_recursive();
 		}
-		
+
 		return true;
 	}
+
+	bool sfGaussianFilter(const ccHObject::Container &selectedEntities, QWidget *parent)
+	{
+		if (selectedEntities.empty())
+			return false;
+		
+		double sigma = ccLibAlgorithms::GetDefaultCloudKernelSize(selectedEntities);
+		if (sigma < 0.0)
+		{
+			ccConsole::Error("No eligible point cloud in selection!");
+			return false;
+		}
+		
+		bool ok = false;
+		sigma = QInputDialog::getDouble(parent,
+										"Gaussian filter",
+										"sigma:",
+										sigma,
+										DBL_MIN,
+										1.0e9,
+										8,
+										&ok);
+		if (!ok)
+			return false;
+		
+		return ApplySFGaussianFilter(selectedEntities, sigma, -1.0, parent);
+	}
 	
 	bool	sfBilateralFilter(const ccHObject::Container &selectedEntities, QWidget *parent)
 	{
@@ -799,81 +875,7 @@ namespace ccEntityAction
 		sigma = dlg.doubleSpinBox1->value();
 		scalarFieldSigma = dlg.doubleSpinBox2->value();
 		
-		ccProgressDialog pDlg(true, parent);
-		pDlg.setAutoClose(false);
-
-		for (ccHObject* ent : selectedEntities)
-		{
-			bool lockedVertices = false;
-			ccPointCloud* pc = ccHObjectCaster::ToPointCloud(ent, &lockedVertices);
-			if (!pc || lockedVertices)
-			{
-				ccUtils::DisplayLockedVerticesWarning(ent->getName(), selectedEntities.size() == 1);
-				continue;
-			}
-			
-			//the algorithm will use the currently displayed SF
-			CCCoreLib::ScalarField* sf = pc->getCurrentDisplayedScalarField();
-			if (sf != nullptr)
-			{
-				//we set the displayed SF as "OUT" SF
-				int outSfIdx = pc->getCurrentDisplayedScalarFieldIndex();
-				Q_ASSERT(outSfIdx >= 0);
-				
-				pc->setCurrentOutScalarField(outSfIdx);
-				CCCoreLib::ScalarField* outSF = pc->getCurrentOutScalarField();
-				Q_ASSERT(outSF != nullptr);
-				
-				QString sfName = QString("%1.bilsmooth(%2,%3)").arg(outSF->getName()).arg(sigma).arg(scalarFieldSigma);
-				int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfName));
-				if (sfIdx < 0)
-					sfIdx = pc->addScalarField(qPrintable(sfName)); //output SF has same type as input SF
-				if (sfIdx >= 0)
-					pc->setCurrentInScalarField(sfIdx);
-				else
-				{
-					ccConsole::Error(QString("Failed to create scalar field for cloud '%1' (not enough memory?)").arg(pc->getName()));
-					continue;
-				}
-				
-				ccOctree::Shared octree = pc->getOctree();
-				if (!octree)
-				{
-					octree = pc->computeOctree(&pDlg);
-					if (!octree)
-					{
-						ccConsole::Error(QString("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
-						continue;
-					}
-				}
-				
-				Q_ASSERT(octree != nullptr);
-				{
-					QElapsedTimer eTimer;
-					eTimer.start();
-					
-					CCCoreLib::ScalarFieldTools::applyScalarFieldGaussianFilter(static_cast<PointCoordinateType>(sigma),
-																			pc,
-																			static_cast<PointCoordinateType>(scalarFieldSigma),
-																			&pDlg,
-																			octree.data());
-					
-					ccConsole::Print("[BilateralFilter] Timing: %3.2f s.", eTimer.elapsed() / 1000.0);
-					pc->setCurrentDisplayedScalarField(sfIdx);
-					pc->showSF(sfIdx >= 0);
-					sf = pc->getCurrentDisplayedScalarField();
-					if (sf)
-						sf->computeMinAndMax();
-					pc->prepareDisplayForRefresh_recursive();
-				}
-			}
-			else
-			{
-				ccConsole::Warning(QString("Entity [%1] has no active scalar field!").arg(pc->getName()));
-			}
-		}
-		
-		return true;
+		return ApplySFGaussianFilter(selectedEntities, sigma, scalarFieldSigma, parent);
 	}
 	
 	bool sfConvertToRGB(const ccHObject::Container &selectedEntities, QWidget *parent)
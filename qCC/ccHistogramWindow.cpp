@@ -35,14 +35,27 @@
 #include <QTextStream>
 #include <QSettings>
 #include <QFileDialog>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
 
 //System
 #include <assert.h>
 #include <cmath>
+#include <numeric>
 
 //Gui
 #include "ui_histogramDlg.h"
 
+//! Default number of bins of the fine histogram (coarser histograms are derived from it)
+static const size_t FINE_HISTOGRAM_SIZE = (1 << 16);
+//! Number of values used to compute the quick-look histogram
+static const unsigned QUICK_LOOK_SAMPLE_COUNT = (1 << 20);
+//! Minimum number of values for which a quick-look is displayed first
+static const unsigned QUICK_LOOK_MIN_VALUE_COUNT = 4 * QUICK_LOOK_SAMPLE_COUNT;
+//! Minimum number of values per thread
+static const unsigned MIN_VALUES_PER_THREAD = (1 << 16);
+
 ccHistogramWindow::ccHistogramWindow(QWidget* parent/*=0*/)
 	: QCustomPlot(parent)
 	, m_titlePlot(nullptr)
@@ -55,6 +68,7 @@ ccHistogramWindow::ccHistogramWindow(QWidget* parent/*=0*/)
 	, m_minVal(0)
 	, m_maxVal(0)
 	, m_maxHistoVal(0)
+	, m_cancelExactHisto(0)
 	, m_overlayCurve(nullptr)
 	, m_vertBar(nullptr)
 	, m_drawVerticalIndicator(false)
@@ -92,6 +106,8 @@ ccHistogramWindow::ccHistogramWindow(QWidget* parent/*=0*/)
 	xAxis->setSubTickLength(0, 3);
 	yAxis->setTickLength(0, 5);
 	yAxis->setSubTickLength(0, 3);
+
+	connect(&m_exactHistoWatcher, &QFutureWatcher<bool>::finished, this, &ccHistogramWindow::onExactHistogramComputed);
 }
 
 ccHistogramWindow::~ccHistogramWindow()
@@ -107,6 +123,9 @@ void ccHistogramWindow::clear()
 
 void ccHistogramWindow::clearInternal()
 {
+	stopExactHistogramComputation();
+	m_fineHisto = FineHistogram();
+
 	if (m_associatedSF)
 	{
 		m_associatedSF->release();
@@ -158,6 +177,8 @@ void ccHistogramWindow::fromSF(	ccScalarField* sf,
 {
 	if (sf && m_associatedSF != sf)
 	{
+		stopExactHistogramComputation();
+		m_fineHisto = FineHistogram();
 		if (m_associatedSF)
 			m_associatedSF->release();
 		m_associatedSF = sf;
@@ -179,6 +200,8 @@ void ccHistogramWindow::fromSF(	ccScalarField* sf,
 	}
 
 	setColorScheme(USE_SF_SCALE);
+	//force the update of the bins (the range may have changed)
+	m_histoValues.resize(0);
 	setNumberOfClasses(initialNumberOfClasses);
 };
 
@@ -186,6 +209,9 @@ void ccHistogramWindow::fromBinArray(	const std::vector<unsigned>& histoValues,
 										double minVal,
 										double maxVal)
 {
+	stopExactHistogramComputation();
+	m_fineHisto = FineHistogram();
+
 	try
 	{
 		m_histoValues = histoValues;
@@ -234,8 +260,10 @@ bool ccHistogramWindow::computeBinArrayFromSF(size_t binCount)
 		return false;
 	}
 
-	//shortcut: same number of classes than the SF own histogram!
-	if (binCount == m_associatedSF->getHistogram().size())
+	//shortcut: same number of classes and same range as the SF own histogram!
+	if (	binCount == m_associatedSF->getHistogram().size()
+		&&	m_minVal == m_associatedSF->getMin()
+		&&	m_maxVal == m_associatedSF->getMax() )
 	{
 		try
 		{
@@ -249,42 +277,268 @@ bool ccHistogramWindow::computeBinArrayFromSF(size_t binCount)
 		return true;
 	}
 
-	//(try to) create new array
+	if (m_maxVal - m_minVal <= 0.0)
+	{
+		//(try to) create new array
+		try
+		{
+			m_histoValues.resize(binCount, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+			return false;
+		}
+		m_histoValues[0] = m_associatedSF->currentSize();
+		return true;
+	}
+
+	//the bins are derived from the fine histogram (computed only once)
+	if (!fineHistogramIsValid(binCount) && !updateFineHistogram(binCount))
+	{
+		return false;
+	}
+
+	return deriveBinArrayFromFineHistogram(binCount);
+}
+
+bool ccHistogramWindow::ComputeFineHistogram(FineHistogram& histo, unsigned sampleStep, const QAtomicInt* cancel/*=nullptr*/)
+{
+	if (!histo.sf || histo.bins.empty() || sampleStep == 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	const ccScalarField* sf = histo.sf;
+	const size_t binCount = histo.bins.size();
+	const double minVal = histo.minVal;
+	const double maxVal = histo.maxVal;
+	const double scale = static_cast<double>(binCount) / (maxVal - minVal);
+
+	unsigned sampleCount = (sf->currentSize() + sampleStep - 1) / sampleStep;
+	int chunkCount = std::max(1, std::min(QThread::idealThreadCount(), static_cast<int>(sampleCount / MIN_VALUES_PER_THREAD)));
+
+	//each chunk has its own bins
+	std::vector< std::vector<unsigned> > chunkBins;
 	try
 	{
-		m_histoValues.resize(binCount, 0);
+		chunkBins.resize(chunkCount);
+		for (std::vector<unsigned>& bins : chunkBins)
+		{
+			bins.resize(binCount, 0);
+		}
 	}
 	catch (const std::bad_alloc&)
 	{
-		ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
 		return false;
 	}
 
-	double range = m_maxVal - m_minVal;
-	if (range > 0.0)
+	std::vector<int> chunkIndexes(chunkCount);
+	std::iota(chunkIndexes.begin(), chunkIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(chunkIndexes, [&](int chunkIndex)
 	{
-		unsigned count = m_associatedSF->currentSize();
-		double step = range / static_cast<double>(binCount);
-		for (unsigned i = 0; i < count; ++i)
+		std::vector<unsigned>& bins = chunkBins[chunkIndex];
+		unsigned firstSample = static_cast<unsigned>((static_cast<uint64_t>(sampleCount) * chunkIndex) / chunkCount);
+		unsigned lastSample = static_cast<unsigned>((static_cast<uint64_t>(sampleCount) * (chunkIndex + 1)) / chunkCount);
+
+		for (unsigned s = firstSample; s < lastSample; ++s)
 		{
-			double val = static_cast<double>(m_associatedSF->getValue(i));
+			if (cancel && ((s - firstSample) & 0xFFFF) == 0 && cancel->loadAcquire())
+			{
+				return;
+			}
 
-			//we ignore values outside of [m_minVal,m_maxVal] (works fro NaN values as well)
-			if (/*ccScalarField::ValidValue(val) &&*/val >= m_minVal && val <= m_maxVal)
+			double val = static_cast<double>(sf->getValue(s * sampleStep));
+
+			//we ignore values outside of [minVal,maxVal] (works for NaN values as well)
+			if (val >= minVal && val <= maxVal)
 			{
-				size_t bin = static_cast<size_t>(floor((val - m_minVal) / step));
-				++m_histoValues[std::min(bin, binCount - 1)];
+				size_t bin = static_cast<size_t>((val - minVal) * scale);
+				++bins[std::min(bin, binCount - 1)];
 			}
 		}
+	});
+
+	if (cancel && cancel->loadAcquire())
+	{
+		return false;
 	}
-	else
+
+	//merge the chunks
+	for (size_t i = 0; i < binCount; ++i)
 	{
-		m_histoValues[0] = m_associatedSF->currentSize();
+		unsigned sum = 0;
+		for (const std::vector<unsigned>& bins : chunkBins)
+		{
+			sum += bins[i];
+		}
+		histo.bins[i] = sum * sampleStep;
 	}
+	histo.exact = (sampleStep == 1);
 
 	return true;
 }
 
+bool ccHistogramWindow::fineHistogramIsValid(size_t binCount) const
+{
+	if (	m_fineHisto.bins.empty()
+		||	m_fineHisto.sf != m_associatedSF
+		||	m_fineHisto.sfVersion != m_associatedSF->getValuesVersion()
+		||	m_fineHisto.minVal > m_minVal
+		||	m_fineHisto.maxVal < m_maxVal )
+	{
+		return false;
+	}
+
+	//if the current range is only a part of the fine histogram range (typically the
+	//display range of the SF), we need enough fine bins to derive the current bins
+	double fineBinsInRange = (m_maxVal - m_minVal) / (m_fineHisto.maxVal - m_fineHisto.minVal) * m_fineHisto.bins.size();
+	return (fineBinsInRange >= 16.0 * binCount || (m_fineHisto.minVal == m_minVal && m_fineHisto.maxVal == m_maxVal));
+}
+
+bool ccHistogramWindow::updateFineHistogram(size_t binCount)
+{
+	stopExactHistogramComputation();
+	m_fineHisto = FineHistogram();
+
+	//we use a multiple of the requested number of classes (so that the derived bins are exact)
+	size_t fineBinCount = binCount * ((FINE_HISTOGRAM_SIZE + binCount - 1) / binCount);
+
+	FineHistogram fineHisto;
+	try
+	{
+		fineHisto.bins.resize(fineBinCount, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+		return false;
+	}
+	fineHisto.minVal = m_minVal;
+	fineHisto.maxVal = m_maxVal;
+	fineHisto.sf = m_associatedSF;
+	fineHisto.sfVersion = m_associatedSF->getValuesVersion();
+
+	unsigned valueCount = m_associatedSF->currentSize();
+	if (valueCount < QUICK_LOOK_MIN_VALUE_COUNT)
+	{
+		//direct computation
+		if (!ComputeFineHistogram(fineHisto, 1))
+		{
+			ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+			return false;
+		}
+		m_fineHisto = std::move(fineHisto);
+		return true;
+	}
+
+	//the exact histogram will be computed in the background
+	try
+	{
+		m_pendingFineHisto = fineHisto;
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+		return false;
+	}
+
+	//meanwhile we display a quick-look (computed on a subset of the values)
+	unsigned sampleStep = (valueCount + QUICK_LOOK_SAMPLE_COUNT - 1) / QUICK_LOOK_SAMPLE_COUNT;
+	if (!ComputeFineHistogram(fineHisto, sampleStep))
+	{
+		ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+		m_pendingFineHisto = FineHistogram();
+		return false;
+	}
+	m_fineHisto = std::move(fineHisto);
+
+	m_cancelExactHisto.storeRelease(0);
+	m_exactHistoWatcher.setFuture(QtConcurrent::run([this]() { return ComputeFineHistogram(m_pendingFineHisto, 1, &m_cancelExactHisto); }));
+
+	return true;
+}
+
+bool ccHistogramWindow::deriveBinArrayFromFineHistogram(size_t binCount)
+{
+	if (m_fineHisto.bins.empty() || binCount == 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	//(try to) create new array
+	try
+	{
+		m_histoValues.resize(binCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccHistogramWindow::computeBinArrayFromSF] Not enough memory!");
+		return false;
+	}
+	std::fill(m_histoValues.begin(), m_histoValues.end(), 0);
+
+	//we merge the fine bins (depending on the position of their center)
+	//DGM: this is exact if the number of classes divides the number of fine bins and if the ranges are the same
+	const size_t fineBinCount = m_fineHisto.bins.size();
+	const double fineStep = (m_fineHisto.maxVal - m_fineHisto.minVal) / fineBinCount;
+	const double scale = static_cast<double>(binCount) / (m_maxVal - m_minVal);
+
+	size_t firstFineBin = static_cast<size_t>(std::max(0.0, floor((m_minVal - m_fineHisto.minVal) / fineStep)));
+	for (size_t i = firstFineBin; i < fineBinCount; ++i)
+	{
+		double center = m_fineHisto.minVal + (i + 0.5) * fineStep;
+		if (center < m_minVal)
+			continue;
+		if (center > m_maxVal)
+			break;
+
+		size_t bin = static_cast<size_t>((center - m_minVal) * scale);
+		m_histoValues[std::min(bin, binCount - 1)] += m_fineHisto.bins[i];
+	}
+
+	return true;
+}
+
+void ccHistogramWindow::stopExactHistogramComputation()
+{
+	if (m_exactHistoWatcher.isRunning())
+	{
+		m_cancelExactHisto.storeRelease(1);
+		m_exactHistoWatcher.waitForFinished();
+	}
+	m_pendingFineHisto = FineHistogram();
+}
+
+void ccHistogramWindow::onExactHistogramComputed()
+{
+	if (	m_exactHistoWatcher.isCanceled()
+		||	!m_exactHistoWatcher.result()
+		||	!m_associatedSF
+		||	!m_pendingFineHisto.sf
+		||	m_pendingFineHisto.sf != m_fineHisto.sf
+		||	m_pendingFineHisto.sfVersion != m_fineHisto.sfVersion
+		||	m_pendingFineHisto.minVal != m_fineHisto.minVal
+		||	m_pendingFineHisto.maxVal != m_fineHisto.maxVal )
+	{
+		//outdated or failed computation
+		return;
+	}
+
+	m_fineHisto = std::move(m_pendingFineHisto);
+	m_pendingFineHisto = FineHistogram();
+
+	//update the current bins
+	if (!m_histoValues.empty() && deriveBinArrayFromFineHistogram(m_histoValues.size()))
+	{
+		m_maxHistoVal = getMaxHistoVal();
+		refresh();
+	}
+}
+
 unsigned ccHistogramWindow::getMaxHistoVal()
 {
 	unsigned m_maxHistoVal = 0;
@@ -408,7 +662,12 @@ void ccHistogramWindow::refresh()
 			plotLayout()->remove(m_titlePlot);
 			m_titlePlot = nullptr;
 		}
-		m_titlePlot = new QCPTextElement(this, QStringLiteral("%0 [%1 classes]").arg(m_titleStr, QString::number(m_histoValues.size())));
+		QString title = QStringLiteral("%0 [%1 classes]").arg(m_titleStr, QString::number(m_histoValues.size()));
+		if (!m_fineHisto.bins.empty() && !m_fineHisto.exact)
+		{
+			title += QStringLiteral(" (preview)");
+		}
+		m_titlePlot = new QCPTextElement(this, title);
 		//title font
 		m_renderingFont.setPointSize(ccGui::Parameters().defaultFontSize);
 		m_titlePlot->setFont(m_renderingFont);
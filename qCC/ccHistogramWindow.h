@@ -22,7 +22,9 @@
 #include <ccIncludeGL.h>
 
 //Qt
+#include <QAtomicInt>
 #include <QDialog>
+#include <QFutureWatcher>
 
 //qCC_db
 #include <ccScalarField.h>
@@ -58,6 +60,9 @@ public:
 
 	//! Computes histogram from a scalar field
 	/** Number of classes can be freely modified afterwards (if enabled).
+		For large scalar fields, a (sampled) quick-look is displayed first while the
+		exact histogram is computed in the background (the display is automatically
+		refreshed once it's ready).
 		\param sf associated scalar field
 		\param initialNumberOfClasses initial number of classes
 		\param numberOfClassesCanBeChanged whether to allow the user to modify the number of classes
@@ -172,6 +177,52 @@ protected: //methods
 	//! Dynamically computes histogram bins from scalar field
 	bool computeBinArrayFromSF(size_t binCount);
 
+	//! Finest resolution histogram of the associated scalar field
+	/** Coarser histograms are derived from it by merging bins.
+	**/
+	struct FineHistogram
+	{
+		//! Bins
+		std::vector<unsigned> bins;
+		//! Min value
+		double minVal = 0.0;
+		//! Max value
+		double maxVal = 0.0;
+		//! Scalar field
+		const ccScalarField* sf = nullptr;
+		//! Scalar field values version (see ccScalarField::getValuesVersion)
+		unsigned sfVersion = 0;
+		//! Whether the bins are exact or have been computed on a subset of the values
+		bool exact = false;
+	};
+
+	//! Computes the bins of a fine histogram (multi-threaded)
+	/** The bins array, the min and max values must have been set beforehand.
+		\param histo fine histogram
+		\param sampleStep only one value out of 'sampleStep' is considered (counts are scaled accordingly)
+		\param cancel optional 'cancel' flag (the process stops and fails as soon as it is set)
+		\return success
+	**/
+	static bool ComputeFineHistogram(FineHistogram& histo, unsigned sampleStep, const QAtomicInt* cancel = nullptr);
+
+	//! Returns whether the current fine histogram can be used to derive the current bins
+	bool fineHistogramIsValid(size_t binCount) const;
+
+	//! (Re)computes the fine histogram of the associated scalar field
+	/** For large scalar fields, a sampled quick-look is computed and the exact
+		histogram is computed in the background.
+	**/
+	bool updateFineHistogram(size_t binCount);
+
+	//! Derives the current bins from the fine histogram
+	bool deriveBinArrayFromFineHistogram(size_t binCount);
+
+	//! Stops the background computation of the exact fine histogram (if any)
+	void stopExactHistogramComputation();
+
+	//! Called when the background computation of the exact fine histogram is finished
+	void onExactHistogramComputed();
+
 	//! Updates overlay curve width depending on the widget display size
 	void updateOverlayCurveWidth(int w, int h);
 
@@ -204,6 +255,15 @@ protected: //attributes
 	double m_maxVal;
 	unsigned m_maxHistoVal;
 
+	//! Fine histogram (the current bins are derived from it)
+	FineHistogram m_fineHisto;
+	//! Exact fine histogram (being computed in the background)
+	FineHistogram m_pendingFineHisto;
+	//! Background computation of the exact fine histogram
+	QFutureWatcher<bool> m_exactHistoWatcher;
+	//! Whether the background computation should be canceled
+	QAtomicInt m_cancelExactHisto;
+
 	//! Overlay curve
 	QCPGraph* m_overlayCurve;
 	std::vector<double> m_curveValues;
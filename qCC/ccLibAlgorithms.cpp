@@ -18,6 +18,9 @@
 #include "ccLibAlgorithms.h"
 
 //CCCoreLib
+#include <DistanceComputationTools.h>
+#include <Jacobi.h>
+#include <Neighbourhood.h>
 #include <ScalarFieldTools.h>
 
 //qCC_db
@@ -37,6 +40,11 @@
 #include <QElapsedTimer>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QtConcurrentMap>
+
+//system
+#include <algorithm>
+#include <numeric>
 
 // This is included only for temporarily removing an object from the tree.
 //	TODO figure out a cleaner way to do this without having to include all of mainwindow.h
@@ -115,68 +123,12 @@ namespace ccLibAlgorithms
 		return sigma;
 	}
 
-	bool ComputeGeomCharacteristics(const GeomCharacteristicSet& characteristics,
-									PointCoordinateType radius,
-									ccHObject::Container& entities,
-									QWidget* parent/*=nullptr*/)
+	//! Returns the name of the scalar field associated to a given geometrical characteristic
+	static bool GetGeomCharacteristicSFName(	CCCoreLib::GeometricalAnalysisTools::GeomCharacteristic c,
+												int subOption,
+												PointCoordinateType radius,
+												QString& sfName)
 	{
-		//no feature case
-		if (characteristics.empty())
-		{
-			//nothing to do
-			assert(false);
-			return true;
-		}
-		
-		//single features case
-		if (characteristics.size() == 1)
-		{
-			return ComputeGeomCharacteristic(	characteristics.front().charac,
-												characteristics.front().subOption,
-												radius,
-												entities,
-												parent);
-		}
-
-		//multiple features case
-		QScopedPointer<ccProgressDialog> pDlg;
-		if (parent)
-		{
-			pDlg.reset(new ccProgressDialog(true, parent));
-			pDlg->setAutoClose(false);
-		}
-		
-		for (const GeomCharacteristic& g : characteristics)
-		{
-			if (!ComputeGeomCharacteristic(	g.charac,
-											g.subOption,
-											radius,
-											entities,
-											parent,
-											pDlg.data()))
-			{
-				return false;
-			}
-		}
-
-		return true;
-	}
-
-
-	bool ComputeGeomCharacteristic(	CCCoreLib::GeometricalAnalysisTools::GeomCharacteristic c,
-									int subOption,
-									PointCoordinateType radius,
-									ccHObject::Container& entities,
-									QWidget* parent/*= nullptr*/,
-									ccProgressDialog* progressDialog/*=nullptr*/)
-	{
-		size_t selNum = entities.size();
-		if (selNum < 1)
-			return false;
-
-		//generate the right SF name
-		QString sfName;
-
 		switch (c)
 		{
 		case CCCoreLib::GeometricalAnalysisTools::Feature:
@@ -278,6 +230,450 @@ namespace ccLibAlgorithms
 			return false;
 		}
 
+		return true;
+	}
+
+	//! Geometrical characteristic computed by the fused engine
+	struct FusedGeomCharacteristic
+	{
+		CCCoreLib::GeometricalAnalysisTools::GeomCharacteristic charac;
+		int subOption;
+		CCCoreLib::ScalarField* sf;
+	};
+
+	//! Parameters of the fused engine
+	struct FusedGeomCharacteristicsParams
+	{
+		PointCoordinateType radius;
+		std::vector<FusedGeomCharacteristic> characteristics;
+		bool needEigenValues;
+	};
+
+	//! Returns whether a characteristic can be computed by the fused engine
+	/** I.e. if it only depends on the spherical neighbourhood of each point.
+	**/
+	static bool CanBeFused(CCCoreLib::GeometricalAnalysisTools::GeomCharacteristic c)
+	{
+		switch (c)
+		{
+		case CCCoreLib::GeometricalAnalysisTools::Feature:
+		case CCCoreLib::GeometricalAnalysisTools::Curvature:
+		case CCCoreLib::GeometricalAnalysisTools::LocalDensity:
+		case CCCoreLib::GeometricalAnalysisTools::Roughness:
+			return true;
+		default:
+			break;
+		}
+		return false;
+	}
+
+	//! Computes an eigen-feature from the (sorted) eigenvalues and the 3rd eigenvector
+	/** Same formulas as CCCoreLib::Neighbourhood::computeFeature.
+	**/
+	static double ComputeEigenFeature(CCCoreLib::Neighbourhood::GeomFeature feature, double l1, double l2, double l3, const CCVector3d& e3)
+	{
+		static const double eps = std::numeric_limits<double>::epsilon();
+
+		switch (feature)
+		{
+		case CCCoreLib::Neighbourhood::EigenValuesSum:
+			return l1 + l2 + l3;
+		case CCCoreLib::Neighbourhood::Omnivariance:
+			return pow(l1 * l2 * l3, 1.0 / 3.0);
+		case CCCoreLib::Neighbourhood::EigenEntropy:
+			return -(l1 * log(l1) + l2 * log(l2) + l3 * log(l3));
+		case CCCoreLib::Neighbourhood::Anisotropy:
+			return (std::abs(l1) > eps ? (l1 - l3) / l1 : CCCoreLib::NAN_VALUE);
+		case CCCoreLib::Neighbourhood::Planarity:
+			return (std::abs(l1) > eps ? (l2 - l3) / l1 : CCCoreLib::NAN_VALUE);
+		case CCCoreLib::Neighbourhood::Linearity:
+			return (std::abs(l1) > eps ? (l1 - l2) / l1 : CCCoreLib::NAN_VALUE);
+		case CCCoreLib::Neighbourhood::PCA1:
+		case CCCoreLib::Neighbourhood::PCA2:
+		case CCCoreLib::Neighbourhood::SurfaceVariation:
+		{
+			double sum = l1 + l2 + l3;
+			if (std::abs(sum) <= eps)
+				return CCCoreLib::NAN_VALUE;
+			return (feature == CCCoreLib::Neighbourhood::PCA1 ? l1 : feature == CCCoreLib::Neighbourhood::PCA2 ? l2 : l3) / sum;
+		}
+		case CCCoreLib::Neighbourhood::Sphericity:
+			return (std::abs(l1) > eps ? l3 / l1 : CCCoreLib::NAN_VALUE);
+		case CCCoreLib::Neighbourhood::Verticality:
+			return 1.0 - std::abs(e3.z);
+		case CCCoreLib::Neighbourhood::EigenValue1:
+			return l1;
+		case CCCoreLib::Neighbourhood::EigenValue2:
+			return l2;
+		case CCCoreLib::Neighbourhood::EigenValue3:
+			return l3;
+		default:
+			assert(false);
+			break;
+		}
+
+		return CCCoreLib::NAN_VALUE;
+	}
+
+	//! Computes all the requested characteristics for the points of a given octree cell
+	/** The neighbourhood of each point is extracted only once, and the eigen
+		decomposition of its covariance matrix is shared by all the eigen-features.
+	**/
+	static bool ComputeFusedGeomCharacteristicsAtLevel(	const CCCoreLib::DgmOctree::octreeCell& cell,
+														void** additionalParameters,
+														CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+	{
+		const FusedGeomCharacteristicsParams& params = *static_cast<const FusedGeomCharacteristicsParams*>(additionalParameters[0]);
+		const PointCoordinateType radius = params.radius;
+
+		return ccOctree::FindNeighborsInASphereForCellPoints(cell, radius, [&](ccOctree::QueryContext& context, unsigned i, unsigned k)
+		{
+			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+			CCCoreLib::DgmOctree::NeighboursSet& neighbours = context.nNSS.pointsInNeighbourhood;
+
+			CCCoreLib::DgmOctreeReferenceCloud neighboursCloud(&neighbours, k);
+			CCCoreLib::Neighbourhood Z(&neighboursCloud);
+
+			//eigen decomposition (computed once, for all the eigen-features)
+			bool eigenValid = false;
+			double l1 = 0.0, l2 = 0.0, l3 = 0.0;
+			CCVector3d e3(0, 0, 1);
+			if (params.needEigenValues && k > 3)
+			{
+				CCCoreLib::SquareMatrixd covMat = Z.computeCovarianceMatrix();
+				CCCoreLib::SquareMatrixd eigVectors;
+				std::vector<double> eigValues;
+				if (covMat.isValid() && CCCoreLib::Jacobi<double>::ComputeEigenValuesAndVectors(covMat, eigVectors, eigValues, true))
+				{
+					CCCoreLib::Jacobi<double>::SortEigenValuesAndVectors(eigVectors, eigValues);
+					l1 = eigValues[0];
+					l2 = eigValues[1];
+					l3 = eigValues[2];
+					CCCoreLib::Jacobi<double>::GetEigenVector(eigVectors, 2, e3.u);
+					eigenValid = true;
+				}
+			}
+
+			bool hasRoughness = false;
+			for (const FusedGeomCharacteristic& fc : params.characteristics)
+			{
+				ScalarType value = CCCoreLib::NAN_VALUE;
+
+				switch (fc.charac)
+				{
+				case CCCoreLib::GeometricalAnalysisTools::Feature:
+					if (eigenValid)
+					{
+						value = static_cast<ScalarType>(ComputeEigenFeature(static_cast<CCCoreLib::Neighbourhood::GeomFeature>(fc.subOption), l1, l2, l3, e3));
+					}
+					break;
+
+				case CCCoreLib::GeometricalAnalysisTools::Curvature:
+					if (k > 5)
+					{
+						value = Z.computeCurvature(context.nNSS.queryPoint, static_cast<CCCoreLib::Neighbourhood::CurvatureType>(fc.subOption));
+					}
+					break;
+
+				case CCCoreLib::GeometricalAnalysisTools::LocalDensity:
+					switch (static_cast<CCCoreLib::GeometricalAnalysisTools::Density>(fc.subOption))
+					{
+					case CCCoreLib::GeometricalAnalysisTools::DENSITY_KNN:
+						value = static_cast<ScalarType>(k);
+						break;
+					case CCCoreLib::GeometricalAnalysisTools::DENSITY_2D:
+						value = static_cast<ScalarType>(k / (M_PI * radius * radius));
+						break;
+					case CCCoreLib::GeometricalAnalysisTools::DENSITY_3D:
+						value = static_cast<ScalarType>(k / ((4.0 / 3.0) * M_PI * radius * radius * radius));
+						break;
+					default:
+						assert(false);
+						break;
+					}
+					break;
+
+				case CCCoreLib::GeometricalAnalysisTools::Roughness:
+					//computed last (as the neighbourhood will be modified)
+					hasRoughness = true;
+					continue;
+
+				default:
+					assert(false);
+					break;
+				}
+
+				fc.sf->setValue(globalIndex, value);
+			}
+
+			if (hasRoughness)
+			{
+				ScalarType value = CCCoreLib::NAN_VALUE;
+				if (k > 3)
+				{
+					//find the query point in the nearest neighbors set and place it at the end
+					unsigned localIndex = 0;
+					while (localIndex < k && neighbours[localIndex].pointIndex != globalIndex)
+						++localIndex;
+					assert(localIndex < k);
+					if (localIndex + 1 < k)
+					{
+						std::swap(neighbours[localIndex], neighbours[k - 1]);
+					}
+
+					//we don't take the query point into account
+					CCCoreLib::DgmOctreeReferenceCloud roughnessCloud(&neighbours, k - 1);
+					CCCoreLib::Neighbourhood roughnessZ(&roughnessCloud);
+					const PointCoordinateType* lsPlane = roughnessZ.getLSPlane();
+					if (lsPlane)
+					{
+						value = std::abs(CCCoreLib::DistanceComputationTools::computePoint2PlaneDistance(&context.nNSS.queryPoint, lsPlane));
+					}
+				}
+
+				for (const FusedGeomCharacteristic& fc : params.characteristics)
+				{
+					if (fc.charac == CCCoreLib::GeometricalAnalysisTools::Roughness)
+					{
+						fc.sf->setValue(globalIndex, value);
+					}
+				}
+			}
+
+			return true;
+		},
+		nProgress);
+	}
+
+	//! Computes several geometrical characteristics on a set of entities in a single pass
+	/** The neighbourhood of each point is extracted only once for all the characteristics.
+		\warning all the characteristics must be compatible (see CanBeFused)
+	**/
+	static bool ComputeFusedGeomCharacteristics(const GeomCharacteristicSet& characteristics,
+												PointCoordinateType radius,
+												ccHObject::Container& entities,
+												QWidget* parent,
+												ccProgressDialog* pDlg)
+	{
+		//generate the SF names
+		QStringList sfNames;
+		bool needEigenValues = false;
+		for (const GeomCharacteristic& g : characteristics)
+		{
+			assert(CanBeFused(g.charac));
+			QString sfName;
+			if (!GetGeomCharacteristicSFName(g.charac, g.subOption, radius, sfName))
+			{
+				return false;
+			}
+			sfNames << sfName;
+			needEigenValues |= (g.charac == CCCoreLib::GeometricalAnalysisTools::Feature);
+		}
+
+		for (ccHObject* entity : entities)
+		{
+			//is this entity eligible for processing?
+			if (!entity->isKindOf(CC_TYPES::POINT_CLOUD))
+			{
+				continue;
+			}
+
+			if (!entity->isA(CC_TYPES::POINT_CLOUD))
+			{
+				//we can't create the scalar fields: we fall back to the standard method
+				ccHObject::Container singleEntity{ entity };
+				for (const GeomCharacteristic& g : characteristics)
+				{
+					if (!ComputeGeomCharacteristic(g.charac, g.subOption, radius, singleEntity, parent, pDlg))
+					{
+						return false;
+					}
+				}
+				continue;
+			}
+
+			ccPointCloud* pc = static_cast<ccPointCloud*>(entity);
+			if (pc->size() == 0)
+			{
+				continue;
+			}
+
+			ccOctree::Shared octree = pc->getOctree();
+			if (!octree)
+			{
+				if (pDlg)
+				{
+					pDlg->show();
+				}
+				octree = pc->computeOctree(pDlg);
+				if (!octree)
+				{
+					ccConsole::Error(QString("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
+					break;
+				}
+			}
+
+			//prepare the scalar fields
+			FusedGeomCharacteristicsParams params;
+			params.radius = radius;
+			params.needEigenValues = needEigenValues;
+			int lastSfIdx = -1;
+			bool error = false;
+			for (size_t j = 0; j < characteristics.size(); ++j)
+			{
+				int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfNames[static_cast<int>(j)]));
+				if (sfIdx < 0)
+					sfIdx = pc->addScalarField(qPrintable(sfNames[static_cast<int>(j)]));
+				if (sfIdx < 0)
+				{
+					ccConsole::Error(QString("Failed to create scalar field on cloud '%1' (not enough memory?)").arg(pc->getName()));
+					error = true;
+					break;
+				}
+
+				CCCoreLib::ScalarField* sf = pc->getScalarField(sfIdx);
+				sf->fill(CCCoreLib::NAN_VALUE);
+				params.characteristics.push_back({ characteristics[j].charac, characteristics[j].subOption, sf });
+				lastSfIdx = sfIdx;
+			}
+
+			if (!error)
+			{
+				if (pDlg)
+				{
+					pDlg->show();
+				}
+
+				void* additionalParameters[1] = { static_cast<void*>(&params) };
+				unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+				unsigned processedCells = octree->executeFunctionForAllCellsAtLevel(level,
+																					&ComputeFusedGeomCharacteristicsAtLevel,
+																					additionalParameters,
+																					true,
+																					pDlg,
+																					"Geometric features");
+				ccOctree::ReleaseQueryContexts();
+				if (processedCells == 0)
+				{
+					ccConsole::Warning(QString("Failed to apply processing to cloud '%1'").arg(pc->getName()));
+					ccConsole::Warning((pDlg && pDlg->wasCanceled()) ? "Process cancelled by user" : "Process failed (not enough memory?)");
+					error = true;
+				}
+			}
+
+			if (error)
+			{
+				//remove the (incomplete) scalar fields
+				for (const QString& sfName : sfNames)
+				{
+					int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfName));
+					if (sfIdx >= 0)
+					{
+						pc->deleteScalarField(sfIdx);
+					}
+				}
+				return false;
+			}
+
+			for (const FusedGeomCharacteristic& fc : params.characteristics)
+			{
+				fc.sf->computeMinAndMax();
+			}
+			pc->setCurrentDisplayedScalarField(lastSfIdx);
+			pc->showSF(true);
+			pc->prepareDisplayForRefresh();
+		}
+
+		return true;
+	}
+
+	bool ComputeGeomCharacteristics(const GeomCharacteristicSet& characteristics,
+									PointCoordinateType radius,
+									ccHObject::Container& entities,
+									QWidget* parent/*=nullptr*/)
+	{
+		//no feature case
+		if (characteristics.empty())
+		{
+			//nothing to do
+			assert(false);
+			return true;
+		}
+		
+		//single features case
+		if (characteristics.size() == 1)
+		{
+			return ComputeGeomCharacteristic(	characteristics.front().charac,
+												characteristics.front().subOption,
+												radius,
+												entities,
+												parent);
+		}
+
+		//multiple features case
+		QScopedPointer<ccProgressDialog> pDlg;
+		if (parent)
+		{
+			pDlg.reset(new ccProgressDialog(true, parent));
+			pDlg->setAutoClose(false);
+		}
+		
+		//the characteristics that only depend on the spherical neighbourhood of each point
+		//are computed in a single pass (the neighbourhoods are only extracted once)
+		GeomCharacteristicSet fusedCharacteristics;
+		GeomCharacteristicSet otherCharacteristics;
+		for (const GeomCharacteristic& g : characteristics)
+		{
+			(CanBeFused(g.charac) ? fusedCharacteristics : otherCharacteristics).push_back(g);
+		}
+
+		if (fusedCharacteristics.size() > 1)
+		{
+			if (!ComputeFusedGeomCharacteristics(fusedCharacteristics, radius, entities, parent, pDlg.data()))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			otherCharacteristics.insert(otherCharacteristics.begin(), fusedCharacteristics.begin(), fusedCharacteristics.end());
+		}
+
+		for (const GeomCharacteristic& g : otherCharacteristics)
+		{
+			if (!ComputeGeomCharacteristic(	g.charac,
+											g.subOption,
+											radius,
+											entities,
+											parent,
+											pDlg.data()))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	bool ComputeGeomCharacteristic(	CCCoreLib::GeometricalAnalysisTools::GeomCharacteristic c,
+									int subOption,
+									PointCoordinateType radius,
+									ccHObject::Container& entities,
+									QWidget* parent/*= nullptr*/,
+									ccProgressDialog* progressDialog/*=nullptr*/)
+	{
+		size_t selNum = entities.size();
+		if (selNum < 1)
+			return false;
+
+		//generate the right SF name
+		QString sfName;
+		if (!GetGeomCharacteristicSFName(c, subOption, radius, sfName))
+		{
+			return false;
+		}
+
 		ccProgressDialog* pDlg = progressDialog;
 		if (!pDlg && parent)
 		{
@@ -399,6 +795,441 @@ namespace ccLibAlgorithms
 	}
 
 
+	//! Parameters of the multi-SF Gaussian filter
+	struct ScalarFieldsGaussianFilterParams
+	{
+		//! Spatial sigma
+		double sigma = 0.0;
+		//! Scalar sigma (bilateral filter only)
+		double scalarSigma = -1.0;
+		//! Input scalar fields
+		std::vector<CCCoreLib::ScalarField*> inputSFs;
+		//! Output scalar fields
+		std::vector<CCCoreLib::ScalarField*> outputSFs;
+
+		//! Returns whether the filter is bilateral
+		inline bool isBilateral() const { return scalarSigma > 0; }
+		//! Returns the scalar weight (bilateral filter only)
+		inline double scalarWeight(double valueDiff) const { return exp(-(valueDiff * valueDiff) / (2 * scalarSigma * scalarSigma)); }
+	};
+
+	//! Applies the multi-SF Gaussian filter to the points of an octree cell (exact mode)
+	static bool ApplyScalarFieldsGaussianFilterAtLevel(	const CCCoreLib::DgmOctree::octreeCell& cell,
+														void** additionalParameters,
+														CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+	{
+		const ScalarFieldsGaussianFilterParams& params = *static_cast<const ScalarFieldsGaussianFilterParams*>(additionalParameters[0]);
+		const size_t sfCount = params.inputSFs.size();
+		const PointCoordinateType radius = static_cast<PointCoordinateType>(3 * params.sigma);
+		const double sigma2x2 = 2 * params.sigma * params.sigma;
+
+		std::vector<double> sums(sfCount);
+		std::vector<double> weightSums(sfCount);
+		std::vector<ScalarType> queryValues(sfCount);
+
+		return ccOctree::FindNeighborsInASphereForCellPoints(cell, radius, [&](ccOctree::QueryContext& context, unsigned i, unsigned k)
+		{
+			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+			const CCCoreLib::DgmOctree::NeighboursSet& neighbours = context.nNSS.pointsInNeighbourhood;
+
+			std::fill(sums.begin(), sums.end(), 0.0);
+			std::fill(weightSums.begin(), weightSums.end(), 0.0);
+			if (params.isBilateral())
+			{
+				for (size_t s = 0; s < sfCount; ++s)
+				{
+					queryValues[s] = params.inputSFs[s]->getValue(globalIndex);
+				}
+			}
+
+			//the neighbourhood is shared by all the scalar fields
+			for (unsigned n = 0; n < k; ++n)
+			{
+				const CCCoreLib::DgmOctree::PointDescriptor& neighbour = neighbours[n];
+				const double spatialWeight = exp(-neighbour.squareDistd / sigma2x2);
+
+				for (size_t s = 0; s < sfCount; ++s)
+				{
+					ScalarType value = params.inputSFs[s]->getValue(neighbour.pointIndex);
+					if (!CCCoreLib::ScalarField::ValidValue(value))
+					{
+						continue;
+					}
+
+					double weight = spatialWeight;
+					if (params.isBilateral())
+					{
+						if (!CCCoreLib::ScalarField::ValidValue(queryValues[s]))
+						{
+							continue;
+						}
+						weight *= params.scalarWeight(value - queryValues[s]);
+					}
+
+					sums[s] += weight * value;
+					weightSums[s] += weight;
+				}
+			}
+
+			for (size_t s = 0; s < sfCount; ++s)
+			{
+				params.outputSFs[s]->setValue(globalIndex, weightSums[s] > 0 ? static_cast<ScalarType>(sums[s] / weightSums[s]) : CCCoreLib::NAN_VALUE);
+			}
+
+			return true;
+		}, nProgress);
+	}
+
+	//! Data of the multi-SF Gaussian filter (approximate mode)
+	struct ApproxScalarFieldsGaussianFilterData
+	{
+		//! Filter parameters
+		const ScalarFieldsGaussianFilterParams* params = nullptr;
+		//! Octree
+		const CCCoreLib::DgmOctree* octree = nullptr;
+		//! Octree level
+		unsigned char level = 0;
+		//! (Truncated) codes of the non empty cells (sorted)
+		CCCoreLib::DgmOctree::cellCodesContainer cellCodes;
+		//! Cells centroids
+		std::vector<CCVector3d> centroids;
+		//! Number of valid values (per cell and per scalar field)
+		std::vector<unsigned> validCounts;
+		//! Average values (per cell and per scalar field)
+		std::vector<double> means;
+		//! Filtered values (per cell and per scalar field)
+		std::vector<double> filtered;
+		//! Sigma of the interpolation kernel
+		double upSigma = 0.0;
+
+		//! Returns the index of a non empty cell (or -1)
+		int findCell(const Tuple3i& cellPos) const
+		{
+			const int length = (1 << level);
+			if (	cellPos.x < 0 || cellPos.x >= length
+				||	cellPos.y < 0 || cellPos.y >= length
+				||	cellPos.z < 0 || cellPos.z >= length)
+			{
+				return -1;
+			}
+
+			CCCoreLib::DgmOctree::CellCode code = CCCoreLib::DgmOctree::GenerateTruncatedCellCode(cellPos, level);
+			auto it = std::lower_bound(cellCodes.begin(), cellCodes.end(), code);
+			return (it != cellCodes.end() && *it == code) ? static_cast<int>(it - cellCodes.begin()) : -1;
+		}
+	};
+
+	//! Computes the per-cell averages (approximate mode)
+	static bool AggregateCellForScalarFieldsGaussianFilter(	const CCCoreLib::DgmOctree::octreeCell& cell,
+															void** additionalParameters,
+															CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+	{
+		ApproxScalarFieldsGaussianFilterData& data = *static_cast<ApproxScalarFieldsGaussianFilterData*>(additionalParameters[0]);
+		const std::vector<CCCoreLib::ScalarField*>& inputSFs = data.params->inputSFs;
+		const size_t sfCount = inputSFs.size();
+
+		Tuple3i cellPos;
+		data.octree->getCellPos(cell.truncatedCode, data.level, cellPos, true);
+		int c = data.findCell(cellPos);
+		if (c < 0)
+		{
+			assert(false);
+			return false;
+		}
+
+		const unsigned pointCount = cell.points->size();
+		CCVector3d sumP(0, 0, 0);
+		double* means = data.means.data() + c * sfCount;
+		unsigned* validCounts = data.validCounts.data() + c * sfCount;
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			sumP += CCVector3d::fromArray(cell.points->getPoint(i)->u);
+
+			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+			for (size_t s = 0; s < sfCount; ++s)
+			{
+				ScalarType value = inputSFs[s]->getValue(globalIndex);
+				if (CCCoreLib::ScalarField::ValidValue(value))
+				{
+					means[s] += value;
+					++validCounts[s];
+				}
+			}
+		}
+
+		data.centroids[c] = sumP / pointCount;
+		for (size_t s = 0; s < sfCount; ++s)
+		{
+			means[s] = (validCounts[s] != 0 ? means[s] / validCounts[s] : std::numeric_limits<double>::quiet_NaN());
+		}
+
+		return (!nProgress || nProgress->steps(pointCount));
+	}
+
+	//! Interpolates the filtered values at each point of a cell (approximate mode)
+	static bool InterpolateCellForScalarFieldsGaussianFilter(	const CCCoreLib::DgmOctree::octreeCell& cell,
+																void** additionalParameters,
+																CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+	{
+		const ApproxScalarFieldsGaussianFilterData& data = *static_cast<const ApproxScalarFieldsGaussianFilterData*>(additionalParameters[0]);
+		const ScalarFieldsGaussianFilterParams& params = *data.params;
+		const size_t sfCount = params.inputSFs.size();
+		const double upSigma2x2 = 2 * data.upSigma * data.upSigma;
+
+		//the (non empty) cells around the current one
+		std::vector<int> neighborCells;
+		neighborCells.reserve(27);
+		{
+			Tuple3i cellPos;
+			data.octree->getCellPos(cell.truncatedCode, data.level, cellPos, true);
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dz = -1; dz <= 1; ++dz)
+					{
+						int n = data.findCell(Tuple3i(cellPos.x + dx, cellPos.y + dy, cellPos.z + dz));
+						if (n >= 0)
+						{
+							neighborCells.push_back(n);
+						}
+					}
+				}
+			}
+		}
+
+		std::vector<double> sums(sfCount);
+		std::vector<double> weightSums(sfCount);
+
+		const unsigned pointCount = cell.points->size();
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			const CCVector3d P = CCVector3d::fromArray(cell.points->getPoint(i)->u);
+			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+
+			std::fill(sums.begin(), sums.end(), 0.0);
+			std::fill(weightSums.begin(), weightSums.end(), 0.0);
+
+			for (int n : neighborCells)
+			{
+				const double spatialWeight = exp(-(P - data.centroids[n]).norm2() / upSigma2x2);
+				const double* filtered = data.filtered.data() + n * sfCount;
+
+				for (size_t s = 0; s < sfCount; ++s)
+				{
+					if (std::isnan(filtered[s]))
+					{
+						continue;
+					}
+
+					double weight = spatialWeight;
+					if (params.isBilateral())
+					{
+						ScalarType queryValue = params.inputSFs[s]->getValue(globalIndex);
+						if (!CCCoreLib::ScalarField::ValidValue(queryValue))
+						{
+							continue;
+						}
+						weight *= params.scalarWeight(filtered[s] - queryValue);
+					}
+
+					sums[s] += weight * filtered[s];
+					weightSums[s] += weight;
+				}
+			}
+
+			for (size_t s = 0; s < sfCount; ++s)
+			{
+				params.outputSFs[s]->setValue(globalIndex, weightSums[s] > 0 ? static_cast<ScalarType>(sums[s] / weightSums[s]) : CCCoreLib::NAN_VALUE);
+			}
+		}
+
+		return (!nProgress || nProgress->steps(pointCount));
+	}
+
+	static bool ApplyApproxScalarFieldsGaussianFilter(	const ScalarFieldsGaussianFilterParams& params,
+														ccOctree* octree,
+														CCCoreLib::GenericProgressCallback* progressCb)
+	{
+		ApproxScalarFieldsGaussianFilterData data;
+		data.params = &params;
+		data.octree = octree;
+
+		//finest level with cells bigger than sigma
+		data.level = 1;
+		for (unsigned char level = CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL; level > 0; --level)
+		{
+			if (octree->getCellSize(level) >= params.sigma)
+			{
+				data.level = level;
+				break;
+			}
+		}
+		const double cellSize = octree->getCellSize(data.level);
+
+		//the variances of the cell-level kernel and of the interpolation kernel add up
+		data.upSigma = cellSize / 2;
+		const double cellSigma = sqrt(std::max(params.sigma * params.sigma - data.upSigma * data.upSigma, params.sigma * params.sigma / 4));
+		const double cellSigma2x2 = 2 * cellSigma * cellSigma;
+		const double cellRadius = 3 * cellSigma;
+		const int cellRange = static_cast<int>(ceil(cellRadius / cellSize));
+
+		const size_t sfCount = params.inputSFs.size();
+		try
+		{
+			if (!octree->getCellCodes(data.level, data.cellCodes, true))
+			{
+				return false;
+			}
+			const size_t cellCount = data.cellCodes.size();
+			data.centroids.resize(cellCount);
+			data.validCounts.resize(cellCount * sfCount, 0);
+			data.means.resize(cellCount * sfCount, 0.0);
+			data.filtered.resize(cellCount * sfCount, std::numeric_limits<double>::quiet_NaN());
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return false;
+		}
+
+		void* additionalParameters[1] = { static_cast<void*>(&data) };
+
+		//1st pass: per-cell averages
+		if (octree->executeFunctionForAllCellsAtLevel(	data.level,
+														&AggregateCellForScalarFieldsGaussianFilter,
+														additionalParameters,
+														true,
+														progressCb,
+														"Gaussian filter (1/2)") == 0)
+		{
+			return false;
+		}
+
+		//2nd pass: filter applied to the cells
+		std::vector<int> cellIndexes(data.cellCodes.size());
+		std::iota(cellIndexes.begin(), cellIndexes.end(), 0);
+		QtConcurrent::blockingMap(cellIndexes, [&](int c)
+		{
+			Tuple3i cellPos;
+			octree->getCellPos(data.cellCodes[c], data.level, cellPos, true);
+			const double* cellMeans = data.means.data() + c * sfCount;
+
+			std::vector<double> sums(sfCount, 0.0);
+			std::vector<double> weightSums(sfCount, 0.0);
+			for (int dx = -cellRange; dx <= cellRange; ++dx)
+			{
+				for (int dy = -cellRange; dy <= cellRange; ++dy)
+				{
+					for (int dz = -cellRange; dz <= cellRange; ++dz)
+					{
+						int n = data.findCell(Tuple3i(cellPos.x + dx, cellPos.y + dy, cellPos.z + dz));
+						if (n < 0)
+						{
+							continue;
+						}
+
+						double squareDist = (data.centroids[c] - data.centroids[n]).norm2();
+						if (squareDist > cellRadius * cellRadius)
+						{
+							continue;
+						}
+						const double spatialWeight = exp(-squareDist / cellSigma2x2);
+
+						const double* neighborMeans = data.means.data() + n * sfCount;
+						const unsigned* neighborCounts = data.validCounts.data() + n * sfCount;
+						for (size_t s = 0; s < sfCount; ++s)
+						{
+							if (neighborCounts[s] == 0)
+							{
+								continue;
+							}
+
+							//each cell weighs as much as its points
+							double weight = spatialWeight * neighborCounts[s];
+							if (params.isBilateral())
+							{
+								if (std::isnan(cellMeans[s]))
+								{
+									continue;
+								}
+								weight *= params.scalarWeight(neighborMeans[s] - cellMeans[s]);
+							}
+
+							sums[s] += weight * neighborMeans[s];
+							weightSums[s] += weight;
+						}
+					}
+				}
+			}
+
+			double* filtered = data.filtered.data() + c * sfCount;
+			for (size_t s = 0; s < sfCount; ++s)
+			{
+				if (weightSums[s] > 0)
+				{
+					filtered[s] = sums[s] / weightSums[s];
+				}
+			}
+		});
+
+		//3rd pass: interpolation at each point
+		return octree->executeFunctionForAllCellsAtLevel(	data.level,
+															&InterpolateCellForScalarFieldsGaussianFilter,
+															additionalParameters,
+															true,
+															progressCb,
+															"Gaussian filter (2/2)") != 0;
+	}
+
+	bool ApplyScalarFieldsGaussianFilter(	PointCoordinateType sigma,
+											double scalarSigma,
+											ccPointCloud* cloud,
+											const std::vector<CCCoreLib::ScalarField*>& inputSFs,
+											const std::vector<CCCoreLib::ScalarField*>& outputSFs,
+											bool approximate/*=false*/,
+											CCCoreLib::GenericProgressCallback* progressCb/*=nullptr*/)
+	{
+		if (!cloud || sigma <= 0 || inputSFs.empty() || inputSFs.size() != outputSFs.size())
+		{
+			assert(false);
+			return false;
+		}
+
+		ccOctree::Shared octree = cloud->getOctree();
+		if (!octree)
+		{
+			octree = cloud->computeOctree(progressCb);
+			if (!octree)
+			{
+				ccConsole::Error(QString("Couldn't compute octree for cloud '%1'!").arg(cloud->getName()));
+				return false;
+			}
+		}
+
+		ScalarFieldsGaussianFilterParams params;
+		params.sigma = sigma;
+		params.scalarSigma = scalarSigma;
+		params.inputSFs = inputSFs;
+		params.outputSFs = outputSFs;
+
+		if (approximate)
+		{
+			return ApplyApproxScalarFieldsGaussianFilter(params, octree.data(), progressCb);
+		}
+
+		void* additionalParameters[1] = { static_cast<void*>(&params) };
+		unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(static_cast<PointCoordinateType>(3 * sigma));
+		unsigned processedCells = octree->executeFunctionForAllCellsAtLevel(level,
+																			&ApplyScalarFieldsGaussianFilterAtLevel,
+																			additionalParameters,
+																			true,
+																			progressCb,
+																			"Gaussian filter");
+		ccOctree::ReleaseQueryContexts();
+		return processedCells != 0;
+	}
+
 	bool ApplyCCLibAlgorithm(CC_LIB_ALGORITHM algo, ccHObject::Container& entities, QWidget* parent/*=0*/, void** additionalParameters/*=0*/)
 	{
 		size_t selNum = entities.size();
@@ -24,8 +24,15 @@
 class QWidget;
 
 class ccGenericPointCloud;
+class ccPointCloud;
 class ccProgressDialog;
 
+namespace CCCoreLib
+{
+	class GenericProgressCallback;
+	class ScalarField;
+}
+
 namespace ccLibAlgorithms
 {
 	//! Returns a default first guess for algorithms kernel size (one cloud)
@@ -65,6 +72,27 @@ namespace ccLibAlgorithms
 									QWidget* parent = nullptr,
 									ccProgressDialog* progressDialog = nullptr);
 
+	//! Applies a Gaussian (or bilateral) filter to several scalar fields of a cloud at once
+	/** The neighbourhood of each point is extracted only once for all the scalar fields.
+		In approximate mode, the filter is applied to the per-cell averages of an octree level
+		(with a cell size close to sigma) and the result is then interpolated at each point.
+		\param sigma spatial sigma (the neighbourhood radius is 3 * sigma)
+		\param scalarSigma scalar sigma (bilateral filter) or a negative value (Gaussian filter)
+		\param cloud point cloud (its octree is computed if necessary)
+		\param inputSFs scalar fields to filter
+		\param outputSFs output scalar fields (one per input scalar field)
+		\param approximate whether to use the (much faster) approximate mode
+		\param progressCb optional progress callback
+		\return success
+	**/
+	bool ApplyScalarFieldsGaussianFilter(	PointCoordinateType sigma,
+											double scalarSigma,
+											ccPointCloud* cloud,
+											const std::vector<CCCoreLib::ScalarField*>& inputSFs,
+											const std::vector<CCCoreLib::ScalarField*>& outputSFs,
+											bool approximate = false,
+											CCCoreLib::GenericProgressCallback* progressCb = nullptr);
+
 	//CCCoreLib algorithms handled by the 'ApplyCCCoreLibAlgorithm' method
 	enum CC_LIB_ALGORITHM { CCLIB_ALGO_SF_GRADIENT,
 	};
@@ -0,0 +1,539 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccMarchingSquares.h"
+
+//CCCoreLib
+#include <GenericProgressCallback.h>
+
+//Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+//system
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+ccMarchingSquares::ccMarchingSquares(const double* values, unsigned width, unsigned height)
+	: m_values(values)
+	, m_width(width)
+	, m_height(height)
+{
+}
+
+CCVector2d ccMarchingSquares::edgeVertex(EdgeID edge, double level) const
+{
+	EdgeID nodeIndex = (edge >> 1);
+	double x = static_cast<double>(nodeIndex % m_width);
+	double y = static_cast<double>(nodeIndex / m_width);
+
+	double a = m_values[nodeIndex];
+	if (edge & 1)
+	{
+		//vertical edge
+		double b = m_values[nodeIndex + m_width];
+		assert(a != b);
+		return CCVector2d(x, y + (level - a) / (b - a));
+	}
+	else
+	{
+		//horizontal edge
+		double b = m_values[nodeIndex + 1];
+		assert(a != b);
+		return CCVector2d(x + (level - a) / (b - a), y);
+	}
+}
+
+void ccMarchingSquares::extractTile(double level, unsigned firstRow, unsigned lastRow, std::vector<Chain>& chains) const
+{
+	//iso-line segment (between two crossed edges)
+	struct Segment
+	{
+		EdgeID e[2];
+	};
+	std::vector<Segment> segments;
+
+	const unsigned w = m_width;
+	for (unsigned y = firstRow; y < lastRow; ++y)
+	{
+		const double* row0 = m_values + static_cast<size_t>(y) * w;
+		const double* row1 = row0 + w;
+
+		for (unsigned x = 0; x + 1 < w; ++x)
+		{
+			//cell corners (top-left, top-right, bottom-right, bottom-left)
+			double a = row0[x];
+			double b = row0[x + 1];
+			double c = row1[x + 1];
+			double d = row1[x];
+			if (std::isnan(a) || std::isnan(b) || std::isnan(c) || std::isnan(d))
+			{
+				//invalid cell
+				continue;
+			}
+
+			unsigned code =		(a >= level ? 1 : 0)
+							|	(b >= level ? 2 : 0)
+							|	(c >= level ? 4 : 0)
+							|	(d >= level ? 8 : 0);
+			if (code == 0 || code == 15)
+			{
+				//the iso-line doesn't cross this cell
+				continue;
+			}
+
+			const EdgeID nodeIndex = static_cast<EdgeID>(y) * w + x;
+			const EdgeID top    = 2 * nodeIndex;
+			const EdgeID left   = 2 * nodeIndex + 1;
+			const EdgeID bottom = 2 * (nodeIndex + w);
+			const EdgeID right  = 2 * (nodeIndex + 1) + 1;
+
+			if (code == 5 || code == 10)
+			{
+				//saddle: we use the cell center value to disambiguate
+				//(see http://en.wikipedia.org/wiki/Marching_squares)
+				bool centerAbove = ((a + b + c + d) / 4.0 >= level);
+				if ((code == 5) == centerAbove)
+				{
+					//the top-right and bottom-left corners are isolated
+					segments.push_back({ { top, right } });
+					segments.push_back({ { bottom, left } });
+				}
+				else
+				{
+					//the top-left and bottom-right corners are isolated
+					segments.push_back({ { top, left } });
+					segments.push_back({ { right, bottom } });
+				}
+			}
+			else
+			{
+				EdgeID e[4];
+				int n = 0;
+				if (((code & 1) != 0) != ((code & 2) != 0))
+					e[n++] = top;
+				if (((code & 2) != 0) != ((code & 4) != 0))
+					e[n++] = right;
+				if (((code & 4) != 0) != ((code & 8) != 0))
+					e[n++] = bottom;
+				if (((code & 8) != 0) != ((code & 1) != 0))
+					e[n++] = left;
+				assert(n == 2);
+
+				segments.push_back({ { e[0], e[1] } });
+			}
+		}
+	}
+
+	if (segments.empty())
+	{
+		return;
+	}
+
+	//each edge is shared by (at most) two segments
+	std::unordered_map<EdgeID, std::pair<int, int>> incidence;
+	incidence.reserve(segments.size() * 2);
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		for (EdgeID e : segments[i].e)
+		{
+			std::pair<int, int>& inc = incidence.emplace(e, std::make_pair(-1, -1)).first->second;
+			(inc.first < 0 ? inc.first : inc.second) = static_cast<int>(i);
+		}
+	}
+
+	auto otherSegment = [&](EdgeID e, int s) -> int
+	{
+		const std::pair<int, int>& inc = incidence.find(e)->second;
+		return (inc.first == s ? inc.second : inc.first);
+	};
+
+	std::vector<bool> visited(segments.size(), false);
+
+	//follows the segments from a given one (and a given extremity)
+	auto walk = [&](int s, EdgeID startEdge)
+	{
+		Chain chain;
+		chain.edges.push_back(startEdge);
+
+		EdgeID currentEdge = startEdge;
+		while (true)
+		{
+			visited[s] = true;
+			EdgeID nextEdge = (segments[s].e[0] == currentEdge ? segments[s].e[1] : segments[s].e[0]);
+			if (nextEdge == startEdge)
+			{
+				//we are back to the start
+				chain.closed = true;
+				break;
+			}
+			chain.edges.push_back(nextEdge);
+
+			int nextSegment = otherSegment(nextEdge, s);
+			if (nextSegment < 0 || visited[nextSegment])
+			{
+				break;
+			}
+			s = nextSegment;
+			currentEdge = nextEdge;
+		}
+
+		chains.push_back(std::move(chain));
+	};
+
+	//first the open chains (starting from a free extremity)
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		if (visited[i])
+			continue;
+
+		for (EdgeID e : segments[i].e)
+		{
+			if (otherSegment(e, static_cast<int>(i)) < 0)
+			{
+				walk(static_cast<int>(i), e);
+				break;
+			}
+		}
+	}
+
+	//then the loops
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		if (!visited[i])
+		{
+			walk(static_cast<int>(i), segments[i].e[0]);
+		}
+	}
+}
+
+void ccMarchingSquares::StitchChains(std::vector<Chain>& chains)
+{
+	//extremities of the open chains (code = 2 * chain index + 0 for the front or + 1 for the back)
+	std::unordered_map<EdgeID, std::pair<int, int>> extremities;
+	for (size_t i = 0; i < chains.size(); ++i)
+	{
+		const Chain& chain = chains[i];
+		if (chain.closed)
+			continue;
+
+		assert(chain.edges.size() > 1);
+		for (int side = 0; side < 2; ++side)
+		{
+			EdgeID e = (side == 0 ? chain.edges.front() : chain.edges.back());
+			std::pair<int, int>& ext = extremities.emplace(e, std::make_pair(-1, -1)).first->second;
+			(ext.first < 0 ? ext.first : ext.second) = static_cast<int>(2 * i + side);
+		}
+	}
+
+	if (extremities.empty())
+	{
+		//nothing to stitch
+		return;
+	}
+
+	auto partner = [&](EdgeID e, int code) -> int
+	{
+		const std::pair<int, int>& ext = extremities.find(e)->second;
+		return (ext.first == code ? ext.second : ext.first);
+	};
+
+	std::vector<Chain> result;
+	result.reserve(chains.size());
+	std::vector<bool> used(chains.size(), false);
+
+	//follows the chains from a given one (starting from its front, or from its back if 'reversed' is true)
+	auto follow = [&](size_t start, bool reversed)
+	{
+		Chain merged = std::move(chains[start]);
+		used[start] = true;
+		if (reversed)
+		{
+			std::reverse(merged.edges.begin(), merged.edges.end());
+		}
+
+		int endCode = static_cast<int>(2 * start + (reversed ? 0 : 1));
+		while (true)
+		{
+			int p = partner(merged.edges.back(), endCode);
+			if (p < 0)
+			{
+				break;
+			}
+
+			size_t pi = static_cast<size_t>(p / 2);
+			if (used[pi])
+			{
+				if (pi == start)
+				{
+					//the loop is closed (the first edge is duplicated)
+					merged.edges.pop_back();
+					merged.closed = true;
+				}
+				break;
+			}
+			used[pi] = true;
+
+			const std::vector<EdgeID>& edges = chains[pi].edges;
+			if ((p & 1) == 0)
+			{
+				//we enter by the front
+				merged.edges.insert(merged.edges.end(), edges.begin() + 1, edges.end());
+				endCode = static_cast<int>(2 * pi + 1);
+			}
+			else
+			{
+				//we enter by the back
+				merged.edges.insert(merged.edges.end(), edges.rbegin() + 1, edges.rend());
+				endCode = static_cast<int>(2 * pi);
+			}
+			chains[pi].edges.clear();
+			chains[pi].edges.shrink_to_fit();
+		}
+
+		result.push_back(std::move(merged));
+	};
+
+	//closed chains are left untouched
+	for (size_t i = 0; i < chains.size(); ++i)
+	{
+		if (chains[i].closed)
+		{
+			result.push_back(std::move(chains[i]));
+			used[i] = true;
+		}
+	}
+
+	//open chains with a free extremity (followed from this extremity)
+	for (size_t i = 0; i < chains.size(); ++i)
+	{
+		if (used[i])
+			continue;
+
+		if (partner(chains[i].edges.front(), static_cast<int>(2 * i)) < 0)
+		{
+			follow(i, false);
+		}
+		else if (partner(chains[i].edges.back(), static_cast<int>(2 * i + 1)) < 0)
+		{
+			follow(i, true);
+		}
+	}
+
+	//remaining chains have no free extremity: they form loops (across several tiles)
+	for (size_t i = 0; i < chains.size(); ++i)
+	{
+		if (!used[i])
+		{
+			follow(i, false);
+		}
+	}
+
+	chains = std::move(result);
+}
+
+bool ccMarchingSquares::extract(const std::vector<double>& levels,
+								std::vector<LevelLines>& output,
+								CCCoreLib::GenericProgressCallback* progressCb/*=nullptr*/,
+								unsigned tileRows/*=0*/) const
+{
+	output.clear();
+
+	if (!m_values || m_width < 2 || m_height < 2)
+	{
+		assert(false);
+		return false;
+	}
+	if (levels.empty())
+	{
+		return true;
+	}
+
+	const unsigned cellRows = m_height - 1;
+	if (tileRows == 0)
+	{
+		//enough tiles to keep all the threads busy (even with a single level)
+		unsigned targetTileCount = static_cast<unsigned>(std::max(1, QThread::idealThreadCount())) * 4;
+		tileRows = std::max(32u, (cellRows + targetTileCount - 1) / targetTileCount);
+	}
+	tileRows = std::min(tileRows, cellRows);
+	const unsigned tileCount = (cellRows + tileRows - 1) / tileRows;
+
+	std::atomic<bool> memoryError(false);
+
+	try
+	{
+		output.resize(levels.size());
+
+		//min and max (valid) values of each tile (so as to skip the levels that don't cross it)
+		std::vector<double> tileMin(tileCount, std::numeric_limits<double>::infinity());
+		std::vector<double> tileMax(tileCount, -std::numeric_limits<double>::infinity());
+		{
+			std::vector<unsigned> tileIndexes(tileCount);
+			std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+
+			QtConcurrent::blockingMap(tileIndexes, [&](unsigned t)
+			{
+				//the tile contains the node rows [firstRow ; lastRow]
+				unsigned firstRow = t * tileRows;
+				unsigned lastRow = std::min(firstRow + tileRows, cellRows);
+				const double* value = m_values + static_cast<size_t>(firstRow) * m_width;
+				const double* lastValue = m_values + static_cast<size_t>(lastRow + 1) * m_width;
+				for (; value != lastValue; ++value)
+				{
+					if (!std::isnan(*value))
+					{
+						tileMin[t] = std::min(tileMin[t], *value);
+						tileMax[t] = std::max(tileMax[t], *value);
+					}
+				}
+			});
+		}
+
+		//(level, tile) pairs to process
+		struct Task
+		{
+			unsigned levelIndex;
+			unsigned tileIndex;
+		};
+		std::vector<Task> tasks;
+		for (unsigned l = 0; l < static_cast<unsigned>(levels.size()); ++l)
+		{
+			for (unsigned t = 0; t < tileCount; ++t)
+			{
+				if (tileMin[t] < levels[l] && levels[l] <= tileMax[t])
+				{
+					tasks.push_back({ l, t });
+				}
+			}
+		}
+
+		std::vector< std::vector<Chain> > tileChains(levels.size() * tileCount);
+		std::atomic<size_t> processedTasks(0);
+
+		if (progressCb)
+		{
+			progressCb->start();
+		}
+
+		QFuture<void> future = QtConcurrent::map(tasks, [&](const Task& task)
+		{
+			unsigned firstRow = task.tileIndex * tileRows;
+			unsigned lastRow = std::min(firstRow + tileRows, cellRows);
+			try
+			{
+				extractTile(levels[task.levelIndex], firstRow, lastRow, tileChains[task.levelIndex * tileCount + task.tileIndex]);
+			}
+			catch (const std::bad_alloc&)
+			{
+				memoryError = true;
+			}
+			++processedTasks;
+		});
+
+		if (progressCb)
+		{
+			while (!future.isFinished())
+			{
+				QThread::msleep(50);
+				progressCb->update(tasks.empty() ? 100.0f : (100.0f * processedTasks) / tasks.size());
+				if ((progressCb->isCancelRequested() || memoryError) && !future.isCanceled())
+				{
+					future.cancel();
+				}
+			}
+		}
+		future.waitForFinished();
+
+		if (future.isCanceled() || memoryError)
+		{
+			output.clear();
+			return false;
+		}
+
+		//now we can stitch the tiles chains of each level and compute the vertices
+		std::vector<unsigned> levelIndexes(levels.size());
+		std::iota(levelIndexes.begin(), levelIndexes.end(), 0);
+
+		QtConcurrent::blockingMap(levelIndexes, [&](unsigned l)
+		{
+			try
+			{
+				std::vector<Chain> chains;
+				for (unsigned t = 0; t < tileCount; ++t)
+				{
+					std::vector<Chain>& tc = tileChains[l * tileCount + t];
+					std::move(tc.begin(), tc.end(), std::back_inserter(chains));
+					std::vector<Chain>().swap(tc);
+				}
+
+				StitchChains(chains);
+
+				LevelLines& levelLines = output[l];
+				levelLines.level = levels[l];
+
+				size_t vertexCount = 0;
+				for (const Chain& chain : chains)
+				{
+					vertexCount += chain.edges.size();
+				}
+				levelLines.vertices.reserve(vertexCount);
+				levelLines.lines.reserve(chains.size());
+
+				for (const Chain& chain : chains)
+				{
+					Line line;
+					line.firstVertex = levelLines.vertices.size();
+					line.vertexCount = static_cast<unsigned>(chain.edges.size());
+					line.closed = chain.closed;
+					for (EdgeID e : chain.edges)
+					{
+						levelLines.vertices.push_back(edgeVertex(e, levels[l]));
+					}
+					levelLines.lines.push_back(line);
+				}
+			}
+			catch (const std::bad_alloc&)
+			{
+				memoryError = true;
+			}
+		});
+	}
+	catch (const std::bad_alloc&)
+	{
+		memoryError = true;
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (memoryError)
+	{
+		output.clear();
+		return false;
+	}
+
+	return true;
+}
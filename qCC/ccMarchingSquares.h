@@ -0,0 +1,111 @@
+#pragma once
+
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//CCCoreLib
+#include <CCGeom.h>
+
+//system
+#include <cstdint>
+#include <vector>
+
+namespace CCCoreLib
+{
+	class GenericProgressCallback;
+}
+
+//! Tiled and multi-threaded marching squares (iso-lines extraction on a regular grid)
+/** The grid is split in horizontal bands of cells (tiles). Each (level, tile) pair
+	is processed independently (in parallel), then the pieces of iso-lines that
+	end on the tiles borders are stitched together. As the iso-lines vertices are
+	identified by the grid edge they lie on, the stitching is exact.
+	Cells with (at least) one invalid (NaN) corner are ignored.
+**/
+class ccMarchingSquares
+{
+public:
+
+	//! Iso-line (see LevelLines)
+	struct Line
+	{
+		//! Index of the first vertex (in LevelLines::vertices)
+		size_t firstVertex = 0;
+		//! Number of vertices
+		unsigned vertexCount = 0;
+		//! Whether the line is closed (the first vertex is not duplicated)
+		bool closed = false;
+	};
+
+	//! Iso-lines of a given level
+	struct LevelLines
+	{
+		//! Level value
+		double level = 0.0;
+		//! Vertices of all the lines (in grid coordinates, i.e. X = column index, Y = row index)
+		std::vector<CCVector2d> vertices;
+		//! Lines
+		std::vector<Line> lines;
+	};
+
+	//! Default constructor
+	/** \param values grid values (row-major, width x height, invalid values = NaN)
+		\param width grid width (number of columns)
+		\param height grid height (number of rows)
+	**/
+	ccMarchingSquares(const double* values, unsigned width, unsigned height);
+
+	//! Extracts the iso-lines for a set of levels
+	/** \param levels levels to extract
+		\param[out] output iso-lines (one entry per level, in the same order)
+		\param progressCb optional progress callback (must be called from the main thread if it's a ccProgressDialog)
+		\param tileRows number of cell rows per tile (0 = automatic)
+		\return success (false if the process has been canceled or if there's not enough memory)
+	**/
+	bool extract(	const std::vector<double>& levels,
+					std::vector<LevelLines>& output,
+					CCCoreLib::GenericProgressCallback* progressCb = nullptr,
+					unsigned tileRows = 0) const;
+
+protected:
+
+	//! Edge identifier (2 * node index + 0 for horizontal edges or + 1 for vertical ones)
+	using EdgeID = uint64_t;
+
+	//! Piece of iso-line (sequence of edges)
+	struct Chain
+	{
+		std::vector<EdgeID> edges;
+		bool closed = false;
+	};
+
+	//! Extracts the pieces of iso-lines of a given level inside a given tile (cell rows [firstRow ; lastRow[)
+	void extractTile(double level, unsigned firstRow, unsigned lastRow, std::vector<Chain>& chains) const;
+
+	//! Stitches the open chains sharing an extremity (edge)
+	static void StitchChains(std::vector<Chain>& chains);
+
+	//! Returns the (interpolated) position of the iso-line vertex lying on a given edge
+	CCVector2d edgeVertex(EdgeID edge, double level) const;
+
+	//! Grid values
+	const double* m_values;
+	//! Grid width
+	unsigned m_width;
+	//! Grid height
+	unsigned m_height;
+};
@@ -0,0 +1,665 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccSoftwareRenderer.h"
+
+//CCCoreLib
+#include <CCMath.h>
+
+//qCC_db
+#include <ccGenericMesh.h>
+#include <ccHObjectCaster.h>
+#include <ccPointCloud.h>
+#include <ccScalarField.h>
+
+//Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+//system
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+//! Tile size (in pixels)
+static const int c_tileSize = 64;
+//! Fraction of the image covered by the scene (when fitting the camera)
+static const double c_fitMargin = 0.95;
+//! Ambient light (mesh shading)
+static const double c_ambientLight = 0.25;
+//! EDL response scale
+static const double c_edlScale = 100.0;
+
+namespace
+{
+	//! Colors of the points of a cloud (as they would be displayed)
+	class PointColors
+	{
+	public:
+
+		PointColors(ccGenericPointCloud* cloud, bool showColors, bool showSF, const ccColor::Rgb& defaultColor)
+			: m_cloud(cloud)
+			, m_sf(nullptr)
+			, m_rgb(false)
+			, m_visibility(nullptr)
+			, m_defaultColor(defaultColor)
+		{
+			ccPointCloud* pc = ccHObjectCaster::ToPointCloud(cloud);
+			if (pc && showSF)
+			{
+				m_sf = pc->getCurrentDisplayedScalarField();
+			}
+			m_rgb = (!m_sf && showColors && cloud->hasColors());
+
+			if (cloud->isVisibilityTableInstantiated())
+			{
+				m_visibility = &cloud->getTheVisibilityArray();
+			}
+		}
+
+		//! Returns whether a point is displayed
+		inline bool isVisible(unsigned index) const
+		{
+			if (m_visibility && !m_visibility->isVisible(index))
+			{
+				return false;
+			}
+			//points with an invalid or hidden scalar value are not displayed
+			return (!m_sf || m_sf->getValueColor(index) != nullptr);
+		}
+
+		//! Returns the color of a (visible) point
+		inline ccColor::Rgb getColor(unsigned index) const
+		{
+			if (m_sf)
+			{
+				const ccColor::Rgb* color = m_sf->getValueColor(index);
+				assert(color);
+				return color ? *color : m_defaultColor;
+			}
+			else if (m_rgb)
+			{
+				return m_cloud->getPointColor(index);
+			}
+			else
+			{
+				return m_defaultColor;
+			}
+		}
+
+	protected:
+
+		ccGenericPointCloud* m_cloud;
+		ccScalarField* m_sf;
+		bool m_rgb;
+		const ccGenericPointCloud::VisibilityTableType* m_visibility;
+		ccColor::Rgb m_defaultColor;
+	};
+}
+
+ccSoftwareRenderer::ccSoftwareRenderer(const Parameters& params)
+	: m_params(params)
+	, m_tileSize(c_tileSize)
+	, m_tileCountX(0)
+	, m_tileCountY(0)
+{
+}
+
+bool ccSoftwareRenderer::addEntity(ccHObject* entity)
+{
+	if (!entity)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (entity->isKindOf(CC_TYPES::POINT_CLOUD))
+	{
+		m_clouds.push_back(ccHObjectCaster::ToGenericPointCloud(entity));
+		return true;
+	}
+	else if (entity->isKindOf(CC_TYPES::MESH))
+	{
+		m_meshes.push_back(ccHObjectCaster::ToGenericMesh(entity));
+		return true;
+	}
+
+	return false;
+}
+
+bool ccSoftwareRenderer::setupCamera()
+{
+	ccBBox box;
+	for (ccGenericPointCloud* cloud : m_clouds)
+	{
+		box += cloud->getOwnBB();
+	}
+	for (ccGenericMesh* mesh : m_meshes)
+	{
+		box += mesh->getOwnBB();
+	}
+	if (!box.isValid())
+	{
+		return false;
+	}
+
+	//image axes
+	CCVector3d Z = m_params.viewDir;
+	if (Z.normd() < CCCoreLib::ZERO_TOLERANCE_D)
+	{
+		return false;
+	}
+	Z.normalize();
+	CCVector3d up = m_params.upDir;
+	up.normalize();
+	CCVector3d X = Z.cross(up);
+	if (X.normd() < 1.0e-6)
+	{
+		//the up direction is (almost) parallel to the viewing direction
+		up = (std::abs(Z.z) < 0.9 ? CCVector3d(0, 0, 1) : CCVector3d(0, 1, 0));
+		X = Z.cross(up);
+	}
+	X.normalize();
+	CCVector3d Y = X.cross(Z);
+
+	m_camera.X = X;
+	m_camera.Y = Y;
+	m_camera.Z = Z;
+	m_camera.perspective = m_params.perspective;
+	m_camera.cx = m_params.width / 2.0;
+	m_camera.cy = m_params.height / 2.0;
+
+	CCVector3d center = CCVector3d::fromArray(box.getCenter().u);
+	double radius = box.getDiagNormd() / 2;
+	if (radius < CCCoreLib::ZERO_TOLERANCE_D)
+	{
+		radius = 1.0;
+	}
+
+	if (m_params.perspective)
+	{
+		//the field of view applies to the smallest image dimension
+		double halfFov_rad = CCCoreLib::DegreesToRadians(std::max(1.0, std::min(m_params.fov_deg, 170.0)) / 2);
+		m_camera.scale = c_fitMargin * std::min(m_params.width, m_params.height) / (2 * std::tan(halfFov_rad));
+		m_camera.eye = center - Z * (radius / std::sin(halfFov_rad));
+	}
+	else
+	{
+		//the eye is placed in front of the scene (so that all the depths are positive)
+		m_camera.eye = center - Z * (2 * radius);
+
+		//half extents of the projected bounding-box
+		double halfWidth = 0.0;
+		double halfHeight = 0.0;
+		const CCVector3& minCorner = box.minCorner();
+		const CCVector3& maxCorner = box.maxCorner();
+		for (int i = 0; i < 8; ++i)
+		{
+			CCVector3d corner(	(i & 1) ? maxCorner.x : minCorner.x,
+								(i & 2) ? maxCorner.y : minCorner.y,
+								(i & 4) ? maxCorner.z : minCorner.z);
+			CCVector3d v = corner - center;
+			halfWidth = std::max(halfWidth, std::abs(v.dot(X)));
+			halfHeight = std::max(halfHeight, std::abs(v.dot(Y)));
+		}
+		halfWidth = std::max(halfWidth, radius * 1.0e-6);
+		halfHeight = std::max(halfHeight, radius * 1.0e-6);
+
+		m_camera.scale = c_fitMargin * std::min(m_params.width / (2 * halfWidth), m_params.height / (2 * halfHeight));
+	}
+
+	return true;
+}
+
+template <class FootprintFunc> void ccSoftwareRenderer::dispatch(unsigned count, FootprintFunc getFootprint, std::vector< std::vector<unsigned> >& bins) const
+{
+	const unsigned tileCount = static_cast<unsigned>(m_tileCountX * m_tileCountY);
+
+	//each chunk of elements is dispatched independently
+	const unsigned maxChunkCount = static_cast<unsigned>(std::max(1, QThread::idealThreadCount()) * 4);
+	const unsigned chunkCount = std::max(1u, std::min(maxChunkCount, count / 4096));
+	const unsigned chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	std::vector< std::vector< std::vector<unsigned> > > chunkBins(chunkCount, std::vector< std::vector<unsigned> >(tileCount));
+	std::vector<unsigned> chunkIndexes(chunkCount);
+	std::iota(chunkIndexes.begin(), chunkIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(chunkIndexes, [&](unsigned c)
+	{
+		std::vector< std::vector<unsigned> >& localBins = chunkBins[c];
+		const unsigned firstIndex = c * chunkSize;
+		const unsigned lastIndex = std::min(count, firstIndex + chunkSize);
+
+		Footprint footprint;
+		for (unsigned i = firstIndex; i < lastIndex; ++i)
+		{
+			if (!getFootprint(i, footprint))
+			{
+				continue;
+			}
+
+			for (int ty = footprint.yMin / m_tileSize; ty <= footprint.yMax / m_tileSize; ++ty)
+			{
+				for (int tx = footprint.xMin / m_tileSize; tx <= footprint.xMax / m_tileSize; ++tx)
+				{
+					localBins[ty * m_tileCountX + tx].push_back(i);
+				}
+			}
+		}
+	});
+
+	//merge the chunks (in order)
+	bins.clear();
+	bins.resize(tileCount);
+	std::vector<unsigned> tileIndexes(tileCount);
+	std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(tileIndexes, [&](unsigned t)
+	{
+		size_t elementCount = 0;
+		for (const std::vector< std::vector<unsigned> >& localBins : chunkBins)
+		{
+			elementCount += localBins[t].size();
+		}
+		bins[t].reserve(elementCount);
+
+		for (std::vector< std::vector<unsigned> >& localBins : chunkBins)
+		{
+			bins[t].insert(bins[t].end(), localBins[t].begin(), localBins[t].end());
+			std::vector<unsigned>().swap(localBins[t]); //release memory
+		}
+	});
+}
+
+void ccSoftwareRenderer::drawCloud(ccGenericPointCloud* cloud)
+{
+	assert(cloud);
+	const unsigned pointCount = cloud->size();
+	if (pointCount == 0)
+	{
+		return;
+	}
+
+	const int width = m_params.width;
+	const int height = m_params.height;
+	const int pointSize = std::max(1, m_params.pointSize);
+	PointColors colors(cloud, cloud->colorsShown(), cloud->sfShown(), ccColor::defaultColor);
+
+	//footprint of a point splat
+	auto splatFootprint = [&](double x, double y, Footprint& footprint)
+	{
+		footprint.xMin = static_cast<int>(std::floor(x)) - (pointSize - 1) / 2;
+		footprint.yMin = static_cast<int>(std::floor(y)) - (pointSize - 1) / 2;
+		footprint.xMax = footprint.xMin + pointSize - 1;
+		footprint.yMax = footprint.yMin + pointSize - 1;
+	};
+
+	std::vector< std::vector<unsigned> > bins;
+	dispatch(pointCount, [&](unsigned index, Footprint& footprint)
+	{
+		if (!colors.isVisible(index))
+		{
+			return false;
+		}
+
+		double x = 0.0;
+		double y = 0.0;
+		double depth = 0.0;
+		if (!m_camera.project(*cloud->getPoint(index), x, y, depth) || !std::isfinite(x) || !std::isfinite(y))
+		{
+			return false;
+		}
+
+		splatFootprint(x, y, footprint);
+		if (footprint.xMax < 0 || footprint.yMax < 0 || footprint.xMin >= width || footprint.yMin >= height)
+		{
+			return false;
+		}
+
+		footprint.xMin = std::max(footprint.xMin, 0);
+		footprint.yMin = std::max(footprint.yMin, 0);
+		footprint.xMax = std::min(footprint.xMax, width - 1);
+		footprint.yMax = std::min(footprint.yMax, height - 1);
+		return true;
+	}, bins);
+
+	//rasterize each tile
+	std::vector<unsigned> tileIndexes(bins.size());
+	std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(tileIndexes, [&](unsigned t)
+	{
+		const int tileXMin = (t % m_tileCountX) * m_tileSize;
+		const int tileYMin = (t / m_tileCountX) * m_tileSize;
+		const int tileXMax = std::min(tileXMin + m_tileSize, width) - 1;
+		const int tileYMax = std::min(tileYMin + m_tileSize, height) - 1;
+
+		for (unsigned index : bins[t])
+		{
+			double x = 0.0;
+			double y = 0.0;
+			double depth = 0.0;
+			m_camera.project(*cloud->getPoint(index), x, y, depth);
+			const float z = static_cast<float>(depth);
+			const ccColor::Rgb color = colors.getColor(index);
+
+			Footprint footprint;
+			splatFootprint(x, y, footprint);
+			for (int py = std::max(footprint.yMin, tileYMin); py <= std::min(footprint.yMax, tileYMax); ++py)
+			{
+				size_t pixelIndex = static_cast<size_t>(py) * width;
+				for (int px = std::max(footprint.xMin, tileXMin); px <= std::min(footprint.xMax, tileXMax); ++px)
+				{
+					if (z < m_depthBuffer[pixelIndex + px])
+					{
+						m_depthBuffer[pixelIndex + px] = z;
+						m_colorBuffer[pixelIndex + px] = color;
+					}
+				}
+			}
+		}
+	});
+}
+
+void ccSoftwareRenderer::drawMesh(ccGenericMesh* mesh)
+{
+	assert(mesh);
+	ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
+	const unsigned triangleCount = mesh->size();
+	if (!vertices || triangleCount == 0)
+	{
+		return;
+	}
+
+	const int width = m_params.width;
+	const int height = m_params.height;
+	PointColors colors(vertices, mesh->colorsShown(), mesh->sfShown(), ccColor::FromRgbafToRgb(ccColor::defaultMeshFrontDiff));
+
+	std::vector< std::vector<unsigned> > bins;
+	dispatch(triangleCount, [&](unsigned index, Footprint& footprint)
+	{
+		const CCCoreLib::VerticesIndexes* tri = mesh->getTriangleVertIndexes(index);
+
+		double xMin = std::numeric_limits<double>::infinity();
+		double yMin = xMin;
+		double xMax = -xMin;
+		double yMax = -xMin;
+		for (unsigned vertexIndex : tri->i)
+		{
+			if (!colors.isVisible(vertexIndex))
+			{
+				return false;
+			}
+
+			double x = 0.0;
+			double y = 0.0;
+			double depth = 0.0;
+			if (!m_camera.project(*vertices->getPoint(vertexIndex), x, y, depth) || !std::isfinite(x) || !std::isfinite(y))
+			{
+				//triangles crossing the eye plane are ignored
+				return false;
+			}
+			xMin = std::min(xMin, x);
+			yMin = std::min(yMin, y);
+			xMax = std::max(xMax, x);
+			yMax = std::max(yMax, y);
+		}
+
+		if (xMax < 0 || yMax < 0 || xMin >= width || yMin >= height)
+		{
+			return false;
+		}
+
+		footprint.xMin = std::max(static_cast<int>(std::floor(xMin)), 0);
+		footprint.yMin = std::max(static_cast<int>(std::floor(yMin)), 0);
+		footprint.xMax = std::min(static_cast<int>(std::floor(xMax)), width - 1);
+		footprint.yMax = std::min(static_cast<int>(std::floor(yMax)), height - 1);
+		return true;
+	}, bins);
+
+	//rasterize each tile
+	std::vector<unsigned> tileIndexes(bins.size());
+	std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(tileIndexes, [&](unsigned t)
+	{
+		const int tileXMin = (t % m_tileCountX) * m_tileSize;
+		const int tileYMin = (t / m_tileCountX) * m_tileSize;
+		const int tileXMax = std::min(tileXMin + m_tileSize, width) - 1;
+		const int tileYMax = std::min(tileYMin + m_tileSize, height) - 1;
+
+		for (unsigned index : bins[t])
+		{
+			const CCCoreLib::VerticesIndexes* tri = mesh->getTriangleVertIndexes(index);
+
+			const CCVector3* P[3];
+			double x[3];
+			double y[3];
+			double z[3];
+			ccColor::Rgb C[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				P[k] = vertices->getPoint(tri->i[k]);
+				m_camera.project(*P[k], x[k], y[k], z[k]);
+				C[k] = colors.getColor(tri->i[k]);
+			}
+
+			//signed area (edge function)
+			double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (std::abs(area) < std::numeric_limits<double>::epsilon())
+			{
+				continue;
+			}
+
+			//flat shading (the light comes from the camera)
+			double intensity = 1.0;
+			{
+				CCVector3d N = CCVector3d::fromArray((*P[1] - *P[0]).cross(*P[2] - *P[0]).u);
+				double normN = N.normd();
+				if (normN > 0)
+				{
+					CCVector3d L = m_camera.Z;
+					if (m_camera.perspective)
+					{
+						L = CCVector3d::fromArray(P[0]->u) - m_camera.eye;
+						L.normalize();
+					}
+					intensity = c_ambientLight + (1.0 - c_ambientLight) * std::abs(N.dot(L)) / normN;
+				}
+			}
+
+			int pxMin = std::max(static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))), tileXMin);
+			int pyMin = std::max(static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))), tileYMin);
+			int pxMax = std::min(static_cast<int>(std::floor(std::max({ x[0], x[1], x[2] }))), tileXMax);
+			int pyMax = std::min(static_cast<int>(std::floor(std::max({ y[0], y[1], y[2] }))), tileYMax);
+
+			for (int py = pyMin; py <= pyMax; ++py)
+			{
+				const double sy = py + 0.5;
+				size_t pixelIndex = static_cast<size_t>(py) * width;
+				for (int px = pxMin; px <= pxMax; ++px)
+				{
+					const double sx = px + 0.5;
+
+					//barycentric coordinates
+					double w0 = ((x[2] - x[1]) * (sy - y[1]) - (y[2] - y[1]) * (sx - x[1])) / area;
+					double w1 = ((x[0] - x[2]) * (sy - y[2]) - (y[0] - y[2]) * (sx - x[2])) / area;
+					double w2 = 1.0 - w0 - w1;
+					if (w0 < 0 || w1 < 0 || w2 < 0)
+					{
+						continue;
+					}
+
+					double depth = 0.0;
+					if (m_camera.perspective)
+					{
+						//perspective-correct interpolation
+						w0 /= z[0];
+						w1 /= z[1];
+						w2 /= z[2];
+						double invDepth = w0 + w1 + w2;
+						depth = 1.0 / invDepth;
+						w0 *= depth;
+						w1 *= depth;
+						w2 *= depth;
+					}
+					else
+					{
+						depth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+					}
+
+					const float fDepth = static_cast<float>(depth);
+					if (fDepth < m_depthBuffer[pixelIndex + px])
+					{
+						m_depthBuffer[pixelIndex + px] = fDepth;
+						m_colorBuffer[pixelIndex + px] = ccColor::Rgb(	static_cast<ColorCompType>(std::min(255.0, intensity * (w0 * C[0].r + w1 * C[1].r + w2 * C[2].r))),
+																		static_cast<ColorCompType>(std::min(255.0, intensity * (w0 * C[0].g + w1 * C[1].g + w2 * C[2].g))),
+																		static_cast<ColorCompType>(std::min(255.0, intensity * (w0 * C[0].b + w1 * C[1].b + w2 * C[2].b))));
+					}
+				}
+			}
+		}
+	});
+}
+
+void ccSoftwareRenderer::applyEDL()
+{
+	const int width = m_params.width;
+	const int height = m_params.height;
+	const int radius = std::max(1, m_params.edlRadius);
+	const double scale = c_edlScale * m_params.edlStrength;
+
+	//log-depth buffer
+	std::vector<float> logDepth(m_depthBuffer.size());
+	for (size_t i = 0; i < m_depthBuffer.size(); ++i)
+	{
+		logDepth[i] = std::isfinite(m_depthBuffer[i]) ? std::log2(std::max(m_depthBuffer[i], std::numeric_limits<float>::min())) : std::numeric_limits<float>::infinity();
+	}
+
+	static const int c_neighborCount = 8;
+	const int neighborOffsets[c_neighborCount][2] = { { radius, 0 }, { -radius, 0 }, { 0, radius }, { 0, -radius }, { radius, radius }, { -radius, radius }, { radius, -radius }, { -radius, -radius } };
+
+	std::vector<int> rowIndexes(height);
+	std::iota(rowIndexes.begin(), rowIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(rowIndexes, [&](int py)
+	{
+		for (int px = 0; px < width; ++px)
+		{
+			size_t pixelIndex = static_cast<size_t>(py) * width + px;
+			float d = logDepth[pixelIndex];
+			if (!std::isfinite(d))
+			{
+				//background
+				continue;
+			}
+
+			//the pixels behind their neighbors are obscured
+			double response = 0.0;
+			for (const int* offset : neighborOffsets)
+			{
+				int nx = px + offset[0];
+				int ny = py + offset[1];
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+				{
+					continue;
+				}
+				float nd = logDepth[static_cast<size_t>(ny) * width + nx];
+				if (std::isfinite(nd))
+				{
+					response += std::max(0.0f, d - nd);
+				}
+			}
+			response /= c_neighborCount;
+
+			double shade = std::exp(-scale * response);
+			ccColor::Rgb& color = m_colorBuffer[pixelIndex];
+			color.r = static_cast<ColorCompType>(color.r * shade);
+			color.g = static_cast<ColorCompType>(color.g * shade);
+			color.b = static_cast<ColorCompType>(color.b * shade);
+		}
+	});
+}
+
+QImage ccSoftwareRenderer::render()
+{
+	const int width = m_params.width;
+	const int height = m_params.height;
+	if (width <= 0 || height <= 0)
+	{
+		assert(false);
+		return QImage();
+	}
+
+	m_tileCountX = (width + m_tileSize - 1) / m_tileSize;
+	m_tileCountY = (height + m_tileSize - 1) / m_tileSize;
+
+	QImage image(width, height, QImage::Format_RGB32);
+	if (image.isNull())
+	{
+		//not enough memory
+		return QImage();
+	}
+
+	try
+	{
+		m_depthBuffer.assign(static_cast<size_t>(width) * height, std::numeric_limits<float>::infinity());
+		m_colorBuffer.assign(static_cast<size_t>(width) * height, m_params.backgroundColor);
+
+		if (setupCamera())
+		{
+			for (ccGenericMesh* mesh : m_meshes)
+			{
+				drawMesh(mesh);
+			}
+			for (ccGenericPointCloud* cloud : m_clouds)
+			{
+				drawCloud(cloud);
+			}
+
+			if (m_params.edl)
+			{
+				applyEDL();
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+		//not enough memory (std::bad_alloc is wrapped in a QUnhandledException when thrown by a worker thread)
+		m_depthBuffer.clear();
+		m_colorBuffer.clear();
+		return QImage();
+	}
+
+	for (int py = 0; py < height; ++py)
+	{
+		QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(py));
+		const ccColor::Rgb* color = m_colorBuffer.data() + static_cast<size_t>(py) * width;
+		for (int px = 0; px < width; ++px, ++color)
+		{
+			line[px] = qRgb(color->r, color->g, color->b);
+		}
+	}
+
+	//release memory
+	std::vector<float>().swap(m_depthBuffer);
+	std::vector<ccColor::Rgb>().swap(m_colorBuffer);
+
+	return image;
+}
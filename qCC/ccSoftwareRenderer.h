@@ -0,0 +1,186 @@
+#pragma once
+
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//qCC_db
+#include <ccColorTypes.h>
+
+//CCCoreLib
+#include <CCGeom.h>
+
+//Qt
+#include <QImage>
+
+//system
+#include <vector>
+
+class ccGenericMesh;
+class ccGenericPointCloud;
+class ccHObject;
+
+//! Software (CPU) renderer
+/** Headless alternative to ccGLWindow for batch snapshots (no OpenGL context nor
+	display server required). Only a subset of ccGLWindow::draw3D is supported:
+	point clouds (square splats) and meshes, displayed with their colors or with
+	the color ramp of their displayed scalar field, plus an EDL-like shading.
+	The image is split in tiles: the points and triangles are first dispatched in
+	the tiles they overlap, then the tiles are rasterized independently (in parallel).
+**/
+class ccSoftwareRenderer
+{
+public:
+
+	//! Rendering parameters
+	struct Parameters
+	{
+		//! Image width (in pixels)
+		int width = 1920;
+		//! Image height (in pixels)
+		int height = 1080;
+		//! Viewing direction
+		CCVector3d viewDir = CCVector3d(0, 0, -1);
+		//! Up direction
+		CCVector3d upDir = CCVector3d(0, 1, 0);
+		//! Whether the projection is perspective (orthographic otherwise)
+		bool perspective = false;
+		//! Field of view (perspective projection only, in degrees)
+		double fov_deg = 30.0;
+		//! Point size (in pixels)
+		int pointSize = 1;
+		//! Background color
+		ccColor::Rgb backgroundColor = ccColor::defaultBkgColor;
+		//! Whether to apply the EDL (Eye-Dome Lighting) shading
+		bool edl = false;
+		//! EDL strength
+		double edlStrength = 1.0;
+		//! EDL neighbors distance (in pixels)
+		int edlRadius = 1;
+	};
+
+	//! Default constructor
+	explicit ccSoftwareRenderer(const Parameters& params);
+
+	//! Adds an entity (cloud or mesh) to the scene
+	/** The entity is not copied (it must remain valid until the rendering is done).
+		\return whether the entity has been added (i.e. whether it's a cloud or a mesh)
+	**/
+	bool addEntity(ccHObject* entity);
+
+	//! Renders the scene
+	/** \return the rendered image (or a null image if there's not enough memory)
+	**/
+	QImage render();
+
+protected:
+
+	//! Camera (world to image projection)
+	struct Camera
+	{
+		//! Eye position
+		CCVector3d eye;
+		//! Image horizontal axis
+		CCVector3d X;
+		//! Image vertical axis (upward)
+		CCVector3d Y;
+		//! Viewing direction
+		CCVector3d Z;
+		//! Number of pixels per unit (orthographic projection) or focal length in pixels (perspective)
+		double scale = 1.0;
+		//! Whether the projection is perspective
+		bool perspective = false;
+		//! Image center (X)
+		double cx = 0.0;
+		//! Image center (Y)
+		double cy = 0.0;
+
+		//! Projects a 3D point in the image
+		/** \param P 3D point
+			\param[out] x horizontal position (in pixels, from the left)
+			\param[out] y vertical position (in pixels, from the top)
+			\param[out] depth distance to the camera (along the viewing direction)
+			\return false if the point is behind the camera
+		**/
+		inline bool project(const CCVector3& P, double& x, double& y, double& depth) const
+		{
+			CCVector3d v = CCVector3d::fromArray(P.u) - eye;
+			depth = v.dot(Z);
+			if (perspective)
+			{
+				if (depth <= 0)
+				{
+					return false;
+				}
+				x = cx + scale * v.dot(X) / depth;
+				y = cy - scale * v.dot(Y) / depth;
+			}
+			else
+			{
+				x = cx + scale * v.dot(X);
+				y = cy - scale * v.dot(Y);
+			}
+			return true;
+		}
+	};
+
+	//! Pixel footprint of an element (inclusive bounds)
+	struct Footprint
+	{
+		int xMin, yMin, xMax, yMax;
+	};
+
+	//! Sets up the camera so that the whole scene is visible
+	bool setupCamera();
+
+	//! Dispatches elements in the tiles they overlap
+	/** \param count number of elements
+		\param getFootprint returns the footprint of an element (or false if it's not visible)
+		\param[out] bins per-tile list of elements (in the input order)
+	**/
+	template <class FootprintFunc> void dispatch(unsigned count, FootprintFunc getFootprint, std::vector< std::vector<unsigned> >& bins) const;
+
+	//! Rasterizes the points of a cloud
+	void drawCloud(ccGenericPointCloud* cloud);
+
+	//! Rasterizes the triangles of a mesh
+	void drawMesh(ccGenericMesh* mesh);
+
+	//! Applies the EDL shading
+	void applyEDL();
+
+	//! Rendering parameters
+	Parameters m_params;
+	//! Clouds to render
+	std::vector<ccGenericPointCloud*> m_clouds;
+	//! Meshes to render
+	std::vector<ccGenericMesh*> m_meshes;
+
+	//! Camera
+	Camera m_camera;
+
+	//! Tile size (in pixels)
+	int m_tileSize;
+	//! Number of tiles (horizontally)
+	int m_tileCountX;
+	//! Number of tiles (vertically)
+	int m_tileCountY;
+
+	//! Depth buffer (infinity = background)
+	std::vector<float> m_depthBuffer;
+	//! Color buffer
+	std::vector<ccColor::Rgb> m_colorBuffer;
+};
@@ -61,6 +61,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <functional>
 
 //Minimum width of the left column of the properties tree view
 static const int c_propViewLeftColumnWidth = 115;
@@ -233,7 +234,9 @@ private:
 Q_GLOBAL_STATIC( DBRootIcons, gDBRootIcons )
 
 
-ccDBRoot::ccDBRoot(ccCustomQTreeView* dbTreeWidget, QTreeView* propertiesTreeWidget, QObject* parent) : QAbstractItemModel(parent)
+ccDBRoot::ccDBRoot(ccCustomQTreeView* dbTreeWidget, QTreeView* propertiesTreeWidget, QObject* parent)
+	: QAbstractItemModel(parent)
+	, m_cacheHierarchyVersion(0)
 {
 	m_treeRoot = new ccHObject("DB Tree");
 
@@ -329,16 +332,20 @@ void ccDBRoot::unloadAll()
 		return;
 	}
 
-	while (m_treeRoot->getChildrenNumber() > 0)
+	int childCount = static_cast<int>(m_treeRoot->getChildrenNumber());
+	if (childCount > 0)
 	{
-		int i = static_cast<int>(m_treeRoot->getChildrenNumber())-1;
-		ccHObject* object = m_treeRoot->getChild(i);
-		assert(object);
-
-		object->prepareDisplayForRefresh_recursive();
+		for (int i = 0; i < childCount; ++i)
+		{
+			m_treeRoot->getChild(i)->prepareDisplayForRefresh_recursive();
+		}
 
-		beginRemoveRows(index(object).parent(),i,i);
-		m_treeRoot->removeChild(i);
+		//single row removal operation for all the top-level entities
+		beginRemoveRows(QModelIndex(), 0, childCount - 1);
+		while (m_treeRoot->getChildrenNumber() > 0)
+		{
+			m_treeRoot->removeChild(static_cast<int>(m_treeRoot->getChildrenNumber()) - 1);
+		}
 		endRemoveRows();
 	}
 
@@ -356,59 +363,101 @@ ccHObject* ccDBRoot::getRootEntity()
 
 void ccDBRoot::addElement(ccHObject* object, bool autoExpand/*=true*/)
 {
-	if (!m_treeRoot)
+	if (!object)
 	{
 		assert(false);
 		return;
 	}
-	if (!object)
+
+	ccHObject::Container objects{ object };
+	addElements(objects, autoExpand);
+}
+
+void ccDBRoot::addElements(const ccHObject::Container& objects, bool autoExpand/*=true*/)
+{
+	if (!m_treeRoot)
 	{
 		assert(false);
 		return;
 	}
+	if (objects.empty())
+	{
+		return;
+	}
 
 	bool wasEmpty = (m_treeRoot->getChildrenNumber() == 0);
 
-	//look for object's parent
-	ccHObject* parentObject = object->getParent();
-	if (!parentObject)
-	{
-		//if the object has no parent, it will be inserted at tree root
-		parentObject = m_treeRoot;
-		m_treeRoot->addChild(object);
-	}
-	else
+	//we group the objects by parent (so as to insert contiguous rows at once)
+	std::vector< std::pair<ccHObject*, std::vector<int> > > childrenByParent;
+	QHash<ccHObject*, size_t> parentSlots;
+
+	for (ccHObject* object : objects)
 	{
-		//DGM TODO: how could we check that the object is not already inserted in the DB tree?
-		//The double insertion can cause serious damage to it (not sure why excatly though).
+		if (!object)
+		{
+			assert(false);
+			continue;
+		}
 
-		//The code below doesn't work because the 'index' method will always return a valid index
-		//as soon as the object has a parent (index creation is a purely 'logical' approach)
-		//QModelIndex nodeIndex = index(object);
-		//if (nodeIndex.isValid())
-		//	return;
-	}
+		//look for object's parent
+		ccHObject* parentObject = object->getParent();
+		if (!parentObject)
+		{
+			//if the object has no parent, it will be inserted at tree root
+			parentObject = m_treeRoot;
+			m_treeRoot->addChild(object);
+		}
+		else
+		{
+			//DGM TODO: how could we check that the object is not already inserted in the DB tree?
+			//The double insertion can cause serious damage to it (not sure why excatly though).
+
+			//The code below doesn't work because the 'index' method will always return a valid index
+			//as soon as the object has a parent (index creation is a purely 'logical' approach)
+			//QModelIndex nodeIndex = index(object);
+			//if (nodeIndex.isValid())
+			//	return;
+		}
 
-	//look for insert node index in tree
-	QModelIndex insertNodeIndex = index(parentObject);
-	int childPos = parentObject->getChildIndex(object);
+		int childPos = parentObject->getChildIndex(object);
+		assert(childPos >= 0);
+		if (childPos < 0)
+		{
+			continue;
+		}
 
-	//row insertion operation (start)
-	beginInsertRows(insertNodeIndex, childPos, childPos);
+		QHash<ccHObject*, size_t>::const_iterator it = parentSlots.constFind(parentObject);
+		if (it == parentSlots.constEnd())
+		{
+			parentSlots.insert(parentObject, childrenByParent.size());
+			childrenByParent.emplace_back(parentObject, std::vector<int>{ childPos });
+		}
+		else
+		{
+			childrenByParent[it.value()].second.push_back(childPos);
+		}
+	}
 
-	//row insertion operation (end)
-	endInsertRows();
+	for (auto& parentAndChildren : childrenByParent)
+	{
+		insertChildrenRows(parentAndChildren.first, parentAndChildren.second);
+	}
 
-	if (autoExpand)
+	for (const auto& parentAndChildren : childrenByParent)
 	{
 		//expand the parent (just in case)
-		m_dbTreeWidget->expand(index(parentObject));
-		//and the child
-		m_dbTreeWidget->expand(index(object));
+		m_dbTreeWidget->expand(index(parentAndChildren.first));
 	}
-	else //if (parentObject)
+	if (autoExpand)
 	{
-		m_dbTreeWidget->expand(insertNodeIndex);
+		//and the children
+		for (ccHObject* object : objects)
+		{
+			if (object)
+			{
+				m_dbTreeWidget->expand(index(object));
+			}
+		}
 	}
 
 	if (wasEmpty && m_treeRoot->getChildrenNumber() != 0)
@@ -438,6 +487,10 @@ void ccDBRoot::removeElements(ccHObject::Container& objects)
 	//we hide properties view in case this is the deleted object that is currently selected
 	hidePropertiesView();
 
+	//we group the objects by parent (so as to remove contiguous rows at once)
+	std::vector< std::pair<ccHObject*, std::vector<int> > > childrenByParent;
+	QHash<ccHObject*, size_t> parentSlots;
+
 	//every object in tree must have a parent!
 	for (ccHObject* object : objects)
 	{
@@ -453,15 +506,26 @@ void ccDBRoot::removeElements(ccHObject::Container& objects)
 
 		int childPos = parent->getChildIndex(object);
 		assert(childPos >= 0);
+		if (childPos < 0)
 		{
-			//row removal operation (start)
-			beginRemoveRows(index(parent), childPos, childPos);
-
-			parent->removeChild(childPos);
+			continue;
+		}
 
-			//row removal operation (end)
-			endRemoveRows();
+		QHash<ccHObject*, size_t>::const_iterator it = parentSlots.constFind(parent);
+		if (it == parentSlots.constEnd())
+		{
+			parentSlots.insert(parent, childrenByParent.size());
+			childrenByParent.emplace_back(parent, std::vector<int>{ childPos });
 		}
+		else
+		{
+			childrenByParent[it.value()].second.push_back(childPos);
+		}
+	}
+
+	for (auto& parentAndChildren : childrenByParent)
+	{
+		removeChildrenRows(parentAndChildren.first, parentAndChildren.second);
 	}
 
 	//we restore properties view
@@ -532,6 +596,13 @@ void ccDBRoot::deleteSelectedEntities()
 	//we remove all objects that are children of other deleted ones!
 	//(otherwise we may delete the parent before the child!)
 	//TODO DGM: not sure this is still necessary with the new dependency mechanism
+	std::unordered_set<const ccHObject*> selectedObjects;
+	selectedObjects.reserve(selCount);
+	for (unsigned i = 0; i < selCount; ++i)
+	{
+		selectedObjects.insert(static_cast<ccHObject*>(selectedIndexes[i].internalPointer()));
+	}
+
 	std::vector<ccHObject*> toBeDeleted;
 	for (unsigned i = 0; i < selCount; ++i)
 	{
@@ -544,17 +615,14 @@ void ccDBRoot::deleteSelectedEntities()
 		}
 
 		//we don't consider objects that are 'descendent' of others in the selection
+		//(we only walk up the object's ancestors, instead of testing all the other selected entities)
 		bool isDescendent = false;
-		for (unsigned j = 0; j < selCount; ++j)
+		for (const ccHObject* ancestor = obj->getParent(); ancestor; ancestor = ancestor->getParent())
 		{
-			if (i != j)
+			if (selectedObjects.find(ancestor) != selectedObjects.end())
 			{
-				ccHObject* otherObj = static_cast<ccHObject*>(selectedIndexes[j].internalPointer());
-				if (otherObj->isAncestorOf(obj))
-				{
-					isDescendent = true;
-					break;
-				}
+				isDescendent = true;
+				break;
 			}
 		}
 
@@ -577,6 +645,10 @@ void ccDBRoot::deleteSelectedEntities()
 
 	qism->clear();
 
+	//we group the objects by parent (so as to remove contiguous rows at once)
+	std::vector< std::pair<ccHObject*, std::vector<int> > > childrenByParent;
+	QHash<ccHObject*, size_t> parentSlots;
+
 	while (!toBeDeleted.empty())
 	{
 		ccHObject* object = toBeDeleted.back();
@@ -599,9 +671,22 @@ void ccDBRoot::deleteSelectedEntities()
 		int childPos = parent->getChildIndex(object);
 		assert(childPos >= 0);
 
-		beginRemoveRows(index(object).parent(), childPos, childPos);
-		parent->removeChild(childPos);
-		endRemoveRows();
+		QHash<ccHObject*, size_t>::const_iterator it = parentSlots.constFind(parent);
+		if (it == parentSlots.constEnd())
+		{
+			parentSlots.insert(parent, childrenByParent.size());
+			childrenByParent.emplace_back(parent, std::vector<int>{ childPos });
+		}
+		else
+		{
+			childrenByParent[it.value()].second.push_back(childPos);
+		}
+	}
+
+	//contiguous rows are removed at once
+	for (auto& parentAndChildren : childrenByParent)
+	{
+		removeChildrenRows(parentAndChildren.first, parentAndChildren.second);
 	}
 
 	updatePropertiesView();
@@ -687,11 +772,7 @@ QVariant ccDBRoot::data(const QModelIndex &index, int role) const
 				return {};
 			}
 			
-			ccHObject::Container	drawableObjects;
-			
-			unsigned int	count = item->filterChildren( drawableObjects, true, CC_TYPES::HIERARCHY_OBJECT, true );
-			
-			if ( item->getChildCountRecursive() == count )
+			if ( isPureGroupHierarchy( item ) )
 			{
 				return {};
 			}
@@ -1052,9 +1133,192 @@ void ccDBRoot::selectEntities(const ccHObject::Container& entities, bool increme
 	selectionModel->select(newSelection,incremental ? QItemSelectionModel::Select : QItemSelectionModel::ClearAndSelect);
 }
 
+void ccDBRoot::updateIDIndex() const
+{
+	unsigned hierarchyVersion = ccHObject::GetHierarchyVersion();
+	if (m_cacheHierarchyVersion == hierarchyVersion)
+	{
+		//nothing changed since the last update
+		return;
+	}
+
+	//as an entity can't be removed from the tree without modifying
+	//its parent, the cached pointers are all valid at this point
+	m_idIndex.clear();
+	m_pureGroupCache.clear();
+
+	if (m_treeRoot)
+	{
+		std::vector<ccHObject*> toVisit{ m_treeRoot };
+		while (!toVisit.empty())
+		{
+			ccHObject* object = toVisit.back();
+			toVisit.pop_back();
+
+			m_idIndex.insert(static_cast<int>(object->getUniqueID()), object);
+			for (unsigned i = 0; i < object->getChildrenNumber(); ++i)
+			{
+				toVisit.push_back(object->getChild(i));
+			}
+		}
+	}
+
+	m_cacheHierarchyVersion = hierarchyVersion;
+}
+
 ccHObject* ccDBRoot::find(int uniqueID) const
 {
-	return m_treeRoot->find(uniqueID);
+	updateIDIndex();
+
+	ccHObject* object = m_idIndex.value(uniqueID, nullptr);
+	if (object && static_cast<int>(object->getUniqueID()) == uniqueID)
+	{
+		return object;
+	}
+
+	//the unique ID of an entity may have changed since the index was built
+	object = m_treeRoot->find(uniqueID);
+	if (object)
+	{
+		m_idIndex.insert(uniqueID, object);
+	}
+
+	return object;
+}
+
+bool ccDBRoot::isPureGroupHierarchy(const ccHObject* group) const
+{
+	assert(group);
+	updateIDIndex();
+
+	QHash<const ccHObject*, bool>::const_iterator it = m_pureGroupCache.constFind(group);
+	if (it != m_pureGroupCache.constEnd())
+	{
+		return it.value();
+	}
+
+	ccHObject::Container drawableObjects;
+	unsigned int count = group->filterChildren(drawableObjects, true, CC_TYPES::HIERARCHY_OBJECT, true);
+	bool isPure = (group->getChildCountRecursive() == count);
+
+	m_pureGroupCache.insert(group, isPure);
+	return isPure;
+}
+
+void ccDBRoot::insertChildrenRows(ccHObject* parent, std::vector<int>& childPositions)
+{
+	assert(parent);
+	if (childPositions.empty())
+	{
+		return;
+	}
+
+	//the children are already inserted: we notify the rows from the first one
+	//so that the rows preceding each range are always known by the view
+	std::sort(childPositions.begin(), childPositions.end());
+	childPositions.erase(std::unique(childPositions.begin(), childPositions.end()), childPositions.end());
+
+	QModelIndex parentIndex = index(parent);
+
+	size_t i = 0;
+	while (i < childPositions.size())
+	{
+		//look for the contiguous range of rows [first ; last]
+		int first = childPositions[i];
+		int last = first;
+		for (++i; i < childPositions.size() && childPositions[i] == last + 1; ++i)
+		{
+			last = childPositions[i];
+		}
+
+		//row insertion operation (start)
+		beginInsertRows(parentIndex, first, last);
+
+		//row insertion operation (end)
+		endInsertRows();
+	}
+}
+
+void ccDBRoot::removeChildrenRows(ccHObject* parent, std::vector<int>& childPositions)
+{
+	assert(parent);
+	if (childPositions.empty())
+	{
+		return;
+	}
+
+	//we remove the children from the last one so that the other positions remain valid
+	std::sort(childPositions.begin(), childPositions.end(), std::greater<int>());
+	childPositions.erase(std::unique(childPositions.begin(), childPositions.end()), childPositions.end());
+
+	//removing (and deleting) a child may remove other children of the same parent as well
+	//(dependencies), shifting their positions: we keep track of the children themselves
+	std::vector<ccHObject*> children;
+	children.reserve(childPositions.size());
+	for (int pos : childPositions)
+	{
+		children.push_back(parent->getChild(static_cast<unsigned>(pos)));
+	}
+
+	//returns the current position of a child (or -1 if it has already been removed)
+	auto currentPosition = [&](size_t k) -> int
+	{
+		int& pos = childPositions[k];
+		if (pos >= 0 && parent->getChild(static_cast<unsigned>(pos)) == children[k])
+		{
+			return pos;
+		}
+
+		//the child has been shifted or removed (we only compare the pointers as it may have been deleted)
+		pos = -1;
+		for (unsigned j = 0; j < parent->getChildrenNumber(); ++j)
+		{
+			if (parent->getChild(j) == children[k])
+			{
+				pos = static_cast<int>(j);
+				break;
+			}
+		}
+		return pos;
+	};
+
+	QModelIndex parentIndex = index(parent);
+
+	size_t i = 0;
+	while (i < children.size())
+	{
+		int last = currentPosition(i);
+		if (last < 0)
+		{
+			//already removed
+			++i;
+			continue;
+		}
+
+		//look for the contiguous range of rows [first ; last]
+		int first = last;
+		size_t rangeEnd = i + 1;
+		for (; rangeEnd < children.size() && currentPosition(rangeEnd) == first - 1; ++rangeEnd)
+		{
+			first = childPositions[rangeEnd];
+		}
+
+		//row removal operation (start)
+		beginRemoveRows(parentIndex, first, last);
+
+		for (; i < rangeEnd; ++i)
+		{
+			//the position is checked again before each removal
+			int pos = currentPosition(i);
+			if (pos >= 0)
+			{
+				parent->removeChild(pos);
+			}
+		}
+
+		//row removal operation (end)
+		endRemoveRows();
+	}
 }
 
 void ccDBRoot::showPropertiesView(ccHObject* obj)
@@ -1319,7 +1583,7 @@ bool ccDBRoot::dropMimeData(const QMimeData* data, Qt::DropAction action, int de
 
 		//selected item
 		int uniqueID = roleDataMap.value(Qt::UserRole).toInt();
-		ccHObject *item = m_treeRoot->find(uniqueID);
+		ccHObject *item = find(uniqueID);
 		if (!item)
 			continue;
 		//ccLog::Print(QString("[Drag & Drop] Source: %1").arg(item->getName()));
@@ -20,6 +20,7 @@
 
 //Qt
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QPoint>
 #include <QTreeView>
 
@@ -105,6 +106,12 @@ public:
 	//! Adds an element to the DB tree
 	void addElement(ccHObject* object, bool autoExpand = true);
 
+	//! Adds several elements at once to the DB tree
+	/** Faster than multiple calls to addElement (contiguous siblings
+		are inserted with a single row insertion notification).
+	**/
+	void addElements(const ccHObject::Container& objects, bool autoExpand = true);
+
 	//! Removes an element from the DB tree
 	/** Automatically calls prepareDisplayForRefresh on the object.
 	**/
@@ -247,9 +254,40 @@ protected:
                                      QString name = QString(),
                                      bool nameIsRegex = false);
 
+	//! Notifies the insertion of a set of (direct) children of a given entity
+	/** The children must already be attached to their parent. Contiguous
+		children are inserted with a single row insertion notification.
+		\param parent parent entity
+		\param childPositions positions of the inserted children (will be sorted)
+	**/
+	void insertChildrenRows(ccHObject* parent, std::vector<int>& childPositions);
+
+	//! Removes a set of (direct) children of a given entity from the DB tree
+	/** Contiguous children are removed with a single row removal
+		notification (instead of one notification per child). The position
+		of each child is checked again before its removal (as removing a
+		child may remove other children of the same parent as well).
+		\param parent parent entity
+		\param childPositions positions of the children to remove (will be sorted)
+	**/
+	void removeChildrenRows(ccHObject* parent, std::vector<int>& childPositions);
+
+	//! Rebuilds the unique ID index if the hierarchy has been modified since the last update
+	void updateIDIndex() const;
+
+	//! Returns whether a group only contains groups (recursively) and should therefore have no check box
+	bool isPureGroupHierarchy(const ccHObject* group) const;
+
 	//! Associated DB root
 	ccHObject* m_treeRoot;
 
+	//! Unique ID index (to quickly retrieve an entity of the DB tree without a recursive search)
+	mutable QHash<int, ccHObject*> m_idIndex;
+	//! Pure group hierarchies cache (see isPureGroupHierarchy)
+	mutable QHash<const ccHObject*, bool> m_pureGroupCache;
+	//! Hierarchy version the above caches correspond to (see ccHObject::GetHierarchyVersion)
+	mutable unsigned m_cacheHierarchyVersion;
+
 	//! Associated widget for DB tree
 	QTreeView* m_dbTreeWidget;
 
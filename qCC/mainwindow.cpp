@@ -7732,7 +7732,7 @@ void MainWindow::doActionCrop()
 
 void MainWindow::doActionClone()
 {
-	ccHObject* lastClone = nullptr;
+	ccHObject::Container clones;
 	
 	for ( ccHObject *entity : getSelectedEntities() )
 	{
@@ -7791,15 +7791,25 @@ void MainWindow::doActionClone()
 			clone->setGLTransformationHistory(entity->getGLTransformationHistory());
 			//copy display
 			clone->setDisplay(entity->getDisplay());
+			if (!clone->getDisplay())
+			{
+				clone->setDisplay_recursive(getActiveGLWindow());
+			}
 
-			addToDB(clone);
-			lastClone = clone;
+			clones.push_back(clone);
 		}
 	}
 
-	if (lastClone && m_ccRoot)
+	if (!clones.empty() && m_ccRoot)
 	{
-		m_ccRoot->selectEntity(lastClone);
+		//the clones are added at once to the DB tree (they are contiguous rows)
+		m_ccRoot->addElements(clones);
+		for (ccHObject* clone : clones)
+		{
+			clone->redrawDisplay();
+		}
+
+		m_ccRoot->selectEntity(clones.back());
 	}
 
 	updateUI();